@@ -0,0 +1,1247 @@
+// ***************************************************************************
+// bench_vxi11.cpp - Benchmarks of the Vxi11 class against the local
+//                   instrument simulator
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Added write_buffer suite comparing commands written one by one
+//              with write_buffer().
+//            Added poller suite comparing a fixed 1 ms readstb() loop with
+//              Vxi11Poller.
+//            Added srq_wait suite comparing a readstb() polling loop with
+//              wait_for_srq().
+//            Added query_all suite comparing query() in a loop with
+//              InstrumentGroup::query_all().
+//            Added trigger suite comparing trigger() in a loop with
+//              InstrumentGroup::trigger_all().
+//            Added syscalls suite comparing tirpc, io_uring and epoll.
+//            Added query_latency_bare suite with a Vxi11Bare link.
+//            Added -T socket to run the suites over the raw SCPI socket.
+//            Added -T option to run the suites over HiSLIP.
+//            Added contention suite, with -t and -l options.
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Usage: bench_vxi11 [-q] [-o file] [-d delay_us] [-t threads] [-l links]
+//                    [-T transport] [suite]...
+//
+//   -q  Quick run with fewer iterations, for a smoke test
+//   -o  Write the JSON results to file instead of stdout
+//   -d  Simulator latency in us of each read for the scaling suite, of
+//       each write, read and readstb for the contention suite, and of each
+//       write for the write_buffer suite, default 200
+//   -t  Number of threads for the contention suite
+//   -l  Number of links for the contention suite
+//       Without -t and -l, a fixed set of thread and link counts is run.
+//   -T  Transport to the simulator, "vxi11" (default), "hislip" or "socket"
+//
+// Suites (default all):
+//   query_latency  Round trip time of "*IDN?" queries, with percentiles
+//   query_latency_bare
+//                  Same with Vxi11Bare, which has no lock, error logging,
+//                  tracing or counters
+//   write          write() MB/s across payload sizes and maxRecvSize values
+//   read           read() MB/s across payload sizes and maxRecvSize values
+//   write_buffer   Time and device_write calls of 50 commands and "*OPC?",
+//                  each command written on its own and with write_buffer(),
+//                  with the -d latency on each write
+//   readstb        readstb() rate
+//   open_close     Cost of open() and close()
+//   scaling        Query rate with N threads, each on its own link
+//   contention     Mixed query, write, read and readstb traffic from T
+//                  threads over L links, with the time spent waiting for
+//                  the library RPC mutex
+//   srq_wait       Time and readstb calls to wait for operation complete,
+//                  polling readstb() and with wait_for_srq()
+//   poller         Time and readstb calls until operation complete is seen
+//                  on 4 devices, polling every 1 ms and with Vxi11Poller
+//   syscalls       System calls per query over the core channel with the
+//                  tirpc, io_uring and epoll transports, one link at a time
+//                  and batched over several links (Linux only)
+//   trigger        Skew between the first and last of 16 devices
+//                  triggered with trigger() in a loop and with
+//                  InstrumentGroup::trigger_all() (Linux only)
+//   query_all      Time to query 8 devices with the -d latency, with
+//                  query() in a loop and with InstrumentGroup::query_all()
+//                  (Linux only)
+//
+// The results are written as one JSON object with a "results" array, one
+// entry per measurement, so runs can be compared to track regressions.  A
+// summary is printed to stderr.  Run with "make bench".
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_sim.h"
+#include "vxi11_poller.h"
+#ifdef __linux__
+#include "vxi11_uring.h"
+#include "vxi11_group.h"
+#include "vxi11_rpc.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <vector>
+
+static Vxi11Sim _sim;                   // Local instrument simulator
+static char _s_addr[64];                // "127.0.0.1:port" of _sim
+static char _s_device[64];              // Device name, empty for default
+static const char *_s_transport = "vxi11"; // vxi11, hislip or socket
+static bool _b_quick = false;           // Fewer iterations
+static int _delay_us = 200;             // Simulator latency for scaling
+                                        // and contention
+static int _cnt_thread = 0;             // Threads for contention, 0 = set
+static int _cnt_link = 0;               // Links for contention, 0 = set
+static FILE *_p_file_json = 0;          // JSON output
+static int _cnt_result = 0;             // Results written so far
+
+static long long time_ns (void) { return (Vxi11Tracer::time_ns ()); }
+
+// ***************************************************************************
+// result - Write one result to the JSON output
+//
+// Parameters:
+// 1. s_suite  - Name of the suite
+// 2. s_format - printf format of the other members, without braces
+//
+// Returns: None
+// ***************************************************************************
+static void
+result (const char *s_suite, const char *s_format, ...)
+{
+  fprintf (_p_file_json, "%s\n  {\"suite\":\"%s\",",
+           (_cnt_result++) ? "," : "", s_suite);
+  va_list args;
+  va_start (args, s_format);
+  vfprintf (_p_file_json, s_format, args);
+  va_end (args);
+  fputs ("}", _p_file_json);
+}
+
+// ***************************************************************************
+// Latency statistics, in us
+// ***************************************************************************
+struct Latency {
+  double mean, p50, p90, p99, max;
+};
+
+static Latency
+latency (std::vector<long long> &a_t_ns)
+{
+  Latency lat = {0, 0, 0, 0, 0};
+  if (a_t_ns.empty ())
+    return (lat);
+  std::sort (a_t_ns.begin (), a_t_ns.end ());
+  double sum = 0;
+  for (size_t i=0; i < a_t_ns.size (); i++)
+    sum += a_t_ns[i];
+  size_t cnt = a_t_ns.size ();
+  lat.mean = sum / cnt / 1000.0;
+  lat.p50 = a_t_ns[cnt * 50 / 100] / 1000.0;
+  lat.p90 = a_t_ns[cnt * 90 / 100] / 1000.0;
+  lat.p99 = a_t_ns[cnt * 99 / 100] / 1000.0;
+  lat.max = a_t_ns[cnt - 1] / 1000.0;
+  return (lat);
+}
+
+// ***************************************************************************
+// open_link - Open a link to the simulator
+// ***************************************************************************
+template <class V> static int
+open_link (V &vxi11)
+{
+  if (vxi11.open (_s_addr, (_s_device[0]) ? _s_device : 0)) {
+    fprintf (stderr, "bench_vxi11: could not open %s %s\n", _s_addr,
+             _s_device);
+    return (1);
+    }
+  vxi11.timeout (10);
+  return (0);
+}
+
+// ***************************************************************************
+// query_latency - Round trip time of queries with link type V
+// ***************************************************************************
+template <class V> static int
+query_latency (const char *s_suite)
+{
+  V vxi11;
+  if (open_link (vxi11))
+    return (1);
+
+  int cnt = (_b_quick) ? 200 : 5000;
+  std::vector<long long> a_t_ns;
+  a_t_ns.reserve (cnt);
+  char s_resp[256];
+  for (int i=0; i < cnt; i++) {
+    long long t_begin_ns = time_ns ();
+    if (vxi11.query ("*IDN?", s_resp, sizeof (s_resp)))
+      return (1);
+    a_t_ns.push_back (time_ns () - t_begin_ns);
+    }
+
+  Latency lat = latency (a_t_ns);
+  result (s_suite, "\"count\":%d,\"mean_us\":%.1f,\"p50_us\":%.1f,"
+          "\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f", cnt, lat.mean,
+          lat.p50, lat.p90, lat.p99, lat.max);
+  fprintf (stderr, "%s: p50 %.1f us, p99 %.1f us\n", s_suite, lat.p50,
+           lat.p99);
+  return (0);
+}
+
+static int bench_query_latency (void) {
+  return (query_latency<Vxi11> ("query_latency"));
+}
+static int bench_query_latency_bare (void) {
+  return (query_latency<Vxi11Bare> ("query_latency_bare"));
+}
+
+// ***************************************************************************
+// bench_transfer - write() or read() MB/s across payload sizes and
+//                  maxRecvSize values
+// ***************************************************************************
+static int
+bench_transfer (bool b_write)
+{
+  const int a_size[] = {64, 1024, 16384, 262144, 1048576, 4194304};
+  const unsigned long a_max_recv_size[] = {1024, 16384, 262144, 1048576};
+  const int cnt_size = sizeof (a_size) / sizeof (a_size[0]);
+  const int cnt_max = sizeof (a_max_recv_size) / sizeof (a_max_recv_size[0]);
+  const char *s_suite = (b_write) ? "write" : "read";
+
+  std::vector<char> ac_data (a_size[cnt_size - 1] + 64, 'x');
+  unsigned long max_recv_size_default = _sim.max_recv_size ();
+
+  for (int idx_max=0; idx_max < cnt_max; idx_max++) {
+    _sim.max_recv_size (a_max_recv_size[idx_max]);
+    Vxi11 vxi11;                        // maxRecvSize is set by create_link
+    if (open_link (vxi11))
+      return (1);
+
+    for (int idx_size=0; idx_size < cnt_size; idx_size++) {
+      int size = a_size[idx_size];
+      long long cnt_bytes_min = (_b_quick) ? (1 << 20) : (32 << 20);
+      int cnt = (int)std::max (20LL, cnt_bytes_min / size);
+      char s_cmd[32];
+      snprintf (s_cmd, sizeof (s_cmd), "DATA? %d", size);
+
+      long long t_total_ns = 0;
+      for (int i=0; i < cnt; i++) {
+        if (b_write) {
+          long long t_begin_ns = time_ns ();
+          if (vxi11.write (&ac_data[0], size))
+            return (1);
+          t_total_ns += time_ns () - t_begin_ns;
+          }
+        else {
+          // Only time the read of the block, not the query sent before it
+          if (vxi11.printf ("%s", s_cmd))
+            return (1);
+          int cnt_read = 0;
+          long long t_begin_ns = time_ns ();
+          if (vxi11.read (&ac_data[0], ac_data.size (), &cnt_read))
+            return (1);
+          t_total_ns += time_ns () - t_begin_ns;
+          }
+        }
+
+      double mb_per_s = (double)size * cnt / 1e6 / (t_total_ns / 1e9);
+      result (s_suite, "\"size\":%d,\"max_recv_size\":%lu,\"count\":%d,"
+              "\"mean_us\":%.1f,\"mb_per_s\":%.2f", size,
+              a_max_recv_size[idx_max], cnt, t_total_ns / 1000.0 / cnt,
+              mb_per_s);
+      fprintf (stderr, "%s: size %7d, maxRecvSize %7lu: %8.2f MB/s\n",
+               s_suite, size, a_max_recv_size[idx_max], mb_per_s);
+      }
+    }
+
+  _sim.max_recv_size (max_recv_size_default);
+  return (0);
+}
+
+static int bench_write (void) { return (bench_transfer (true)); }
+static int bench_read (void) { return (bench_transfer (false)); }
+
+// ***************************************************************************
+// bench_write_buffer - Time and device_write calls of a configuration
+//                      sequence of 50 commands and "*OPC?", with each
+//                      command written on its own and with write_buffer()
+// ***************************************************************************
+static int
+bench_write_buffer (void)
+{
+  const int cnt_cmd = 50;
+  int cnt = (_b_quick) ? 10 : 200;
+  _sim.latency (Vxi11Sim::OP_WRITE, _delay_us);
+
+  for (int b_buffer=0; b_buffer < 2; b_buffer++) {
+    Vxi11 vxi11;
+    if (open_link (vxi11) || vxi11.write_buffer (b_buffer))
+      return (1);
+
+    unsigned long cnt_write = _sim.count (Vxi11Sim::OP_WRITE);
+    std::vector<long long> a_t_ns;
+    for (int i=0; i < cnt; i++) {
+      long long t_begin_ns = time_ns ();
+      for (int idx=0; idx < cnt_cmd; idx++)
+        if (vxi11.printf ("*ESE %d", idx))
+          return (1);
+      std::string s_opc;
+      if (vxi11.query ("*OPC?", s_opc))
+        return (1);
+      a_t_ns.push_back (time_ns () - t_begin_ns);
+      }
+    cnt_write = _sim.count (Vxi11Sim::OP_WRITE) - cnt_write;
+
+    Latency lat = latency (a_t_ns);
+    const char *s_mode = (b_buffer) ? "buffered" : "unbuffered";
+    result ("write_buffer", "\"mode\":\"%s\",\"commands\":%d,\"count\":%d,"
+            "\"writes_per_sequence\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f",
+            s_mode, cnt_cmd, cnt, (double)cnt_write / cnt, lat.p50,
+            lat.p99);
+    fprintf (stderr, "write_buffer: %-10s %5.1f writes, p50 %8.1f us\n",
+             s_mode, (double)cnt_write / cnt, lat.p50);
+    }
+
+  _sim.latency (Vxi11Sim::OP_WRITE, 0);
+  return (0);
+}
+
+// ***************************************************************************
+// bench_readstb - readstb() rate
+// ***************************************************************************
+static int
+bench_readstb (void)
+{
+  Vxi11 vxi11;
+  if (open_link (vxi11))
+    return (1);
+
+  int cnt = (_b_quick) ? 200 : 5000;
+  long long t_begin_ns = time_ns ();
+  for (int i=0; i < cnt; i++)
+    if (vxi11.readstb () < 0)
+      return (1);
+  long long t_ns = time_ns () - t_begin_ns;
+
+  double ops_per_s = cnt / (t_ns / 1e9);
+  result ("readstb", "\"count\":%d,\"mean_us\":%.1f,\"ops_per_s\":%.0f", cnt,
+          t_ns / 1000.0 / cnt, ops_per_s);
+  fprintf (stderr, "readstb: %.0f/s\n", ops_per_s);
+  return (0);
+}
+
+// ***************************************************************************
+// bench_open_close - Cost of open() and close()
+// ***************************************************************************
+static int
+bench_open_close (void)
+{
+  int cnt = (_b_quick) ? 20 : 500;
+  std::vector<long long> a_t_open_ns, a_t_close_ns;
+  for (int i=0; i < cnt; i++) {
+    Vxi11 vxi11;
+    long long t_begin_ns = time_ns ();
+    if (open_link (vxi11))
+      return (1);
+    long long t_open_ns = time_ns ();
+    vxi11.close ();
+    a_t_open_ns.push_back (t_open_ns - t_begin_ns);
+    a_t_close_ns.push_back (time_ns () - t_open_ns);
+    }
+
+  Latency lat_open = latency (a_t_open_ns);
+  Latency lat_close = latency (a_t_close_ns);
+  result ("open_close", "\"count\":%d,\"open_mean_us\":%.1f,"
+          "\"open_p99_us\":%.1f,\"close_mean_us\":%.1f,\"close_p99_us\":%.1f",
+          cnt, lat_open.mean, lat_open.p99, lat_close.mean, lat_close.p99);
+  fprintf (stderr, "open_close: open %.1f us, close %.1f us\n",
+           lat_open.mean, lat_close.mean);
+  return (0);
+}
+
+// ***************************************************************************
+// bench_scaling - Query rate with N threads, each on its own link
+// ***************************************************************************
+struct ScalingThread {
+  Vxi11 *p_vxi11;                       // Link of this thread
+  volatile bool *pb_stop;               // Set to stop
+  int cnt_op;                           // Returns number of queries
+  int err;                              // Returns 1 on error
+};
+
+static void *
+fn_scaling (void *p_arg)
+{
+  ScalingThread *p_thread = (ScalingThread *)p_arg;
+  char s_resp[256];
+  while (!*p_thread->pb_stop) {
+    if (p_thread->p_vxi11->query ("*IDN?", s_resp, sizeof (s_resp))) {
+      p_thread->err = 1;
+      break;
+      }
+    p_thread->cnt_op++;
+    }
+  return (0);
+}
+
+static int
+bench_scaling (void)
+{
+  const int a_cnt_link[] = {1, 2, 4, 8};
+  const int cnt_cnt_link = sizeof (a_cnt_link) / sizeof (a_cnt_link[0]);
+  int t_run_ms = (_b_quick) ? 200 : 2000;
+
+  _sim.latency (Vxi11Sim::OP_READ, _delay_us);
+  double ops_per_s_1 = 0;
+  int err = 0;
+
+  for (int idx=0; idx < cnt_cnt_link && !err; idx++) {
+    int cnt_link = a_cnt_link[idx];
+    std::vector<Vxi11> a_vxi11 (cnt_link);
+    std::vector<ScalingThread> a_thread (cnt_link);
+    std::vector<pthread_t> a_pthread (cnt_link);
+    volatile bool b_stop = false;
+
+    for (int i=0; i < cnt_link && !err; i++)
+      err = open_link (a_vxi11[i]);
+    if (err)
+      break;
+
+    long long t_begin_ns = time_ns ();
+    for (int i=0; i < cnt_link; i++) {
+      a_thread[i].p_vxi11 = &a_vxi11[i];
+      a_thread[i].pb_stop = &b_stop;
+      a_thread[i].cnt_op = 0;
+      a_thread[i].err = 0;
+      pthread_create (&a_pthread[i], NULL, fn_scaling, &a_thread[i]);
+      }
+    usleep (t_run_ms * 1000);
+    b_stop = true;
+    int cnt_op = 0;
+    for (int i=0; i < cnt_link; i++) {
+      pthread_join (a_pthread[i], NULL);
+      cnt_op += a_thread[i].cnt_op;
+      err |= a_thread[i].err;
+      }
+    long long t_ns = time_ns () - t_begin_ns;
+
+    double ops_per_s = cnt_op / (t_ns / 1e9);
+    if (cnt_link == 1)
+      ops_per_s_1 = ops_per_s;
+    double speedup = (ops_per_s_1 > 0) ? ops_per_s / ops_per_s_1 : 0;
+    result ("scaling", "\"links\":%d,\"delay_us\":%d,\"count\":%d,"
+            "\"ops_per_s\":%.0f,\"speedup\":%.2f", cnt_link, _delay_us,
+            cnt_op, ops_per_s, speedup);
+    fprintf (stderr, "scaling: %d links, %.0f queries/s, speedup %.2f\n",
+             cnt_link, ops_per_s, speedup);
+    }
+
+  _sim.latency (Vxi11Sim::OP_READ, 0);
+  return (err);
+}
+
+// ***************************************************************************
+// bench_contention - Mixed traffic from T threads over L links
+//
+// Thread i uses link i % L.  Threads sharing a link take turns with a
+// mutex of the link around each operation, so that the query of one thread
+// is not read by another.  The time spent waiting for the library RPC
+// mutex is measured separately with a Vxi11Tracer.
+// ***************************************************************************
+enum {OP_QUERY, OP_WRITE, OP_READ, OP_READSTB, CNT_OP_MIX};
+static const char *_as_op_mix[CNT_OP_MIX] = {"query", "write", "read",
+                                             "readstb"};
+
+// Tracer collecting the RPC mutex waits of each thread
+static __thread std::vector<long long> *_pa_t_wait_ns = 0;
+
+class ContentionTracer : public Vxi11Tracer {
+ public:
+  void rpc_begin (const Vxi11TraceEvent &event) {}
+  void rpc_end (const Vxi11TraceEvent &event) {}
+  void mutex_wait (long long t_begin_ns, long long t_end_ns) {
+    if (_pa_t_wait_ns)
+      _pa_t_wait_ns->push_back (t_end_ns - t_begin_ns);
+    }
+};
+
+struct ContentionThread {
+  Vxi11 *p_vxi11;                       // Link used by this thread
+  pthread_mutex_t *p_mutex_link;        // Mutex of the link
+  volatile bool *pb_stop;               // Set to stop
+  unsigned int seed;                    // Random operation mix
+  std::vector<long long> a_t_ns[CNT_OP_MIX]; // Returns latency of each op
+  std::vector<long long> a_t_wait_ns;   // Returns RPC mutex waits
+  long long t_link_wait_ns;             // Returns time waiting for the link
+  int err;                              // Returns 1 on error
+};
+
+static void *
+fn_contention (void *p_arg)
+{
+  ContentionThread *p_thread = (ContentionThread *)p_arg;
+  Vxi11 *p_vxi11 = p_thread->p_vxi11;
+  _pa_t_wait_ns = &p_thread->a_t_wait_ns;
+  char ac_data[2048];
+  int cnt_read;
+
+  while (!*p_thread->pb_stop && !p_thread->err) {
+    // Mix of 40% query, 20% write, 20% read, 20% readstb
+    int r = rand_r (&p_thread->seed) % 10;
+    int op = (r < 4) ? OP_QUERY : (r < 6) ? OP_WRITE :
+             (r < 8) ? OP_READ : OP_READSTB;
+
+    long long t_begin_ns = time_ns ();
+    pthread_mutex_lock (p_thread->p_mutex_link);
+    long long t_lock_ns = time_ns ();
+    switch (op) {
+    case OP_QUERY:
+      p_thread->err = p_vxi11->query ("*IDN?", ac_data, sizeof (ac_data));
+      break;
+    case OP_WRITE:
+      p_thread->err = p_vxi11->printf ("*CLS");
+      break;
+    case OP_READ:                       // Read a 1 kB block
+      p_thread->err = p_vxi11->printf ("DATA? 1024") ||
+                      p_vxi11->read (ac_data, sizeof (ac_data), &cnt_read);
+      break;
+    case OP_READSTB:
+      p_thread->err = (p_vxi11->readstb () < 0);
+      break;
+      }
+    pthread_mutex_unlock (p_thread->p_mutex_link);
+    long long t_end_ns = time_ns ();
+
+    p_thread->t_link_wait_ns += t_lock_ns - t_begin_ns;
+    p_thread->a_t_ns[op].push_back (t_end_ns - t_begin_ns);
+    }
+
+  _pa_t_wait_ns = 0;
+  return (0);
+}
+
+// Run T threads over L links
+static int
+contention (int cnt_thread, int cnt_link)
+{
+  int t_run_ms = (_b_quick) ? 300 : 2000;
+  std::vector<Vxi11> a_vxi11 (cnt_link);
+  std::vector<pthread_mutex_t> a_mutex_link (cnt_link);
+  std::vector<ContentionThread> a_thread (cnt_thread);
+  std::vector<pthread_t> a_pthread (cnt_thread);
+  volatile bool b_stop = false;
+
+  for (int i=0; i < cnt_link; i++) {
+    if (open_link (a_vxi11[i]))
+      return (1);
+    pthread_mutex_init (&a_mutex_link[i], NULL);
+    }
+
+  long long t_begin_ns = time_ns ();
+  for (int i=0; i < cnt_thread; i++) {
+    a_thread[i].p_vxi11 = &a_vxi11[i % cnt_link];
+    a_thread[i].p_mutex_link = &a_mutex_link[i % cnt_link];
+    a_thread[i].pb_stop = &b_stop;
+    a_thread[i].seed = i + 1;
+    a_thread[i].t_link_wait_ns = 0;
+    a_thread[i].err = 0;
+    pthread_create (&a_pthread[i], NULL, fn_contention, &a_thread[i]);
+    }
+  usleep (t_run_ms * 1000);
+  b_stop = true;
+  for (int i=0; i < cnt_thread; i++)
+    pthread_join (a_pthread[i], NULL);
+  long long t_ns = time_ns () - t_begin_ns;
+
+  // Combine the threads
+  int err = 0;
+  std::vector<long long> a_t_all_ns, a_t_op_ns[CNT_OP_MIX], a_t_wait_ns;
+  long long t_link_wait_ns = 0;
+  for (int i=0; i < cnt_thread; i++) {
+    err |= a_thread[i].err;
+    for (int op=0; op < CNT_OP_MIX; op++) {
+      a_t_op_ns[op].insert (a_t_op_ns[op].end (), a_thread[i].a_t_ns[op].begin (),
+                            a_thread[i].a_t_ns[op].end ());
+      a_t_all_ns.insert (a_t_all_ns.end (), a_thread[i].a_t_ns[op].begin (),
+                         a_thread[i].a_t_ns[op].end ());
+      }
+    a_t_wait_ns.insert (a_t_wait_ns.end (), a_thread[i].a_t_wait_ns.begin (),
+                        a_thread[i].a_t_wait_ns.end ());
+    t_link_wait_ns += a_thread[i].t_link_wait_ns;
+    }
+  for (int i=0; i < cnt_link; i++)
+    pthread_mutex_destroy (&a_mutex_link[i]);
+  if (err) {
+    fprintf (stderr, "bench_vxi11: contention error\n");
+    return (1);
+    }
+
+  long long t_wait_ns = 0;
+  for (size_t i=0; i < a_t_wait_ns.size (); i++)
+    t_wait_ns += a_t_wait_ns[i];
+  size_t cnt_op = a_t_all_ns.size ();
+  double ops_per_s = cnt_op / (t_ns / 1e9);
+  double t_thread_ms = (double)t_ns / 1e6 * cnt_thread;
+  Latency lat = latency (a_t_all_ns);
+  Latency lat_wait = latency (a_t_wait_ns);
+  std::sort (a_t_all_ns.begin (), a_t_all_ns.end ());
+  double p999_us = (cnt_op) ? a_t_all_ns[cnt_op * 999 / 1000] / 1000.0 : 0;
+
+  fprintf (_p_file_json, "%s\n  {\"suite\":\"contention\",\"threads\":%d,"
+           "\"links\":%d,\"delay_us\":%d,\"count\":%zu,\"ops_per_s\":%.0f,"
+           "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,"
+           "\"max_us\":%.1f,\"mutex_wait_ms\":%.1f,\"mutex_wait_pct\":%.1f,"
+           "\"mutex_wait_p99_us\":%.1f,\"link_wait_ms\":%.1f,\"ops\":{",
+           (_cnt_result++) ? "," : "", cnt_thread, cnt_link, _delay_us,
+           cnt_op, ops_per_s, lat.p50, lat.p99, p999_us, lat.max,
+           t_wait_ns / 1e6, 100.0 * t_wait_ns / 1e6 / t_thread_ms,
+           lat_wait.p99, t_link_wait_ns / 1e6);
+  for (int op=0; op < CNT_OP_MIX; op++) {
+    Latency lat_op = latency (a_t_op_ns[op]);
+    fprintf (_p_file_json, "%s\"%s\":{\"count\":%zu,\"p50_us\":%.1f,"
+             "\"p99_us\":%.1f}", (op) ? "," : "", _as_op_mix[op],
+             a_t_op_ns[op].size (), lat_op.p50, lat_op.p99);
+    }
+  fputs ("}}", _p_file_json);
+
+  fprintf (stderr, "contention: %2d threads, %2d links: %7.0f ops/s, "
+           "p99 %8.1f us, RPC mutex wait %5.1f%%\n", cnt_thread, cnt_link,
+           ops_per_s, lat.p99, 100.0 * t_wait_ns / 1e6 / t_thread_ms);
+  return (0);
+}
+
+static int
+bench_contention (void)
+{
+  const int a_cnt[][2] = {{1, 1}, {4, 1}, {4, 4}, {16, 4}, {16, 16}};
+  const int cnt_cnt = sizeof (a_cnt) / sizeof (a_cnt[0]);
+
+  ContentionTracer tracer;
+  Vxi11Tracer *p_tracer_prev = Vxi11::tracer ();
+  Vxi11::tracer (&tracer);
+  _sim.latency (Vxi11Sim::OP_WRITE, _delay_us);
+  _sim.latency (Vxi11Sim::OP_READ, _delay_us);
+  _sim.latency (Vxi11Sim::OP_READSTB, _delay_us);
+
+  int err = 0;
+  if (_cnt_thread || _cnt_link)
+    err = contention ((_cnt_thread) ? _cnt_thread : 1,
+                      (_cnt_link) ? _cnt_link : 1);
+  else
+    for (int i=0; i < cnt_cnt && !err; i++)
+      err = contention (a_cnt[i][0], a_cnt[i][1]);
+
+  _sim.latency (Vxi11Sim::OP_WRITE, 0);
+  _sim.latency (Vxi11Sim::OP_READ, 0);
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  Vxi11::tracer (p_tracer_prev);
+  return (err);
+}
+
+// ***************************************************************************
+// bench_srq_wait - Waiting for operation complete by polling readstb() and
+//                  with wait_for_srq()
+//
+// "*OPC" completes after 2 ms in the simulator.  The polling loop reads the
+// status byte until ESB is set; wait_for_srq() sleeps until the SRQ.
+// ***************************************************************************
+static int
+bench_srq_wait (void)
+{
+  if (!strcmp (_s_transport, "socket")) {
+    fprintf (stderr, "srq_wait: not with -T socket\n");
+    return (0);
+    }
+  const int opc_delay_us = 2000;
+  int cnt = (_b_quick) ? 5 : 100;
+
+  Vxi11 vxi11;
+  if (open_link (vxi11))
+    return (1);
+
+  _sim.opc_delay (opc_delay_us);
+  std::vector<long long> a_t_poll_ns, a_t_srq_ns;
+  unsigned long cnt_readstb_poll = 0, cnt_readstb_srq = 0;
+  int err = 0;
+  for (int i=0; i < cnt && !err; i++) {
+    for (int b_srq=0; b_srq < 2 && !err; b_srq++) {
+      unsigned long cnt_readstb = _sim.count (Vxi11Sim::OP_READSTB);
+      long long t_begin_ns = time_ns ();
+      err = vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC");
+      if (b_srq)
+        err |= (vxi11.wait_for_srq (0x20, 1.0) < 0);
+      else {
+        int stb = 0;
+        while (!err && !(stb & 0x20)) {
+          stb = vxi11.readstb ();
+          err = (stb < 0);
+          }
+        }
+      long long t_ns = time_ns () - t_begin_ns;
+      cnt_readstb = _sim.count (Vxi11Sim::OP_READSTB) - cnt_readstb;
+      (b_srq ? a_t_srq_ns : a_t_poll_ns).push_back (t_ns);
+      (b_srq ? cnt_readstb_srq : cnt_readstb_poll) += cnt_readstb;
+      }
+    }
+  _sim.opc_delay (0);
+  vxi11.enable_srq (false);
+  if (err)
+    return (1);
+
+  Latency lat_poll = latency (a_t_poll_ns);
+  Latency lat_srq = latency (a_t_srq_ns);
+  result ("srq_wait", "\"opc_delay_us\":%d,\"count\":%d,"
+          "\"poll_p50_us\":%.1f,\"poll_readstb_per_wait\":%.1f,"
+          "\"srq_p50_us\":%.1f,\"srq_readstb_per_wait\":%.1f",
+          opc_delay_us, cnt, lat_poll.p50, double (cnt_readstb_poll) / cnt,
+          lat_srq.p50, double (cnt_readstb_srq) / cnt);
+  fprintf (stderr, "srq_wait: poll %.1f us with %.1f readstb, "
+           "wait_for_srq %.1f us with %.1f readstb\n", lat_poll.p50,
+           double (cnt_readstb_poll) / cnt, lat_srq.p50,
+           double (cnt_readstb_srq) / cnt);
+  return (0);
+}
+
+// ***************************************************************************
+// bench_poller - Waiting for operation complete on several devices by
+//                polling readstb() every 1 ms and with Vxi11Poller
+//
+// "*OPC" completes after 20 ms in the simulator on each of 4 devices, all
+// started together.  The time is from the start until the last device is
+// seen complete.
+// ***************************************************************************
+static const int CNT_POLLER_LINK = 4;
+
+// Vxi11Poller completion function: count the devices complete
+struct PollerDone {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int cnt_done;
+  bool b_err;
+};
+static void
+poller_done (Vxi11 *p_vxi11, int stb, void *p_arg)
+{
+  PollerDone *p_done = (PollerDone *)p_arg;
+  pthread_mutex_lock (&p_done->mutex);
+  p_done->cnt_done++;
+  p_done->b_err |= (stb < 0);
+  pthread_cond_signal (&p_done->cond);
+  pthread_mutex_unlock (&p_done->mutex);
+}
+
+static int
+bench_poller (void)
+{
+  if (strcmp (_s_transport, "vxi11")) {
+    fprintf (stderr, "poller: only with -T vxi11\n");
+    return (0);
+    }
+  const int opc_delay_us = 20000;
+  int cnt = (_b_quick) ? 3 : 50;
+
+  Vxi11 a_vxi11[CNT_POLLER_LINK];
+  for (int i=0; i < CNT_POLLER_LINK; i++) {
+    char s_device[16];
+    snprintf (s_device, sizeof (s_device), "inst%d", i);
+    if (a_vxi11[i].open (_s_addr, s_device)) {
+      fprintf (stderr, "bench_vxi11: could not open %s %s\n", _s_addr,
+               s_device);
+      return (1);
+      }
+    }
+
+  Vxi11Poller poller;
+  PollerDone done;
+  pthread_mutex_init (&done.mutex, NULL);
+  pthread_cond_init (&done.cond, NULL);
+  done.b_err = false;
+
+  _sim.opc_delay (opc_delay_us);
+  std::vector<long long> a_t_fixed_ns, a_t_poller_ns;
+  unsigned long cnt_readstb_fixed = 0, cnt_readstb_poller = 0;
+  int err = 0;
+  for (int i=0; i < cnt && !err; i++) {
+    for (int b_poller=0; b_poller < 2 && !err; b_poller++) {
+      unsigned long cnt_readstb = _sim.count (Vxi11Sim::OP_READSTB);
+      long long t_begin_ns = time_ns ();
+      for (int j=0; j < CNT_POLLER_LINK; j++)
+        err |= a_vxi11[j].printf ("*CLS;*ESE 1;*OPC");
+
+      if (b_poller) {
+        done.cnt_done = 0;
+        for (int j=0; j < CNT_POLLER_LINK && !err; j++)
+          err = poller.watch (&a_vxi11[j], 0x20, &poller_done, &done, 1.0);
+        pthread_mutex_lock (&done.mutex);
+        while (!err && done.cnt_done < CNT_POLLER_LINK)
+          pthread_cond_wait (&done.cond, &done.mutex);
+        pthread_mutex_unlock (&done.mutex);
+        err |= done.b_err;
+        }
+      else {
+        bool ab_done[CNT_POLLER_LINK] = {};
+        for (int cnt_done=0; !err && cnt_done < CNT_POLLER_LINK; ) {
+          for (int j=0; j < CNT_POLLER_LINK && !err; j++) {
+            if (ab_done[j])
+              continue;
+            int stb = a_vxi11[j].readstb ();
+            err = (stb < 0);
+            if (stb & 0x20) {
+              ab_done[j] = true;
+              cnt_done++;
+              }
+            }
+          if (cnt_done < CNT_POLLER_LINK)
+            usleep (1000);
+          }
+        }
+
+      long long t_ns = time_ns () - t_begin_ns;
+      cnt_readstb = _sim.count (Vxi11Sim::OP_READSTB) - cnt_readstb;
+      (b_poller ? a_t_poller_ns : a_t_fixed_ns).push_back (t_ns);
+      (b_poller ? cnt_readstb_poller : cnt_readstb_fixed) += cnt_readstb;
+      }
+    }
+  _sim.opc_delay (0);
+  for (int i=0; i < CNT_POLLER_LINK; i++)
+    poller.remove (&a_vxi11[i]);
+  Vxi11PollerStats stats = poller.stats ();
+  pthread_cond_destroy (&done.cond);
+  pthread_mutex_destroy (&done.mutex);
+  if (err)
+    return (1);
+
+  Latency lat_fixed = latency (a_t_fixed_ns);
+  Latency lat_poller = latency (a_t_poller_ns);
+  double d_div = double (cnt) * CNT_POLLER_LINK;
+  result ("poller", "\"links\":%d,\"opc_delay_us\":%d,\"count\":%d,"
+          "\"fixed_p50_us\":%.1f,\"fixed_readstb_per_op\":%.1f,"
+          "\"poller_p50_us\":%.1f,\"poller_readstb_per_op\":%.1f,"
+          "\"poller_coalesced\":%lu", CNT_POLLER_LINK, opc_delay_us, cnt,
+          lat_fixed.p50, cnt_readstb_fixed / d_div, lat_poller.p50,
+          cnt_readstb_poller / d_div, stats.cnt_coalesce);
+  fprintf (stderr, "poller: fixed 1 ms %.1f us with %.1f readstb, "
+           "Vxi11Poller %.1f us with %.1f readstb per device\n",
+           lat_fixed.p50, cnt_readstb_fixed / d_div, lat_poller.p50,
+           cnt_readstb_poller / d_div);
+  return (0);
+}
+
+#ifdef __linux__
+// ***************************************************************************
+// bench_syscalls - System calls per query with each transport
+//
+// The io_uring and epoll transports count their system calls.  For tirpc,
+// the read() and write() calls of this thread are taken from
+// /proc/thread-self/io; tirpc polls the socket before each read(), which
+// is added.  The batched runs query every link of a Vxi11Uring with one
+// wait() for the device_write calls and one for the device_read calls.
+// ***************************************************************************
+
+// Get the read and write system calls of this thread so far
+static long long
+syscalls_tirpc (void)
+{
+  FILE *p_file = fopen ("/proc/thread-self/io", "r");
+  if (!p_file)
+    return (0);
+  char s_line[128];
+  long long cnt_read = 0, cnt_write = 0, cnt;
+  while (fgets (s_line, sizeof (s_line), p_file)) {
+    if (sscanf (s_line, "syscr: %lld", &cnt) == 1)
+      cnt_read = cnt;
+    else if (sscanf (s_line, "syscw: %lld", &cnt) == 1)
+      cnt_write = cnt;
+    }
+  fclose (p_file);
+  return (2 * cnt_read + cnt_write);    // poll() before each read()
+}
+
+// Queries on one link, with p_uring null for tirpc
+static int
+syscalls_link (const char *s_transport, Vxi11Uring *p_uring)
+{
+  Vxi11 vxi11;
+  if (vxi11.open (_s_addr, 0, (p_uring) ? new Vxi11TransportUring (p_uring)
+                                        : 0)) {
+    fprintf (stderr, "bench_vxi11: could not open %s\n", _s_addr);
+    return (1);
+    }
+  vxi11.timeout (10);
+
+  int cnt = (_b_quick) ? 200 : 5000;
+  char s_resp[256];
+  if (p_uring)
+    p_uring->stats_reset ();
+  long long cnt_syscall = syscalls_tirpc ();
+  long long t_begin_ns = time_ns ();
+  for (int i=0; i < cnt; i++)
+    if (vxi11.query ("*IDN?", s_resp, sizeof (s_resp)))
+      return (1);
+  long long t_ns = time_ns () - t_begin_ns;
+  cnt_syscall = (p_uring) ? (long long)p_uring->stats ().cnt_syscall :
+                syscalls_tirpc () - cnt_syscall;
+
+  double syscalls_per_query = (double)cnt_syscall / cnt;
+  result ("syscalls", "\"transport\":\"%s\",\"links\":1,\"count\":%d,"
+          "\"syscalls_per_query\":%.2f,\"mean_us\":%.1f", s_transport, cnt,
+          syscalls_per_query, t_ns / 1000.0 / cnt);
+  fprintf (stderr, "syscalls: %-6s  1 link : %5.2f per query, %6.1f us\n",
+           s_transport, syscalls_per_query, t_ns / 1000.0 / cnt);
+  return (0);
+}
+
+// Queries batched over cnt_link links of *p_uring
+static int
+syscalls_batch (const char *s_transport, Vxi11Uring *p_uring, int cnt_link)
+{
+  std::vector<Vxi11TransportUring *> a_p_transport;
+  std::vector<Device_Link> a_lid;
+  int err = 0;
+  for (int i=0; i < cnt_link && !err; i++) {
+    Vxi11TransportUring *p_transport = new Vxi11TransportUring (p_uring);
+    a_p_transport.push_back (p_transport);
+    Create_LinkParms parms;
+    memset (&parms, 0, sizeof (parms));
+    parms.clientId = i;
+    parms.device = (char *)"inst0";
+    Create_LinkResp resp;
+    memset (&resp, 0, sizeof (resp));
+    err = p_transport->open ("127.0.0.1", _sim.port ()) ||
+          p_transport->call (create_link, (xdrproc_t)xdr_Create_LinkParms,
+                             &parms, (xdrproc_t)xdr_Create_LinkResp, &resp) ||
+          resp.error;
+    a_lid.push_back (resp.lid);
+    }
+
+  int cnt = (_b_quick) ? 50 : 1000;
+  char ac_idn[] = "*IDN?";
+  std::vector<Device_WriteResp> a_write_resp (cnt_link);
+  std::vector<Device_ReadResp> a_read_resp (cnt_link);
+  p_uring->stats_reset ();
+  long long t_begin_ns = time_ns ();
+  for (int i=0; i < cnt && !err; i++) {
+    for (int idx=0; idx < cnt_link; idx++) {
+      Device_WriteParms parms;
+      memset (&parms, 0, sizeof (parms));
+      parms.lid = a_lid[idx];
+      parms.io_timeout = 10000;
+      parms.flags = 8;                  // END
+      parms.data.data_len = strlen (ac_idn);
+      parms.data.data_val = ac_idn;
+      memset (&a_write_resp[idx], 0, sizeof (Device_WriteResp));
+      a_p_transport[idx]->call_submit (device_write,
+                                       (xdrproc_t)xdr_Device_WriteParms,
+                                       &parms,
+                                       (xdrproc_t)xdr_Device_WriteResp,
+                                       &a_write_resp[idx]);
+      }
+    err = (p_uring->wait () != 0);
+
+    for (int idx=0; idx < cnt_link && !err; idx++) {
+      Device_ReadParms parms;
+      memset (&parms, 0, sizeof (parms));
+      parms.lid = a_lid[idx];
+      parms.requestSize = 256;
+      parms.io_timeout = 10000;
+      memset (&a_read_resp[idx], 0, sizeof (Device_ReadResp));
+      a_p_transport[idx]->call_submit (device_read,
+                                       (xdrproc_t)xdr_Device_ReadParms,
+                                       &parms,
+                                       (xdrproc_t)xdr_Device_ReadResp,
+                                       &a_read_resp[idx]);
+      }
+    if (!err)
+      err = (p_uring->wait () != 0);
+    for (int idx=0; idx < cnt_link; idx++) {
+      err |= (a_read_resp[idx].error != 0);
+      a_p_transport[idx]->free_result ((xdrproc_t)xdr_Device_ReadResp,
+                                       &a_read_resp[idx]);
+      }
+    }
+  long long t_ns = time_ns () - t_begin_ns;
+  long long cnt_syscall = p_uring->stats ().cnt_syscall;
+
+  for (int i=0; i < (int)a_p_transport.size (); i++) {
+    Device_Error resp;
+    memset (&resp, 0, sizeof (resp));
+    if (i < (int)a_lid.size ())
+      a_p_transport[i]->call (destroy_link, (xdrproc_t)xdr_Device_Link,
+                              &a_lid[i], (xdrproc_t)xdr_Device_Error, &resp);
+    delete a_p_transport[i];
+    }
+  if (err) {
+    fprintf (stderr, "bench_vxi11: syscalls batch error\n");
+    return (1);
+    }
+
+  int cnt_query = cnt * cnt_link;
+  double syscalls_per_query = (double)cnt_syscall / cnt_query;
+  result ("syscalls", "\"transport\":\"%s\",\"links\":%d,\"count\":%d,"
+          "\"syscalls_per_query\":%.2f,\"queries_per_s\":%.0f", s_transport,
+          cnt_link, cnt_query, syscalls_per_query, cnt_query / (t_ns / 1e9));
+  fprintf (stderr, "syscalls: %-6s %2d links: %5.2f per query, %6.0f "
+           "queries/s\n", s_transport, cnt_link, syscalls_per_query,
+           cnt_query / (t_ns / 1e9));
+  return (0);
+}
+
+static int
+bench_syscalls (void)
+{
+  if (strcmp (_s_transport, "vxi11")) {
+    fprintf (stderr, "syscalls: only with -T vxi11\n");
+    return (0);
+    }
+  const int a_cnt_link[] = {4, 16};
+  const int cnt_cnt_link = sizeof (a_cnt_link) / sizeof (a_cnt_link[0]);
+
+  int err = syscalls_link ("tirpc", 0);
+  for (int b_uring=1; b_uring >= 0 && !err; b_uring--) {
+    Vxi11Uring uring (16, b_uring);
+    const char *s_transport = (uring.uring ()) ? "uring" : "epoll";
+    if (b_uring && !uring.uring ()) {
+      fprintf (stderr, "syscalls: io_uring not available\n");
+      continue;
+      }
+    err = syscalls_link (s_transport, &uring);
+    for (int idx=0; idx < cnt_cnt_link && !err; idx++)
+      err = syscalls_batch (s_transport, &uring, a_cnt_link[idx]);
+    }
+  return (err);
+}
+
+// ***************************************************************************
+// bench_trigger - Skew of triggering 16 devices in a loop and with
+//                 InstrumentGroup::trigger_all()
+//
+// In the loop, the send time of each device is taken as the time its
+// trigger() is called.
+// ***************************************************************************
+static int
+bench_trigger (void)
+{
+  if (strcmp (_s_transport, "vxi11")) {
+    fprintf (stderr, "trigger: only with -T vxi11\n");
+    return (0);
+    }
+  const int cnt_link = 16;
+  int cnt = (_b_quick) ? 20 : 500;
+
+  InstrumentGroup group (cnt_link);
+  for (int i=0; i < cnt_link; i++)
+    if (group.add (_s_addr))
+      return (1);
+
+  std::vector<long long> a_t_loop_ns, a_t_group_ns;
+  std::vector<InstrumentGroupTrigger> a_trigger;
+  for (int i=0; i < cnt; i++) {
+    long long t_first_ns = time_ns (), t_last_ns = t_first_ns;
+    for (int idx=0; idx < cnt_link; idx++) {
+      t_last_ns = time_ns ();
+      if (group.link (idx)->trigger ())
+        return (1);
+      }
+    a_t_loop_ns.push_back (t_last_ns - t_first_ns);
+
+    if (group.trigger_all (&a_trigger))
+      return (1);
+    long long t_skew_ns = 0;
+    for (int idx=0; idx < cnt_link; idx++)
+      t_skew_ns = std::max (t_skew_ns, a_trigger[idx].t_skew_ns);
+    a_t_group_ns.push_back (t_skew_ns);
+    }
+
+  Latency lat_loop = latency (a_t_loop_ns);
+  Latency lat_group = latency (a_t_group_ns);
+  const char *s_transport = (group.uring ()->uring ()) ? "uring" : "epoll";
+  result ("trigger", "\"links\":%d,\"count\":%d,\"transport\":\"%s\","
+          "\"loop_skew_p50_us\":%.1f,\"loop_skew_max_us\":%.1f,"
+          "\"group_skew_p50_us\":%.1f,\"group_skew_max_us\":%.1f",
+          cnt_link, cnt, s_transport, lat_loop.p50, lat_loop.max,
+          lat_group.p50, lat_group.max);
+  fprintf (stderr, "trigger: %d links, skew p50 loop %.1f us, "
+           "trigger_all (%s) %.1f us\n", cnt_link, lat_loop.p50,
+           s_transport, lat_group.p50);
+  return (0);
+}
+
+// ***************************************************************************
+// bench_query_all - Time to query 8 devices in a loop and with
+//                   InstrumentGroup::query_all()
+// ***************************************************************************
+static int
+bench_query_all (void)
+{
+  if (strcmp (_s_transport, "vxi11")) {
+    fprintf (stderr, "query_all: only with -T vxi11\n");
+    return (0);
+    }
+  const int cnt_link = 8;
+  int cnt = (_b_quick) ? 10 : 200;
+
+  InstrumentGroup group (cnt_link);
+  for (int i=0; i < cnt_link; i++)
+    if (group.add (_s_addr))
+      return (1);
+
+  _sim.latency (Vxi11Sim::OP_READ, _delay_us);
+  std::vector<long long> a_t_loop_ns, a_t_group_ns;
+  std::vector<InstrumentGroupValue<double> > a_val;
+  int err = 0;
+  for (int i=0; i < cnt && !err; i++) {
+    long long t_begin_ns = time_ns ();
+    for (int idx=0; idx < cnt_link && !err; idx++) {
+      double d_val;
+      err = group.link (idx)->query ("MEAS:VOLT?", &d_val);
+      }
+    long long t_loop_ns = time_ns ();
+    err |= (group.query_all ("MEAS:VOLT?", a_val) != 0);
+    a_t_loop_ns.push_back (t_loop_ns - t_begin_ns);
+    a_t_group_ns.push_back (time_ns () - t_loop_ns);
+    }
+  _sim.latency (Vxi11Sim::OP_READ, 0);
+  if (err)
+    return (1);
+
+  Latency lat_loop = latency (a_t_loop_ns);
+  Latency lat_group = latency (a_t_group_ns);
+  result ("query_all", "\"links\":%d,\"delay_us\":%d,\"count\":%d,"
+          "\"loop_p50_us\":%.1f,\"group_p50_us\":%.1f,"
+          "\"group_p99_us\":%.1f", cnt_link, _delay_us, cnt, lat_loop.p50,
+          lat_group.p50, lat_group.p99);
+  fprintf (stderr, "query_all: %d links, delay %d us: loop %.1f us, "
+           "query_all %.1f us\n", cnt_link, _delay_us, lat_loop.p50,
+           lat_group.p50);
+  return (0);
+}
+#endif
+
+// ***************************************************************************
+// Suites
+// ***************************************************************************
+struct Suite {
+  const char *s_name;
+  int (*pfn_bench) (void);
+};
+
+static const Suite _a_suite[] = {
+  {"query_latency",       bench_query_latency},
+  {"query_latency_bare",  bench_query_latency_bare},
+  {"write",               bench_write},
+  {"read",                bench_read},
+  {"write_buffer",        bench_write_buffer},
+  {"readstb",             bench_readstb},
+  {"open_close",          bench_open_close},
+  {"scaling",             bench_scaling},
+  {"contention",          bench_contention},
+  {"srq_wait",            bench_srq_wait},
+  {"poller",              bench_poller},
+#ifdef __linux__
+  {"syscalls",            bench_syscalls},
+  {"trigger",             bench_trigger},
+  {"query_all",           bench_query_all},
+#endif
+};
+static const int CNT_SUITE = sizeof (_a_suite) / sizeof (_a_suite[0]);
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: bench_vxi11 [-q] [-o file] [-d delay_us] "
+           "[-t threads] [-l links]\n                   "
+           "[-T vxi11|hislip|socket] [suite]...\n"
+           "Suites:");
+  for (int i=0; i < CNT_SUITE; i++)
+    fprintf (stderr, " %s", _a_suite[i].s_name);
+  fprintf (stderr, "\n");
+}
+
+int main (int argc, char *argv[])
+{
+  const char *s_file_json = 0;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "qo:d:t:l:T:")) != -1) {
+    switch (opt) {
+    case 'q': _b_quick = true;             break;
+    case 'o': s_file_json = optarg;        break;
+    case 'd': _delay_us = atoi (optarg);   break;
+    case 't': _cnt_thread = atoi (optarg); break;
+    case 'l': _cnt_link = atoi (optarg);   break;
+    case 'T': _s_transport = optarg;       break;
+    default:
+      usage ();
+      return (1);
+      }
+    }
+
+  bool b_hislip = !strcmp (_s_transport, "hislip");
+  bool b_socket = !strcmp (_s_transport, "socket");
+  if (!b_hislip && !b_socket && strcmp (_s_transport, "vxi11")) {
+    usage ();
+    return (1);
+    }
+
+  // Check the suite names before starting
+  for (int idx_arg=optind; idx_arg < argc; idx_arg++) {
+    int idx=0;
+    while (idx < CNT_SUITE && strcmp (argv[idx_arg], _a_suite[idx].s_name))
+      idx++;
+    if (idx == CNT_SUITE) {
+      usage ();
+      return (1);
+      }
+    }
+
+  _p_file_json = (s_file_json) ? fopen (s_file_json, "w") : stdout;
+  if (!_p_file_json) {
+    fprintf (stderr, "bench_vxi11: could not open %s\n", s_file_json);
+    return (1);
+    }
+
+  if (_sim.start ())
+    return (1);
+  if (b_hislip) {
+    snprintf (_s_addr, sizeof (_s_addr), "127.0.0.1");
+    snprintf (_s_device, sizeof (_s_device), "hislip0,%d",
+              _sim.port_hislip ());
+    }
+  else if (b_socket) {
+    snprintf (_s_addr, sizeof (_s_addr), "127.0.0.1");
+    snprintf (_s_device, sizeof (_s_device), "socket,%d",
+              _sim.port_socket ());
+    }
+  else
+    snprintf (_s_addr, sizeof (_s_addr), "127.0.0.1:%d", _sim.port ());
+
+  fprintf (_p_file_json, "{\"benchmark\":\"bench_vxi11\",\"quick\":%s,"
+           "\"transport\":\"%s\",\"results\":[",
+           (_b_quick) ? "true" : "false", _s_transport);
+
+  int err = 0;
+  for (int idx=0; idx < CNT_SUITE && !err; idx++) {
+    bool b_run = (optind == argc);      // Run all suites if none given
+    for (int idx_arg=optind; idx_arg < argc; idx_arg++)
+      b_run |= !strcmp (argv[idx_arg], _a_suite[idx].s_name);
+    if (b_run && (err = _a_suite[idx].pfn_bench ()))
+      fprintf (stderr, "bench_vxi11: %s failed\n", _a_suite[idx].s_name);
+    }
+
+  fprintf (_p_file_json, "\n]}\n");
+  if (_p_file_json != stdout)
+    fclose (_p_file_json);
+  _sim.stop ();
+  return (err);
+}
@@ -10,6 +10,49 @@
 //
 // Edit history:
 //
+// 10-17-26 - Vxi11 and Vxi11Bare are declared in vxi11_fwd.h, for the code
+//              that declared "class Vxi11;".
+//            write_buffer() works with every lock policy, Vxi11Bare too.
+//            cancel_token() and call_deadline() need Vxi11LockGlobal, as
+//              breaker(), so their checks are compiled out of Vxi11Bare.
+//              The types of the library are declared extern.
+//            The breaker re-creates the link of a device that restarted.
+//            open() always creates the abort channel.
+//            Added write_buffer() and flush() to send many commands in one
+//              device_write.
+//            Added read_stats() for the chunks of each response, learned
+//              to size the device_read calls of a growing buffer.
+//            Added read() and query() to a std::string or std::vector<char>
+//              that grows as needed, reserving the size learned for the
+//              link and query.
+//            Added breaker() for a circuit breaker failing the calls of a
+//              link right away while its device does not reply.
+//            Added rtt_timeout() to derive the I/O and RPC timeouts of each
+//              kind of operation from its observed latency, and rtt() to
+//              get the estimate.
+//            Added timeouts for each kind of operation, in ms, with
+//              timeout(op) and Vxi11TimeoutScope, and rpc_margin() for the
+//              RPC timeout.
+//            Added cancel_token() and call_deadline() to abort calls in
+//              progress with a Vxi11Cancel token or after a time limit.
+//            readstb(): Concurrent callers on a link share one
+//              device_readstb, and readstb_max_age() sets how long its
+//              result may be reused.
+//            Added wait_for_srq() to wait for an SRQ without polling.
+//            Added srq_handler() for an SRQ handler per object, and
+//              srq_workers() for the threads calling the SRQ handlers.
+//            Added lid() to get the link ID.
+//            Made the Vxi11 class the default of the BasicVxi11 template,
+//              with policies for locking, error reporting, stats and the
+//              transport, and added Vxi11Bare with none of them.
+//            Added Vxi11Transport under the Vxi11 class, with open() taking
+//              an optional transport and transport() to get it.
+//            open(): Added HiSLIP and raw SCPI socket devices, and VISA
+//              resource strings.
+//            Added Vxi11Tracer interface, called at the start and end of each
+//              RPC, and Vxi11TraceChrome to write Chrome trace-event JSON.
+//            Added record() and replay() to record a session to a trace file
+//              and replay it later without the device.
 // 01-21-24 - Changed _c_read_terminator and read_terminator() function from
 //             char to signed char to work with both MacOS and Linux.
 // 01-17-23 - Updated comments to read_terminator() to indicate that on the
@@ -43,52 +86,352 @@
 // of the use of each function.
 // ***************************************************************************
 
-class Vxi11 {
-  
+#include "vxi11_fwd.h"
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+class Vxi11Common;
+class Vxi11Cancel;
+class Vxi11Breaker;
+
+// ***************************************************************************
+// Vxi11TraceEvent - Description of one VXI-11 RPC passed to a Vxi11Tracer
+// ***************************************************************************
+struct Vxi11TraceEvent {
+  Vxi11Common *p_vxi11;                 // Object making the RPC
+  const char *s_device_addr;            // Device address & name of the object
+  long lid;                             // VXI-11 link ID, -1 if no link yet
+  int proc;                             // RPC procedure number
+  const char *s_proc;                   // RPC procedure name, "device_read"
+  unsigned int xid;                     // RPC transaction ID (end only)
+  int cnt_send;                         // Payload bytes sent to the device
+  int cnt_recv;                         // Payload bytes received (end only)
+  int err;                              // Error (end only)
+                                        //  0 = no error
+                                        // -1 = no RPC response
+                                        // >0 = VXI-11 error code
+  long long t_begin_ns;                 // Monotonic time RPC started, in ns
+  long long t_end_ns;                   // Monotonic time RPC ended, in ns
+                                        // (end only)
+};
+
+// ***************************************************************************
+// Vxi11Tracer - Observer interface for span-level tracing of VXI-11 RPCs
+//
+// Derive from this class and install it with Vxi11::tracer().  The member
+// functions are called on the thread making the RPC, so they must be fast
+// and thread safe.
+// ***************************************************************************
+class Vxi11Tracer {
+ public:
+  virtual ~Vxi11Tracer () {}
+
+  // Called just before the RPC is sent to the device
+  virtual void rpc_begin (const Vxi11TraceEvent &event) = 0;
+
+  // Called just after the RPC reply is received or the RPC failed
+  virtual void rpc_end (const Vxi11TraceEvent &event) = 0;
+
+  // Called after waiting to lock the mutex that serializes RPCs
+  virtual void mutex_wait (long long t_begin_ns, long long t_end_ns) {}
+
+  // Monotonic clock used for all trace timestamps, in ns
+  static long long time_ns (void);
+};
+
+// ***************************************************************************
+// Vxi11TraceChrome - Vxi11Tracer that writes Chrome trace-event JSON
+//
+// The output file can be loaded in chrome://tracing or ui.perfetto.dev.
+// Each RPC is one slice on the thread that made it, and each wait for the
+// RPC mutex is a "mutex wait" slice just before it.
+// ***************************************************************************
+class Vxi11TraceChrome : public Vxi11Tracer {
+ private:
+  void *_p_file;                        // Output file, type FILE*
+  void *_p_mutex;                       // Mutex for _p_file, pthread_mutex_t*
+  long long _t_start_ns;                // Time file was opened, in ns
+  int _cnt_event;                       // Number of events written
+  int _cnt_thread;                      // Number of thread IDs assigned
+
+  int _thread_id (void);                // Small integer ID of calling thread
+  void _write_slice (const char *s_name, const char *s_cat,
+                     long long t_begin_ns, long long t_end_ns,
+                     const char *s_args);
+
+ public:
+  Vxi11TraceChrome (void);
+  ~Vxi11TraceChrome ();
+
+  // Open/close the output file
+  int open (const char *s_file);
+  int close (void);
+
+  virtual void rpc_begin (const Vxi11TraceEvent &event);
+  virtual void rpc_end (const Vxi11TraceEvent &event);
+  virtual void mutex_wait (long long t_begin_ns, long long t_end_ns);
+};
+
+// ***************************************************************************
+// Vxi11Timeout - Timeouts of one kind of operation, in milliseconds
+// ***************************************************************************
+struct Vxi11Timeout {
+  int lock_ms;                          // Time the device waits for a lock
+                                        // held by another link
+                                        // (lock_timeout)
+  int io_ms;                            // Time the device waits for I/O
+                                        // (io_timeout)
+  int rpc_ms;                           // Time to wait for the RPC reply,
+                                        // < 0 for the longer of lock_ms and
+                                        // io_ms plus rpc_margin()
+};
+
+// ***************************************************************************
+// Vxi11Rtt - Latency estimate of one kind of operation, see rtt_timeout()
+//
+// Smoothed round-trip time and its variation, as in TCP (RFC 6298): each
+// call that is replied to in time is a sample R, and
+//   d_srtt   = 7/8 d_srtt + 1/8 R
+//   d_rttvar = 3/4 d_rttvar + 1/4 |d_srtt - R|
+// The I/O timeout is d_srtt + 4 d_rttvar, doubled for each call in a row
+// that timed out or was not replied to.
+// ***************************************************************************
+struct Vxi11Rtt {
+  double d_srtt;                        // Smoothed latency, in s
+  double d_rttvar;                      // Variation of the latency, in s
+  unsigned long cnt_sample;             // Calls measured
+  int backoff;                          // Timeouts in a row, doubling rto_ms
+  int rto_ms;                           // I/O timeout derived, in ms, 0 if
+                                        // no sample yet, before the limits
+                                        // of rtt_timeout()
+};
+
+// ***************************************************************************
+// Vxi11ReadStats - Chunks of the responses read from one link, see
+//                  read_stats()
+//
+// Each device_read returns one chunk of a response, ended by END or the
+// termination character, by requestSize (the room left in the buffer), or
+// by the device itself when its buffer is smaller, as on some gateways.
+// ***************************************************************************
+struct Vxi11ReadStats {
+  unsigned long cnt_read;               // Responses read to the end
+  unsigned long cnt_chunk;              // device_read calls
+  unsigned long long cnt_byte;          // Bytes read
+  unsigned long cnt_end;                // Chunks ended by END or the
+                                        // termination character
+  unsigned long cnt_reqcnt;             // Chunks ended by requestSize
+  unsigned long cnt_frag;               // Chunks ended by the device
+  int chunk_device;                     // Largest chunk ended by the device,
+                                        // 0 if none
+};
+
+// ***************************************************************************
+// Vxi11TimeoutScope - Timeouts of the calls made by this thread, on any
+//                     link, while the object exists
+//
+// Create a local instance around a call to override the timeouts of its
+// link for that call only:
+//
+//   {
+//     Vxi11TimeoutScope timeoutScope (50);  // Fail after 50 ms
+//     stb = vxi11.readstb ();
+//   }
+//
+// Scopes may be nested; the innermost one is used.
+// ***************************************************************************
+class Vxi11TimeoutScope {
+ private:
+  Vxi11Timeout _timeout;                // Timeouts of the calls
+  const Vxi11Timeout *_p_prev;          // Scope replaced, restored after
+
+ public:
+  // Use timeout for the calls
+  Vxi11TimeoutScope (const Vxi11Timeout &timeout);
+
+  // Use timeout_ms for the lock and I/O, and the RPC timeout derived from it
+  Vxi11TimeoutScope (int timeout_ms);
+
+  ~Vxi11TimeoutScope ();
+
+  // Get the timeouts of the innermost scope of this thread, null if none
+  static const Vxi11Timeout *current (void);
+};
+
+// ***************************************************************************
+// Policies of BasicVxi11
+//
+// Each policy is a class with static member functions or constants that
+// BasicVxi11 calls at compile time.  The "None" policies are empty inline
+// functions or false constants, so their code is removed by the compiler.
+// ***************************************************************************
+
+// Lock policy: serializes the RPCs of all objects
+// Vxi11LockGlobal - One mutex for all objects and threads (default), needed
+//                   for SRQ callbacks and objects used by several threads
+// Vxi11LockNone   - No lock, for an object used by one thread only
+// B_ENA is 0 if no thread ever waits for another.
+class Vxi11LockGlobal {
+ public:
+  enum {B_ENA = 1};
+  static void lock (void);
+  static void unlock (void);
+};
+
+class Vxi11LockNone {
+ public:
+  enum {B_ENA = 0};
+  static void lock (void) {}
+  static void unlock (void) {}
+};
+
+// Error policy: reports errors, in printf style
+// Vxi11ErrorLog  - Log to stderr if Vxi11Common::log_err_ena() (default)
+// Vxi11ErrorNone - Nothing is reported, only the error return values
+class Vxi11ErrorLog {
+ public:
+  static void err (const char *s_format, ...);
+};
+
+class Vxi11ErrorNone {
+ public:
+  static void err (const char *s_format, ...) {}
+};
+
+// Stats policy: reports each RPC to the tracer and the transport counters
+// Vxi11StatsTrace - Tracer set by Vxi11Common::tracer() and counters of
+//                   Vxi11Transport::stats() (default)
+// Vxi11StatsNone  - No tracer calls, no clock reads and no counters
+class Vxi11StatsTrace {
+ public:
+  enum {B_ENA = 1};
+};
+
+class Vxi11StatsNone {
+ public:
+  enum {B_ENA = 0};
+};
+
+// ***************************************************************************
+// Vxi11Common - Members of BasicVxi11 that do not depend on the policies
+//
+// Holds the state of the link and the settings shared by all objects: error
+// logging, the tracer, and the RPC service for SRQ interrupts.
+// ***************************************************************************
+class Vxi11Common {
+
   // *************************************************************************
-  // Private members
+  // Public types
   // *************************************************************************
- private:
+ public:
+
+  // Kinds of operation with their own timeouts, see timeout()
+  enum Op {
+    OP_WRITE,                           // device_write
+    OP_READ,                            // device_read
+    OP_READSTB,                         // device_readstb
+    OP_TRIGGER,                         // device_trigger
+    OP_CLEAR,                           // device_clear
+    OP_LOCK,                            // device_lock, device_unlock
+    OP_CONTROL,                         // All others, such as create_link,
+                                        // device_remote and device_docmd
+    CNT_OP
+  };
+
+  // *************************************************************************
+  // Protected members, used by BasicVxi11
+  // *************************************************************************
+ protected:
 
   int _b_valid;                         // 1 = has connection to device
 
   double _d_timeout;                    // Timeout time, in seconds
-  int _timeout_ms;                      // Timeout time, in milliseconds
+  Vxi11Timeout _a_timeout[CNT_OP];      // Timeouts of each kind of operation
+  int _rpc_margin_ms;                   // Added to the lock and I/O timeouts
+                                        // for the RPC timeout, in ms
+  int _rpc_timeout_ms;                  // RPC timeout set on the transport,
+                                        // -1 if not set yet
+  Vxi11Rtt _a_rtt[CNT_OP];              // Latency of each kind of operation
+  Vxi11ReadStats _read_stats;           // Chunks read by device_read
+  bool _b_rtt_ena;                      // Timeouts derived from _a_rtt
+  int _rtt_min_ms;                      // Shortest I/O timeout derived, ms
+  int _rtt_max_ms;                      // Longest I/O timeout derived, ms
 
   signed char _c_read_terminator;       // Read termination character
                                         // -1 = END (use EOI for GPIB,
                                         //      line feed for RS-232 on E5810A)
   
-  void *__p_client;                     // RPC client, type CLIENT*
-                                        // Use macro _p_client for access
+  void *__p_transport;                  // Transport of the core channel,
+                                        // type Transport* of BasicVxi11
+                                        // Use macro _p_transport for access
   void *__p_link;                       // VXI-11 link, type Create_LinkResp*
                                         // Use macro _p_link for access
 
   void *__p_client_abort;               // RPC client for the abort channel
                                         // Use macro _p_client_abort for access
+  pthread_mutex_t _mutex_abort;         // For __p_client_abort, between
+                                        // abort() and close()
+  Vxi11Cancel *_p_cancel;               // Token aborting the calls, or null
+  double _d_call_deadline;              // Longest time of a call before it
+                                        // is aborted, in s, < 0 for none
+  Vxi11Breaker *_p_breaker;             // Circuit breaker, or null
+
+  char *_s_record_file;                 // File to record sessions to, or null
+  void *__p_record;                     // Session being recorded, type
+                                        // Vxi11RecordFile*
+  void *__p_replay;                     // Session being replayed, type
+                                        // Vxi11ReplayFile*
+  bool _b_replay_realtime;              // Replay with recorded RPC durations
 
   char _s_device_addr[256];             // Device address & name used in the
                                         // constructor or open()
 
   unsigned int _ui_device_ip_addr;      // IP address of device
+  int _port_relink;                     // TCP port of the core channel for
+                                        // re-creating the link, 0 to ask the
+                                        // portmapper, -1 if not possible
 
   bool _b_srq_ena;                      // True if SRQ interrupt is enabled
   bool _b_srq_udp;                      // True if SRQ uses UDP, else TCP
   char _a_srq_handle[40];               // Unique handle for SRQ interrupt
                                         // thread access to the devices
-  static void *_p_pthread_svc_run;      // Thread pointer for _fn_svc_run()
-  static void *_fn_svc_run(void *p_arg);// Func to run svc_run() for SRQ intr
-  static void *_p_svcXprt_srq_tcp;      // TCP RPC service transport for SRQ
-  static void *_p_svcXprt_srq_udp;      // UDP RPC service transport for SRQ
-  static void (*_pfn_srq_callback)(Vxi11 *); // User callback function for SRQ
-  static void _fn_srq_callback (void *, void *); // Internal callback for SRQ
-                                        // VXI-11 RPC is "device_intr_srq"
+  int _cnt_srq_handle;                  // Bytes in _a_srq_handle, 0 if none
+  void *__p_srq_waiter;                 // Wakes up wait_for_srq(), type
+                                        // Vxi11SrqWaiter*
+                                        // Use macro _p_srq_waiter for access
+  bool _b_srq_wait;                     // SRQ service used by wait_for_srq()
+  void *__p_stb;                        // Status byte shared by the callers
+                                        // of readstb(), type Vxi11StbShare*
+                                        // Use macro _p_stb for access
+  void *__p_read_hint;                  // Longest responses read, type
+                                        // Vxi11ReadHint*
+                                        // Use macro _p_read_hint for access
+  void *__p_write_buf;                  // Commands not sent yet, type
+                                        // Vxi11WriteBuf*
+                                        // Use macro _p_write_buf for access
+  double _d_stb_max_age;                // Age in seconds of a status byte
+                                        // that readstb() may return again
+  void (*_pfn_srq_call)(Vxi11Common *); // Calls the SRQ handler of this
+                                        // object or the SRQ callback of its
+                                        // BasicVxi11 type
+  static int _cnt_srq_worker;           // Threads calling the SRQ callbacks
+  static void _srq_handle (const char *ac_handle, int cnt_handle);
+                                        // Call user callback for SRQ handle
+  static int _srq_service (bool b_run); // Add/remove a user of the SRQ server
   
   enum {CNT_ERR_DESC_MAX=32};           // Description of RPC call error codes
   static const char *_as_err_desc[CNT_ERR_DESC_MAX];
 
   static bool _b_log_err;               // Flag to log errors to stderr
-  
+
+  static Vxi11Tracer *_p_tracer;        // RPC tracer, null if not tracing
+
+  Vxi11Common (void);
+  ~Vxi11Common ();
+
   // *************************************************************************
   // Public members
   //
@@ -96,29 +439,9 @@ class Vxi11 {
   // *************************************************************************
  public:
   
-  // Default constructor
-  Vxi11 (void);
-
-  // Constructor to open connection to device
-  // VXI-11 RPC is "create_link"
-  Vxi11 (const char *s_address, const char *s_device = 0, int *p_err = 0);
-
-  // Destructor
-  // VXI-11 RPC is "destroy_link"
-  ~Vxi11 ();
-
-  // Open connection to device (if default constructor used);
-  // VXI-11 RPC is "create_link"
-  int open (const char *s_address, const char *s_device);
-
-  // Close connection to device (if destructor is not used)
-  // VXI-11 RPC is "destroy_link"
-  int close (void);
-
-  // Set/get timeout time in seconds
-  // Default timeout is 10 seconds
-  void timeout (double d_timeout);
-  double timeout (void);
+  // Record all RPCs of the following open() calls to a session trace file
+  // Set to null to stop recording
+  int record (const char *s_file);
 
   // Set/get the read termination method
   // -1    = END (EOI line for GPIB, line feed for RS-232 on E5810A)
@@ -128,6 +451,12 @@ class Vxi11 {
   void read_terminator (signed char c_term) { _c_read_terminator = c_term; }
   signed char read_terminator (void) { return (_c_read_terminator); }
 
+  // Set/get how long readstb() may return the status byte it last read,
+  // in seconds, instead of calling the device again
+  // Default is 0 (always call the device)
+  void readstb_max_age (double d_age) { _d_stb_max_age = d_age; }
+  double readstb_max_age (void) { return (_d_stb_max_age); }
+
   // Get device address and name used in contructor or open()
   // This can be used in the SRQ callback function to identify which Vxi11
   // object is calling the callback.
@@ -135,6 +464,10 @@ class Vxi11 {
     return (_s_device_addr);
     }
 
+  // Get the link ID from create_link, -1 if not open
+  // For calls made directly on the transport
+  long lid (void);
+
   // Enable/disable logging of errors to stderr
   // Default is enabled (true)
   static void log_err_ena (bool b_log_err) { _b_log_err = b_log_err; }
@@ -142,6 +475,163 @@ class Vxi11 {
 
   // Log error message to std_err if log_err_ena() is true
   static void log_err (const char *s_format, ...);
+
+  // Set/get the number of threads calling the SRQ callbacks and handlers
+  // Used when the SRQ service is started.  Default is 4.
+  static void srq_workers (int cnt_worker) { _cnt_srq_worker = cnt_worker; }
+  static int srq_workers (void) { return (_cnt_srq_worker); }
+
+  // Set/get the tracer called at the start and end of every RPC
+  // Default is null (no tracing)
+  static void tracer (Vxi11Tracer *p_tracer) { _p_tracer = p_tracer; }
+  static Vxi11Tracer *tracer (void) { return (_p_tracer); }
+};
+
+// ***************************************************************************
+// BasicVxi11 - VXI-11 link to one device, specialized at compile time
+//
+// LockPolicy   - Vxi11LockGlobal or Vxi11LockNone
+// ErrorPolicy  - Vxi11ErrorLog or Vxi11ErrorNone
+// StatsPolicy  - Vxi11StatsTrace or Vxi11StatsNone
+// Transport    - Vxi11Transport (any transport, called through virtual
+//                functions) or Vxi11TransportRpc (the built-in transports
+//                only, called directly)
+//
+// Vxi11 is the default, with every feature.  Vxi11Bare has no lock, no
+// error logging, no tracing and no counters, for a control loop that uses
+// its links from one thread.  Both are typedefs, declared with the default
+// policies in vxi11_fwd.h; include it instead of "class Vxi11;".  The
+// library has every combination of the policies above, declared extern at
+// the end of this file.
+//
+// cancel_token(), call_deadline() and breaker() need Vxi11LockGlobal;
+// with Vxi11LockNone their checks are compiled out of the calls.
+// write_buffer() works with every lock policy.
+// ***************************************************************************
+template <class LockPolicy, class ErrorPolicy, class StatsPolicy,
+          class Transport>              // Defaults are in vxi11_fwd.h
+class BasicVxi11 : public Vxi11Common {
+  
+  // *************************************************************************
+  // Private members
+  // *************************************************************************
+ private:
+
+  static void (*_pfn_srq_callback)(BasicVxi11 *); // User callback function
+                                        // for SRQ of this BasicVxi11 type
+  static void _srq_call (Vxi11Common *p_vxi11); // Call _pfn_srq_handler
+                                        // or _pfn_srq_callback
+  void (*_pfn_srq_handler)(BasicVxi11 *, void *); // User handler for SRQ of
+                                        // this object, or null
+  void *_p_srq_arg;                     // Parameter of _pfn_srq_handler
+
+  int _open_link (const char *s_device);// Create link on RPC client
+  int _open_abort (void);               // Create RPC client of abort channel
+  int _open_abort_locked (void);        // Same, with _mutex_abort locked
+  int _abort (int timeout_ms);          // Call device_abort
+  static int _abort_call (Vxi11Common *p_vxi11); // Abort the call of
+                                        // p_vxi11 for Vxi11CancelCall
+  int _readstb_rpc (void);              // Call device_readstb
+  void _timeout_rpc (int rpc_ms);       // Set RPC timeout of the transport
+  void _call_end (Op op, int err);      // Count the last call for
+                                        // _p_breaker and _a_rtt
+  static int _probe_call (Vxi11Common *p_vxi11, int timeout_ms); // Ping
+                                        // the device for _p_breaker
+  int _probe (int timeout_ms);          // Ping the device, or relink
+  int _relink (int timeout_ms);         // Re-create the transport and link
+  int _write (const char *ac_data, int cnt_data); // Call device_write
+  int _write_flush (void);              // Send the buffered commands, with
+                                        // the mutex of the buffer locked
+  int _readstb (bool b_reuse);          // Share device_readstb with the
+                                        // other callers
+  int _read (char *ac_data, int cnt_data_max, int *pcnt_read,
+             char *(*pfn_grow) (void *, long long, int *),
+             void *p_buf);              // Read, growing p_buf with pfn_grow
+  template <class B> int _read_buf (B &buf, const char *s_query); // Read
+                                        // to a growing buffer, with the
+                                        // size hint of s_query
+  
+  // *************************************************************************
+  // Public members
+  //
+  // NOTE: See function header comments in vxi11.cpp for full documentation
+  // *************************************************************************
+ public:
+  
+  // Default constructor
+  BasicVxi11 (void);
+
+  // Constructor to open connection to device
+  // VXI-11 RPC is "create_link"
+  BasicVxi11 (const char *s_address, const char *s_device = 0,
+              int *p_err = 0);
+
+  // Destructor
+  // VXI-11 RPC is "destroy_link"
+  ~BasicVxi11 ();
+
+  // Open connection to device (if default constructor used);
+  // VXI-11 RPC is "create_link"
+  // s_address may be "host:port" to connect without the portmapper, or a
+  // VISA resource string such as "TCPIP0::host::hislip0::INSTR"
+  // s_device "hislipN" uses HiSLIP, and "socket" the raw SCPI socket,
+  // instead of VXI-11
+  // p_transport replaces the built-in transports, see vxi11_transport.h
+  int open (const char *s_address, const char *s_device,
+            Transport *p_transport = 0);
+
+  // Close connection to device (if destructor is not used)
+  // VXI-11 RPC is "destroy_link"
+  int close (void);
+
+  // Open a session recorded with record(), instead of a device
+  // The recorded replies are returned without any I/O
+  int replay (const char *s_file, bool b_realtime = false);
+
+  // Get the transport of the core channel, null if not open
+  // Use it for its stats() and fd()
+  Transport *transport (void) {
+    return ((Transport *)__p_transport);
+    }
+
+  // Set/get timeout time in seconds
+  // Default timeout is 10 seconds
+  // Sets the lock and I/O timeouts of every kind of operation, with the
+  // RPC timeout rpc_margin() longer
+  void timeout (double d_timeout);
+  double timeout (void);
+
+  // Set/get the timeouts of one kind of operation, in ms
+  // For example a short timeout for OP_READSTB, and a long one for OP_READ
+  void timeout (Op op, const Vxi11Timeout &timeout);
+  Vxi11Timeout timeout (Op op);
+
+  // Get the timeouts of the next call of kind op from this thread: those of
+  // a Vxi11TimeoutScope, or else of timeout(op), with the RPC timeout set
+  Vxi11Timeout timeout_call (Op op);
+
+  // Set/get the time added to the lock and I/O timeouts for the RPC
+  // timeout, in seconds, when not set in the Vxi11Timeout
+  // Default is 10 seconds
+  void rpc_margin (double d_margin);
+  double rpc_margin (void);
+
+  // Enable/disable timeouts derived from the latency of the calls
+  // The I/O timeout of each kind of operation but OP_LOCK is its estimate
+  // of rtt(), from d_min to d_max seconds, and the RPC timeout is twice
+  // that, at most rpc_margin() longer.  Needs the stats policy; disabled by
+  // default.  Vxi11TimeoutScope still overrides the timeouts.
+  void rtt_timeout (bool b_ena, double d_min = 0.01, double d_max = 10.0);
+  bool rtt_timeout (void) { return (_b_rtt_ena); }
+
+  // Get the latency estimate of one kind of operation
+  Vxi11Rtt rtt (Op op);
+
+  // Log error message with ErrorPolicy
+  // Hides Vxi11Common::log_err(), so Vxi11ErrorNone removes every message
+  template <class... A> static void log_err (const char *s_format, A... a) {
+    ErrorPolicy::err (s_format, a...);
+    }
   
   // Write data to device
   // VXI-11 RPC is "device_write"
@@ -151,18 +641,45 @@ class Vxi11 {
   // VXI-11 RPC is "device_write"
   int printf (const char *s_format, ...);
 
+  // Enable/disable buffered writes
+  // write() and printf() append each command to a buffer joined by c_sep,
+  // ';' or '\n', sent as one device_write by flush() or before the next
+  // call to the device other than abort().  Disabled by default.
+  int write_buffer (bool b_ena, char c_sep = ';');
+  bool write_buffer (void);
+
+  // Send the buffered commands
+  // VXI-11 RPC is "device_write"
+  int flush (void);
+
   // Read data from device
   // VXI-11 RPC is "device_read"
   int read (char *ac_data, int cnt_data_max, int *pcnt_data = 0);
 
+  // Read data from device, of any length
+  // The buffer grows as needed, starting at the size of the longest
+  // response read with it on this link
+  // VXI-11 RPC is "device_read"
+  int read (std::string &s_data);
+  int read (std::vector<char> &a_data);
+
+  // Get/reset the counters of the chunks read by device_read
+  Vxi11ReadStats read_stats (void);
+  void read_stats_reset (void);
+
   // Query for a value (double, int, or string)
   // Convenience functions combines write and read
   int query (const char *s_query, double *pd_val);
   int query (const char *s_query, int *pi_val);
   int query (const char *s_query, char *s_val, int len_val_max);
+
+  // Query for a string of any length, reserving the size of the longest
+  // response to s_query so far
+  int query (const char *s_query, std::string &s_val);
   
   // Read status byte (serial poll)
   // VXI-11 RPC is "device_readstb"
+  // Threads calling at the same time share one call to the device
   int readstb (void);
 
   // Send group execute trigger (GET)
@@ -193,14 +710,46 @@ class Vxi11 {
   // VXI-11 RPC is "device_abort"
   int abort (void);
 
+  // Set/get the token that aborts the calls in progress when cancelled,
+  // null for none, see vxi11_cancel.h
+  // The abort channel is opened by open(), so it is ready when needed.
+  int cancel_token (Vxi11Cancel *p_cancel);
+  Vxi11Cancel *cancel_token (void) { return (_p_cancel); }
+
+  // Set/get the longest time of each call, in seconds, after which it is
+  // aborted with device_abort; < 0 for no limit (default)
+  int call_deadline (double d_time);
+  double call_deadline (void) { return (_d_call_deadline); }
+
+  // Set/get the circuit breaker, see vxi11_breaker.h
+  // Opens after cnt_fail calls in a row without reply, 0 for none (default);
+  // then the calls fail right away, and the device is pinged every d_probe
+  // seconds with an RPC timeout of d_probe_timeout seconds until it replies,
+  // re-creating the link if the device restarted
+  int breaker (int cnt_fail, double d_probe = 1.0,
+               double d_probe_timeout = 0.1);
+  Vxi11Breaker *breaker (void) { return (_p_breaker); }
+
   // Set the callback function for SRQ (service request) interrupt
-  static int srq_callback (void (*pfn_srq_callback)(Vxi11 *));
+  // One callback for each BasicVxi11 type, such as Vxi11
+  static int srq_callback (void (*pfn_srq_callback)(BasicVxi11 *));
+
+  // Set the handler function for SRQ interrupt of this object
+  // Called instead of the srq_callback() of the type, with p_arg
+  int srq_handler (void (*pfn_srq_handler)(BasicVxi11 *, void *),
+                   void *p_arg = 0);
   
   // Enable/disable SRQ (service request) interrupt
   // VXI-11 RPCs are "device_enable_srq"
   //                 "create_intr_chan"
   //                 "destroy_intr_chan"
   int enable_srq (bool b_ena, bool b_udp = false);
+
+  // Wait until the device requests service with a status byte bit of mask
+  // Sleeps until the SRQ interrupt, instead of polling readstb()
+  // VXI-11 RPC is "device_readstb"
+  // d_timeout in seconds, < 0 for no limit
+  int wait_for_srq (int mask, double d_timeout = -1);
   
   // Send raw GPIB command codes via GPIB/LAN gateway
   // VXI-11 RPC is "device_docmd" with command 0x20000 "Send command"
@@ -231,4 +780,21 @@ class Vxi11 {
   int docmd_ifc_control (void);
 };
 
+// Types instantiated in the library, see the end of vxi11.cpp; the code
+// of the others is not generated in each program
+#define VXI11_EXTERN(L, E, S) \
+  extern template class BasicVxi11<L, E, S, Vxi11Transport>; \
+  extern template class BasicVxi11<L, E, S, Vxi11TransportRpc>;
+
+VXI11_EXTERN (Vxi11LockGlobal, Vxi11ErrorLog,  Vxi11StatsTrace)
+VXI11_EXTERN (Vxi11LockGlobal, Vxi11ErrorLog,  Vxi11StatsNone)
+VXI11_EXTERN (Vxi11LockGlobal, Vxi11ErrorNone, Vxi11StatsTrace)
+VXI11_EXTERN (Vxi11LockGlobal, Vxi11ErrorNone, Vxi11StatsNone)
+VXI11_EXTERN (Vxi11LockNone,   Vxi11ErrorLog,  Vxi11StatsTrace)
+VXI11_EXTERN (Vxi11LockNone,   Vxi11ErrorLog,  Vxi11StatsNone)
+VXI11_EXTERN (Vxi11LockNone,   Vxi11ErrorNone, Vxi11StatsTrace)
+VXI11_EXTERN (Vxi11LockNone,   Vxi11ErrorNone, Vxi11StatsNone)
+
+#undef VXI11_EXTERN
+
 #endif
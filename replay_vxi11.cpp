@@ -0,0 +1,350 @@
+// ***************************************************************************
+// replay_vxi11.cpp - Replay a VXI-11 session trace file recorded with
+//                    Vxi11::record()
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Usage: replay_vxi11 [-d] [-r] file
+//
+//   -d  Dump the recorded RPCs instead of replaying them
+//   -r  Replay in real time, waiting for the recorded device reply times
+//
+// The recorded calls are issued again through a Vxi11 object opened with
+// Vxi11::replay(), so no device is needed.  The time spent in the library
+// for each call is compared with the time recorded from the device.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_rpc.h"
+#include "vxi11_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Statistics for one RPC procedure
+struct ProcStats {
+  int cnt_call;                         // Number of library calls replayed
+  int cnt_rpc;                          // Number of RPCs those calls made
+  long long t_record_ns;                // Total recorded RPC time
+  long long t_replay_ns;                // Total replayed library call time
+};
+
+enum {CNT_PROC_MAX=32};                 // Procedure numbers are < 32
+
+// ***************************************************************************
+// proc_name - Get name of an RPC procedure
+// ***************************************************************************
+static const char *
+proc_name (unsigned int prog, unsigned int proc)
+{
+  if (prog == DEVICE_ASYNC)
+    return ((proc == device_abort) ? "device_abort" : "?");
+
+  switch (proc) {
+  case create_link:       return ("create_link");
+  case device_write:      return ("device_write");
+  case device_read:       return ("device_read");
+  case device_readstb:    return ("device_readstb");
+  case device_trigger:    return ("device_trigger");
+  case device_clear:      return ("device_clear");
+  case device_remote:     return ("device_remote");
+  case device_local:      return ("device_local");
+  case device_lock:       return ("device_lock");
+  case device_unlock:     return ("device_unlock");
+  case device_enable_srq: return ("device_enable_srq");
+  case device_docmd:      return ("device_docmd");
+  case destroy_link:      return ("destroy_link");
+  case create_intr_chan:  return ("create_intr_chan");
+  case destroy_intr_chan: return ("destroy_intr_chan");
+  default:                return ("?");
+    }
+}
+
+// ***************************************************************************
+// dump - Print every recorded RPC
+// ***************************************************************************
+static int
+dump (Vxi11ReplayFile *p_file)
+{
+  printf ("Device %s\n", p_file->header ()->s_device_addr);
+  printf ("%12s %10s %-18s %10s %5s %8s %8s\n", "start_us", "dur_us",
+          "procedure", "xid", "stat", "args", "results");
+
+  unsigned long long offset = 0;
+  const Vxi11RecordEntry *p_entry;
+  while ((p_entry = p_file->entry (&offset)) != 0)
+    printf ("%12.1f %10.1f %-18s %10u %5d %8u %8u\n",
+            p_entry->t_begin_ns / 1000.0,
+            (p_entry->t_end_ns - p_entry->t_begin_ns) / 1000.0,
+            proc_name (p_entry->prog, p_entry->proc), p_entry->xid,
+            p_entry->stat, p_entry->cnt_args, p_entry->cnt_res);
+
+  return (0);
+}
+
+// ***************************************************************************
+// replay_entry - Issue the library call for a recorded RPC
+//
+// Parameters:
+// 1. vxi11    - Object opened with Vxi11::replay()
+// 2. p_file   - Session trace file
+// 3. p_entry  - Recorded RPC to issue
+// 4. p_offset - Offset of the entry after p_entry; advanced past entries
+//               consumed by the same library call
+// 5. pcnt_rpc - Returns number of recorded RPCs consumed
+// 6. pt_ns    - Returns total recorded time of those RPCs
+//
+// Returns: 0 = replayed
+//          1 = procedure cannot be replayed and was skipped
+// ***************************************************************************
+static int
+replay_entry (Vxi11 &vxi11, Vxi11ReplayFile *p_file,
+              const Vxi11RecordEntry *p_entry, unsigned long long *p_offset,
+              int *pcnt_rpc, long long *pt_ns)
+{
+  *pcnt_rpc = 1;
+  *pt_ns = p_entry->t_end_ns - p_entry->t_begin_ns;
+
+  if (p_entry->prog == DEVICE_ASYNC) {
+    vxi11.abort ();
+    return (0);
+    }
+
+  switch (p_entry->proc) {
+
+  // A write() sends device_write RPCs until the one with the END flag
+  case device_write: {
+    char *ac_data = 0;
+    int cnt_data = 0;
+    const Vxi11RecordEntry *p_write = p_entry;
+    while (1) {
+      Device_WriteParms writeParms;
+      memset (&writeParms, 0, sizeof (writeParms));
+      if (!p_file->decode_args (p_write, (xdrproc_t)xdr_Device_WriteParms,
+                                &writeParms))
+        break;
+      ac_data = (char *)realloc (ac_data,
+                                 cnt_data + writeParms.data.data_len + 1);
+      memcpy (ac_data + cnt_data, writeParms.data.data_val,
+              writeParms.data.data_len);
+      cnt_data += writeParms.data.data_len;
+      bool b_end = (writeParms.flags & 8) != 0;
+      xdr_free ((xdrproc_t)xdr_Device_WriteParms, (char *)&writeParms);
+
+      // Stop at END, or if the write chunk failed
+      if (b_end || (p_write->stat != RPC_SUCCESS))
+        break;
+      unsigned long long offset = *p_offset;
+      const Vxi11RecordEntry *p_next = p_file->entry (&offset);
+      if (!p_next || (p_next->prog != DEVICE_CORE) ||
+          (p_next->proc != device_write))
+        break;
+      p_write = p_next;
+      *p_offset = offset;
+      (*pcnt_rpc)++;
+      *pt_ns += p_write->t_end_ns - p_write->t_begin_ns;
+      }
+    vxi11.write (ac_data, cnt_data);
+    free (ac_data);
+    return (0);
+    }
+
+  // A read() sends device_read RPCs until END or the termination character
+  case device_read: {
+    Device_ReadParms readParms;
+    memset (&readParms, 0, sizeof (readParms));
+    if (!p_file->decode_args (p_entry, (xdrproc_t)xdr_Device_ReadParms,
+                              &readParms))
+      return (1);
+
+    const Vxi11RecordEntry *p_read = p_entry;
+    while (p_read->stat == RPC_SUCCESS) {
+      Device_ReadResp readResp;
+      memset (&readResp, 0, sizeof (readResp));
+      XDR xdrs;
+      xdrmem_create (&xdrs, (char *)p_file->res (p_read), p_read->cnt_res,
+                     XDR_DECODE);
+      bool b_ok = xdr_Device_ReadResp (&xdrs, &readResp);
+      xdr_destroy (&xdrs);
+      long reason = readResp.reason;
+      long error = readResp.error;
+      xdr_free ((xdrproc_t)xdr_Device_ReadResp, (char *)&readResp);
+      if (!b_ok || error || (reason & 6))
+        break;
+      unsigned long long offset = *p_offset;
+      const Vxi11RecordEntry *p_next = p_file->entry (&offset);
+      if (!p_next || (p_next->prog != DEVICE_CORE) ||
+          (p_next->proc != device_read))
+        break;
+      p_read = p_next;
+      *p_offset = offset;
+      (*pcnt_rpc)++;
+      *pt_ns += p_read->t_end_ns - p_read->t_begin_ns;
+      }
+
+    if (readParms.flags & 128)
+      vxi11.read_terminator (readParms.termChar);
+    else
+      vxi11.read_terminator (-1);
+
+    int cnt_max = (readParms.requestSize > 0) ? readParms.requestSize : 1;
+    char *ac_data = (char *)malloc (cnt_max);
+    vxi11.read (ac_data, cnt_max);
+    free (ac_data);
+    return (0);
+    }
+
+  case device_readstb: vxi11.readstb (); return (0);
+  case device_trigger: vxi11.trigger (); return (0);
+  case device_clear:   vxi11.clear ();   return (0);
+  case device_remote:  vxi11.remote ();  return (0);
+  case device_local:   vxi11.local ();   return (0);
+  case device_lock:    vxi11.lock ();    return (0);
+  case device_unlock:  vxi11.unlock ();  return (0);
+
+  case device_docmd: {
+    Device_DocmdParms docmdParms;
+    memset (&docmdParms, 0, sizeof (docmdParms));
+    if (!p_file->decode_args (p_entry, (xdrproc_t)xdr_Device_DocmdParms,
+                              &docmdParms))
+      return (1);
+    int cnt_in = docmdParms.data_in.data_in_len;
+    char ac_in[8] = {0};
+    memcpy (ac_in, docmdParms.data_in.data_in_val, (cnt_in < 8) ? cnt_in :8);
+    int err = 0;
+    switch (docmdParms.cmd) {
+    case 0x20000: {
+      char *s_data = (char *)malloc (cnt_in + 1);
+      memcpy (s_data, docmdParms.data_in.data_in_val, cnt_in);
+      s_data[cnt_in] = 0;
+      vxi11.docmd_send_command (s_data);
+      free (s_data);
+      break;
+      }
+    case 0x20001: vxi11.docmd_bus_status (*(short *)ac_in); break;
+    case 0x20002: vxi11.docmd_atn_control (*(short *)ac_in != 0); break;
+    case 0x20003: vxi11.docmd_ren_control (*(short *)ac_in != 0); break;
+    case 0x20004: vxi11.docmd_pass_control (*(int *)ac_in); break;
+    case 0x2000a: vxi11.docmd_bus_address (*(int *)ac_in); break;
+    case 0x20010: vxi11.docmd_ifc_control (); break;
+    default:      err = 1; break;
+      }
+    xdr_free ((xdrproc_t)xdr_Device_DocmdParms, (char *)&docmdParms);
+    return (err);
+    }
+
+  // SRQ interrupts need the SRQ service of the original application, and
+  // the link is created and destroyed by replay() and close()
+  default:
+    return (1);
+    }
+}
+
+// ***************************************************************************
+// main
+// ***************************************************************************
+int main (int argc, char **argv)
+{
+  bool b_dump = false;
+  bool b_realtime = false;
+  int opt;
+  while ((opt = getopt (argc, argv, "dr")) != -1) {
+    switch (opt) {
+    case 'd': b_dump = true;     break;
+    case 'r': b_realtime = true; break;
+    default:
+      fprintf (stderr, "Usage: %s [-d] [-r] file\n", argv[0]);
+      return (1);
+      }
+    }
+  if (optind >= argc) {
+    fprintf (stderr, "Usage: %s [-d] [-r] file\n", argv[0]);
+    return (1);
+    }
+  const char *s_file = argv[optind];
+
+  Vxi11ReplayFile file;
+  if (file.open (s_file))
+    return (1);
+
+  if (b_dump)
+    return (dump (&file));
+
+  Vxi11 vxi11;
+  if (vxi11.replay (s_file, b_realtime))
+    return (1);
+
+  ProcStats a_stats[2][CNT_PROC_MAX];
+  memset (a_stats, 0, sizeof (a_stats));
+  int cnt_skip = 0;
+
+  long long t_start_ns = Vxi11Tracer::time_ns ();
+  long long t_record_first_ns = -1;
+  long long t_record_last_ns = 0;
+
+  unsigned long long offset = 0;
+  const Vxi11RecordEntry *p_entry;
+  while ((p_entry = file.entry (&offset)) != 0) {
+    if (t_record_first_ns < 0)
+      t_record_first_ns = p_entry->t_begin_ns;
+    if (p_entry->t_end_ns > t_record_last_ns)
+      t_record_last_ns = p_entry->t_end_ns;
+
+    if ((p_entry->prog == DEVICE_CORE) &&
+        ((p_entry->proc == create_link) || (p_entry->proc == destroy_link)))
+      continue;
+
+    int cnt_rpc;
+    long long t_record_ns;
+    long long t_begin_ns = Vxi11Tracer::time_ns ();
+    int err = replay_entry (vxi11, &file, p_entry, &offset, &cnt_rpc,
+                            &t_record_ns);
+    long long t_end_ns = Vxi11Tracer::time_ns ();
+
+    if (err) {
+      cnt_skip++;
+      continue;
+      }
+
+    // Use the last entry consumed, which has the same procedure
+    ProcStats *p_stats =
+      &a_stats[(p_entry->prog == DEVICE_ASYNC) ? 1 : 0][p_entry->proc %
+                                                        CNT_PROC_MAX];
+    p_stats->cnt_call++;
+    p_stats->cnt_rpc += cnt_rpc;
+    p_stats->t_record_ns += t_record_ns;
+    p_stats->t_replay_ns += t_end_ns - t_begin_ns;
+    }
+
+  vxi11.close ();
+  long long t_replay_ns = Vxi11Tracer::time_ns () - t_start_ns;
+
+  printf ("Device %s\n", file.header ()->s_device_addr);
+  printf ("%-18s %8s %8s %14s %14s\n", "procedure", "calls", "rpcs",
+          "recorded_us", "replayed_us");
+  for (int idx_prog=0; idx_prog < 2; idx_prog++)
+    for (int proc=0; proc < CNT_PROC_MAX; proc++) {
+      ProcStats *p_stats = &a_stats[idx_prog][proc];
+      if (!p_stats->cnt_call)
+        continue;
+      printf ("%-18s %8d %8d %14.1f %14.1f\n",
+              proc_name ((idx_prog) ? DEVICE_ASYNC : DEVICE_CORE, proc),
+              p_stats->cnt_call, p_stats->cnt_rpc,
+              p_stats->t_record_ns / 1000.0, p_stats->t_replay_ns / 1000.0);
+      }
+  printf ("Session: recorded %.1f us, replayed %.1f us, %d RPCs skipped\n",
+          (t_record_first_ns < 0) ? 0.0 :
+            (t_record_last_ns - t_record_first_ns) / 1000.0,
+          t_replay_ns / 1000.0, cnt_skip);
+
+  return (0);
+}
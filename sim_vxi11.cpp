@@ -0,0 +1,146 @@
+// ***************************************************************************
+// sim_vxi11.cpp - Run the VXI-11 instrument simulator as a server
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Usage: sim_vxi11 [-p port] [-H port] [-S port] [-m max_recv_size]
+//                  [-f read_fragment] [-o opc_delay_us] [-i idn] [-l op=us]...
+//                  [-s srq_period_ms]
+//
+//   -p  TCP port of the core channel, default any free port
+//   -H  TCP port of HiSLIP, default any free port
+//   -S  TCP port of the raw SCPI socket, default any free port
+//   -m  maxRecvSize returned by create_link, default 1048576
+//   -f  Most bytes returned by one device_read, default no limit
+//   -o  Delay until *OPC and *OPC? complete, in us
+//   -i  Response to *IDN?
+//   -l  Latency of an operation in us, op is one of
+//         create_link write read readstb trigger clear remote local lock
+//         unlock enable_srq docmd destroy_link
+//       or "all"; may be repeated
+//   -s  Request service on all devices periodically, in ms
+//
+// The simulator is not registered with the portmapper.  Connect to it with
+// the address "host:port", for example
+//   Vxi11 vxi11 ("127.0.0.1:1024");
+// or for HiSLIP, with the device name "hislip0,port", for example
+//   Vxi11 vxi11 ("127.0.0.1", "hislip0,4880");
+// or for the raw SCPI socket, with the device name "socket,port", for example
+//   Vxi11 vxi11 ("127.0.0.1", "socket,5025");
+// The server runs until interrupted.
+// ***************************************************************************
+
+#include "vxi11_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Names of the operations with a latency, in Vxi11Sim::Op order
+static const char *_as_op[] = {
+  "create_link", "write", "read", "readstb", "trigger", "clear", "remote",
+  "local", "lock", "unlock", "enable_srq", "docmd", "destroy_link"
+};
+static const int CNT_OP_NAME = sizeof (_as_op) / sizeof (_as_op[0]);
+
+static volatile sig_atomic_t _b_stop = 0;  // Set by SIGINT and SIGTERM
+
+static void
+fn_signal (int sig)
+{
+  _b_stop = 1;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: sim_vxi11 [-p port] [-H port] [-S port] "
+           "[-m max_recv_size]\n"
+           "                 [-f read_fragment] [-o opc_delay_us] [-i idn] "
+           "[-l op=us]...\n"
+           "                 [-s srq_period_ms]\n");
+}
+
+int main (int argc, char *argv[])
+{
+  Vxi11Sim sim;
+  int port = 0;
+  int port_hislip = 0;
+  int port_socket = 0;
+  int srq_period_ms = 0;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "p:H:S:m:f:o:i:l:s:")) != -1) {
+    switch (opt) {
+    case 'p': port = atoi (optarg);                  break;
+    case 'H': port_hislip = atoi (optarg);           break;
+    case 'S': port_socket = atoi (optarg);           break;
+    case 'm': sim.max_recv_size (strtoul (optarg, 0, 0)); break;
+    case 'f': sim.read_fragment (strtoul (optarg, 0, 0)); break;
+    case 'o': sim.opc_delay (atoi (optarg));         break;
+    case 'i': sim.idn (optarg);                      break;
+    case 's': srq_period_ms = atoi (optarg);         break;
+    case 'l': {
+      const char *p_equal = strchr (optarg, '=');
+      if (!p_equal) {
+        usage ();
+        return (1);
+        }
+      int len = p_equal - optarg;
+      int us = atoi (p_equal + 1);
+      bool b_found = false;
+      for (int op=0; op < CNT_OP_NAME; op++) {
+        if ((len == 3 && !strncmp (optarg, "all", 3)) ||
+            (len == (int)strlen (_as_op[op]) &&
+             !strncmp (optarg, _as_op[op], len))) {
+          sim.latency (op, us);
+          b_found = true;
+          }
+        }
+      if (!b_found) {
+        fprintf (stderr, "sim_vxi11: unknown operation %.*s\n", len, optarg);
+        return (1);
+        }
+      break;
+      }
+    default:
+      usage ();
+      return (1);
+      }
+    }
+
+  if (sim.start (port, port_hislip, port_socket))
+    return (1);
+  printf ("sim_vxi11: core channel on port %d, abort channel on port %d, "
+          "HiSLIP on port %d, socket on port %d\n", sim.port (),
+          sim.port_abort (), sim.port_hislip (), sim.port_socket ());
+  fflush (stdout);
+
+  signal (SIGINT, fn_signal);
+  signal (SIGTERM, fn_signal);
+
+  int t_ms = 0;
+  while (!_b_stop) {
+    usleep (10000);
+    t_ms += 10;
+    if (srq_period_ms > 0 && t_ms >= srq_period_ms) {
+      sim.srq ();
+      t_ms = 0;
+      }
+    }
+
+  sim.stop ();
+  printf ("sim_vxi11: served %lu writes, %lu reads, %lu readstb\n",
+          sim.count (Vxi11Sim::OP_WRITE), sim.count (Vxi11Sim::OP_READ),
+          sim.count (Vxi11Sim::OP_READSTB));
+  return (0);
+}
@@ -0,0 +1,2180 @@
+// ***************************************************************************
+// test_sim_vxi11.cpp - Regression tests of the Vxi11 class against the local
+//                      instrument simulator
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Usage: test_sim_vxi11 [test]...
+//
+// Tests (default all):
+//   sim            Queries, blocks, latency and counters of the simulator
+//   tracer         Events of a Vxi11Tracer for each RPC, and the JSON file
+//                  of Vxi11TraceChrome
+//   record         Session recorded with record(), read back and replayed
+//                  with replay() without calling the simulator
+//   hislip         Messages, blocks, status byte, lock, SRQ and timeout of
+//                  a HiSLIP device, also opened by a VISA resource string
+//   socket         Messages, blocks with newlines, emulated status byte and
+//                  clear, and unsupported calls of a raw SCPI socket
+//   transport      Calls of a link through a Vxi11Transport of the program
+//   bare           Calls of Vxi11Bare, without tracing or counters, and the
+//                  features it refuses
+//   fragments      Replies in several record fragments, split over several
+//                  receives, after the reply of an old call, and with a
+//                  fragment header too large, with the io_uring and epoll
+//                  transports (Linux only)
+//   trigger_skew   Send times and skews of trigger_all() of an
+//                  InstrumentGroup, with a slow device (Linux only)
+//   query_all      Replies of query_all() of an InstrumentGroup parsed for
+//                  each link, and a device that went away (Linux only)
+//   executor       Order of the jobs of each link, merged writes, and a link
+//                  stolen from a busy thread of a Vxi11Executor
+//   srq_handle     SRQ handles of deleted and reused table entries, and
+//                  SRQs after disable/enable and after close()
+//   wait_for_srq   wait_for_srq() woken up by the SRQ of an operation
+//                  complete, and timing out without one
+//   poller_remove  Vxi11Poller::remove() while the completion function runs,
+//                  and from the completion function
+//   readstb_share  One device_readstb shared by the threads calling
+//                  readstb(), and the status byte reused within
+//                  readstb_max_age()
+//   cancel         Cancellation tokens and call deadlines with a slow
+//                  device, and a device that does not reply at all
+//   timeout        Timeouts in ms of each kind of operation, and their
+//                  override by Vxi11TimeoutScope
+//   rtt_timeout    Timeouts derived from the latency of the calls, at the
+//                  floor and the ceiling of rtt_timeout(), and backing off
+//   breaker        Circuit breaker opening after calls without reply,
+//                  failing calls at once, and closing after a probe, also
+//                  after the simulator restarted, and while the probe of
+//                  another device gets no reply
+//   read_grow      Responses read to a string or vector that grows, with
+//                  the size of the longest one reserved for the next
+//   read_stats     Chunk counters of read() with a device that fragments
+//                  its responses, and a definite length block header
+//                  larger than the data sent
+//   write_buffer   Buffered commands sent in one device_write, before the
+//                  calls that depend on them, also by Vxi11Bare, and before
+//                  trigger_all() of an InstrumentGroup (Linux only)
+//
+// Each check that fails is printed with its line.  The exit status is 1 if
+// any check failed.  Run with "make test".
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_sim.h"
+#include "vxi11_srq.h"
+#include "vxi11_poller.h"
+#include "vxi11_cancel.h"
+#include "vxi11_breaker.h"
+#include "vxi11_record.h"
+#include "vxi11_transport.h"
+#include "vxi11_executor.h"
+#include "vxi11_rpc.h"
+#ifdef __linux__
+#include "vxi11_uring.h"
+#include "vxi11_group.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static Vxi11Sim _sim;                   // Local instrument simulator
+static char _s_addr[64];                // "127.0.0.1:port" of _sim
+static int _cnt_check = 0;              // Checks made so far
+static int _cnt_fail = 0;               // Checks failed so far
+
+static long long time_ns (void) { return (Vxi11Tracer::time_ns ()); }
+
+// Check that an expression is true
+#define CHECK(b_expr)   check ((b_expr), #b_expr, __LINE__)
+
+// ***************************************************************************
+// check - Count a check, and print it if it failed
+//
+// Parameters:
+// 1. b_ok   - Result of the check
+// 2. s_expr - Expression checked
+// 3. line   - Line of the check
+//
+// Returns: b_ok
+// ***************************************************************************
+static bool
+check (bool b_ok, const char *s_expr, int line)
+{
+  _cnt_check++;
+  if (!b_ok) {
+    _cnt_fail++;
+    fprintf (stderr, "test_sim_vxi11.cpp:%d: check failed: %s\n", line,
+             s_expr);
+    }
+  return (b_ok);
+}
+
+// ***************************************************************************
+// ms_since - Time elapsed since t0_ns, in ms
+// ***************************************************************************
+static double
+ms_since (long long t0_ns)
+{
+  return ((time_ns () - t0_ns) / 1e6);
+}
+
+// ***************************************************************************
+// test_sim - Test the simulator through the Vxi11 class
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_sim (void)
+{
+  char s_resp[256];
+  Vxi11 vxi11 (_s_addr);
+  _sim.count_reset ();
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "Lew Engineering,VXI-11 Simulator", 32));
+  CHECK (!vxi11.query ("ECHO? hello", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "hello", 5));
+  CHECK (_sim.count (Vxi11Sim::OP_WRITE) == 2);
+  CHECK (_sim.count (Vxi11Sim::OP_READ) == 2);
+
+  // Definite length block
+  std::string s_block;
+  CHECK (!vxi11.query ("DATA? 1000", s_block));
+  CHECK (s_block.size () >= 1006 && !s_block.compare (0, 6, "#41000"));
+
+  // Status registers and *OPC?
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+  CHECK (vxi11.readstb () == 0x60);
+  CHECK (!vxi11.query ("*OPC?", s_resp, sizeof (s_resp)));
+  CHECK (atoi (s_resp) == 1);
+
+  // Latency of an operation
+  _sim.latency (Vxi11Sim::OP_READSTB, 50000);
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.readstb () >= 0);
+  CHECK (ms_since (t0_ns) >= 45);
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  CHECK (!vxi11.close ());
+}
+
+// ***************************************************************************
+// Vxi11Tracer keeping the events of the RPCs made
+// ***************************************************************************
+class TraceEvents : public Vxi11Tracer {
+ public:
+  std::vector<Vxi11TraceEvent> a_begin; // Events of rpc_begin()
+  std::vector<Vxi11TraceEvent> a_end;   // Events of rpc_end()
+
+  virtual void rpc_begin (const Vxi11TraceEvent &event) {
+    a_begin.push_back (event);
+    }
+  virtual void rpc_end (const Vxi11TraceEvent &event) {
+    a_end.push_back (event);
+    }
+};
+
+// ***************************************************************************
+// test_tracer - Test the events passed to a Vxi11Tracer, and the JSON file
+//               of Vxi11TraceChrome
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_tracer (void)
+{
+  Vxi11 vxi11 (_s_addr);
+  char s_resp[256];
+
+  // One begin and one end event for each RPC, with the link ID, sizes and
+  // times of the call
+  TraceEvents trace;
+  Vxi11::tracer (&trace);
+  CHECK (!vxi11.query ("ECHO? traced", s_resp, sizeof (s_resp)));
+  Vxi11::tracer (0);
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  if (CHECK (trace.a_begin.size () == 2 && trace.a_end.size () == 2)) {
+    const Vxi11TraceEvent &write = trace.a_end[0];
+    const Vxi11TraceEvent &read = trace.a_end[1];
+    CHECK (!strcmp (trace.a_begin[0].s_proc, "device_write"));
+    CHECK (!strcmp (write.s_proc, "device_write"));
+    CHECK (!strcmp (read.s_proc, "device_read"));
+    CHECK (write.p_vxi11 == &vxi11 && write.lid == vxi11.lid ());
+    CHECK (write.cnt_send == 12 && !write.err);
+    CHECK (read.cnt_recv == 7);         // "traced" and a line feed
+    CHECK (!read.err && (read.xid != write.xid));
+    CHECK (trace.a_begin[1].t_begin_ns >= write.t_end_ns);
+    CHECK (read.t_end_ns >= read.t_begin_ns);
+    }
+
+  // A call without reply ends with error -1
+  TraceEvents trace_fail;
+  Vxi11Timeout timeout = {50, 50, 100};
+  vxi11.timeout (Vxi11::OP_READSTB, timeout);
+  _sim.latency (Vxi11Sim::OP_READSTB, 300000);
+  Vxi11::tracer (&trace_fail);
+  CHECK (vxi11.readstb () < 0);
+  Vxi11::tracer (0);
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  CHECK (trace_fail.a_end.size () == 1 && trace_fail.a_end[0].err == -1);
+  usleep (300000);                      // Late reply of the simulator
+  vxi11.close ();
+
+  // Chrome trace-event JSON with one slice for each RPC
+  char s_file[] = "/tmp/test_sim_vxi11_XXXXXX";
+  int fd = mkstemp (s_file);
+  if (!CHECK (fd >= 0))
+    return;
+  ::close (fd);
+  Vxi11TraceChrome chrome;
+  CHECK (!chrome.open (s_file));
+  Vxi11 vxi11_chrome (_s_addr);
+  Vxi11::tracer (&chrome);
+  CHECK (!vxi11_chrome.query ("ECHO? chrome", s_resp, sizeof (s_resp)));
+  Vxi11::tracer (0);
+  CHECK (!chrome.close ());
+  vxi11_chrome.close ();
+
+  std::string s_json;
+  FILE *p_file = fopen (s_file, "r");
+  if (CHECK (p_file != 0)) {
+    char s_buf[1024];
+    size_t cnt;
+    while ((cnt = fread (s_buf, 1, sizeof (s_buf), p_file)) > 0)
+      s_json.append (s_buf, cnt);
+    fclose (p_file);
+    }
+  unlink (s_file);
+  const char *s_head = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  CHECK (!s_json.compare (0, strlen (s_head), s_head));
+  CHECK (s_json.size () > 4 &&
+         !s_json.compare (s_json.size () - 4, 4, "\n]}\n"));
+  CHECK (s_json.find ("\"name\":\"device_write\",\"cat\":\"rpc\"") !=
+         std::string::npos);
+  CHECK (s_json.find ("\"name\":\"device_read\",\"cat\":\"rpc\"") !=
+         std::string::npos);
+  CHECK (s_json.find ("\"send\":12,") != std::string::npos);
+}
+
+// ***************************************************************************
+// record_calls - Make the calls of the record test on a link
+//
+// Parameters:
+// 1. p_vxi11 - Link, opened or replayed
+// 2. s_resp  - Returns the response to "ECHO? recorded"
+// 3. s_block - Returns the response to "DATA? 100"
+//
+// Returns: Status byte, -1 if error
+// ***************************************************************************
+static int
+record_calls (Vxi11 *p_vxi11, char *s_resp, std::string &s_block)
+{
+  if (p_vxi11->query ("ECHO? recorded", s_resp, 64) ||
+      p_vxi11->query ("DATA? 100", s_block))
+    return (-1);
+  return (p_vxi11->readstb ());
+}
+
+// ***************************************************************************
+// test_record - Test a session recorded with record() and replayed with
+//               replay()
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_record (void)
+{
+  char s_file[] = "/tmp/test_sim_vxi11_XXXXXX";
+  int fd = mkstemp (s_file);
+  if (!CHECK (fd >= 0))
+    return;
+  ::close (fd);
+
+  // Record a session
+  char s_resp[64];
+  std::string s_block;
+  Vxi11 vxi11;
+  CHECK (!vxi11.record (s_file));
+  CHECK (!vxi11.open (_s_addr, 0));
+  CHECK (!vxi11.printf ("*SRE 16"));
+  int stb = record_calls (&vxi11, s_resp, s_block);
+  CHECK (stb >= 0);
+  CHECK (!vxi11.close ());
+  CHECK (!vxi11.record (0));
+
+  // The file has the calls of the core channel in order, with their
+  // replies
+  Vxi11ReplayFile replayFile;
+  if (CHECK (!replayFile.open (s_file))) {
+    const Vxi11RecordHeader *p_header = replayFile.header ();
+    CHECK (!memcmp (p_header->magic, VXI11_RECORD_MAGIC, 8));
+    CHECK (strstr (p_header->s_device_addr, _s_addr) != 0);
+    std::vector<unsigned int> a_proc;
+    unsigned long long offset = 0;
+    const Vxi11RecordEntry *p_entry;
+    while ((p_entry = replayFile.entry (&offset)) != 0) {
+      if (p_entry->prog != DEVICE_CORE)
+        continue;
+      CHECK ((p_entry->stat == RPC_SUCCESS) && p_entry->cnt_res);
+      CHECK (p_entry->t_end_ns >= p_entry->t_begin_ns);
+      a_proc.push_back (p_entry->proc);
+      }
+    const unsigned int a_proc_expect[] = {
+      create_link, device_write, device_write, device_read, device_write,
+      device_read, device_readstb, destroy_link};
+    CHECK (a_proc == std::vector<unsigned int> (a_proc_expect,
+                                                a_proc_expect + 8));
+    replayFile.close ();
+    }
+
+  // Replay it without calling the device, with the same results
+  _sim.count_reset ();
+  Vxi11 vxi11_replay;
+  CHECK (!vxi11_replay.replay (s_file));
+  char s_resp_replay[64];
+  std::string s_block_replay;
+  CHECK (!vxi11_replay.printf ("*SRE 16"));
+  CHECK (record_calls (&vxi11_replay, s_resp_replay, s_block_replay) ==
+         stb);
+  CHECK (!strcmp (s_resp_replay, s_resp) && (s_block_replay == s_block));
+  CHECK (!vxi11_replay.close ());
+  CHECK (!_sim.count (Vxi11Sim::OP_WRITE) && !_sim.count (Vxi11Sim::OP_READ));
+  unlink (s_file);
+}
+
+// ***************************************************************************
+// wait_count - Wait until a counter reaches a value
+//
+// Parameters:
+// 1. p_cnt      - Counter, changed by other threads
+// 2. cnt        - Value to wait for
+// 3. timeout_ms - Time to wait
+//
+// Returns: true if the counter reached cnt
+// ***************************************************************************
+static bool
+wait_count (int *p_cnt, int cnt, int timeout_ms)
+{
+  long long t0_ns = time_ns ();
+  while (__atomic_load_n (p_cnt, __ATOMIC_ACQUIRE) < cnt) {
+    if (ms_since (t0_ns) > timeout_ms)
+      return (false);
+    usleep (1000);
+    }
+  return (true);
+}
+
+// SRQ handler counting the SRQs of a link
+static void
+on_srq_count (Vxi11 *p_vxi11, void *p_arg)
+{
+  __atomic_add_fetch ((int *)p_arg, 1, __ATOMIC_RELEASE);
+}
+
+// ***************************************************************************
+// test_hislip - Test a HiSLIP device of the simulator through the Vxi11
+//               class
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_hislip (void)
+{
+  char s_device[64], s_resp[256];
+  snprintf (s_device, sizeof (s_device), "hislip0,%d", _sim.port_hislip ());
+  Vxi11 vxi11 ("127.0.0.1", s_device);
+  if (!CHECK (vxi11.lid () >= 0))
+    return;
+
+  // Messages, blocks and the status byte
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "Lew Engineering,VXI-11 Simulator", 32));
+  std::string s_block;
+  CHECK (!vxi11.query ("DATA? 100000", s_block));
+  CHECK (s_block.size () == 100009 && !s_block.compare (0, 8, "#6100000"));
+  // The status query is sent on the async channel, which may pass the
+  // write, so *OPC? waits for the write first
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+  CHECK (!vxi11.query ("*OPC?", s_resp, sizeof (s_resp)));
+  CHECK (vxi11.readstb () == 0x60);
+  CHECK (!vxi11.trigger () && !vxi11.clear ());
+  CHECK (!vxi11.remote () && !vxi11.local ());
+
+  // The lock is exclusive between links, and abort() has no channel
+  Vxi11 vxi11_other ("127.0.0.1", s_device);
+  vxi11_other.timeout (0.2);
+  CHECK (!vxi11.lock ());
+  CHECK (vxi11_other.lock ());
+  CHECK (!vxi11.unlock ());
+  CHECK (vxi11.unlock ());
+  CHECK (!vxi11_other.lock () && !vxi11_other.unlock ());
+  vxi11_other.close ();
+  CHECK (vxi11.abort ());
+
+  // SRQ
+  int cnt_srq = 0;
+  CHECK (!vxi11.srq_handler (on_srq_count, &cnt_srq));
+  CHECK (!vxi11.enable_srq (true));
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+  CHECK (wait_count (&cnt_srq, 1, 2000));
+  CHECK (!vxi11.enable_srq (false));
+
+  // A read with nothing to read times out
+  vxi11.timeout (0.2);
+  CHECK (vxi11.read (s_resp, sizeof (s_resp)));
+  CHECK (!vxi11.close ());
+
+  // VISA resource string
+  char s_addr[128];
+  snprintf (s_addr, sizeof (s_addr), "TCPIP0::127.0.0.1::hislip0,%d::INSTR",
+            _sim.port_hislip ());
+  Vxi11 vxi11_visa (s_addr);
+  CHECK (!vxi11_visa.query ("ECHO? visa", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "visa", 4));
+  vxi11_visa.close ();
+}
+
+// ***************************************************************************
+// newline_response - Response generator of the simulator for "NLBLK?", two
+//                    definite length blocks with newlines in their data
+// ***************************************************************************
+static bool
+newline_response (void *p_arg, const std::string &s_cmd, std::string &s_resp)
+{
+  if (s_cmd != "NLBLK?")
+    return (false);
+  s_resp = "#15a\nb\nc,#13x\ny";
+  return (true);
+}
+
+// ***************************************************************************
+// test_socket - Test the raw SCPI socket of the simulator through the Vxi11
+//               class
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_socket (void)
+{
+  Vxi11Sim sim;
+  sim.response (&newline_response, 0);
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[128], s_resp[256];
+  snprintf (s_addr, sizeof (s_addr), "TCPIP0::127.0.0.1::%d::SOCKET",
+            sim.port_socket ());
+  Vxi11 vxi11 (s_addr);
+  if (!CHECK (vxi11.lid () >= 0))
+    return;
+
+  // A message ends at a newline outside of definite length blocks
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "Lew Engineering,VXI-11 Simulator", 32));
+  int cnt_read = 0;
+  CHECK (!vxi11.printf ("NLBLK?"));
+  CHECK (!vxi11.read (s_resp, sizeof (s_resp), &cnt_read));
+  CHECK (cnt_read == 16 && !memcmp (s_resp, "#15a\nb\nc,#13x\ny\n", 16));
+  std::string s_block;
+  CHECK (!vxi11.query ("DATA? 100000", s_block));
+  CHECK (s_block.size () == 100009 && !s_block.compare (0, 8, "#6100000"));
+
+  // readstb() by *STB?, and clear() drops the response not read
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+  CHECK (vxi11.readstb () == 0x60);
+  CHECK (!vxi11.printf ("ECHO? dropped"));
+  usleep (20000);
+  CHECK (!vxi11.clear ());
+  vxi11.timeout (0.2);
+  CHECK (vxi11.read (s_resp, sizeof (s_resp)));
+  CHECK (!vxi11.trigger ());
+  CHECK (!vxi11.query ("ECHO? after", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "after", 5));
+
+  // No lock, remote/local, SRQ or abort channel
+  CHECK (vxi11.lock ());
+  CHECK (vxi11.remote ());
+  int cnt_srq = 0;
+  CHECK (!vxi11.srq_handler (on_srq_count, &cnt_srq));
+  CHECK (vxi11.enable_srq (true));
+  CHECK (vxi11.abort ());
+  CHECK (!vxi11.close ());
+
+  // Device name with the port
+  char s_device[64];
+  snprintf (s_device, sizeof (s_device), "socket,%d", sim.port_socket ());
+  Vxi11 vxi11_device ("127.0.0.1", s_device);
+  CHECK (!vxi11_device.query ("ECHO? device", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "device", 6));
+  vxi11_device.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// Vxi11Transport answering the calls itself, without a device: a write is
+// echoed back by the next read, with "fake:" in front
+// ***************************************************************************
+struct FakeState {
+  std::string s_host;                   // Host given to open()
+  int port;                             // Port given to open()
+  int timeout_ms;                       // Last timeout set
+  int a_cnt_proc[32];                   // Calls of each procedure
+  bool b_deleted;                       // Transport deleted
+};
+
+class FakeTransport : public Vxi11Transport {
+ private:
+  FakeState *_p_state;                  // State seen by the test
+  std::string _s_write;                 // Message being written
+  std::string _s_read;                  // Response not read yet
+
+ protected:
+  virtual enum clnt_stat _call (u_long proc, xdrproc_t xdr_args,
+                                void *p_args, xdrproc_t xdr_res,
+                                void *p_res) {
+    if (proc < 32)
+      _p_state->a_cnt_proc[proc]++;
+    switch (proc) {
+    case create_link: {
+      Create_LinkResp *p_link = (Create_LinkResp *)p_res;
+      p_link->lid = 7;
+      p_link->maxRecvSize = 4;          // Writes of 4 bytes
+      return (RPC_SUCCESS);
+      }
+    case device_write: {
+      Device_WriteParms *p_write = (Device_WriteParms *)p_args;
+      _s_write.append (p_write->data.data_val, p_write->data.data_len);
+      ((Device_WriteResp *)p_res)->size = p_write->data.data_len;
+      if (p_write->flags & 8) {         // END
+        _s_read = "fake:" + _s_write + "\n";
+        _s_write.clear ();
+        }
+      return (RPC_SUCCESS);
+      }
+    case device_read: {
+      Device_ReadParms *p_read = (Device_ReadParms *)p_args;
+      Device_ReadResp *p_resp = (Device_ReadResp *)p_res;
+      size_t cnt = std::min (size_t (p_read->requestSize), _s_read.size ());
+      p_resp->data.data_val = (char *)malloc (cnt ? cnt : 1);
+      memcpy (p_resp->data.data_val, _s_read.data (), cnt);
+      p_resp->data.data_len = cnt;
+      _s_read.erase (0, cnt);
+      p_resp->reason = (_s_read.empty ()) ? 4 : 1;
+      return (RPC_SUCCESS);
+      }
+    case destroy_link:
+      return (RPC_SUCCESS);
+    default:                            // No reply to the others
+      return (RPC_PROCUNAVAIL);
+      }
+    }
+
+  virtual void _cancel (void) {}
+
+ public:
+  FakeTransport (FakeState *p_state) { _p_state = p_state; }
+  virtual ~FakeTransport () { _p_state->b_deleted = true; }
+
+  virtual int open (const char *s_host, int port) {
+    _p_state->s_host = s_host;
+    _p_state->port = port;
+    return (0);
+    }
+  virtual void close (void) {}
+  virtual void free_result (xdrproc_t xdr_res, void *p_res) {
+    xdr_free (xdr_res, (char *)p_res);
+    }
+  virtual void timeout (int timeout_ms) { _p_state->timeout_ms = timeout_ms; }
+  virtual const char *error (void) { return ("no reply from fake"); }
+};
+
+// ***************************************************************************
+// test_transport - Test a Vxi11 link through a transport of the program
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_transport (void)
+{
+  FakeState state;
+  state.port = 0;
+  state.timeout_ms = 0;
+  memset (state.a_cnt_proc, 0, sizeof (state.a_cnt_proc));
+  state.b_deleted = false;
+
+  Vxi11 vxi11;
+  CHECK (!vxi11.open ("fakehost:99", 0, new FakeTransport (&state)));
+  CHECK (state.s_host == "fakehost" && state.port == 99);
+  CHECK (state.a_cnt_proc[create_link] == 1 && vxi11.lid () == 7);
+  CHECK (vxi11.transport () && (vxi11.transport ()->fd () == -1));
+
+  // Every call goes through the transport, split by its maxRecvSize
+  char s_resp[64];
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (!strcmp (s_resp, "fake:*IDN?\n"));
+  CHECK (state.a_cnt_proc[device_write] == 2);
+  CHECK (state.a_cnt_proc[device_read] == 1);
+  vxi11.timeout (2.5);
+  CHECK (!vxi11.query ("ECHO?", s_resp, sizeof (s_resp)));
+  CHECK (state.timeout_ms > 2500);      // RPC timeout after the I/O one
+
+  // A call the transport does not reply to fails, and is counted
+  CHECK (vxi11.trigger ());
+  CHECK (state.a_cnt_proc[device_trigger] == 1);
+  const Vxi11TransportStats &stats = vxi11.transport ()->stats ();
+  CHECK (stats.cnt_call == 8 && stats.cnt_fail == 1);
+
+  // close() destroys the link and deletes the transport
+  CHECK (!vxi11.close ());
+  CHECK (state.a_cnt_proc[destroy_link] == 1 && state.b_deleted);
+}
+
+// SRQ handler counting the SRQs of a Vxi11Bare link
+static void
+on_srq_count_bare (Vxi11Bare *p_vxi11, void *p_arg)
+{
+  __atomic_add_fetch ((int *)p_arg, 1, __ATOMIC_RELEASE);
+}
+
+// ***************************************************************************
+// test_bare - Test the calls of Vxi11Bare, with none of the policies
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_bare (void)
+{
+  Vxi11Bare vxi11 (_s_addr);
+  if (!CHECK (vxi11.lid () >= 0))
+    return;
+
+  // The results of Vxi11, without tracing or counters
+  TraceEvents trace;
+  Vxi11::tracer (&trace);
+  char s_resp[256];
+  CHECK (!vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "Lew Engineering,VXI-11 Simulator", 32));
+  std::string s_block;
+  CHECK (!vxi11.query ("DATA? 1000", s_block));
+  CHECK (s_block.size () == 1007 && !s_block.compare (0, 6, "#41000"));
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+  CHECK (vxi11.readstb () == 0x60);
+  CHECK (!vxi11.trigger () && !vxi11.clear ());
+  Vxi11::tracer (0);
+  CHECK (trace.a_begin.empty () && trace.a_end.empty ());
+  CHECK (vxi11.transport ()->stats ().cnt_call == 0);
+
+  // Errors are returned as with Vxi11; the features that need a lock
+  // policy are refused
+  CHECK (vxi11.write (0, 5));
+  Vxi11Cancel cancel;
+  CHECK (vxi11.cancel_token (&cancel));
+  CHECK (vxi11.call_deadline (1.0));
+  CHECK (vxi11.breaker (2));
+
+  // SRQ handler of its own type
+  int cnt_srq = 0;
+  CHECK (!vxi11.srq_handler (on_srq_count_bare, &cnt_srq));
+  CHECK (!vxi11.enable_srq (true));
+  _sim.srq ("inst0");
+  CHECK (wait_count (&cnt_srq, 1, 2000));
+  CHECK (!vxi11.enable_srq (false));
+  CHECK (!vxi11.close ());
+}
+
+#ifdef __linux__
+// ***************************************************************************
+// Raw ONC-RPC server answering the calls of one connection with replies
+// framed in unusual ways, for the parsing of Vxi11TransportUring
+// ***************************************************************************
+#define RM_LAST         0x80000000u     // Last fragment of a record
+
+enum FragReply {
+  FRAG_SPLIT,                           // Three fragments, sent in pieces
+  FRAG_OLD,                             // Reply of an old call first
+  FRAG_HUGE                             // Fragment header too large
+};
+
+struct FragServer {
+  int sock_listen;                      // Listening socket
+  int port;                             // Its TCP port
+  const FragReply *a_reply;             // Reply of each call
+  int cnt_reply;                        // Calls to answer
+};
+
+// ***************************************************************************
+// recv_full / send_full - Receive or send exactly cnt bytes
+//
+// Returns: 0 = no error
+//          1 = error or connection closed
+// ***************************************************************************
+static int
+recv_full (int sock, void *p_buf, int cnt)
+{
+  for (int pos=0; pos < cnt; ) {
+    int ret = recv (sock, (char *)p_buf + pos, cnt - pos, 0);
+    if (ret <= 0)
+      return (1);
+    pos += ret;
+    }
+  return (0);
+}
+
+static int
+send_full (int sock, const void *p_buf, int cnt)
+{
+  return (send (sock, p_buf, cnt, MSG_NOSIGNAL) != cnt);
+}
+
+// ***************************************************************************
+// fn_frag_server - Thread answering the calls of one connection
+//
+// Parameters:
+// 1. p_arg - Server, type FragServer*
+//
+// Returns: Null
+// ***************************************************************************
+static void *
+fn_frag_server (void *p_arg)
+{
+  FragServer *p_server = (FragServer *)p_arg;
+  int sock = accept (p_server->sock_listen, 0, 0);
+  if (sock < 0)
+    return (0);
+  int b_nodelay = 1;
+  setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, &b_nodelay, sizeof (int));
+
+  for (int idx=0; idx < p_server->cnt_reply; idx++) {
+    // Read the call record, which has one fragment, and get its xid
+    uint32_t header, xid;
+    if (recv_full (sock, &header, 4))
+      break;
+    std::string s_call (ntohl (header) & ~RM_LAST, '\0');
+    if (s_call.size () < 4 || recv_full (sock, &s_call[0], s_call.size ()))
+      break;
+    memcpy (&xid, s_call.data (), 4);
+
+    // Accepted reply with no results: xid, REPLY, MSG_ACCEPTED, null
+    // verifier, SUCCESS
+    uint32_t a_reply[6] = {xid, htonl (1), 0, 0, 0, 0};
+
+    switch (p_server->a_reply[idx]) {
+    case FRAG_SPLIT: {
+      // 8 + 12 + 4 bytes in three fragments, sent a few bytes at a time
+      std::string s_record;
+      const int a_len[3] = {8, 12, 4};
+      int pos = 0;
+      for (int i=0; i < 3; i++) {
+        uint32_t header_frag = htonl (a_len[i] | ((i == 2) ? RM_LAST : 0));
+        s_record.append ((char *)&header_frag, 4);
+        s_record.append ((char *)a_reply + pos, a_len[i]);
+        pos += a_len[i];
+        }
+      for (size_t off=0; off < s_record.size (); off += 5) {
+        size_t cnt = s_record.size () - off;
+        send_full (sock, s_record.data () + off, (cnt < 5) ? cnt : 5);
+        usleep (2000);
+        }
+      break;
+      }
+    case FRAG_OLD: {
+      // The reply of the call before, then this one, in one send
+      uint32_t a_old[6];
+      memcpy (a_old, a_reply, sizeof (a_old));
+      a_old[0] = htonl (ntohl (xid) - 1);
+      uint32_t header_last = htonl (sizeof (a_reply) | RM_LAST);
+      std::string s_record;
+      s_record.append ((char *)&header_last, 4);
+      s_record.append ((char *)a_old, sizeof (a_old));
+      s_record.append ((char *)&header_last, 4);
+      s_record.append ((char *)a_reply, sizeof (a_reply));
+      send_full (sock, s_record.data (), s_record.size ());
+      break;
+      }
+    case FRAG_HUGE: {
+      // A header of almost 2 GB, which must not be allocated
+      uint32_t header_huge = htonl (0xfffffff0u);
+      send_full (sock, &header_huge, 4);
+      send_full (sock, a_reply, sizeof (a_reply));
+      break;
+      }
+      }
+    }
+
+  // Wait for the client to close
+  char c;
+  while (recv (sock, &c, 1, 0) > 0)
+    ;
+  close (sock);
+  return (0);
+}
+
+// ***************************************************************************
+// test_fragments - Test the reply parsing of Vxi11TransportUring
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_fragments (void)
+{
+  static const FragReply a_reply[] =
+    {FRAG_SPLIT, FRAG_OLD, FRAG_SPLIT, FRAG_HUGE};
+  const int cnt_reply = sizeof (a_reply) / sizeof (a_reply[0]);
+
+  for (int b_uring=1; b_uring >= 0; b_uring--) {
+    FragServer server;
+    server.sock_listen = socket (AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    socklen_t len_addr = sizeof (addr);
+    if (!CHECK (!bind (server.sock_listen, (sockaddr *)&addr,
+                       sizeof (addr)) &&
+                !listen (server.sock_listen, 1) &&
+                !getsockname (server.sock_listen, (sockaddr *)&addr,
+                              &len_addr))) {
+      close (server.sock_listen);
+      return;
+      }
+    server.port = ntohs (addr.sin_port);
+    server.a_reply = a_reply;
+    server.cnt_reply = cnt_reply;
+    pthread_t pthread;
+    pthread_create (&pthread, NULL, fn_frag_server, &server);
+
+    Vxi11Uring uring (4, b_uring);
+    Vxi11TransportUring transport (&uring);
+    CHECK (!transport.open ("127.0.0.1", server.port));
+    transport.timeout (2000);
+    for (int idx=0; idx < cnt_reply; idx++) {
+      long long t0_ns = time_ns ();
+      enum clnt_stat stat = transport.call (0, (xdrproc_t)xdr_void, 0,
+                                            (xdrproc_t)xdr_void, 0);
+      if (a_reply[idx] == FRAG_HUGE) {
+        CHECK (stat == RPC_CANTDECODERES);
+        CHECK (ms_since (t0_ns) < 1000);
+        }
+      else
+        CHECK (stat == RPC_SUCCESS);
+      }
+    transport.close ();
+    pthread_join (pthread, NULL);
+    close (server.sock_listen);
+
+    // A reply larger than the registered buffers, from the simulator
+    Vxi11 vxi11;
+    CHECK (!vxi11.open (_s_addr, 0, new Vxi11TransportUring (&uring)));
+    std::string s_resp;
+    CHECK (!vxi11.query ("DATA? 200000", s_resp));
+    CHECK (s_resp.size () >= 200008 && !s_resp.compare (0, 8, "#6200000"));
+    vxi11.close ();
+    }
+}
+
+// ***************************************************************************
+// test_trigger_skew - Test the send times reported by trigger_all() of an
+//                     InstrumentGroup
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_trigger_skew (void)
+{
+  const int CNT_LINK = 4;
+  for (int b_uring=1; b_uring >= 0; b_uring--) {
+    InstrumentGroup group (8, b_uring);
+    for (int i=0; i < CNT_LINK; i++)
+      CHECK (!group.add (_s_addr));
+
+    // Every link is sent before any reply, so the skews stay well below
+    // the time the device takes to trigger
+    _sim.latency (Vxi11Sim::OP_TRIGGER, 50000);
+    _sim.count_reset ();
+    std::vector<InstrumentGroupTrigger> a_trigger;
+    long long t0_ns = time_ns ();
+    CHECK (group.trigger_all (&a_trigger) == 0);
+    double ms = ms_since (t0_ns);
+    _sim.latency (Vxi11Sim::OP_TRIGGER, 0);
+    CHECK (_sim.count (Vxi11Sim::OP_TRIGGER) == CNT_LINK);
+    CHECK (ms < 50.0 * CNT_LINK);
+    if (!CHECK (a_trigger.size () == CNT_LINK))
+      continue;
+
+    // The skew is the send time after the earliest send of the group
+    long long t_first_ns = a_trigger[0].t_sent_ns;
+    long long t_skew_min_ns = a_trigger[0].t_skew_ns;
+    for (int idx=0; idx < CNT_LINK; idx++) {
+      const InstrumentGroupTrigger &trigger = a_trigger[idx];
+      CHECK (!trigger.err);
+      CHECK (trigger.t_sent_ns >= t0_ns);
+      CHECK (trigger.t_skew_ns >= 0 && trigger.t_skew_ns < 20000000);
+      if (trigger.t_sent_ns < t_first_ns)
+        t_first_ns = trigger.t_sent_ns;
+      if (trigger.t_skew_ns < t_skew_min_ns)
+        t_skew_min_ns = trigger.t_skew_ns;
+      }
+    CHECK (t_skew_min_ns == 0);
+    for (int idx=0; idx < CNT_LINK; idx++)
+      CHECK (a_trigger[idx].t_skew_ns ==
+             a_trigger[idx].t_sent_ns - t_first_ns);
+    }
+}
+
+// ***************************************************************************
+// test_query_all - Test the replies of query_all() of an InstrumentGroup
+//                  parsed for each link, and the error of a single link
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_query_all (void)
+{
+  for (int b_uring=1; b_uring >= 0; b_uring--) {
+    // A different device on each link, each with its own *ESE value
+    InstrumentGroup group (8, b_uring);
+    static const char *a_s_device[] = {"inst0", "inst1", "inst2"};
+    const int cnt_device = sizeof (a_s_device) / sizeof (a_s_device[0]);
+    for (int idx=0; idx < cnt_device; idx++) {
+      CHECK (!group.add (_s_addr, a_s_device[idx]));
+      CHECK (!group.link (idx)->printf ("*ESE %d", 10 + idx));
+      }
+
+    // Each reply is parsed for its own link, in the order added
+    std::vector<InstrumentGroupValue<int> > a_int;
+    CHECK (group.query_all ("*ESE?", a_int) == 0);
+    CHECK (a_int.size () == size_t (cnt_device));
+    for (size_t idx=0; idx < a_int.size (); idx++)
+      CHECK (!a_int[idx].err && a_int[idx].val == 10 + int (idx));
+    std::vector<InstrumentGroupValue<double> > a_dbl;
+    CHECK (group.query_all ("MEAS:VOLT?", a_dbl) == 0);
+    CHECK (a_dbl.size () == size_t (cnt_device));
+    for (size_t idx=0; idx < a_dbl.size (); idx++)
+      CHECK (!a_dbl[idx].err && a_dbl[idx].val == 1.0);
+    std::vector<InstrumentGroupValue<std::string> > a_str;
+    CHECK (group.query_all ("DATA? 100000", a_str) == 0);
+    for (size_t idx=0; idx < a_str.size (); idx++)
+      CHECK (!a_str[idx].err && a_str[idx].val.size () >= 100007 &&
+             !a_str[idx].val.compare (0, 8, "#6100000"));
+
+    // A reply that is not a number, or too long, is an error with no value
+    CHECK (group.query_all ("*IDN?", a_dbl) == cnt_device);
+    for (size_t idx=0; idx < a_dbl.size (); idx++)
+      CHECK (a_dbl[idx].err == -2 && a_dbl[idx].val == 0);
+    CHECK (group.query_all ("DATA? 2000000", a_str) == cnt_device);
+    for (size_t idx=0; idx < a_str.size (); idx++)
+      CHECK (a_str[idx].err == -2 && a_str[idx].val.empty ());
+
+    // A device that went away fails alone, and the others still reply
+    Vxi11Sim sim_gone;
+    if (!CHECK (!sim_gone.start ()))
+      return;
+    char s_addr_gone[64];
+    snprintf (s_addr_gone, sizeof (s_addr_gone), "127.0.0.1:%d",
+              sim_gone.port ());
+    if (!CHECK (!group.add (s_addr_gone)))
+      return;
+    sim_gone.stop ();
+    CHECK (group.query_all ("*ESE?", a_int) == 1);
+    CHECK (a_int.size () == size_t (cnt_device + 1));
+    for (int idx=0; idx < cnt_device; idx++)
+      CHECK (!a_int[idx].err && a_int[idx].val == 10 + idx);
+    CHECK (a_int[cnt_device].err && !a_int[cnt_device].val);
+    }
+}
+#endif
+
+// ***************************************************************************
+// Jobs of Vxi11Executor that record their order, wait for a gate, or
+// submit a job on another link
+// ***************************************************************************
+struct ExecLog {
+  std::vector<int> a_idx;               // Index of each job run, in order
+};
+
+struct ExecStep {
+  ExecLog *p_log;                       // Log of the link
+  int idx;                              // Index of the job
+};
+
+static int
+fn_exec_step (Vxi11 *p_vxi11, void *p_arg)
+{
+  ExecStep *p_step = (ExecStep *)p_arg;
+  p_step->p_log->a_idx.push_back (p_step->idx);
+  return (0);
+}
+
+static int
+fn_exec_gate (Vxi11 *p_vxi11, void *p_arg)
+{
+  return (!wait_count ((int *)p_arg, 1, 2000));
+}
+
+struct ExecNested {
+  Vxi11Executor *p_executor;            // Executor running the job
+  Vxi11 *p_vxi11_other;                 // Link of the nested job
+  Vxi11JobReadstb job_other;            // Nested job
+};
+
+static int
+fn_exec_nested (Vxi11 *p_vxi11, void *p_arg)
+{
+  // The nested link goes on the deque of this thread, which is busy
+  // until another thread has stolen and run it
+  ExecNested *p_nested = (ExecNested *)p_arg;
+  if (p_nested->p_executor->submit (p_nested->p_vxi11_other,
+                                    &p_nested->job_other))
+    return (1);
+  long long t0_ns = time_ns ();
+  while (!p_nested->job_other.done ()) {
+    if (ms_since (t0_ns) > 2000)
+      return (1);
+    usleep (1000);
+    }
+  return (0);
+}
+
+// ***************************************************************************
+// test_executor - Test the order, merging and stealing of the jobs of a
+//                 Vxi11Executor
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_executor (void)
+{
+  const int CNT_LINK = 4;
+  const int CNT_STEP = 200;
+  Vxi11 a_vxi11[CNT_LINK];
+  for (int idx=0; idx < CNT_LINK; idx++)
+    CHECK (!a_vxi11[idx].open (_s_addr, 0));
+
+  {
+    // The jobs of each link run in the order submitted, with the links
+    // spread over the threads
+    Vxi11Executor executor (3);
+    ExecLog a_log[CNT_LINK];
+    std::vector<ExecStep> a_step (CNT_STEP);
+    std::vector<Vxi11JobFunc *> a_p_job (CNT_STEP);
+    for (int i=0; i < CNT_STEP; i++) {
+      a_step[i].p_log = &a_log[i % CNT_LINK];
+      a_step[i].idx = i;
+      a_p_job[i] = new Vxi11JobFunc (fn_exec_step, &a_step[i]);
+      CHECK (!executor.submit (&a_vxi11[i % CNT_LINK], a_p_job[i]));
+      }
+    executor.drain ();
+    for (int i=0; i < CNT_STEP; i++) {
+      CHECK (a_p_job[i]->done () && !a_p_job[i]->wait ());
+      delete a_p_job[i];
+      }
+    for (int idx=0; idx < CNT_LINK; idx++) {
+      CHECK (int (a_log[idx].a_idx.size ()) == CNT_STEP / CNT_LINK);
+      for (size_t i=0; i < a_log[idx].a_idx.size (); i++)
+        CHECK (a_log[idx].a_idx[i] == int (idx + i * CNT_LINK));
+      }
+    Vxi11ExecutorStats stats = executor.stats ();
+    CHECK (stats.cnt_job == CNT_STEP && !stats.cnt_merge);
+
+    // Writes queued behind a job are merged into one device_write, and
+    // the query after them is not
+    int b_open = 0;
+    Vxi11JobFunc job_gate (fn_exec_gate, &b_open);
+    CHECK (!executor.submit (&a_vxi11[0], &job_gate));
+    std::vector<Vxi11JobWrite *> a_p_write;
+    for (int i=0; i < 20; i++) {
+      char s_cmd[32];
+      snprintf (s_cmd, sizeof (s_cmd), "*ESE %d", i);
+      a_p_write.push_back (new Vxi11JobWrite (s_cmd));
+      CHECK (!executor.submit (&a_vxi11[0], a_p_write.back ()));
+      }
+    Vxi11JobWrite job_alone ("*ESE 21", false);
+    CHECK (!executor.submit (&a_vxi11[0], &job_alone));
+    Vxi11JobQuery job_query ("*ESE?");
+    CHECK (!executor.submit (&a_vxi11[0], &job_query));
+    _sim.count_reset ();
+    __atomic_store_n (&b_open, 1, __ATOMIC_RELEASE);
+    CHECK (!job_query.wait ());
+    CHECK (atoi (job_query.resp ().c_str ()) == 21);
+    for (size_t i=0; i < a_p_write.size (); i++) {
+      CHECK (!a_p_write[i]->wait ());
+      delete a_p_write[i];
+      }
+    CHECK (!job_alone.wait ());
+    CHECK (_sim.count (Vxi11Sim::OP_WRITE) == 3);
+    executor.drain ();                  // Counted after the jobs finished
+    stats = executor.stats ();
+    CHECK (stats.cnt_job == CNT_STEP + 23 && stats.cnt_merge == 19);
+  }
+
+  {
+    // A link submitted by a job waits on the busy thread of that job, and
+    // is stolen by the other thread
+    Vxi11Executor executor (2);
+    ExecNested nested;
+    nested.p_executor = &executor;
+    nested.p_vxi11_other = &a_vxi11[1];
+    Vxi11JobFunc job_nested (fn_exec_nested, &nested);
+    CHECK (!executor.submit (&a_vxi11[0], &job_nested));
+    CHECK (!job_nested.wait ());
+    CHECK (!nested.job_other.wait () && nested.job_other.stb () >= 0);
+    CHECK (executor.stats ().cnt_steal >= 1);
+  }
+
+  for (int idx=0; idx < CNT_LINK; idx++)
+    a_vxi11[idx].close ();
+}
+
+// ***************************************************************************
+// Thread looking up a stale SRQ handle while entries are created and
+// deleted, which must never find an object
+// ***************************************************************************
+struct SrqReader {
+  char ac_handle[VXI11_SRQ_HANDLE_LEN]; // Handle of a deleted entry
+  bool b_stop;                          // Set to stop the thread
+  int cnt_found;                        // Lookups that found an object
+};
+
+static void *
+fn_srq_reader (void *p_arg)
+{
+  SrqReader *p_reader = (SrqReader *)p_arg;
+  while (!__atomic_load_n (&p_reader->b_stop, __ATOMIC_ACQUIRE))
+    if (vxi11_srq_handle_find (p_reader->ac_handle, VXI11_SRQ_HANDLE_LEN))
+      p_reader->cnt_found++;
+  return (0);
+}
+
+// ***************************************************************************
+// test_srq_handle - Test the SRQ handle table and the SRQs of links
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_srq_handle (void)
+{
+  // A deleted handle is not found, even when its entry is used again
+  int a_obj[2];
+  char ac_handle[VXI11_SRQ_HANDLE_LEN], ac_handle2[VXI11_SRQ_HANDLE_LEN];
+  CHECK (!vxi11_srq_handle_new (&a_obj[0], ac_handle));
+  CHECK (vxi11_srq_handle_find (ac_handle, VXI11_SRQ_HANDLE_LEN) ==
+         &a_obj[0]);
+  vxi11_srq_handle_delete (ac_handle, VXI11_SRQ_HANDLE_LEN);
+  CHECK (!vxi11_srq_handle_find (ac_handle, VXI11_SRQ_HANDLE_LEN));
+  CHECK (!vxi11_srq_handle_new (&a_obj[1], ac_handle2));
+  CHECK (!vxi11_srq_handle_find (ac_handle, VXI11_SRQ_HANDLE_LEN));
+  CHECK (vxi11_srq_handle_find (ac_handle2, VXI11_SRQ_HANDLE_LEN) ==
+         &a_obj[1]);
+  CHECK (!vxi11_srq_handle_find (ac_handle, VXI11_SRQ_HANDLE_LEN - 1));
+  vxi11_srq_handle_delete (ac_handle2, VXI11_SRQ_HANDLE_LEN);
+
+  // Lookups without lock while entries are created and deleted
+  SrqReader reader;
+  memcpy (reader.ac_handle, ac_handle, VXI11_SRQ_HANDLE_LEN);
+  reader.b_stop = false;
+  reader.cnt_found = 0;
+  pthread_t pthread;
+  pthread_create (&pthread, NULL, fn_srq_reader, &reader);
+  for (int i=0; i < 200000; i++) {
+    char ac_handle_new[VXI11_SRQ_HANDLE_LEN];
+    if (vxi11_srq_handle_new (&a_obj[i % 2], ac_handle_new))
+      break;
+    vxi11_srq_handle_delete (ac_handle_new, VXI11_SRQ_HANDLE_LEN);
+    }
+  __atomic_store_n (&reader.b_stop, true, __ATOMIC_RELEASE);
+  pthread_join (pthread, NULL);
+  CHECK (reader.cnt_found == 0);
+
+  // The handle of a link is kept after disable and enable
+  int cnt_srq = 0;
+  Vxi11 *p_vxi11 = new Vxi11 (_s_addr, "inst0");
+  CHECK (!p_vxi11->srq_handler (on_srq_count, &cnt_srq));
+  CHECK (!p_vxi11->enable_srq (true));
+  _sim.srq ("inst0");
+  CHECK (wait_count (&cnt_srq, 1, 2000));
+  CHECK (!p_vxi11->enable_srq (false));
+  CHECK (!p_vxi11->enable_srq (true));
+  _sim.srq ("inst0");
+  CHECK (wait_count (&cnt_srq, 2, 2000));
+
+  // SRQs reach the link created after it was deleted, and not the old one
+  delete p_vxi11;
+  int cnt_srq2 = 0;
+  Vxi11 vxi11 (_s_addr, "inst0");
+  CHECK (!vxi11.srq_handler (on_srq_count, &cnt_srq2));
+  CHECK (!vxi11.enable_srq (true));
+  _sim.srq ("inst0");
+  CHECK (wait_count (&cnt_srq2, 1, 2000));
+  usleep (50000);
+  CHECK (cnt_srq == 2 && cnt_srq2 == 1);
+  vxi11.close ();
+}
+
+// ***************************************************************************
+// test_wait_for_srq - Test wait_for_srq() woken up by the SRQ of a device,
+//                     and timing out
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_wait_for_srq (void)
+{
+  // A simulator completing operations after 200 ms
+  Vxi11Sim sim;
+  sim.opc_delay (200000);
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+  int cnt_srq = 0;
+  CHECK (!vxi11.srq_handler (on_srq_count, &cnt_srq));
+
+  // Woken up by the SRQ, with the status byte read only before sleeping
+  // and after the SRQ, and the handler of the link still called
+  for (int i=0; i < 3; i++) {
+    CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32;*OPC"));
+    sim.count_reset ();
+    long long t0_ns = time_ns ();
+    int stb = vxi11.wait_for_srq (0x20, 2.0);
+    double ms = ms_since (t0_ns);
+    CHECK (stb >= 0 && (stb & 0x20));
+    CHECK (ms >= 150 && ms < 1000);
+    CHECK (sim.count (Vxi11Sim::OP_READSTB) == 2);
+    CHECK (wait_count (&cnt_srq, i + 1, 2000));
+    }
+
+  // Times out without an SRQ, also when the status byte has other bits
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*SRE 32"));
+  sim.count_reset ();
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.wait_for_srq (0x20, 0.3) == -1);
+  double ms = ms_since (t0_ns);
+  CHECK (ms >= 290 && ms < 1000);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 1);
+  CHECK (!vxi11.printf ("*OPC"));
+  t0_ns = time_ns ();
+  CHECK (vxi11.wait_for_srq (0x10, 0.5) == -1);
+  ms = ms_since (t0_ns);
+  CHECK (ms >= 490 && ms < 1500);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 3);
+
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// Completion function of Vxi11Poller that takes a while, or removes its
+// link from the poller
+// ***************************************************************************
+struct PollerDone {
+  Vxi11Poller *p_poller;                // Poller calling the function
+  bool b_remove;                        // Remove the link from the function
+  int cnt_begin;                        // Calls started
+  int cnt_end;                          // Calls ended
+};
+
+static void
+on_poller_done (Vxi11 *p_vxi11, int stb, void *p_arg)
+{
+  PollerDone *p_done = (PollerDone *)p_arg;
+  __atomic_add_fetch (&p_done->cnt_begin, 1, __ATOMIC_RELEASE);
+  if (p_done->b_remove)
+    p_done->p_poller->remove (p_vxi11);
+  else
+    usleep (50000);
+  __atomic_add_fetch (&p_done->cnt_end, 1, __ATOMIC_RELEASE);
+}
+
+// ***************************************************************************
+// test_poller_remove - Test Vxi11Poller::remove() during a completion
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_poller_remove (void)
+{
+  Vxi11 vxi11 (_s_addr);
+  Vxi11Poller poller;
+  PollerDone done;
+  done.p_poller = &poller;
+  done.b_remove = false;
+  done.cnt_begin = 0;
+  done.cnt_end = 0;
+
+  // remove() returns only after the completion function in progress
+  for (int i=1; i <= 5; i++) {
+    CHECK (!vxi11.printf ("*CLS;*ESE 1;*OPC"));
+    CHECK (!poller.watch (&vxi11, 0x20, on_poller_done, &done, 2.0));
+    if (!CHECK (wait_count (&done.cnt_begin, i, 2000)))
+      break;
+    poller.remove (&vxi11);
+    CHECK (__atomic_load_n (&done.cnt_end, __ATOMIC_ACQUIRE) == i);
+    }
+
+  // remove() from the completion function does not wait for itself
+  done.b_remove = true;
+  int cnt_end = done.cnt_end;
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*OPC"));
+  CHECK (!poller.watch (&vxi11, 0x20, on_poller_done, &done, 2.0));
+  CHECK (wait_count (&done.cnt_end, cnt_end + 1, 2000));
+
+  // The link can be watched again
+  done.b_remove = false;
+  CHECK (!vxi11.printf ("*CLS;*ESE 1;*OPC"));
+  CHECK (!poller.watch (&vxi11, 0x20, on_poller_done, &done, 2.0));
+  CHECK (wait_count (&done.cnt_end, cnt_end + 2, 2000));
+  vxi11.close ();
+}
+
+// ***************************************************************************
+// Thread calling readstb() on a link shared with other threads
+// ***************************************************************************
+struct StbCaller {
+  Vxi11 *p_vxi11;                       // Link
+  int stb;                              // Status byte read
+};
+
+static void *
+fn_stb_caller (void *p_arg)
+{
+  StbCaller *p_caller = (StbCaller *)p_arg;
+  p_caller->stb = p_caller->p_vxi11->readstb ();
+  return (0);
+}
+
+// ***************************************************************************
+// test_readstb_share - Test one device_readstb shared by the threads
+//                      calling readstb(), and readstb_max_age()
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_readstb_share (void)
+{
+  // A simulator taking 200 ms to read the status byte
+  Vxi11Sim sim;
+  sim.latency (Vxi11Sim::OP_READSTB, 200000);
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+  CHECK (!vxi11.printf ("*ESE 1;*SRE 32;*OPC"));
+
+  // Threads calling while a device_readstb is in progress wait for it and
+  // return its status byte
+  const int CNT_CALLER = 6;
+  StbCaller a_caller[CNT_CALLER];
+  pthread_t a_pthread[CNT_CALLER];
+  sim.count_reset ();
+  long long t0_ns = time_ns ();
+  for (int idx=0; idx < CNT_CALLER; idx++) {
+    a_caller[idx].p_vxi11 = &vxi11;
+    a_caller[idx].stb = -1;
+    pthread_create (&a_pthread[idx], NULL, fn_stb_caller, &a_caller[idx]);
+    if (!idx)
+      usleep (50000);                   // First call in progress
+    }
+  for (int idx=0; idx < CNT_CALLER; idx++)
+    pthread_join (a_pthread[idx], NULL);
+  CHECK (ms_since (t0_ns) < 350);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 1);
+  for (int idx=0; idx < CNT_CALLER; idx++)
+    CHECK (a_caller[idx].stb == a_caller[0].stb && a_caller[0].stb >= 0);
+
+  // Calls one after the other each read the device, unless the last
+  // status byte is recent enough, as the one read just before
+  sim.latency (Vxi11Sim::OP_READSTB, 0);
+  sim.count_reset ();
+  for (int i=0; i < 3; i++)
+    CHECK (vxi11.readstb () >= 0);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 3);
+  vxi11.readstb_max_age (0.3);
+  CHECK (vxi11.readstb_max_age () == 0.3);
+  sim.count_reset ();
+  for (int i=0; i < 5; i++)
+    CHECK (vxi11.readstb () >= 0);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 0);
+  usleep (350000);
+  for (int i=0; i < 5; i++)
+    CHECK (vxi11.readstb () >= 0);
+  CHECK (sim.count (Vxi11Sim::OP_READSTB) == 1);
+  vxi11.readstb_max_age (0);
+
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// Thread cancelling a token after a delay
+// ***************************************************************************
+static void *
+fn_cancel_later (void *p_arg)
+{
+  usleep (20000);
+  ((Vxi11Cancel *)p_arg)->cancel ();
+  return (0);
+}
+
+// ***************************************************************************
+// test_cancel - Test cancellation tokens and call deadlines
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_cancel (void)
+{
+  char s_resp[256];
+  Vxi11Cancel cancel;
+  Vxi11 vxi11 (_s_addr);
+  CHECK (!vxi11.cancel_token (&cancel));
+
+  // cancel() from another thread ends a read the device takes 5 s for
+  _sim.latency (Vxi11Sim::OP_READ, 5000000);
+  unsigned long cnt_abort = _sim.count (Vxi11Sim::OP_ABORT);
+  CHECK (!vxi11.printf ("*IDN?"));
+  pthread_t pthread;
+  pthread_create (&pthread, NULL, fn_cancel_later, &cancel);
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.read (s_resp, sizeof (s_resp)));
+  CHECK (ms_since (t0_ns) < 1000);
+  pthread_join (pthread, NULL);
+  CHECK (_sim.count (Vxi11Sim::OP_ABORT) > cnt_abort);
+
+  // Calls fail without calling the device until reset()
+  t0_ns = time_ns ();
+  CHECK (vxi11.printf ("*CLS"));
+  CHECK (ms_since (t0_ns) < 100);
+  _sim.latency (Vxi11Sim::OP_READ, 0);
+  cancel.reset ();
+  CHECK (!vxi11.query ("ECHO? after cancel", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "after cancel", 12));
+
+  // A deadline of the token
+  _sim.latency (Vxi11Sim::OP_READSTB, 2000000);
+  cancel.deadline (0.05);
+  t0_ns = time_ns ();
+  CHECK (vxi11.readstb () < 0);
+  CHECK (ms_since (t0_ns) < 1000);
+  CHECK (cancel.cancelled ());
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  cancel.reset ();
+  CHECK (!vxi11.cancel_token (0));
+
+  // A deadline of each call of the link
+  CHECK (!vxi11.call_deadline (0.05));
+  _sim.latency (Vxi11Sim::OP_READ, 2000000);
+  CHECK (!vxi11.printf ("*IDN?"));
+  t0_ns = time_ns ();
+  CHECK (vxi11.read (s_resp, sizeof (s_resp)));
+  CHECK (ms_since (t0_ns) < 1000);
+  _sim.latency (Vxi11Sim::OP_READ, 0);
+  CHECK (!vxi11.query ("ECHO? after deadline", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "after deadline", 14));
+
+  // A device that does not reply to the call nor to device_abort: the
+  // call still ends soon after its deadline
+  _sim.unresponsive (true);
+  t0_ns = time_ns ();
+  CHECK (vxi11.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (ms_since (t0_ns) < 1500);
+  _sim.unresponsive (false);
+  t0_ns = time_ns ();
+  vxi11.close ();
+  CHECK (ms_since (t0_ns) < 1500);
+}
+
+// ***************************************************************************
+// timeout_is - Compare the timeouts of a Vxi11Timeout, in ms
+// ***************************************************************************
+static bool
+timeout_is (const Vxi11Timeout &timeout, int lock_ms, int io_ms, int rpc_ms)
+{
+  return (timeout.lock_ms == lock_ms && timeout.io_ms == io_ms &&
+          timeout.rpc_ms == rpc_ms);
+}
+
+// ***************************************************************************
+// test_timeout - Test the timeouts of each kind of operation in ms, and
+//                their override by Vxi11TimeoutScope
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_timeout (void)
+{
+  Vxi11Sim sim;
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+  Vxi11 vxi11_other (s_addr);
+
+  // timeout() sets every kind of operation, with the RPC timeout
+  // rpc_margin() longer
+  vxi11.timeout (2.5);
+  CHECK (vxi11.timeout () == 2.5);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 2500, 2500,
+                     12500));
+  vxi11.rpc_margin (0.25);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 2500, 2500,
+                     2750));
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 2500, 2500,
+                     2750));
+
+  // A timeout of one kind of operation leaves the others alone
+  Vxi11Timeout timeout_stb = {50, 50, 120};
+  vxi11.timeout (Vxi11::OP_READSTB, timeout_stb);
+  CHECK (timeout_is (vxi11.timeout (Vxi11::OP_READSTB), 50, 50, 120));
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 50, 50, 120));
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 2500, 2500,
+                     2750));
+  sim.latency (Vxi11Sim::OP_READSTB, 300000);
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.readstb () == -1);
+  double ms = ms_since (t0_ns);
+  CHECK (ms >= 110 && ms < 250);
+  sim.latency (Vxi11Sim::OP_READSTB, 0);
+  std::string s_resp;
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+
+  // A scope overrides the timeouts of the calls of this thread on every
+  // link, the innermost scope first, until it ends
+  {
+    Vxi11Timeout timeout_scope = {20, 20, 70};
+    Vxi11TimeoutScope timeoutScope (timeout_scope);
+    CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 20, 20, 70));
+    CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 20, 20,
+                       70));
+    CHECK (timeout_is (vxi11_other.timeout_call (Vxi11::OP_WRITE), 20, 20,
+                       70));
+    {
+      Vxi11TimeoutScope timeoutScope_inner (30);
+      CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 30, 30,
+                         280));
+    }
+    CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 20, 20, 70));
+
+    CHECK (!vxi11.printf ("*ESE?"));
+    sim.latency (Vxi11Sim::OP_READ, 300000);
+    char s_buf[64];
+    t0_ns = time_ns ();
+    CHECK (vxi11.read (s_buf, sizeof (s_buf)));
+    ms = ms_since (t0_ns);
+    CHECK (ms >= 60 && ms < 200);
+    sim.latency (Vxi11Sim::OP_READ, 0);
+  }
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READ), 2500, 2500,
+                     2750));
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 50, 50, 120));
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+
+  vxi11_other.close ();
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// test_rtt_timeout - Test the timeouts derived from the latency of the
+//                    calls, within the floor and ceiling of rtt_timeout()
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_rtt_timeout (void)
+{
+  Vxi11Sim sim;
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+
+  // A fast device gets the floor, and the RPC timeout twice the I/O
+  // timeout, or at most rpc_margin() longer
+  CHECK (!vxi11.rtt_timeout ());
+  vxi11.rtt_timeout (true, 0.1, 1.0);
+  CHECK (vxi11.rtt_timeout ());
+  for (int i=0; i < 10; i++)
+    CHECK (vxi11.readstb () >= 0);
+  Vxi11Rtt rtt = vxi11.rtt (Vxi11::OP_READSTB);
+  CHECK (rtt.cnt_sample == 10 && !rtt.backoff);
+  CHECK (rtt.rto_ms < 100);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 10000, 100,
+                     200));
+  vxi11.rpc_margin (0.01);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 10000, 100,
+                     110));
+  vxi11.rpc_margin (10);
+
+  // A kind of operation not measured yet keeps timeout()
+  CHECK (!vxi11.rtt (Vxi11::OP_TRIGGER).cnt_sample);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_TRIGGER), 10000, 10000,
+                     20000));
+
+  // A slow device gets the ceiling, also when the calls stop replying and
+  // the estimate backs off
+  sim.latency (Vxi11Sim::OP_READSTB, 60000);
+  for (int i=0; i < 10; i++)
+    CHECK (vxi11.readstb () >= 0);
+  rtt = vxi11.rtt (Vxi11::OP_READSTB);
+  CHECK (rtt.d_srtt > 0.03 && rtt.rto_ms > 40);
+  vxi11.rtt_timeout (true, 0.01, 0.04);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 10000, 40,
+                     80));
+  sim.latency (Vxi11Sim::OP_READSTB, 200000);
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.readstb () == -1);
+  CHECK (ms_since (t0_ns) < 150);
+  rtt = vxi11.rtt (Vxi11::OP_READSTB);
+  CHECK (rtt.backoff == 1);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 10000, 40,
+                     80));
+
+  // A reply in time ends the backoff, and disabling restores timeout()
+  sim.latency (Vxi11Sim::OP_READSTB, 0);
+  usleep (300000);                      // Late reply of the call above
+  CHECK (vxi11.readstb () >= 0);
+  CHECK (!vxi11.rtt (Vxi11::OP_READSTB).backoff);
+  vxi11.rtt_timeout (false);
+  CHECK (timeout_is (vxi11.timeout_call (Vxi11::OP_READSTB), 10000, 10000,
+                     20000));
+
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// wait_closed - Wait until the breaker of a link closes
+//
+// Parameters:
+// 1. p_vxi11    - Link
+// 2. timeout_ms - Time to wait
+//
+// Returns: true if the breaker closed
+// ***************************************************************************
+static bool
+wait_closed (Vxi11 *p_vxi11, int timeout_ms)
+{
+  long long t0_ns = time_ns ();
+  while (p_vxi11->breaker ()->tripped ()) {
+    if (ms_since (t0_ns) > timeout_ms)
+      return (false);
+    usleep (10000);
+    }
+  return (true);
+}
+
+// ***************************************************************************
+// test_breaker - Test the circuit breaker of a link
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_breaker (void)
+{
+  // Opens after 2 readstb() without reply, then fails calls at once
+  Vxi11 vxi11 (_s_addr);
+  Vxi11Timeout timeout = {50, 50, 100};
+  vxi11.timeout (Vxi11::OP_READSTB, timeout);
+  CHECK (!vxi11.breaker (2, 0.2, 0.05));
+  _sim.latency (Vxi11Sim::OP_READSTB, 300000);
+  CHECK (vxi11.readstb () < 0);
+  CHECK (!vxi11.breaker ()->tripped ());
+  CHECK (vxi11.readstb () < 0);
+  CHECK (vxi11.breaker ()->tripped ());
+  unsigned long cnt_write = _sim.count (Vxi11Sim::OP_WRITE);
+  long long t0_ns = time_ns ();
+  CHECK (vxi11.printf ("*CLS"));
+  CHECK (ms_since (t0_ns) < 20);
+  CHECK (_sim.count (Vxi11Sim::OP_WRITE) == cnt_write);
+
+  // Closes when a probe gets a reply
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  CHECK (wait_closed (&vxi11, 5000));
+  CHECK (vxi11.readstb () >= 0);
+  Vxi11BreakerStats stats = vxi11.breaker ()->stats ();
+  CHECK (stats.cnt_open == 1 && stats.cnt_reject >= 1 && stats.cnt_probe >= 1);
+  vxi11.close ();
+
+  // Re-creates the link when the device restarts on the same port
+  Vxi11Sim sim;
+  if (!CHECK (!sim.start ()))
+    return;
+  int port = sim.port ();
+  char s_addr[64], s_resp[256];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", port);
+  Vxi11 vxi11_restart (s_addr);
+  vxi11_restart.timeout (0.2);
+  CHECK (!vxi11_restart.breaker (2, 0.1, 0.1));
+  CHECK (!vxi11_restart.query ("*IDN?", s_resp, sizeof (s_resp)));
+  sim.stop ();
+  CHECK (vxi11_restart.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (vxi11_restart.query ("*IDN?", s_resp, sizeof (s_resp)));
+  CHECK (vxi11_restart.breaker ()->tripped ());
+  usleep (200000);
+  if (!CHECK (!sim.start (port)))
+    return;
+  CHECK (wait_closed (&vxi11_restart, 5000));
+  CHECK (!vxi11_restart.query ("ECHO? restarted", s_resp, sizeof (s_resp)));
+  CHECK (!strncmp (s_resp, "restarted", 9));
+  CHECK (!vxi11_restart.close ());
+  sim.stop ();
+
+  // A device that does not reply to its probe does not delay the probes
+  // of the other links
+  Vxi11Sim sim_dead;
+  if (!CHECK (!sim_dead.start ()))
+    return;
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim_dead.port ());
+  Vxi11 vxi11_dead (s_addr);
+  vxi11_dead.timeout (Vxi11::OP_READSTB, timeout);
+  CHECK (!vxi11_dead.breaker (1, 0.01, 0.5));
+  sim_dead.unresponsive (true);
+  CHECK (vxi11_dead.readstb () < 0);
+  CHECK (vxi11_dead.breaker ()->tripped ());
+  usleep (50000);                       // Its probe is in progress
+  Vxi11 vxi11_alive (_s_addr);
+  vxi11_alive.timeout (Vxi11::OP_READSTB, timeout);
+  CHECK (!vxi11_alive.breaker (1, 0.05, 0.05));
+  _sim.latency (Vxi11Sim::OP_READSTB, 300000);
+  CHECK (vxi11_alive.readstb () < 0);
+  CHECK (vxi11_alive.breaker ()->tripped ());
+  _sim.latency (Vxi11Sim::OP_READSTB, 0);
+  t0_ns = time_ns ();
+  CHECK (wait_closed (&vxi11_alive, 5000));
+  CHECK (ms_since (t0_ns) < 300);
+  CHECK (vxi11_dead.breaker ()->tripped ());
+  vxi11_alive.close ();
+  vxi11_dead.close ();
+  sim_dead.stop ();
+}
+
+// ***************************************************************************
+// test_read_grow - Test read() and query() to a buffer that grows, and the
+//                  size reserved from the longest response read before
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_read_grow (void)
+{
+  Vxi11Sim sim;
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+  const size_t LEN_BLOCK = 300009;      // "#6300000" + data + "\n"
+
+  // The first response to a query grows the string in two chunks; later
+  // ones reserve its size up front and are read in one chunk
+  for (int i=0; i < 3; i++) {
+    std::string s_resp;
+    vxi11.read_stats_reset ();
+    CHECK (!vxi11.query ("DATA? 300000", s_resp));
+    CHECK (s_resp.size () == LEN_BLOCK &&
+           !s_resp.compare (0, 10, "#6300000AB"));
+    CHECK (s_resp.capacity () >= LEN_BLOCK);
+    Vxi11ReadStats stats = vxi11.read_stats ();
+    CHECK (stats.cnt_read == 1);
+    CHECK (stats.cnt_chunk == ((i) ? 1UL : 2UL));
+    }
+
+  // Another query does not reserve the size of the first
+  std::string s_resp;
+  CHECK (!vxi11.query ("DATA? 100", s_resp));
+  CHECK (s_resp.size () == 106 && s_resp.capacity () < 4096);
+
+  // read() keeps its own size, for a vector too
+  for (int i=0; i < 3; i++) {
+    std::vector<char> a_resp;
+    CHECK (!vxi11.printf ("DATA? 300000"));
+    vxi11.read_stats_reset ();
+    CHECK (!vxi11.read (a_resp));
+    CHECK (a_resp.size () == LEN_BLOCK &&
+           !memcmp (&a_resp[0], "#6300000AB", 10));
+    CHECK (vxi11.read_stats ().cnt_chunk == ((i) ? 1UL : 2UL));
+    }
+
+  // A string used again keeps its buffer, also for a shorter response
+  CHECK (!vxi11.query ("DATA? 300000", s_resp));
+  CHECK (!vxi11.query ("DATA? 300000", s_resp));
+  const char *p_data = s_resp.data ();
+  size_t cnt_capacity = s_resp.capacity ();
+  CHECK (!vxi11.query ("DATA? 300000", s_resp));
+  CHECK (s_resp.size () == LEN_BLOCK);
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+  CHECK (s_resp.size () < 8 && atoi (s_resp.c_str ()) >= 0);
+  CHECK (s_resp.data () == p_data && s_resp.capacity () == cnt_capacity);
+
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// Vxi11Tracer keeping the names of the RPCs made
+// ***************************************************************************
+class TraceProcs : public Vxi11Tracer {
+ public:
+  std::string s_procs;                  // Names of the RPCs, ' ' after each
+
+  virtual void rpc_begin (const Vxi11TraceEvent &event) {}
+  virtual void rpc_end (const Vxi11TraceEvent &event) {
+    s_procs += event.s_proc;
+    s_procs += ' ';
+    }
+};
+
+// ***************************************************************************
+// block_response - Response generator of the simulator for "BLK? size cnt",
+//                  a definite length block header of any size, followed by
+//                  cnt bytes only
+// ***************************************************************************
+static bool
+block_response (void *p_arg, const std::string &s_cmd, std::string &s_resp)
+{
+  char s_size[16];
+  int cnt = 0;
+  if (sscanf (s_cmd.c_str (), "BLK? %15s %d", s_size, &cnt) != 2)
+    return (false);
+  s_resp = "#";
+  s_resp += char ('0' + strlen (s_size));
+  s_resp += s_size;
+  s_resp.append (cnt, 'x');
+  return (true);
+}
+
+// ***************************************************************************
+// test_read_stats - Test the chunk counters of read() with a device that
+//                   fragments its responses, and the buffer grown for the
+//                   header of a definite length block
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_read_stats (void)
+{
+  Vxi11Sim sim;
+  sim.max_recv_size (1024);
+  sim.read_fragment (1000);
+  sim.response (&block_response, 0);
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+
+  // 100009 bytes in chunks of 1000 ended by the device, the last by END
+  std::string s_resp;
+  CHECK (!vxi11.query ("DATA? 100000", s_resp));
+  Vxi11ReadStats stats = vxi11.read_stats ();
+  CHECK (stats.cnt_read == 1 && stats.cnt_end == 1);
+  CHECK (stats.cnt_byte == s_resp.size () && s_resp.size () == 100009);
+  CHECK (stats.cnt_chunk == 101);
+  CHECK (stats.cnt_frag + stats.cnt_reqcnt == 100);
+  CHECK (stats.chunk_device == 1000);
+
+  // The chunk size learned is kept by read_stats_reset(), so the buffer
+  // is grown for a full chunk and no chunk is cut short by requestSize
+  vxi11.read_stats_reset ();
+  stats = vxi11.read_stats ();
+  CHECK (!stats.cnt_chunk && (stats.chunk_device == 1000));
+  CHECK (!vxi11.query ("DATA? 50000", s_resp));
+  stats = vxi11.read_stats ();
+  CHECK (stats.cnt_chunk == 51 && stats.cnt_frag == 50);
+  CHECK (!stats.cnt_reqcnt);
+
+  // A header larger than the data sent, up to almost 1 GB, grows the
+  // buffer only with the data
+  sim.read_fragment (0);
+  CHECK (!vxi11.query ("BLK? 100000000 100000", s_resp));
+  CHECK (s_resp.size () == 100012 && !s_resp.compare (0, 11, "#9100000000"));
+  CHECK (s_resp.capacity () < 1000000);
+  std::string s_huge;
+  CHECK (!vxi11.query ("BLK? 999999999 100000", s_huge));
+  CHECK (s_huge.size () == 100012 && s_huge.capacity () < 1000000);
+
+  vxi11.close ();
+  sim.stop ();
+}
+
+// ***************************************************************************
+// test_write_buffer - Test buffered writes and flush ordering
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+static void
+test_write_buffer (void)
+{
+  // A simulator with a small maxRecvSize, to fill the buffer
+  Vxi11Sim sim;
+  sim.max_recv_size (200);
+  if (!CHECK (!sim.start ()))
+    return;
+  char s_addr[64];
+  snprintf (s_addr, sizeof (s_addr), "127.0.0.1:%d", sim.port ());
+  Vxi11 vxi11 (s_addr);
+  std::string s_resp;
+
+  // 50 commands are sent in two device_write: one when the buffer reached
+  // maxRecvSize, and one before the query
+  CHECK (!vxi11.write_buffer (true));
+  CHECK (vxi11.write_buffer ());
+  sim.count_reset ();
+  for (int i=0; i < 50; i++)
+    CHECK (!vxi11.printf ("*ESE %d", i));
+  CHECK (sim.count (Vxi11Sim::OP_WRITE) == 1);
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 49);
+  CHECK (sim.count (Vxi11Sim::OP_WRITE) == 2);
+
+  // Commands are sent before readstb() and trigger()
+  TraceProcs trace;
+  Vxi11::tracer (&trace);
+  CHECK (!vxi11.printf ("*SRE 16"));
+  CHECK (vxi11.readstb () >= 0);
+  CHECK (!vxi11.printf ("*ESE 3"));
+  CHECK (!vxi11.trigger ());
+  CHECK (!vxi11.printf ("*ESE 4"));
+  CHECK (!vxi11.lock ());
+  CHECK (!vxi11.printf ("*ESE 5"));
+  CHECK (!vxi11.unlock ());
+  CHECK (!vxi11.printf ("*ESE 6"));
+  vxi11.local ();
+  CHECK (!vxi11.printf ("*ESE 7"));
+  vxi11.remote ();
+  CHECK (!vxi11.printf ("*ESE 8"));
+  vxi11.docmd_ren_control (true);
+  Vxi11::tracer (0);
+  CHECK (trace.s_procs == "device_write device_readstb device_write "
+                          "device_trigger device_write device_lock "
+                          "device_write device_unlock device_write "
+                          "device_local device_write device_remote "
+                          "device_write device_docmd ");
+
+  // Joined with newlines, and a command longer than maxRecvSize is sent
+  // after the buffer
+  CHECK (!vxi11.write_buffer (true, '\n'));
+  CHECK (!vxi11.printf ("*ESE 7"));
+  CHECK (!vxi11.printf ("*ESE 9"));
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 9);
+  char s_long[300];
+  memset (s_long, ' ', sizeof (s_long) - 1);
+  s_long[sizeof (s_long) - 1] = '\0';
+  CHECK (!vxi11.printf ("*ESE 5"));
+  sim.count_reset ();
+  CHECK (!vxi11.write (s_long, strlen (s_long)));
+  CHECK (sim.count (Vxi11Sim::OP_WRITE) == 3);
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 5);
+
+  // Disabling and closing flush the buffer
+  CHECK (!vxi11.printf ("*ESE 11"));
+  CHECK (!vxi11.write_buffer (false));
+  CHECK (!vxi11.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 11);
+  CHECK (!vxi11.write_buffer (true));
+  CHECK (!vxi11.printf ("*ESE 13"));
+  CHECK (!vxi11.close ());
+  Vxi11 vxi11_after (s_addr);
+  CHECK (!vxi11_after.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 13);
+  vxi11_after.close ();
+
+  // Vxi11Bare buffers its commands too, without the mutex of the buffer
+  Vxi11Bare vxi11_bare (s_addr);
+  CHECK (!vxi11_bare.write_buffer (true));
+  sim.count_reset ();
+  for (int i=0; i < 10; i++)
+    CHECK (!vxi11_bare.printf ("*ESE %d", i + 20));
+  CHECK (sim.count (Vxi11Sim::OP_WRITE) == 0);
+  CHECK (vxi11_bare.readstb () >= 0);
+  CHECK (sim.count (Vxi11Sim::OP_WRITE) == 1);
+  CHECK (!vxi11_bare.query ("*ESE?", s_resp));
+  CHECK (atoi (s_resp.c_str ()) == 29);
+  vxi11_bare.close ();
+
+#ifdef __linux__
+  // trigger_all() flushes each link first, and skips a cancelled link
+  for (int b_uring=1; b_uring >= 0; b_uring--) {
+    InstrumentGroup group (8, b_uring);
+    for (int i=0; i < 3; i++)
+      CHECK (!group.add (s_addr));
+    CHECK (!group.link (0)->write_buffer (true));
+    CHECK (!group.link (0)->printf ("*ESE 9"));
+    Vxi11Cancel cancel;
+    CHECK (!group.link (2)->cancel_token (&cancel));
+    cancel.cancel ();
+    sim.count_reset ();
+    std::vector<InstrumentGroupTrigger> a_trigger;
+    CHECK (group.trigger_all (&a_trigger) == 1);
+    CHECK (sim.count (Vxi11Sim::OP_WRITE) == 1);
+    CHECK (sim.count (Vxi11Sim::OP_TRIGGER) == 2);
+    CHECK (a_trigger.size () == 3 && !a_trigger[0].err &&
+           !a_trigger[1].err && a_trigger[2].err == -3);
+    std::vector<InstrumentGroupValue<int> > a_val;
+    group.query_all ("*ESE?", a_val);
+    CHECK (a_val.size () == 3 && !a_val[0].err && a_val[0].val == 9);
+    CHECK (!group.link (2)->cancel_token (0));
+    }
+#endif
+
+  sim.stop ();
+}
+
+// ***************************************************************************
+// Tests
+// ***************************************************************************
+struct Test {
+  const char *s_name;
+  void (*pfn_test) (void);
+};
+
+static const Test _a_test[] = {
+  {"sim", test_sim},
+  {"tracer", test_tracer},
+  {"record", test_record},
+  {"hislip", test_hislip},
+  {"socket", test_socket},
+  {"transport", test_transport},
+  {"bare", test_bare},
+#ifdef __linux__
+  {"fragments", test_fragments},
+  {"trigger_skew", test_trigger_skew},
+  {"query_all", test_query_all},
+#endif
+  {"executor", test_executor},
+  {"srq_handle", test_srq_handle},
+  {"wait_for_srq", test_wait_for_srq},
+  {"poller_remove", test_poller_remove},
+  {"readstb_share", test_readstb_share},
+  {"cancel", test_cancel},
+  {"timeout", test_timeout},
+  {"rtt_timeout", test_rtt_timeout},
+  {"breaker", test_breaker},
+  {"read_grow", test_read_grow},
+  {"read_stats", test_read_stats},
+  {"write_buffer", test_write_buffer},
+};
+static const int CNT_TEST = sizeof (_a_test) / sizeof (_a_test[0]);
+
+// ***************************************************************************
+// usage - Print the command line options
+// ***************************************************************************
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: test_sim_vxi11 [test]...\nTests:");
+  for (int idx=0; idx < CNT_TEST; idx++)
+    fprintf (stderr, " %s", _a_test[idx].s_name);
+  fprintf (stderr, "\n");
+}
+
+// ***************************************************************************
+// main
+// ***************************************************************************
+int main (int argc, char *argv[])
+{
+  // Check the test names before starting
+  for (int idx_arg=1; idx_arg < argc; idx_arg++) {
+    int idx=0;
+    while (idx < CNT_TEST && strcmp (argv[idx_arg], _a_test[idx].s_name))
+      idx++;
+    if (idx == CNT_TEST) {
+      usage ();
+      return (1);
+      }
+    }
+
+  // Links to a simulator that was stopped get EPIPE, not SIGPIPE
+  signal (SIGPIPE, SIG_IGN);
+
+  if (_sim.start ())
+    return (1);
+  snprintf (_s_addr, sizeof (_s_addr), "127.0.0.1:%d", _sim.port ());
+
+  for (int idx=0; idx < CNT_TEST; idx++) {
+    bool b_run = (argc == 1);           // Run all tests if none given
+    for (int idx_arg=1; idx_arg < argc; idx_arg++)
+      b_run |= !strcmp (argv[idx_arg], _a_test[idx].s_name);
+    if (!b_run)
+      continue;
+    int cnt_fail = _cnt_fail;
+    long long t0_ns = time_ns ();
+    _a_test[idx].pfn_test ();
+    fprintf (stderr, "test_sim_vxi11: %-14s %s (%.0f ms)\n",
+             _a_test[idx].s_name, (_cnt_fail == cnt_fail) ? "ok" : "FAILED",
+             ms_since (t0_ns));
+    }
+
+  _sim.stop ();
+  fprintf (stderr, "test_sim_vxi11: %d checks, %d failed\n", _cnt_check,
+           _cnt_fail);
+  return (_cnt_fail != 0);
+}
@@ -7,6 +7,108 @@
 //
 // Edit history:
 //
+// 10-17-26 - The calls read the link ID, and write() maxRecvSize, after
+//              taking the lock, so a call waiting for it while _relink()
+//              replaces the link uses the new one.
+//            read() to a std::string or std::vector<char> grows its
+//              buffer for a definite length block at most 16 maxRecvSize
+//              ahead of the data read, or twice it, whatever the header.
+//            write_buffer() works with every lock policy, so Vxi11Bare
+//              buffers its commands too; only the mutex of the buffer is
+//              left out of Vxi11LockNone.
+//            remote(), local(), lock(), enable_srq() and the docmd_*()
+//              functions send the write buffer first, like the other calls.
+//            Traced RPCs report the transaction ID the RPC client chose,
+//              read back at the end of the call instead of set before it.
+//            The breaker probes on the abort channel, without the RPC
+//              mutex, and re-creates the transport and link when the
+//              device does not reply or the core channel is broken.
+//            Operations check the breaker before the RPC mutex.
+//            open() always creates the abort channel, and abort() and
+//              close() serialize on _mutex_abort, so the client is not
+//              destroyed during an abort from another thread.
+//            Calls cancelled or past their deadline are aborted with a
+//              200 ms RPC timeout, and the core channel is shut down if
+//              device_abort gets no reply.
+//            Added write_buffer() and flush(): write() appends each command
+//              to a buffer of the link, sent as one device_write before
+//              the calls that depend on it.
+//            read(): Each chunk is counted in read_stats() by what ended
+//              it, and a growing buffer is grown before the next
+//              device_read to the rest of a definite length block, or to
+//              the largest chunk the device returned by itself.
+//            Added read() to a std::string or std::vector<char>, and
+//              query() to a std::string, growing the buffer between
+//              device_read calls, and reserving the longest size read so
+//              far for the link or the query.  read() to a char buffer
+//              calls _read(), which does the reading for both.
+//            Added breaker(): the calls of a link fail right away after
+//              calls in a row without reply, until a probe thread gets a
+//              reply to the null procedure.  close() skips destroy_link
+//              while the breaker is open.
+//            Added rtt_timeout(): the latency of each reply updates the
+//              estimate of its kind of operation, and the I/O and RPC
+//              timeouts of the next calls are derived from it.
+//            Added timeouts for each kind of operation with timeout(op),
+//              overridden for the calls of a thread by Vxi11TimeoutScope.
+//              The RPC timeout is set before each call from the lock and
+//              I/O timeouts plus rpc_margin(), in ms, instead of the whole
+//              seconds of timeout() plus 10 s.
+//            Added cancel_token() and call_deadline(): the calls of the
+//              link are aborted with device_abort by Vxi11Cancel::cancel()
+//              or when they run too long, and fail while the token is
+//              cancelled.
+//            abort(): Moved the creation of the abort channel to
+//              _open_abort(), and keep the results on the stack instead of
+//              the static results of the rpcgen stub, so several threads
+//              can abort at the same time.
+//            readstb(): Threads calling at the same time on one link share
+//              one device_readstb and its result, and the result may be
+//              returned again for readstb_max_age() seconds.
+//            Added wait_for_srq() to sleep until the device requests
+//              service, woken up by the SRQ service instead of polling
+//              readstb().
+//            enable_srq(): The SRQ handle is an entry of the handle table
+//              of vxi11_srq.cpp instead of the object pointer, and is
+//              deleted by close(), so a late SRQ for an object that was
+//              closed or destroyed is ignored instead of using the pointer.
+//            Replaced the svc_run() thread of the SRQ service with the
+//              DEVICE_INTR server of vxi11_srq.cpp, which calls the SRQ
+//              callbacks on a pool of worker threads set by srq_workers().
+//              A slow callback only delays the SRQs of its own object.
+//            Added srq_handler() for an SRQ handler per object.
+//            close(): Wait for the SRQ handler running for the object.
+//            Added lid() to get the link ID, for calls made outside the
+//              Vxi11 class such as by InstrumentGroup.
+//            Made the Vxi11 class the default of the BasicVxi11 template,
+//              with the lock, error reporting, tracing and transport chosen
+//              by policies at compile time.  The state and the SRQ service
+//              shared by all types are in Vxi11Common.
+//            srq_callback(): One callback for each BasicVxi11 type, with the
+//              RPC service started and stopped by _srq_service().
+//            Made all calls of the core channel through a Vxi11Transport,
+//              with result storage per call instead of the static results of
+//              the rpcgen stubs.
+//            open(): Added p_transport to use a transport other than the
+//              ones built in.
+//            open(): Added the raw SCPI socket for device name "socket" and
+//              VISA SOCKET resource strings.
+//            open(): Added HiSLIP for device names "hislipN", and VISA
+//              resource strings for the address.
+//            abort(): Return an error for HiSLIP links, which have no abort
+//              channel.
+//            Moved the SRQ handle check of _fn_srq_callback() to
+//              _srq_handle(), which is also used by HiSLIP.
+//            open(): Address may be "host:port" to connect to the core
+//              channel on a TCP port without the portmapper.
+//            srq_callback(): Register the SRQ service without the
+//              portmapper if the portmapper is not running.
+//            printf(), log_err(): Do not use a static buffer, which was
+//              overwritten when called from several threads.
+//            Report the start and end of every RPC, and the wait for the RPC
+//              mutex, to the tracer set by tracer().
+//            Added record() and replay() for session trace files.
+//            open(): Moved link creation to _open_link().
 // 01-21-24 - Added support for Linux in addition to MacOS.
 //            read(): Added more information in error messages.
 // 12-19-23 - timeout(): Prevent crash if called before open() or after close()
@@ -39,31 +141,56 @@
 
 #include "libvxi11.h"
 #include "vxi11_rpc.h"
+#include "vxi11_record.h"
+#include "vxi11_hislip.h"
+#include "vxi11_socket.h"
+#include "vxi11_transport.h"
+#include "vxi11_srq.h"
+#include "vxi11_cancel.h"
+#include "vxi11_breaker.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <rpc/pmap_clnt.h>
 #include <netdb.h>
-
-// Macro to conveniently access __p_client and __p_link members of the class.
-// They are defined as void * in the class so that the .h file does not need
-// to include the RPC interface.
-#define _p_client       ((CLIENT *)__p_client)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Macro to conveniently access __p_transport and __p_link members of the
+// class.  They are defined as void * in the class so that the .h file does
+// not need to include the RPC interface.
+#define _p_transport    ((X *)__p_transport)
 #define _p_client_abort ((CLIENT *)__p_client_abort)
 #define _p_link         ((Create_LinkResp *)__p_link)
+#define _p_srq_waiter   ((Vxi11SrqWaiter *)__p_srq_waiter)
+#define _p_stb          ((Vxi11StbShare *)__p_stb)
+#define _p_read_hint    ((Vxi11ReadHint *)__p_read_hint)
+#define _p_write_buf    ((Vxi11WriteBuf *)__p_write_buf)
+
+// Macros for the definitions of the BasicVxi11 member functions
+// The policies are L = LockPolicy, E = ErrorPolicy, S = StatsPolicy, and
+// X = Transport; _p_transport has type X*.
+#define VXI11_TEMPLATE  template <class L, class E, class S, class X>
+#define BASIC_VXI11     BasicVxi11<L, E, S, X>
 
 // Static members to support SRQ callback function
-void *Vxi11::_p_pthread_svc_run = 0;    // Thread pointer for _fn_svc_run()
-void *Vxi11::_p_svcXprt_srq_tcp = 0;    // TCP RPC service transport for SRQ
-void *Vxi11::_p_svcXprt_srq_udp = 0;    // UDP RPC service transport for SRQ
-void (*Vxi11::_pfn_srq_callback)(Vxi11 *) = 0; // User callback for SRQ intr
+int Vxi11Common::_cnt_srq_worker = 4;   // Threads calling the SRQ callbacks
+VXI11_TEMPLATE void (*BASIC_VXI11::_pfn_srq_callback)(BASIC_VXI11 *) = 0;
+                                        // User callback for SRQ intr
+
+Vxi11Tracer *Vxi11Common::_p_tracer = 0; // No RPC tracer
 
 // Error description for each error code from the VXI-11 RPC calls
-const char *Vxi11::_as_err_desc[Vxi11::CNT_ERR_DESC_MAX] =
+const char *Vxi11Common::_as_err_desc[Vxi11Common::CNT_ERR_DESC_MAX] =
   {"",                                  // 0 (no error)
    "syntax error",                      // 1
    "",                                  // 2
@@ -98,339 +225,1314 @@ const char *Vxi11::_as_err_desc[Vxi11::CNT_ERR_DESC_MAX] =
    "",                                  // 31
   };
 
-bool Vxi11::_b_log_err = true;          // Enable error logging to stderr
+bool Vxi11Common::_b_log_err = true;    // Enable error logging to stderr
 
 // ***************************************************************************
-// Vxi11Mutex - Class to serialize access VXI-11 RPCs via pthread mutexes
+// Vxi11Mutex - Class to serialize access VXI-11 RPCs with a lock policy
 //
 // This is needed to properly handle SRQ interrupts and Vxi11 objects
 // used in multiple threads.
 //
 // Create a local instance of this class in each function where a lock on the
 // mutex is required.  The mutex will be unlocked when that instance goes out
-// of scope, such as when the function returns.
+// of scope, such as when the function returns.  Nothing is done with
+// Vxi11LockNone.
 // ***************************************************************************
-class Vxi11Mutex
+template <class L> class Vxi11Mutex
 {
-  private:
-    static pthread_mutex_t mutex;       // Mutex to lock & unlock
-  
   public:
   // Constructor to lock mutex
-  Vxi11Mutex () {
-    int err = pthread_mutex_lock (&mutex);
-    if (err)
-      Vxi11::log_err ("Vxi11 error: could not lock mutex, error %d", err);
-    }
+  Vxi11Mutex () { L::lock (); }
 
   // Destructor to unlock mutex
-  ~Vxi11Mutex () {
-    int err = pthread_mutex_unlock (&mutex);
-    if (err)
-      Vxi11::log_err ("Vxi11 error: could not unlock mutex, error %d", err);
+  ~Vxi11Mutex () { L::unlock (); }
+};
+
+// ***************************************************************************
+// Vxi11StbShare - Status byte of one link shared by the callers of readstb()
+//
+// The first caller makes the device_readstb call; the others wait on cond
+// for it to finish and return the same result, instead of each making its
+// own call.  The result is kept with its time for readstb_max_age().
+// ***************************************************************************
+struct Vxi11StbShare {
+  pthread_mutex_t mutex;                // For the members below
+  pthread_cond_t cond;                  // Call finished
+  bool b_call;                          // device_readstb in progress
+  unsigned long cnt_call;               // Calls finished so far
+  int stb;                              // Result of the last call
+  long long t_ns;                       // Time the last call started, 0 if
+                                        // none or it failed
+
+  Vxi11StbShare () {
+    pthread_mutex_init (&mutex, NULL);
+    pthread_cond_init (&cond, NULL);
+    b_call = false;
+    cnt_call = 0;
+    stb = -1;
+    t_ns = 0;
+    }
+  ~Vxi11StbShare () {
+    pthread_cond_destroy (&cond);
+    pthread_mutex_destroy (&mutex);
+    }
+};
+
+// ***************************************************************************
+// Vxi11ReadHint - Longest responses read from one link to a growing buffer
+//
+// read() and query() to a std::string or std::vector<char> reserve that
+// size before reading, so a buffer used again for the same query is never
+// reallocated.  Only the first queries of a link are remembered, so queries
+// built with changing values do not grow the table without limit.
+// ***************************************************************************
+struct Vxi11ReadHint {
+  pthread_mutex_t mutex;                // For the members below
+  int cnt_read;                         // Longest response of read()
+  std::map<std::string, int> map_query; // Longest response of each query
+
+  Vxi11ReadHint () {
+    pthread_mutex_init (&mutex, NULL);
+    cnt_read = 0;
+    }
+  ~Vxi11ReadHint () {
+    pthread_mutex_destroy (&mutex);
+    }
+};
+
+// ***************************************************************************
+// Vxi11WriteBuf - Commands of one link not sent yet, see write_buffer()
+//
+// The commands are joined by c_sep in s_buf and sent as one device_write.
+// The mutex keeps them in order while one is sent; it is locked before the
+// RPC mutex, never after.
+// ***************************************************************************
+struct Vxi11WriteBuf {
+  pthread_mutex_t mutex;                // For the members below
+  bool b_ena;                           // Commands are buffered
+  char c_sep;                           // Joins the commands, ';' or '\n'
+  std::string s_buf;                    // Commands not sent yet
+  int cnt_cmd;                          // Commands in s_buf
+
+  Vxi11WriteBuf () {
+    pthread_mutex_init (&mutex, NULL);
+    b_ena = false;
+    c_sep = ';';
+    cnt_cmd = 0;
+    }
+  ~Vxi11WriteBuf () {
+    pthread_mutex_destroy (&mutex);
     }
 };
 
-pthread_mutex_t Vxi11Mutex::mutex = PTHREAD_MUTEX_INITIALIZER;
+// Most queries remembered per link by Vxi11ReadHint
+static const size_t CNT_READ_HINT_MAX = 256;
+
+// RPC timeout of the device_abort sent to end a cancelled call, in ms
+static const int ABORT_CALL_MS = 200;
+
+// Smallest buffer of read() to a std::string or std::vector<char>
+static const int CNT_READ_BUF_MIN = 256;
+
+// Most bytes read() grows its buffer by for the header of a definite length
+// block, in maxRecvSize; beyond that it grows with the data received, so a
+// header such as "#9999999999" does not allocate what was never sent
+static const int BLOCK_AHEAD_RECV = 16;
+static const long long CNT_BLOCK_AHEAD_MAX = 16 << 20;
 
 // ***************************************************************************
-// Vxi11::log_err - Log errors to stderr if enabled 
+// block_size - Get the size of the IEEE 488.2 definite length block at the
+//              start of the data read, such as "#41000" and 1000 bytes
 //
 // Parameters:
-// 1. s_format - printf style format string to log
-// 2. ...      - Variable number of parameters, depending on s_format
+// 1. ac_data  - Data read so far
+// 2. cnt_data - Bytes in ac_data
 //
-// Returns: None
+// Returns: Bytes of the header and the block, plus one for a terminator,
+//          0 if not a definite length block or the header is not complete
 // ***************************************************************************
-  void Vxi11::
-log_err (const char *s_format, ...)
+static long long
+block_size (const char *ac_data, int cnt_data)
 {
-  if (!_b_log_err)                      // Do nothing if logging is disabled
-    return;
-  
-  if (!s_format)                        // Do nothing if null pointer
-    return;
+  if ((cnt_data < 2) || (ac_data[0] != '#') || (ac_data[1] < '1') ||
+      (ac_data[1] > '9'))
+    return (0);
 
-  const int LEN_MSG_MAX = 65535;        // Max string length to log
-  static char s_msg[LEN_MSG_MAX+1];
-  
-  va_list va;                           // Process input like printf() does
-  va_start (va, s_format);
-  int cnt = vsnprintf (s_msg, LEN_MSG_MAX, s_format, va);
-  va_end (va);
-  s_msg[LEN_MSG_MAX] = 0;               // Make sure it is terminated
+  int cnt_digit = ac_data[1] - '0';
+  if (cnt_data < 2 + cnt_digit)
+    return (0);
 
-  fputs (s_msg, stderr);                // Print error message to stderr
+  long long cnt_block = 0;
+  for (int i=0; i < cnt_digit; i++) {
+    char c = ac_data[2 + i];
+    if ((c < '0') || (c > '9'))
+      return (0);
+    cnt_block = cnt_block * 10 + (c - '0');
+    }
+
+  return (2 + cnt_digit + cnt_block + 1);
 }
 
 // ***************************************************************************
-// Vxi11 default constructor - Do not connect to device yet
+// connect_timeout - Connect a TCP socket to a device, waiting at most a
+//                   given time
 //
-// Parameters: None
-// Returns:    N/A
+// Parameters:
+// 1. ui_ip_addr - IP address of the device
+// 2. port       - TCP port
+// 3. timeout_ms - Longest wait for the connection, in ms
 //
-// Notes: Use this constructor if you want to connect to the device at
-//        a later time using the open() call.
+// Returns: Connected socket, in blocking mode, -1 if error
 // ***************************************************************************
-  Vxi11::
-Vxi11 (void)
+static int
+connect_timeout (unsigned int ui_ip_addr, int port, int timeout_ms)
 {
-  _b_valid = 0;                         // No connection to device
-  __p_client = 0;                       // No RPC client yet
-  __p_link = 0;                         // No link to device yet
-  __p_client_abort = 0;                 // No RPC client for abort channel yet
-  _s_device_addr[0] = 0;                // No device address/name yet
-  _ui_device_ip_addr = 0;               // No device IP address yet
-  _b_srq_ena = false;                   // SRQ interrupt not enabled
-  _b_srq_udp = false;                   // SRQ interrupt will use TCP, not UDP
-  _d_timeout = 10.0;                    // Default timeout in seconds
-  _timeout_ms = 10000;                  // Default timeout in milliseconds
-  read_terminator (-1);                 // Terminate read with END (EOI line
-                                        // for GPIB)
+  int sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return (-1);
+
+  int flags = fcntl (sock, F_GETFL, 0); // Do not wait in connect()
+  fcntl (sock, F_SETFL, flags | O_NONBLOCK);
+
+  sockaddr_in sockaddr = {0};
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons (port);
+  sockaddr.sin_addr.s_addr = ui_ip_addr;
+  int err = connect (sock, (struct sockaddr *)&sockaddr, sizeof (sockaddr));
+  if (err && (errno == EINPROGRESS)) {
+    pollfd pollFd = {sock, POLLOUT, 0};
+    int err_sock = 1;
+    socklen_t len = sizeof (err_sock);
+    if ((poll (&pollFd, 1, timeout_ms) == 1) &&
+        !getsockopt (sock, SOL_SOCKET, SO_ERROR, &err_sock, &len))
+      err = err_sock;
+    }
+
+  if (err) {
+    close (sock);
+    return (-1);
+    }
+
+  fcntl (sock, F_SETFL, flags);
+  return (sock);
 }
 
 // ***************************************************************************
-// Vxi11 constructor - Open connection to device 
+// pmap_port - Ask the portmapper of a device for the TCP port of its core
+//             channel, waiting at most a given time
 //
 // Parameters:
-// 1. s_address   - Device network address, either a host name or IP
-//                  address in dot notation
-//
-// 2. s_device    - Device name at s_address
-//
-//                  May be set to null pointer if device is directly
-//                  connected to the network (an Ethernet or Wifi device); in
-//                  that case "inst0" is used by default.
+// 1. ui_ip_addr - IP address of the device
+// 2. timeout_ms - Longest wait for the connection and for the reply, in ms
 //
-//                  For GPIB devices connected to a GPIB/LAN gateways, this is
-//                  usually "gpib0,n", where 'n' is the GPIB address number of
-//                  the GPIB device.
+// Returns: TCP port, 0 if error
 //
-//                  For GPIB interfaces (the GPIB/LAN gateway itself), this is
-//                  usually "gpib0".
+// Notes: Unlike clnt_create(), the time is limited when the device does not
+//        answer.
+// ***************************************************************************
+static int
+pmap_port (unsigned int ui_ip_addr, int timeout_ms)
+{
+  int sock = connect_timeout (ui_ip_addr, PMAPPORT, timeout_ms);
+  if (sock < 0)
+    return (0);
+
+  sockaddr_in sockaddr = {0};
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons (PMAPPORT);
+  sockaddr.sin_addr.s_addr = ui_ip_addr;
+  CLIENT *p_client = clnttcp_create (&sockaddr, PMAPPROG, PMAPVERS, &sock,
+                                     0, 0);
+  if (!p_client) {
+    close (sock);
+    return (0);
+    }
+  clnt_control (p_client, CLSET_FD_CLOSE, 0); // Closed with the client
+
+  pmap map = {DEVICE_CORE, DEVICE_CORE_VERSION, IPPROTO_TCP, 0};
+  u_long port = 0;
+  timeval tv_timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  if (clnt_call (p_client, PMAPPROC_GETPORT, (xdrproc_t)xdr_pmap,
+                 (char *)&map, (xdrproc_t)xdr_u_long, (char *)&port,
+                 tv_timeout) != RPC_SUCCESS)
+    port = 0;
+  clnt_destroy (p_client);
+
+  return (int (port));
+}
+
+// Mutex for all Vxi11LockGlobal objects
+static pthread_mutex_t mutex_global = PTHREAD_MUTEX_INITIALIZER;
+
+// ***************************************************************************
+// Vxi11LockGlobal::lock - Lock the mutex shared by all objects
 //
-//                  For RS-232 devices connected to an Agilent/Keysight
-//                  E5810A/B, this is usually "COM1,488". 
+// Parameters: None
 //
-// 3. p_err       - Returns error code if given non-zero pointer
-//                  Stores to pointer location 0 = no error
-//                                             1 = error
+// Returns: None
 //
-// Notes: If there was an error in the RPC call, that error message will
-//        be printed to stderr if log_err_ena() is true.
+// Notes: The time waiting for the lock is reported to the tracer, if any.
 // ***************************************************************************
-  Vxi11::
-Vxi11 (const char *s_address, const char *s_device, int *p_err)
+  void Vxi11LockGlobal::
+lock (void)
 {
-  _b_valid = 0;                         // No connection to device
-  __p_client = 0;                       // No RPC client yet
-  __p_link = 0;                         // No link to device yet
-  __p_client_abort = 0;                 // No RPC client for abort channel yet
-  _s_device_addr[0] = 0;                // No device address/name yet
-  _ui_device_ip_addr = 0;               // No device IP address yet
-  _b_srq_ena = false;                   // SRQ interrupt not enabled
-  _b_srq_udp = false;                   // SRQ interrupt will use TCP, not UDP
-  _d_timeout = 10.0;                    // Default timeout in seconds
-  _timeout_ms = 10000;                  // Default timeout in milliseconds
-  read_terminator (-1);                 // Terminate read with END (EOI line
-                                        // for GPIB)
+  Vxi11Tracer *p_tracer = Vxi11Common::tracer ();
+  long long t_begin_ns = (p_tracer) ? Vxi11Tracer::time_ns () : 0;
 
-  int err = open (s_address, s_device); // Connect to device
+  int err = pthread_mutex_lock (&mutex_global);
+  if (err)
+    Vxi11Common::log_err ("Vxi11 error: could not lock mutex, error %d", err);
 
-  if (p_err)                            // Return error to caller
-    *p_err = err;
+  if (p_tracer)
+    p_tracer->mutex_wait (t_begin_ns, Vxi11Tracer::time_ns ());
 }
 
 // ***************************************************************************
-// Vxi11 destructor - Close connection to device if it was open
+// Vxi11LockGlobal::unlock - Unlock the mutex shared by all objects
+//
+// Parameters: None
+//
+// Returns: None
 // ***************************************************************************
-  Vxi11::
-~Vxi11 ()
+  void Vxi11LockGlobal::
+unlock (void)
 {
-  if (_b_valid)                         // Close connection to device if
-    close ();                           // it currently open
+  int err = pthread_mutex_unlock (&mutex_global);
+  if (err)
+    Vxi11Common::log_err ("Vxi11 error: could not unlock mutex, error %d",
+                          err);
 }
 
+// Timeouts of the innermost Vxi11TimeoutScope of each thread
+static __thread const Vxi11Timeout *p_timeout_scope = 0;
+
 // ***************************************************************************
-// Vxi11::open - Open connection to device
-//               VXI-11 RPC is "create_link"
+// Vxi11TimeoutScope constructor - Use timeouts for the calls of this thread
 //
 // Parameters:
-// 1. s_address   - Device network address, either a host name or IP
-//                  address in dot notation
-// 2. s_device    - Device name at s_address
-//
-//                  May be set to null pointer if device is directly
-//                  connected to the network (an Ethernet or WiFi device); in
-//                  that case "inst0" is used by default.
-//
-//                  For GPIB devices connected to a GPIB/LAN gateways, this is
-//                  usually "gpib0,n", where 'n' is the GPIB address number of
-//                  the GPIB device.
-//
-//                  For GPIB interfaces (the GPIB/LAN gateway itself), this is
-//                  usually "gpib0".
+// 1. timeout - Lock, I/O and RPC timeouts in ms, see Vxi11Timeout
+// ***************************************************************************
+  Vxi11TimeoutScope::
+Vxi11TimeoutScope (const Vxi11Timeout &timeout)
+{
+  _timeout = timeout;
+  _p_prev = p_timeout_scope;
+  p_timeout_scope = &_timeout;
+}
+
+// ***************************************************************************
+// Vxi11TimeoutScope constructor - Use one timeout for the calls of this
+//                                 thread
 //
-//                  For RS-232 devices connected to an Agilent/Keysight
-//                  E5810A/B, this is usually "COM1,488". 
+// Parameters:
+// 1. timeout_ms - Lock and I/O timeouts in ms; the RPC timeout is
+//                 rpc_margin() longer
+// ***************************************************************************
+  Vxi11TimeoutScope::
+Vxi11TimeoutScope (int timeout_ms)
+{
+  _timeout.lock_ms = timeout_ms;
+  _timeout.io_ms = timeout_ms;
+  _timeout.rpc_ms = -1;
+  _p_prev = p_timeout_scope;
+  p_timeout_scope = &_timeout;
+}
+
+// ***************************************************************************
+// Vxi11TimeoutScope destructor - Restore the timeouts of the enclosing scope
+// ***************************************************************************
+  Vxi11TimeoutScope::
+~Vxi11TimeoutScope ()
+{
+  p_timeout_scope = _p_prev;
+}
+
+// ***************************************************************************
+// Vxi11TimeoutScope::current - Get the timeouts of the innermost scope of
+//                              this thread
 //
-// Returns:  0 = no error
-//           1 = error
+// Parameters: None
 //
-// Notes: If there was an error in the RPC call, that error message will
-//        be printed to stderr if log_err_ena() is true.
+// Returns: Timeouts, or null if no scope
+// ***************************************************************************
+  const Vxi11Timeout *Vxi11TimeoutScope::
+current (void)
+{
+  return (p_timeout_scope);
+}
+
+// ***************************************************************************
+// Vxi11TraceSpan - Class to report the start and end of one RPC to the
+//                  tracer set by Vxi11::tracer()
 //
-//        Use this function if the default constructor was used, or if
-//        re-opening the device after closing it.
+// Create a local instance of this class just before each RPC call, and call
+// end() just after it.  Nothing is done if no tracer is set, or if the stats
+// policy S is Vxi11StatsNone.
 // ***************************************************************************
-  int Vxi11::
-open (const char *s_address, const char *s_device)
+template <class S> class Vxi11TraceSpan
 {
-  // Cannot open a new connection if one is already open in this instance
-  if (_b_valid) {
-    log_err ("Vxi11::open error: connection already open to %s.\n",
-             _s_device_addr);
-    return (1);
+  private:
+    Vxi11Tracer *_p_tracer;             // Tracer used, null if not tracing
+    Vxi11Transport *_p_trans;           // Core channel transport, or null
+    CLIENT *_p_clnt;                    // Abort channel RPC client, or null
+    Vxi11TraceEvent _event;             // Event passed to the tracer
+
+    // Report start of RPC
+    void _begin (Vxi11Common *p_vxi11, long lid, int proc, const char *s_proc,
+                 int cnt_send) {
+      _event.p_vxi11 = p_vxi11;
+      _event.s_device_addr = p_vxi11->device_addr ();
+      _event.lid = lid;
+      _event.proc = proc;
+      _event.s_proc = s_proc;
+      _event.xid = 0;
+      _event.cnt_send = cnt_send;
+      _event.cnt_recv = 0;
+      _event.err = 0;
+      _event.t_end_ns = 0;
+      _event.t_begin_ns = Vxi11Tracer::time_ns ();
+      _p_tracer->rpc_begin (_event);
+      }
+
+  public:
+  // Constructor to report start of RPC on the core channel
+  Vxi11TraceSpan (Vxi11Common *p_vxi11, Vxi11Transport *p_transport,
+                  long lid, int proc, const char *s_proc, int cnt_send) {
+    _p_tracer = (S::B_ENA) ? Vxi11Common::tracer () : 0;
+    _p_trans = p_transport;
+    _p_clnt = 0;
+    if (_p_tracer)
+      _begin (p_vxi11, lid, proc, s_proc, cnt_send);
     }
 
-  // Check if host name or IP address is not null
-  if (!s_address) {
-    log_err ("Vxi11::open error: null address.\n");
-    return (1);
+  // Constructor to report start of RPC on an RPC client (abort channel)
+  Vxi11TraceSpan (Vxi11Common *p_vxi11, CLIENT *p_client, long lid,
+                  int proc, const char *s_proc, int cnt_send) {
+    _p_tracer = (S::B_ENA) ? Vxi11Common::tracer () : 0;
+    _p_trans = 0;
+    _p_clnt = p_client;
+    if (_p_tracer)
+      _begin (p_vxi11, lid, proc, s_proc, cnt_send);
     }
-  
-  // Use default device name if it is not specified
-  if (!s_device)
-    s_device = "inst0";                 // According to VXI-11.3 Rule B.1.2
 
-  // Store the address and device name so that the user can distinguish
-  // the Vxi11 object used.
+  // Report end of RPC
+  // cnt_recv = payload bytes received, err = -1 if no RPC response, else the
+  // VXI-11 error code
+  // The transaction ID is read back from the client that made the call, so
+  // end() must be called before the transport or client is deleted.
+  void end (int cnt_recv, int err) {
+    if (!_p_tracer)
+      return;
+
+    if (_p_trans)
+      _event.xid = _p_trans->xid_last ();
+    else if (_p_clnt) {
+      u_int32_t xid = 0;
+      clnt_control (_p_clnt, CLGET_XID, (char *)&xid);
+      _event.xid = xid;
+      }
+    _event.t_end_ns = Vxi11Tracer::time_ns ();
+    _event.cnt_recv = cnt_recv;
+    _event.err = err;
+    _p_tracer->rpc_end (_event);
+    }
+};
 
-  _s_device_addr[255] = 0;             // Terminate in case input is too large
-  strncpy (_s_device_addr, s_address, 255);
-  strncat (_s_device_addr, ":", 255);
-  strncat (_s_device_addr, s_device, 255);
+// ***************************************************************************
+// Vxi11RpcResult - Class to hold the results of one RPC
+//
+// Create a local instance of this class for each RPC call, and make the call
+// with call().  The results are released when that instance goes out of
+// scope, so different links and threads do not share result storage as they
+// do with the rpcgen stubs.  Call free() first if the transport is deleted
+// in the same scope.
+//
+// X is the transport type, and the call is counted in its stats() unless
+// the stats policy S is Vxi11StatsNone.
+// ***************************************************************************
+static xdrproc_t xdr_result (Create_LinkResp *) {
+  return ((xdrproc_t)xdr_Create_LinkResp);
+}
+static xdrproc_t xdr_result (Device_Error *) {
+  return ((xdrproc_t)xdr_Device_Error);
+}
+static xdrproc_t xdr_result (Device_WriteResp *) {
+  return ((xdrproc_t)xdr_Device_WriteResp);
+}
+static xdrproc_t xdr_result (Device_ReadResp *) {
+  return ((xdrproc_t)xdr_Device_ReadResp);
+}
+static xdrproc_t xdr_result (Device_ReadStbResp *) {
+  return ((xdrproc_t)xdr_Device_ReadStbResp);
+}
+static xdrproc_t xdr_result (Device_DocmdResp *) {
+  return ((xdrproc_t)xdr_Device_DocmdResp);
+}
 
-  // *************************************************************************
-  // Set up core RPC channel
-  // *************************************************************************
+template <class T, class X, class S> class Vxi11RpcResult
+{
+  private:
+    X *_p_call;                         // Transport of the call, null after
+                                        // free()
+    T _res;                             // Results
+
+    // Make the call, counted in the stats of the transport or not
+    enum clnt_stat _call (u_long proc, xdrproc_t xdr_args, void *p_args) {
+      if (S::B_ENA)
+        return (_p_call->call (proc, xdr_args, p_args, xdr_result (&_res),
+                               &_res));
+      return (_p_call->call_uncounted (proc, xdr_args, p_args,
+                                       xdr_result (&_res), &_res));
+      }
 
-  // Create a client of the RPC functions for device at given address
-  const char *s_tcp = "tcp";
-  __p_client = clnt_create ((char *)s_address, DEVICE_CORE,
-                            DEVICE_CORE_VERSION, (char *)s_tcp);
-    
-  if (!_p_client) {                     // Exit early if error
-    const char *s_err = "Vxi11 open error: client creation";
-    clnt_pcreateerror ((char *)s_err);  // Print error message
-    return (1);
+  public:
+  // Constructor to clear the results
+  Vxi11RpcResult (X *p_transport) {
+    _p_call = p_transport;
+    memset (&_res, 0, sizeof (T));
     }
 
-  // Change underlying RPC timeout from 25s that was set in vxi11_rpc_clnt.c
-  // to 10 seconds more than the user specified timeout
-  timeout (_d_timeout);
+  // Destructor to release the results
+  ~Vxi11RpcResult () { free (); }
 
-  // Create a link to the device
-  Create_LinkParms linkParms;
-  linkParms.clientId = (long)_p_client; // RPC client ID
-  linkParms.lockDevice = 0;             // Do not lock device
-  linkParms.lock_timeout = _timeout_ms; // Timeout in ms
-  linkParms.device = (char *)s_device;  // Device name
-  
-  Create_LinkResp *p_link = create_link_1 (&linkParms, _p_client);
-  
-  if (!p_link) {                        // Exit early if error
-    const char *s_err = "Vxi11::open error: link creation";
-    clnt_perror (_p_client, (char *)s_err); // Print error message
-    clnt_destroy (_p_client);
-    return (1);
+  // Call procedure proc with the arguments p_args
+  // Returns the results, or null if there was no reply
+  template <class A> T *call (u_long proc, bool_t (*xdr_args) (XDR *, A *),
+                              A *p_args) {
+    if (_call (proc, (xdrproc_t)xdr_args, p_args) != RPC_SUCCESS)
+      return (0);
+    return (&_res);
     }
 
-  // Copy it to the object, since RPC will lose it on next call
-  __p_link = (Create_LinkResp *)malloc (sizeof (Create_LinkResp));
-
-  if (!_p_link) {                       // Exit early if error
-    log_err ("Vxi11::open error: could not allocate memory for %s.\n",
-             _s_device_addr);
-    destroy_link_1 (&(p_link->lid), _p_client);
-    clnt_destroy (_p_client);
-    return (1);
+  // Call procedure proc that has no arguments
+  T *call (u_long proc) {
+    if (_call (proc, (xdrproc_t)xdr_void, 0) != RPC_SUCCESS)
+      return (0);
+    return (&_res);
     }
-  
-  *_p_link = *p_link;
 
-  // Get IP address of the device
-  // This is used later if the abort channel is used
-  hostent *p_hostent = gethostbyname (s_address);
-  if (!p_hostent) {
-    log_err ("Vxi11::open error: could not get device IP address for %s.\n",
-             _s_device_addr);
-    destroy_link_1 (&(p_link->lid), _p_client);
-    clnt_destroy (_p_client);
-    return (1);
+  // Release the results
+  void free (void) {
+    if (_p_call)
+      _p_call->free_result (xdr_result (&_res), &_res);
+    _p_call = 0;
     }
-  _ui_device_ip_addr = *(unsigned int *)(p_hostent->h_addr_list[0]);
-  
-  _b_valid = 1;                         // Now have valid connection
-  return (0);
-}
+};
 
 // ***************************************************************************
-// Vxi11::close - Close connection to the device
-//                VXI-11 RPC is "destroy_link"
-//
-// Parameters: None
+// Vxi11CancelScope - Vxi11CancelCall of one call of BasicVxi11, or nothing
+//                    if the lock policy has no lock (B_ENA is 0)
 //
-// Returns: 0 = no error
+// Cancellation tokens and call deadlines are aborted from another thread,
+// so a link without a lock has none, and its calls do not watch for them.
 // ***************************************************************************
-  int Vxi11::
-close (void)
+template <int B_ENA> class Vxi11CancelScope
 {
-  if (!_b_valid)                        // Early return if no connection to
-    return (0);                         // the device
+  private:
+    Vxi11CancelCall _cancelCall;        // Call watched by the watchdog
 
-  // Close SRQ interrupt channel
-  // Leave RPC service running for SRQ since it is global to all Vxi11 objects
-  int err = enable_srq (false);
+  public:
+  Vxi11CancelScope (Vxi11Common *p_vxi11, Vxi11Cancel *p_cancel,
+                    double d_limit, int (*pfn_abort) (Vxi11Common *))
+    : _cancelCall (p_vxi11, p_cancel, d_limit, pfn_abort) {}
 
-  _b_valid = 0;                         // No connection to device
+  // true if the token was cancelled before the call
+  bool cancelled (void) { return (_cancelCall.cancelled ()); }
+};
+
+template <> class Vxi11CancelScope<0>
+{
+  public:
+  Vxi11CancelScope (Vxi11Common *, Vxi11Cancel *, double,
+                    int (*) (Vxi11Common *)) {}
+  bool cancelled (void) { return (false); }
+};
+
+// ***************************************************************************
+// visa_parse - Split a VISA resource string into host and device name
+//
+// Parameters:
+// 1. s_resource - VISA resource string "TCPIP[board]::host[::device][::INSTR]"
+//                 for example "TCPIP0::192.168.1.10::hislip0::INSTR", or
+//                 "TCPIP[board]::host::port::SOCKET"
+// 2. s_host     - Returns host name or IP address
+// 3. s_device   - Returns device name, "inst0" if not in s_resource, or
+//                 "socket,port" for a SOCKET resource
+// 4. len_max    - Size of s_host and s_device
+//
+// Returns: 0 = no error
+//          1 = not a supported resource string
+// ***************************************************************************
+static int
+visa_parse (const char *s_resource, char *s_host, char *s_device, int len_max)
+{
+  const char *as_field[4];              // Start of each field
+  int a_len[4];                         // Length of each field
+  int cnt_field = 0;
+
+  const char *p_field = s_resource;
+  for (;;) {
+    const char *p_sep = strstr (p_field, "::");
+    if (cnt_field == 4)
+      return (1);
+    as_field[cnt_field] = p_field;
+    a_len[cnt_field] = (p_sep) ? p_sep - p_field : strlen (p_field);
+    cnt_field++;
+    if (!p_sep)
+      break;
+    p_field = p_sep + 2;
+    }
+
+  // A SOCKET resource has the port instead of the device name
+  if (cnt_field == 4 && a_len[3] == 6 &&
+      !strncasecmp (as_field[3], "SOCKET", 6)) {
+    int port = atoi (as_field[2]);
+    if (port <= 0 || a_len[1] == 0 || a_len[1] >= len_max)
+      return (1);
+    memcpy (s_host, as_field[1], a_len[1]);
+    s_host[a_len[1]] = 0;
+    snprintf (s_device, len_max, "socket,%d", port);
+    return (0);
+    }
+
+  // The resource class is optional for INSTR
+  if (cnt_field > 2 && a_len[cnt_field - 1] == 5 &&
+      !strncasecmp (as_field[cnt_field - 1], "INSTR", 5))
+    cnt_field--;
+  if (cnt_field < 2 || cnt_field > 3 || a_len[1] == 0 ||
+      a_len[1] >= len_max || (cnt_field == 3 && a_len[2] >= len_max))
+    return (1);
+
+  memcpy (s_host, as_field[1], a_len[1]);
+  s_host[a_len[1]] = 0;
+  if (cnt_field == 3 && a_len[2]) {
+    memcpy (s_device, as_field[2], a_len[2]);
+    s_device[a_len[2]] = 0;
+    }
+  else
+    strcpy (s_device, "inst0");
+
+  return (0);
+}
+
+// ***************************************************************************
+// log_err_va - Log errors to stderr if enabled, for log_err() and
+//              Vxi11ErrorLog::err()
+//
+// Parameters:
+// 1. s_format - printf style format string to log
+// 2. va       - Parameters, depending on s_format
+//
+// Returns: None
+// ***************************************************************************
+static void
+log_err_va (const char *s_format, va_list va)
+{
+  if (!Vxi11Common::log_err_ena ())     // Do nothing if logging is disabled
+    return;
+  
+  if (!s_format)                        // Do nothing if null pointer
+    return;
+
+  // Print error message to stderr
+  // No shared buffer is used, so threads can log at the same time
+  vfprintf (stderr, s_format, va);
+}
+
+// ***************************************************************************
+// Vxi11::log_err - Log errors to stderr if enabled 
+//
+// Parameters:
+// 1. s_format - printf style format string to log
+// 2. ...      - Variable number of parameters, depending on s_format
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Common::
+log_err (const char *s_format, ...)
+{
+  va_list va;                           // Process input like printf() does
+  va_start (va, s_format);
+  log_err_va (s_format, va);
+  va_end (va);
+}
+
+// ***************************************************************************
+// Vxi11ErrorLog::err - Log errors to stderr if enabled, for the error
+//                      policy of BasicVxi11
+//
+// Parameters:
+// 1. s_format - printf style format string to log
+// 2. ...      - Variable number of parameters, depending on s_format
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11ErrorLog::
+err (const char *s_format, ...)
+{
+  va_list va;                           // Process input like printf() does
+  va_start (va, s_format);
+  log_err_va (s_format, va);
+  va_end (va);
+}
+
+// ***************************************************************************
+// Vxi11Common constructor - Clear the state of the link
+// ***************************************************************************
+  Vxi11Common::
+Vxi11Common (void)
+{
+  _b_valid = 0;                         // No connection to device
+  __p_transport = 0;                    // No transport yet
+  __p_link = 0;                         // No link to device yet
+  __p_client_abort = 0;                 // No RPC client for abort channel yet
+  pthread_mutex_init (&_mutex_abort, NULL);
+  _p_cancel = 0;                        // No cancellation token
+  _d_call_deadline = -1;                // No limit on the time of a call
+  _p_breaker = 0;                       // No circuit breaker
+  _s_record_file = 0;                   // Not recording
+  __p_record = 0;
+  __p_replay = 0;                       // Not replaying
+  _b_replay_realtime = false;
+  _s_device_addr[0] = 0;                // No device address/name yet
+  _ui_device_ip_addr = 0;               // No device IP address yet
+  _port_relink = -1;                    // No link to create again
+  _b_srq_ena = false;                   // SRQ interrupt not enabled
+  _b_srq_udp = false;                   // SRQ interrupt will use TCP, not UDP
+  _cnt_srq_handle = 0;                  // No SRQ handle yet
+  __p_srq_waiter = new Vxi11SrqWaiter;  // No SRQ received yet
+  _b_srq_wait = false;                  // wait_for_srq() not called yet
+  __p_stb = new Vxi11StbShare;          // No status byte read yet
+  __p_read_hint = new Vxi11ReadHint;    // No response read yet
+  __p_write_buf = new Vxi11WriteBuf;    // Writes not buffered
+  _d_stb_max_age = 0;                   // Always read the status byte
+  _d_timeout = 10.0;                    // Default timeout in seconds
+  for (int op=0; op < CNT_OP; op++) {   // Same for every operation, in ms
+    _a_timeout[op].lock_ms = 10000;
+    _a_timeout[op].io_ms = 10000;
+    _a_timeout[op].rpc_ms = -1;         // Lock or I/O timeout + margin
+    }
+  _rpc_margin_ms = 10000;               // RPC timeout is 10 s longer
+  _rpc_timeout_ms = -1;                 // RPC timeout of transport not set
+  memset (_a_rtt, 0, sizeof (_a_rtt));  // No latency measured yet
+  memset (&_read_stats, 0, sizeof (_read_stats)); // No chunk read yet
+  _b_rtt_ena = false;                   // Timeouts not derived from latency
+  _rtt_min_ms = 10;                     // From 10 ms to 10 s when enabled
+  _rtt_max_ms = 10000;
+  read_terminator (-1);                 // Terminate read with END (EOI line
+                                        // for GPIB)
+  _pfn_srq_call = 0;                    // Set by BasicVxi11
+}
+
+// ***************************************************************************
+// Vxi11Common destructor - Release the name of the recording file
+// ***************************************************************************
+  Vxi11Common::
+~Vxi11Common ()
+{
+  free (_s_record_file);
+  delete _p_srq_waiter;
+  delete _p_stb;
+  delete _p_read_hint;
+  delete _p_write_buf;
+  pthread_mutex_destroy (&_mutex_abort);
+}
+
+// ***************************************************************************
+// Vxi11 default constructor - Do not connect to device yet
+//
+// Parameters: None
+// Returns:    N/A
+//
+// Notes: Use this constructor if you want to connect to the device at
+//        a later time using the open() call.
+// ***************************************************************************
+  VXI11_TEMPLATE BASIC_VXI11::
+BasicVxi11 (void)
+{
+  _pfn_srq_call = &_srq_call;           // SRQ callback of this type
+  _pfn_srq_handler = 0;                 // No SRQ handler of this object
+  _p_srq_arg = 0;
+}
+
+// ***************************************************************************
+// Vxi11 constructor - Open connection to device 
+//
+// Parameters:
+// 1. s_address   - Device network address, either a host name or IP
+//                  address in dot notation
+//
+//                  May be followed by ":port" to connect to the core channel
+//                  on that TCP port instead of asking the portmapper of the
+//                  device, for example "127.0.0.1:1024" for a simulator.
+//
+//                  May also be a VISA resource string
+//                  "TCPIP[board]::host[::device][::INSTR]", for example
+//                  "TCPIP0::192.168.1.10::hislip0::INSTR", or
+//                  "TCPIP[board]::host::port::SOCKET"; s_device is not used
+//                  in that case.
+//
+// 2. s_device    - Device name at s_address
+//
+//                  May be set to null pointer if device is directly
+//                  connected to the network (an Ethernet or Wifi device); in
+//                  that case "inst0" is used by default.
+//
+//                  For GPIB devices connected to a GPIB/LAN gateways, this is
+//                  usually "gpib0,n", where 'n' is the GPIB address number of
+//                  the GPIB device.
+//
+//                  For GPIB interfaces (the GPIB/LAN gateway itself), this is
+//                  usually "gpib0".
+//
+//                  For HiSLIP devices, this is "hislip0" (or another HiSLIP
+//                  sub-address), optionally followed by ",port" if the
+//                  device does not use the default port 4880.  HiSLIP is
+//                  used instead of VXI-11 for these device names.
+//
+//                  For the raw SCPI socket of a device, this is "socket",
+//                  optionally followed by ",port" if the device does not
+//                  use the default port 5025.
+//
+//                  For RS-232 devices connected to an Agilent/Keysight
+//                  E5810A/B, this is usually "COM1,488". 
+//
+// 3. p_err       - Returns error code if given non-zero pointer
+//                  Stores to pointer location 0 = no error
+//                                             1 = error
+//
+// Notes: If there was an error in the RPC call, that error message will
+//        be printed to stderr if log_err_ena() is true.
+// ***************************************************************************
+  VXI11_TEMPLATE BASIC_VXI11::
+BasicVxi11 (const char *s_address, const char *s_device, int *p_err)
+{
+  _pfn_srq_call = &_srq_call;           // SRQ callback of this type
+  _pfn_srq_handler = 0;                 // No SRQ handler of this object
+  _p_srq_arg = 0;
+
+  int err = open (s_address, s_device); // Connect to device
+
+  if (p_err)                            // Return error to caller
+    *p_err = err;
+}
+
+// ***************************************************************************
+// Vxi11 destructor - Close connection to device if it was open
+// ***************************************************************************
+  VXI11_TEMPLATE BASIC_VXI11::
+~BasicVxi11 ()
+{
+  if (_b_valid)                         // Close connection to device if
+    close ();                           // it currently open
+  delete _p_breaker;                    // Not probed any more
+
+  if (_pfn_srq_handler)                 // Release the SRQ service
+    srq_handler (0);
+  if (_b_srq_wait) {
+    _b_srq_wait = false;
+    _srq_service (false);
+    }
+}
+
+// ***************************************************************************
+// Vxi11::open - Open connection to device
+//               VXI-11 RPC is "create_link"
+//
+// Parameters:
+// 1. s_address   - Device network address, either a host name or IP
+//                  address in dot notation
+//
+//                  May be followed by ":port" to connect to the core channel
+//                  on that TCP port instead of asking the portmapper of the
+//                  device, for example "127.0.0.1:1024" for a simulator.
+//
+//                  May also be a VISA resource string
+//                  "TCPIP[board]::host[::device][::INSTR]", for example
+//                  "TCPIP0::192.168.1.10::hislip0::INSTR", or
+//                  "TCPIP[board]::host::port::SOCKET"; s_device is not used
+//                  in that case.
+// 2. s_device    - Device name at s_address
+//
+//                  May be set to null pointer if device is directly
+//                  connected to the network (an Ethernet or WiFi device); in
+//                  that case "inst0" is used by default.
+//
+//                  For GPIB devices connected to a GPIB/LAN gateways, this is
+//                  usually "gpib0,n", where 'n' is the GPIB address number of
+//                  the GPIB device.
+//
+//                  For GPIB interfaces (the GPIB/LAN gateway itself), this is
+//                  usually "gpib0".
+//
+//                  For HiSLIP devices, this is "hislip0" (or another HiSLIP
+//                  sub-address), optionally followed by ",port" if the
+//                  device does not use the default port 4880.  HiSLIP is
+//                  used instead of VXI-11 for these device names.
+//
+//                  For the raw SCPI socket of a device, this is "socket",
+//                  optionally followed by ",port" if the device does not
+//                  use the default port 5025.
+//
+//                  For RS-232 devices connected to an Agilent/Keysight
+//                  E5810A/B, this is usually "COM1,488". 
+//
+// 3. p_transport - Transport for the core channel, created with new, or null
+//                  (default) to select it from s_address and s_device
+//
+//                  It is opened with the host and optional port of
+//                  s_address, and deleted by close(), or by open() if there
+//                  is an error.  See vxi11_transport.h.
+//
+// Returns:  0 = no error
+//           1 = error
+//
+// Notes: If there was an error in the RPC call, that error message will
+//        be printed to stderr if log_err_ena() is true.
+//
+//        Use this function if the default constructor was used, or if
+//        re-opening the device after closing it.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+open (const char *s_address, const char *s_device, X *p_transport)
+{
+  // Cannot open a new connection if one is already open in this instance
+  if (_b_valid) {
+    log_err ("Vxi11::open error: connection already open to %s.\n",
+             _s_device_addr);
+    delete p_transport;
+    return (1);
+    }
+
+  // Check if host name or IP address is not null
+  if (!s_address) {
+    log_err ("Vxi11::open error: null address.\n");
+    delete p_transport;
+    return (1);
+    }
+  
+  // Split a VISA resource string into host and device name
+  char s_visa_host[256];
+  char s_visa_device[256];
+  if (!strncasecmp (s_address, "TCPIP", 5) && strstr (s_address, "::")) {
+    if (visa_parse (s_address, s_visa_host, s_visa_device, 256)) {
+      log_err ("Vxi11::open error: unsupported VISA resource %s.\n",
+               s_address);
+      delete p_transport;
+      return (1);
+      }
+    s_address = s_visa_host;
+    s_device = s_visa_device;
+    }
+
+  // Use default device name if it is not specified
+  if (!s_device)
+    s_device = "inst0";                 // According to VXI-11.3 Rule B.1.2
+
+  // Store the address and device name so that the user can distinguish
+  // the Vxi11 object used.
+
+  _s_device_addr[255] = 0;             // Terminate in case input is too large
+  strncpy (_s_device_addr, s_address, 255);
+  strncat (_s_device_addr, ":", 255);
+  strncat (_s_device_addr, s_device, 255);
+
+  // *************************************************************************
+  // Set up core RPC channel
+  // *************************************************************************
+
+  // Split optional ":port" from the host name or IP address
+  char s_host[256];
+  s_host[255] = 0;
+  strncpy (s_host, s_address, 255);
+  int port = 0;
+  char *p_colon = strrchr (s_host, ':');
+  if (p_colon && p_colon[1] &&
+      strspn (p_colon + 1, "0123456789") == strlen (p_colon + 1)) {
+    port = atoi (p_colon + 1);
+    *p_colon = 0;
+    }
+
+  // HiSLIP device names are "hislipN", and the raw socket device name is
+  // "socket", optionally followed by ",port", unless a transport is given
+  char s_hislip[256];
+  bool b_hislip = !p_transport && !strncasecmp (s_device, "hislip", 6);
+  bool b_socket = !p_transport && !strncasecmp (s_device, "socket", 6);
+  if (b_hislip || b_socket) {
+    s_hislip[255] = 0;
+    strncpy (s_hislip, s_device, 255);
+    char *p_comma = strchr (s_hislip, ',');
+    if (p_comma) {
+      port = atoi (p_comma + 1);
+      *p_comma = 0;
+      }
+    if (!port)
+      port = (b_hislip) ? VXI11_HISLIP_PORT : VXI11_SOCKET_PORT;
+    s_device = s_hislip;                // Sent as the HiSLIP sub-address
+    }
+
+  // Get IP address of the device
+  // This is used later if the abort channel is used.  A transport given may
+  // not use an IP address.
+  hostent *p_hostent = gethostbyname (s_host);
+  if (!p_hostent && !p_transport) {
+    log_err ("Vxi11::open error: could not get device IP address for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  _ui_device_ip_addr = (p_hostent) ?
+                       *(unsigned int *)(p_hostent->h_addr_list[0]) : 0;
+
+  // Create the transport for the device at given address, unless one was
+  // given: an RPC client of the HiSLIP or raw socket device, or a tirpc
+  // client created by open() of the transport
+  Vxi11TransportRpc *p_transport_rpc = 0;
+  if (!p_transport) {
+    CLIENT *p_client = 0;
+    if (b_hislip)
+      p_client = vxi11_hislip_create (s_host, port, &vxi11_srq_post);
+    else if (b_socket)
+      p_client = vxi11_socket_create (s_host, port);
+    p_transport_rpc = new Vxi11TransportRpc (p_client);
+    p_transport = p_transport_rpc;
+    }
+  __p_transport = p_transport;
+
+  // The breaker can only create the tirpc client of a VXI-11 link again
+  _port_relink = (p_transport_rpc && !b_hislip && !b_socket &&
+                  !_s_record_file) ? port : -1;
+
+  if (_p_transport->open (s_host, port)) { // Exit early if error
+    log_err ("Vxi11::open error: client creation: %s for %s.\n",
+             _p_transport->error (), _s_device_addr);
+    delete _p_transport;
+    __p_transport = 0;
+    return (1);
+    }
+
+  // Record the session if requested with record()
+  // Only the RPC client of the built-in transport can be recorded
+  if (_s_record_file) {
+    Vxi11RecordFile *p_record = new Vxi11RecordFile;
+    if (!p_transport_rpc)
+      log_err ("Vxi11::open error: cannot record the transport given for "
+               "%s.\n", _s_device_addr);
+    if (!p_transport_rpc ||
+        p_record->open (_s_record_file, _s_device_addr)) {
+      delete p_record;
+      delete _p_transport;
+      __p_transport = 0;
+      return (1);
+      }
+    __p_record = p_record;
+    p_transport_rpc->client (p_record->client (p_transport_rpc->client (),
+                                               DEVICE_CORE));
+    }
+
+  // Create a link to the device
+  if (_open_link (s_device))            // Exit early if error
+    return (1);
+
+  _b_valid = 1;                         // Now have valid connection
+
+  // Open the abort channel now, so abort() never has to create it while
+  // another thread closes the link
+  if (_p_link->abortPort)
+    _open_abort ();
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::_open_link - Create the link to the device on the RPC client
+//                     VXI-11 RPC is "create_link"
+//
+// Parameters:
+// 1. s_device - Device name, see open()
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: __p_transport must already be open.  On error, __p_transport is
+//        deleted, and the session being recorded or replayed is closed.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_open_link (const char *s_device)
+{
+  memset (_a_rtt, 0, sizeof (_a_rtt));  // Latency and chunks of another
+  memset (&_read_stats, 0, sizeof (_read_stats)); // device
+
+  // Change underlying RPC timeout from 25s that was set in vxi11_rpc_clnt.c
+  // to the one of OP_CONTROL
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL);
+  _rpc_timeout_ms = -1;                 // New transport
+  _timeout_rpc (timeoutCall.rpc_ms);
+
+  // Create a link to the device
+  Create_LinkParms linkParms;
+  linkParms.clientId = (long)_p_transport; // RPC client ID
+  linkParms.lockDevice = 0;             // Do not lock device
+  linkParms.lock_timeout = timeoutCall.lock_ms; // Timeout in ms
+  linkParms.device = (char *)s_device;  // Device name
   
-  // Close link to device
-  Device_Error *p_error = destroy_link_1 (&(_p_link->lid), _p_client);  
-  if (!p_error) { 
-    log_err ("Vxi11::close error: no RPC response for %s.\n", _s_device_addr);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, -1, create_link,
+                               "create_link", strlen (s_device));
+  Vxi11RpcResult<Create_LinkResp, X, S> res (_p_transport);
+  Create_LinkResp *p_link = res.call (create_link,
+                                      xdr_Create_LinkParms, &linkParms);
+  traceSpan.end (0, (p_link) ? int (p_link->error) : -1);
+  
+  if (!p_link) {                        // Exit early if error
+    log_err ("Vxi11::open error: link creation: %s for %s.\n",
+             _p_transport->error (), _s_device_addr);
+    res.free ();                        // Before the transport is deleted
+    delete _p_transport;
+    __p_transport = 0;
+    delete (Vxi11RecordFile *)__p_record;
+    __p_record = 0;
+    delete (Vxi11ReplayFile *)__p_replay;
+    __p_replay = 0;
+    return (1);
+    }
+
+  // Copy it to the object, since the results are released on return
+  __p_link = (Create_LinkResp *)malloc (sizeof (Create_LinkResp));
+
+  if (!_p_link) {                       // Exit early if error
+    log_err ("Vxi11::open error: could not allocate memory for %s.\n",
+             _s_device_addr);
+    Vxi11TraceSpan<S> traceSpanDestroy (this, _p_transport, p_link->lid,
+                                        destroy_link, "destroy_link", 0);
+    Vxi11RpcResult<Device_Error, X, S> resDestroy (_p_transport);
+    Device_Error *p_error = resDestroy.call (destroy_link,
+                                             xdr_Device_Link, &(p_link->lid));
+    traceSpanDestroy.end (0, (p_error) ? int (p_error->error) : -1);
+    resDestroy.free ();                 // Before the transport is deleted
+    res.free ();
+    delete _p_transport;
+    __p_transport = 0;
+    delete (Vxi11RecordFile *)__p_record;
+    __p_record = 0;
+    delete (Vxi11ReplayFile *)__p_replay;
+    __p_replay = 0;
+    return (1);
+    }
+  
+  *_p_link = *p_link;
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::close - Close connection to the device
+//                VXI-11 RPC is "destroy_link"
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+close (void)
+{
+  if (!_b_valid)                        // Early return if no connection to
+    return (0);                         // the device
+
+  // Send the buffered commands while the link is open
+  int err = flush ();
+
+  // Close SRQ interrupt channel
+  // Leave RPC service running for SRQ since it is global to all Vxi11 objects
+  if (enable_srq (false))
     err = 1;
+
+  // Ignore SRQs for the handle from now on, drop one already received, and
+  // wait for the handler running for it
+  if (_cnt_srq_handle) {
+    vxi11_srq_handle_delete (_a_srq_handle, _cnt_srq_handle);
+    vxi11_srq_forget (_a_srq_handle, _cnt_srq_handle);
+    _cnt_srq_handle = 0;
+    }
+
+  // Stop probing the link; skip destroy_link if the device does not reply
+  bool b_tripped = false;
+  if (_p_breaker) {
+    b_tripped = _p_breaker->tripped ();
+    _p_breaker->reset ();
+    }
+
+  _b_valid = 0;                         // No connection to device
+
+  pthread_mutex_lock (&_p_stb->mutex);  // Status byte is not from this link
+  _p_stb->t_ns = 0;                     // if opened again
+  pthread_mutex_unlock (&_p_stb->mutex);
+
+  // Close the abort channel, after an abort() or Vxi11Cancel::cancel() in
+  // progress on another thread
+  pthread_mutex_lock (&_mutex_abort);
+  if (_p_client_abort) {
+    clnt_destroy (_p_client_abort);
+    __p_client_abort = 0;
     }
+  pthread_mutex_unlock (&_mutex_abort);
   
-  // Possible errors
-  //  0 = no error
-  //  4 = invalid link identifier
+  // Close link to device, unless known not to reply
+  if (b_tripped) {
+    log_err ("Vxi11::close error: circuit open for %s.\n", _s_device_addr);
+    err = 1;
+    }
   else {
-    int err_code = int (p_error->error);
-    if (err_code) {
-      int idx_err_desc = ((err_code >= 0) && (err_code < CNT_ERR_DESC_MAX)) ?
-                         err_code : 0;
-      log_err ("Vxi11::close error: destroy_link error %d %s for %s.\n",
-               err_code, _as_err_desc[idx_err_desc], _s_device_addr);
+    _timeout_rpc (timeout_call (OP_CONTROL).rpc_ms);
+    Vxi11TraceSpan<S> traceSpan (this, _p_transport, _p_link->lid,
+                                 destroy_link, "destroy_link", 0);
+    Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+    Device_Error *p_error = res.call (destroy_link,
+                                      xdr_Device_Link, &(_p_link->lid));
+    traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+    if (!p_error) { 
+      log_err ("Vxi11::close error: no RPC response for %s.\n",
+               _s_device_addr);
       err = 1;
       }
+
+    // Possible errors
+    //  0 = no error
+    //  4 = invalid link identifier
+    else {
+      int err_code = int (p_error->error);
+      if (err_code) {
+        int idx_err_desc = ((err_code >= 0) &&
+                            (err_code < CNT_ERR_DESC_MAX)) ? err_code : 0;
+        log_err ("Vxi11::close error: destroy_link error %d %s for %s.\n",
+                 err_code, _as_err_desc[idx_err_desc], _s_device_addr);
+        err = 1;
+        }
+      }
     }
-  
+
   free (_p_link);
   __p_link = 0;
-  
-  if (_p_client_abort) {
-    clnt_destroy (_p_client_abort);     // Abort channel
-    __p_client_abort = 0;
-    }
 
-  // Close RPC client
-  clnt_destroy (_p_client);             // Core (normal) channel
-  __p_client = 0;
+  // Close the transport
+  delete _p_transport;                  // Core (normal) channel
+  __p_transport = 0;
+
+  // Finish the session being recorded or replayed
+  delete (Vxi11RecordFile *)__p_record;
+  __p_record = 0;
+  delete (Vxi11ReplayFile *)__p_replay;
+  __p_replay = 0;
 
   return (err);
 }
 
+// ***************************************************************************
+// Vxi11::record - Record the RPCs of the following sessions to a file
+//
+// Parameters:
+// 1. s_file - Name of session trace file to create
+//             Set to null to stop recording at the next open()
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Call this before open().  Every RPC request and reply exchanged
+//        with the device from open() until close() is appended to the file,
+//        with its payload and timing.  Each open() replaces the file.
+//
+//        The file is memory-mapped and append-only, so recording has low
+//        overhead.  Play it back with replay() or the replay_vxi11 tool.
+// ***************************************************************************
+  int Vxi11Common::
+record (const char *s_file)
+{
+  free (_s_record_file);
+  _s_record_file = (s_file) ? strdup (s_file) : 0;
+
+  if (s_file && !_s_record_file) {
+    log_err ("Vxi11::record error: could not allocate memory.\n");
+    return (1);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::lid - Get the link ID returned by create_link
+//
+// Parameters: None
+//
+// Returns: Link ID, -1 if there is no connection to the device
+//
+// Notes: For calls of the core channel made directly on the transport, such
+//        as those that InstrumentGroup sends to many links at once.
+// ***************************************************************************
+  long Vxi11Common::
+lid (void)
+{
+  return ((_b_valid && _p_link) ? long (_p_link->lid) : -1);
+}
+
+// ***************************************************************************
+// Vxi11::replay - Open a recorded session instead of a device
+//                 VXI-11 RPC is "create_link", replayed from the file
+//
+// Parameters:
+// 1. s_file     - Session trace file created with record()
+// 2. b_realtime - false = replies are returned immediately (default)
+//                 true  = each reply is returned after the time the device
+//                         took to reply when it was recorded
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Use this instead of open().  No I/O is done; each RPC returns the
+//        reply recorded for the next RPC of the same procedure, so the
+//        calls should be made in the same order as when recording.  This
+//        allows client side performance to be measured offline.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+replay (const char *s_file, bool b_realtime)
+{
+  // Cannot open a new connection if one is already open in this instance
+  if (_b_valid) {
+    log_err ("Vxi11::replay error: connection already open to %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  if (!s_file) {
+    log_err ("Vxi11::replay error: null file name.\n");
+    return (1);
+    }
+
+  Vxi11ReplayFile *p_replay = new Vxi11ReplayFile;
+  if (p_replay->open (s_file)) {
+    delete p_replay;
+    return (1);
+    }
+  __p_replay = p_replay;
+  _b_replay_realtime = b_realtime;
+
+  // Use the device address and name that was recorded
+  _s_device_addr[255] = 0;
+  strncpy (_s_device_addr, p_replay->header ()->s_device_addr, 255);
+  const char *s_device = strrchr (_s_device_addr, ':');
+  s_device = (s_device) ? s_device + 1 : "inst0";
+
+  __p_transport = new Vxi11TransportRpc (p_replay->client (DEVICE_CORE,
+                                                           b_realtime));
+  if (_open_link (s_device))            // Exit early if error
+    return (1);
+
+  _ui_device_ip_addr = 0;               // No device to connect to
+  _port_relink = -1;
+  _b_valid = 1;                         // Now have valid connection
+
+  if (_p_link->abortPort)               // Replayed abort channel
+    _open_abort ();
+  return (0);
+}
+
 // ***************************************************************************
 // Vxi11::timeout - Set timeout time
 //
@@ -440,39 +1542,381 @@ close (void)
 // Returns: None
 //
 // Notes: Default timeout if this function is not called is 10 seconds.
+//
+//        Sets the lock and I/O timeouts of every kind of operation, replacing
+//        those set with timeout(op).  The RPC timeout is rpc_margin() longer.
 // ***************************************************************************
-  void Vxi11::
+  VXI11_TEMPLATE void BASIC_VXI11::
 timeout (double d_timeout)
 {
   if (d_timeout < 0)
     d_timeout = 0;
   
   _d_timeout = d_timeout;                     // Store timeout in s
-  _timeout_ms = int (d_timeout * 1000 + 0.5); // Store timeout in ms
+  int timeout_ms = int (d_timeout * 1000 + 0.5); // Timeout in ms
+
+  for (int op=0; op < CNT_OP; op++) {
+    _a_timeout[op].lock_ms = timeout_ms;
+    _a_timeout[op].io_ms = timeout_ms;
+    _a_timeout[op].rpc_ms = -1;         // Derived when the call is made
+    }
+}
+
+// ***************************************************************************
+// Vxi11::timeout - Get timeout time
+//
+// Parameters: None
+//
+// Returns: Timeout time, in seconds, set by timeout()
+// ***************************************************************************
+  VXI11_TEMPLATE double BASIC_VXI11::
+timeout (void)
+{
+  return (_d_timeout);
+}
+
+// ***************************************************************************
+// Vxi11::timeout - Set the timeouts of one kind of operation
+//
+// Parameters:
+// 1. op      - Kind of operation, such as OP_READSTB
+// 2. timeout - Lock, I/O and RPC timeouts, in ms; rpc_ms < 0 for the
+//              longer of lock_ms and io_ms plus rpc_margin()
+//
+// Returns: None
+//
+// Notes: The RPC timeout is how long the library waits for the reply.  Set
+//        it close to the I/O timeout so a dead link fails fast; it must be
+//        long enough for the device to time out itself and reply.
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+timeout (Op op, const Vxi11Timeout &timeout)
+{
+  if ((op < 0) || (op >= CNT_OP)) {
+    log_err ("Vxi11::timeout error: invalid operation %d for %s.\n", op,
+             _s_device_addr);
+    return;
+    }
+
+  _a_timeout[op] = timeout;
+  if (_a_timeout[op].lock_ms < 0)
+    _a_timeout[op].lock_ms = 0;
+  if (_a_timeout[op].io_ms < 0)
+    _a_timeout[op].io_ms = 0;
+}
+
+// ***************************************************************************
+// Vxi11::timeout - Get the timeouts of one kind of operation
+//
+// Parameters:
+// 1. op - Kind of operation, such as OP_READSTB
+//
+// Returns: Timeouts set by timeout() or timeout(op), in ms
+// ***************************************************************************
+  VXI11_TEMPLATE Vxi11Timeout BASIC_VXI11::
+timeout (Op op)
+{
+  if ((op < 0) || (op >= CNT_OP))
+    op = OP_CONTROL;
+  return (_a_timeout[op]);
+}
+
+// ***************************************************************************
+// Vxi11::timeout_call - Get the timeouts of the next call from this thread
+//
+// Parameters:
+// 1. op - Kind of operation, such as OP_READSTB
+//
+// Returns: Timeouts of the innermost Vxi11TimeoutScope of this thread, or
+//          else of timeout(op), in ms, with rpc_ms derived if < 0
+//
+// Notes: With rtt_timeout() enabled and no scope, the I/O and RPC timeouts
+//        of op are derived from its latency once it has been measured.
+// ***************************************************************************
+  VXI11_TEMPLATE Vxi11Timeout BASIC_VXI11::
+timeout_call (Op op)
+{
+  const Vxi11Timeout *p_scope = Vxi11TimeoutScope::current ();
+  Vxi11Timeout timeoutCall = (p_scope) ? *p_scope : timeout (op);
+
+  // Latency estimate, updated by _call_end() of another thread
+  int rto_ms = (S::B_ENA && _b_rtt_ena && !p_scope && (op >= 0) &&
+                (op < CNT_OP) && (op != OP_LOCK)) ?
+               __atomic_load_n (&_a_rtt[op].rto_ms, __ATOMIC_RELAXED) : 0;
+  if (rto_ms > 0) {
+    rto_ms = (rto_ms < _rtt_min_ms) ? _rtt_min_ms :
+             (rto_ms > _rtt_max_ms) ? _rtt_max_ms : rto_ms;
+    timeoutCall.io_ms = rto_ms;
+    timeoutCall.rpc_ms = rto_ms + ((rto_ms < _rpc_margin_ms) ?
+                                   rto_ms : _rpc_margin_ms);
+    }
+
+  if (timeoutCall.rpc_ms < 0)
+    timeoutCall.rpc_ms = ((timeoutCall.lock_ms > timeoutCall.io_ms) ?
+                          timeoutCall.lock_ms : timeoutCall.io_ms) +
+                         _rpc_margin_ms;
+  return (timeoutCall);
+}
+
+// ***************************************************************************
+// Vxi11::rpc_margin - Set the time added to the lock and I/O timeouts for
+//                     the RPC timeout
+//
+// Parameters:
+// 1. d_margin - Time in seconds
+//
+// Returns: None
+//
+// Notes: Used when the RPC timeout of a Vxi11Timeout is < 0.  Default is
+//        10 seconds.
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+rpc_margin (double d_margin)
+{
+  _rpc_margin_ms = (d_margin < 0) ? 0 : int (d_margin * 1000 + 0.5);
+}
+
+// ***************************************************************************
+// Vxi11::rpc_margin - Get the time added to the lock and I/O timeouts for
+//                     the RPC timeout
+//
+// Parameters: None
+//
+// Returns: Time in seconds
+// ***************************************************************************
+  VXI11_TEMPLATE double BASIC_VXI11::
+rpc_margin (void)
+{
+  return (_rpc_margin_ms * 1e-3);
+}
+
+// ***************************************************************************
+// Vxi11::rtt_timeout - Enable/disable timeouts derived from the latency of
+//                      the calls
+//
+// Parameters:
+// 1. b_ena - true to derive the timeouts, false to use timeout(op)
+// 2. d_min - Shortest I/O timeout derived, in seconds
+// 3. d_max - Longest I/O timeout derived, in seconds
+//
+// Returns: None
+//
+// Notes: The latency of each kind of operation is always measured with the
+//        stats policy, see rtt().  When enabled, the I/O timeout of a call
+//        is the estimate of its kind of operation, clamped to d_min and
+//        d_max, and its RPC timeout is twice that, at most rpc_margin()
+//        longer.  Until the first reply of a kind of operation, and for
+//        OP_LOCK, whose latency is that of the other links holding the
+//        lock, timeout(op) is used.  A slow device then fails in a few
+//        times its usual latency instead of after the fixed timeout.
+//
+//        Set d_min above the longest normal variation of a call, such as a
+//        read waiting for a measurement.  A call that times out doubles the
+//        timeout of its kind of operation, up to d_max, until a reply comes
+//        in time.
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+rtt_timeout (bool b_ena, double d_min, double d_max)
+{
+  if (d_min < 0.001)
+    d_min = 0.001;
+  if (d_max < d_min)
+    d_max = d_min;
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _rtt_min_ms = int (d_min * 1000 + 0.5);
+  _rtt_max_ms = int (d_max * 1000 + 0.5);
+  _b_rtt_ena = b_ena;
+  if (!S::B_ENA && b_ena)
+    log_err ("Vxi11::rtt_timeout error: no latency measured without "
+             "stats for %s.\n", _s_device_addr);
+}
+
+// ***************************************************************************
+// Vxi11::rtt - Get the latency estimate of one kind of operation
+//
+// Parameters:
+// 1. op - Kind of operation, such as OP_READSTB
+//
+// Returns: Smoothed latency and variation, in seconds, and the I/O timeout
+//          derived from them, in ms, before the limits of rtt_timeout();
+//          all 0 if not measured yet
+// ***************************************************************************
+  VXI11_TEMPLATE Vxi11Rtt BASIC_VXI11::
+rtt (Op op)
+{
+  if ((op < 0) || (op >= CNT_OP))
+    op = OP_CONTROL;
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  return (_a_rtt[op]);
+}
+
+// ***************************************************************************
+// Vxi11::_call_end - Private function to count the end of a call for the
+//                    circuit breaker, and add its latency to the estimate
+//                    of its kind of operation
+//
+// Parameters:
+// 1. op  - Kind of operation of the call
+// 2. err - Error code of the reply, -1 if no reply
+//
+// Returns: None
+//
+// Notes: Call with the RPC mutex locked, right after the call.  The latency
+//        is the time of the last call in the transport stats.  As in TCP,
+//        a call that timed out is not a sample (its latency is not known),
+//        and doubles the timeout instead; an aborted call is ignored.
+//        OP_LOCK is not estimated, see rtt_timeout().
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+_call_end (Op op, int err)
+{
+  if (L::B_ENA && _p_breaker)          // Opens after calls without reply
+    _p_breaker->call_end (err != -1);
+
+  if (!S::B_ENA || !_p_transport || (op == OP_LOCK)) // Calls not timed
+    return;
+
+  Vxi11Rtt *p_rtt = &_a_rtt[op];
+
+  // No reply, or I/O timeout: back off, up to 64 times the estimate
+  if ((err == -1) || (err == 15)) {
+    if (p_rtt->backoff < 6)
+      p_rtt->backoff++;
+    }
+
+  else if (err == 23)                   // Aborted, latency not known
+    return;
+
+  // Reply in time: update the estimate, RFC 6298 with alpha 1/8, beta 1/4
+  else {
+    double d_sample = _p_transport->stats ().t_last_ns * 1e-9;
+    if (p_rtt->cnt_sample == 0) {
+      p_rtt->d_srtt = d_sample;
+      p_rtt->d_rttvar = d_sample / 2;
+      }
+    else {
+      double d_diff = p_rtt->d_srtt - d_sample;
+      p_rtt->d_rttvar = 0.75 * p_rtt->d_rttvar +
+                        0.25 * ((d_diff < 0) ? -d_diff : d_diff);
+      p_rtt->d_srtt = 0.875 * p_rtt->d_srtt + 0.125 * d_sample;
+      }
+    p_rtt->cnt_sample++;
+    p_rtt->backoff = 0;
+    }
+
+  if (p_rtt->cnt_sample == 0)           // Nothing known to back off from
+    return;
+
+  // I/O timeout derived, at least 1 ms; clamped by timeout_call()
+  double d_rto_ms = (p_rtt->d_srtt + 4 * p_rtt->d_rttvar) * 1000 *
+                    (1 << p_rtt->backoff);
+  int rto_ms = (d_rto_ms < 1) ? 1 : (d_rto_ms > 1e9) ? 1000000000 :
+               int (d_rto_ms + 0.5);
+  __atomic_store_n (&p_rtt->rto_ms, rto_ms, __ATOMIC_RELAXED);
+}
 
-  // Change underlying RPC timeout 10 seconds longer
-  if (_p_client) {
-    struct timeval timeval_timeout = {int (_d_timeout + 10.5), 0};
-    clnt_control (_p_client, CLSET_TIMEOUT, (char *)(&timeval_timeout));
+// ***************************************************************************
+// Vxi11::_timeout_rpc - Private function to set the RPC timeout of the
+//                       transport for the next call
+//
+// Parameters:
+// 1. rpc_ms - Timeout in ms
+//
+// Returns: None
+//
+// Notes: Call with the RPC mutex locked.  The transport is only changed if
+//        the timeout is not the one set last.
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+_timeout_rpc (int rpc_ms)
+{
+  if (_p_transport && (rpc_ms != _rpc_timeout_ms)) {
+    _p_transport->timeout (rpc_ms);
+    _rpc_timeout_ms = rpc_ms;
     }
 }
 
-// ***************************************************************************
-// Vxi11::timeout - Get timeout time
-//
-// Parameters: None
-//
-// Returns: Timeout time, in seconds
-// ***************************************************************************
-  double Vxi11::
-timeout (void)
-{
-  return (_d_timeout);
+// ***************************************************************************
+// Vxi11::write - Write data to the device
+//                VXI-11 RPC is "device_write"
+//
+// Parameters:
+// 1. ac_data  - Data to send to device
+// 2. cnt_data - Number of bytes in ac_data to send
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: If Vxi11 object is associated with a GPIB device or GPIB interface
+//        via a GPIB/LAN gateway, GPIB uses SEND command sequence, with EOI
+//        on last byte.
+//
+//        With write_buffer() enabled, ac_data is one command appended to
+//        the buffer of the link, without a line feed that ends it, and the
+//        error is that of the buffered commands sent to make room, if any.
+//        A command longer than maxRecvSize is sent right after them.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+write (const char *ac_data, int cnt_data)
+{
+  if (!__atomic_load_n (&_p_write_buf->b_ena, __ATOMIC_ACQUIRE))
+    return (_write (ac_data, cnt_data));
+
+  // Early return if object did not make connection to instrument
+  if (!_b_valid) {
+    log_err ("Vxi11::write error: no connection to device.\n");
+    return (1);
+    }
+
+  // Check input parameters
+  if ((!ac_data) || (cnt_data < 0)) {
+    log_err ("Vxi11::write error: invalid parameters for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  if (cnt_data && (ac_data[cnt_data - 1] == '\n')) // The separator or END
+    cnt_data--;                         // ends the command instead
+  if (cnt_data == 0)                    // No error for sending no data
+    return (0);
+
+  // Send the buffer first if the command does not fit in one device_write
+  int cnt_max = _p_link->maxRecvSize;
+  if (cnt_max <= 0)                     // Check for valid max value
+    cnt_max = 1024;                     // Default to 1K if not valid
+
+  Vxi11WriteBuf *p_write_buf = _p_write_buf;
+  if (L::B_ENA)                         // Vxi11LockNone has one thread
+    pthread_mutex_lock (&p_write_buf->mutex);
+  int err = 0;
+  if (!p_write_buf->b_ena)              // Disabled since checked
+    err = _write (ac_data, cnt_data);
+  else {
+    size_t cnt_sep = (p_write_buf->cnt_cmd) ? 1 : 0;
+    if (p_write_buf->s_buf.size () + cnt_sep + cnt_data > (size_t)cnt_max) {
+      err = _write_flush ();
+      cnt_sep = 0;
+      }
+    if (!err && (cnt_data > cnt_max))   // Too long to buffer
+      err = _write (ac_data, cnt_data);
+    else if (!err) {
+      if (cnt_sep)
+        p_write_buf->s_buf += p_write_buf->c_sep;
+      p_write_buf->s_buf.append (ac_data, cnt_data);
+      __atomic_store_n (&p_write_buf->cnt_cmd, p_write_buf->cnt_cmd + 1,
+                        __ATOMIC_RELEASE);
+      }
+    }
+  if (L::B_ENA)
+    pthread_mutex_unlock (&p_write_buf->mutex);
+
+  return (err);
 }
 
 // ***************************************************************************
-// Vxi11::write - Write data to the device
-//                VXI-11 RPC is "device_write"
+// Vxi11::_write - Private function to write data to the device
+//                 VXI-11 RPC is "device_write"
 //
 // Parameters:
 // 1. ac_data  - Data to send to device
@@ -481,12 +1925,11 @@ timeout (void)
 // Returns: 0 = no error
 //          1 = error
 //
-// Notes: If Vxi11 object is associated with a GPIB device or GPIB interface
-//        via a GPIB/LAN gateway, GPIB uses SEND command sequence, with EOI
-//        on last byte.
+// Notes: Sends ac_data as it is, without write_buffer().  See write() for
+//        the rest.
 // ***************************************************************************
-  int Vxi11::
-write (const char *ac_data, int cnt_data)
+  VXI11_TEMPLATE int BASIC_VXI11::
+_write (const char *ac_data, int cnt_data)
 {
   // Early return if object did not make connection to instrument
   if (!_b_valid) {
@@ -504,9 +1947,25 @@ write (const char *ac_data, int cnt_data)
     return (0);
     
   Device_WriteParms writeParms;         // To send to device_write RPC call
-  writeParms.lid = _p_link->lid;        // Link ID from create_link RPC call
-  writeParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  writeParms.lock_timeout = _timeout_ms;// Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_WRITE); // Timeouts in ms
+  writeParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  writeParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
+
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::write error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::write error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  writeParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Get max # of bytes to send at a time
   int cnt_max = _p_link->maxRecvSize;
@@ -514,8 +1973,6 @@ write (const char *ac_data, int cnt_data)
     cnt_max = 1024;                     // Default to 1K if not valid
   
   int cnt_left = cnt_data;              // Number of bytes left to send
-
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
   
   // Loop sending data to the device, limited to the max allowed at a time
   do {
@@ -534,7 +1991,15 @@ write (const char *ac_data, int cnt_data)
     // Send data to device
     writeParms.data.data_val = (char *)(&ac_data[cnt_data - cnt_left]);
 
-    Device_WriteResp *p_writeResp = device_write_1 (&writeParms, _p_client);
+    Vxi11TraceSpan<S> traceSpan (this, _p_transport, writeParms.lid,
+                                 device_write, "device_write",
+                                 writeParms.data.data_len);
+    Vxi11RpcResult<Device_WriteResp, X, S> res (_p_transport);
+    Device_WriteResp *p_writeResp = res.call (device_write,
+                                              xdr_Device_WriteParms,
+                                              &writeParms);
+    traceSpan.end (0, (p_writeResp) ? int (p_writeResp->error) : -1);
+    _call_end (OP_WRITE, (p_writeResp) ? int (p_writeResp->error) : -1);
 
     if (p_writeResp == 0) {             // Error if device does not respond
       log_err ("Vxi11::write error: no RPC response for %s.\n",_s_device_addr);
@@ -564,6 +2029,125 @@ write (const char *ac_data, int cnt_data)
   return (0);
 }
 
+// ***************************************************************************
+// Vxi11::write_buffer - Enable/disable buffered writes
+//
+// Parameters:
+// 1. b_ena - true to buffer the commands of write() and printf()
+// 2. c_sep - Character joining the commands in one message
+//            ';'  = commands of one program message, the default
+//            '\n' = program messages in a row, for devices that do not
+//                   allow some commands after ';'
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Configuration sequences of many short commands then take one or
+//        two device_write calls instead of one each.  The buffer is sent
+//        by flush() before every other call to the device: read(),
+//        query(), readstb(), trigger(), clear(), remote(), local(), lock(),
+//        unlock(), enable_srq(), wait_for_srq(), the docmd_*() functions
+//        and close(), and by InstrumentGroup before its calls on the link.
+//        It is also sent when the next command would not fit in
+//        maxRecvSize.  Disabling, or changing c_sep, sends the buffer, with
+//        its error returned.  Only abort() does not wait for it.
+//
+//        A device reports errors of a buffered command only when the buffer
+//        is sent, and a command after an error in the same message may not
+//        be executed; use it for commands that are known to be valid.
+//
+//        The buffer works with every lock policy; Vxi11LockNone only skips
+//        its mutex.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+write_buffer (bool b_ena, char c_sep)
+{
+  if ((c_sep != ';') && (c_sep != '\n')) { // Check input parameters
+    log_err ("Vxi11::write_buffer error: invalid parameters for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11WriteBuf *p_write_buf = _p_write_buf;
+  if (L::B_ENA)                         // Vxi11LockNone has one thread
+    pthread_mutex_lock (&p_write_buf->mutex);
+  int err = 0;
+  if (!b_ena || (c_sep != p_write_buf->c_sep))
+    err = _write_flush ();
+  p_write_buf->c_sep = c_sep;
+  __atomic_store_n (&p_write_buf->b_ena, b_ena, __ATOMIC_RELEASE);
+  if (L::B_ENA)
+    pthread_mutex_unlock (&p_write_buf->mutex);
+
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11::write_buffer - Check if writes are buffered
+//
+// Parameters: None
+//
+// Returns: true if enabled by write_buffer()
+// ***************************************************************************
+  VXI11_TEMPLATE bool BASIC_VXI11::
+write_buffer (void)
+{
+  return (__atomic_load_n (&_p_write_buf->b_ena, __ATOMIC_ACQUIRE));
+}
+
+// ***************************************************************************
+// Vxi11::flush - Send the commands buffered by write_buffer()
+//                VXI-11 RPC is "device_write"
+//
+// Parameters: None
+//
+// Returns: 0 = no error, or no command buffered
+//          1 = error
+//
+// Notes: The buffer is emptied even on error, so a link that failed does
+//        not send the same commands again.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+flush (void)
+{
+  if (!__atomic_load_n (&_p_write_buf->cnt_cmd, __ATOMIC_ACQUIRE))
+    return (0);                         // Nothing buffered
+
+  Vxi11WriteBuf *p_write_buf = _p_write_buf;
+  if (L::B_ENA)                         // Vxi11LockNone has one thread
+    pthread_mutex_lock (&p_write_buf->mutex);
+  int err = _write_flush ();
+  if (L::B_ENA)
+    pthread_mutex_unlock (&p_write_buf->mutex);
+
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11::_write_flush - Private function to send the buffered commands
+//                       VXI-11 RPC is "device_write"
+//
+// Parameters: None
+//
+// Returns: 0 = no error, or no command buffered
+//          1 = error
+//
+// Notes: The mutex of the buffer must be locked, with Vxi11LockGlobal.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_write_flush (void)
+{
+  Vxi11WriteBuf *p_write_buf = _p_write_buf;
+  if (!p_write_buf->cnt_cmd)
+    return (0);
+
+  int err = _write (p_write_buf->s_buf.data (), p_write_buf->s_buf.size ());
+  p_write_buf->s_buf.clear ();          // Keeps the memory for the next ones
+  __atomic_store_n (&p_write_buf->cnt_cmd, 0, __ATOMIC_RELEASE);
+
+  return (err);
+}
+
 // ***************************************************************************
 // Vxi11::printf - Write data to the device using printf format
 //                 VXI-11 RPC is "device_write"
@@ -579,7 +2163,7 @@ write (const char *ac_data, int cnt_data)
 //        via a GPIB/LAN gateway, GPIB uses SEND command sequence, with EOI
 //        on last byte.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 printf (const char *s_format, ...)
 {
   if (!s_format) {                      // Check input parameters
@@ -589,22 +2173,41 @@ printf (const char *s_format, ...)
     }
 
   const int CNT_DATA_MAX = 65536;       // Max string to send
-  static char s_data[CNT_DATA_MAX];
+  char s_data_stack[256];               // Most strings fit on the stack; a
+                                        // per-call buffer keeps this
+                                        // function thread-safe
 
   va_list va;                           // Process input like printf() does
   va_start (va, s_format);
-  int cnt = vsnprintf (s_data, CNT_DATA_MAX, s_format, va);
+  int cnt = vsnprintf (s_data_stack, sizeof (s_data_stack), s_format, va);
   va_end (va);
-  s_data[CNT_DATA_MAX-1] = 0;           // Make sure it is terminated
   
   if ((cnt < 0) || (cnt>CNT_DATA_MAX)) {// Check for error
     log_err ("Vxi11::printf error: vsnprintf error, count = %d for %s.\n",
              cnt, _s_device_addr);
     return (1);
     }
+
+  // Format again into a heap buffer if the string is too long for the stack
+  char *s_data = s_data_stack;
+  if (cnt >= (int)sizeof (s_data_stack)) {
+    int cnt_alloc = (cnt < CNT_DATA_MAX) ? cnt + 1 : CNT_DATA_MAX;
+    s_data = (char *)malloc (cnt_alloc);
+    if (!s_data) {
+      log_err ("Vxi11::printf error: out of memory for %s.\n",
+               _s_device_addr);
+      return (1);
+      }
+    va_start (va, s_format);
+    vsnprintf (s_data, cnt_alloc, s_format, va);
+    va_end (va);
+    }
   
   // Send string to the device
   int err = write (s_data, strlen (s_data));
+
+  if (s_data != s_data_stack)
+    free (s_data);
   
   return (err);
 }
@@ -628,8 +2231,46 @@ printf (const char *s_format, ...)
 // Notes: If Vxi11 object is associated with a GPIB device or GPIB interface
 //        via a GPIB/LAN gateway, GPIB uses RECEIVE command sequence
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 read (char *ac_data, int cnt_data_max, int *pcnt_read)
+{
+  return (_read (ac_data, cnt_data_max, pcnt_read, 0, 0));
+}
+
+// ***************************************************************************
+// Vxi11::_read - Private function to read data from the device
+//                VXI-11 RPC is "device_read"
+//
+// Parameters:
+// 1. ac_data      - Store read data here
+// 2. cnt_data_max - Max length allocated in ac_data
+// 3. pcnt_read    - Returns actual number of bytes returned in ac_data, or
+//                   null
+// 4. pfn_grow     - Function to grow the buffer before the end of the
+//                   data, or null to return an error when full
+// 5. p_buf        - Buffer for pfn_grow
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: pfn_grow (p_buf, cnt_min, &cnt_data_max) returns the buffer grown
+//        to at least cnt_min bytes, with its new length in cnt_data_max and
+//        the data read so far kept, or null if it cannot grow.  See read()
+//        for the rest.
+//
+//        Each chunk is counted in read_stats(), and the largest chunk the
+//        device ended by itself is learned.  With pfn_grow, the buffer is
+//        grown before the next device_read so that requestSize covers the
+//        rest of an IEEE 488.2 definite length block, or at least that
+//        chunk size; the round trips are then the fewest the device allows,
+//        instead of extra ones cut short by a buffer that was too small.
+//        The size in the header is trusted only up to 16 maxRecvSize past
+//        the data read, at most 16 MB, and then up to twice the data read,
+//        so a wrong header costs memory only for the data sent.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_read (char *ac_data, int cnt_data_max, int *pcnt_read,
+       char *(*pfn_grow) (void *, long long, int *), void *p_buf)
 {
   int cnt_read_default;                 // Use local variable if user does not
   if (!pcnt_read)                       // specify pcnt_read parameter
@@ -643,6 +2284,9 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
     return (1);
     }
 
+  if (flush ())                         // Send the query if buffered
+    return (1);
+
   if (!ac_data || (cnt_data_max < 1)) { // Check input parameters
     log_err ("Vxi11::read error: invalid parameters for %s.\n",
              _s_device_addr);
@@ -652,10 +2296,10 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
   ac_data[0] = 0;                       // Null string for early return
   
   Device_ReadParms readParms;           // To send to device_read RPC
-  readParms.lid = _p_link->lid;         // Link ID from create_link RPC call
   readParms.requestSize = cnt_data_max; // Maximum # of bytes to read
-  readParms.io_timeout = _timeout_ms;	// Timeout for I/O in ms
-  readParms.lock_timeout = _timeout_ms;	// Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_READ); // Timeouts in ms
+  readParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  readParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
 
   // Use END signal to terminate the read
   // EOI line on GPIB, line feed (ASCII 10) data character on RS-232
@@ -671,8 +2315,25 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
     readParms.termChar = (char)_c_read_terminator;
     }
   
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::read error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::read error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  readParms.lid = _p_link->lid;         // Link ID, as _relink() left it
   
+  long long cnt_block = 0;              // Size of the definite length
+                                        // block read, 0 if not known
+
   // Iterate reads, since internal buffer in device_read RPC call may be less
   // than the maximum number of bytes requested
   do {
@@ -680,7 +2341,14 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
     readParms.requestSize = cnt_data_max - *pcnt_read;
 
     // Read from the device
-    Device_ReadResp *p_readResp = device_read_1 (&readParms, _p_client);
+    Vxi11TraceSpan<S> traceSpan (this, _p_transport, readParms.lid,
+                                 device_read, "device_read", 0);
+    Vxi11RpcResult<Device_ReadResp, X, S> res (_p_transport);
+    Device_ReadResp *p_readResp = res.call (device_read,
+                                            xdr_Device_ReadParms, &readParms);
+    traceSpan.end ((p_readResp) ? int (p_readResp->data.data_len) : 0,
+                   (p_readResp) ? int (p_readResp->error) : -1);
+    _call_end (OP_READ, (p_readResp) ? int (p_readResp->error) : -1);
 
     if (p_readResp == 0) {              // Check for error
       log_err ("Vxi11::read error: no RPC response for %s.\n", _s_device_addr);
@@ -734,12 +2402,59 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
     // Test each bit separately because the E5810A when using the RS-232 port
     // will turn on bit 2 whenever the line feed character is read, even if a
     // different termination character is specified.
-    if (((_c_read_terminator == -1) && (p_readResp->reason & 4)) ||
-        ((_c_read_terminator != -1) && (p_readResp->reason & 2)))
+    bool b_end = ((_c_read_terminator == -1) && (p_readResp->reason & 4)) ||
+                 ((_c_read_terminator != -1) && (p_readResp->reason & 2));
+
+    // Count the chunk for read_stats(), by what ended it
+    // reason bit 0 = requestSize reached; none = the device ended the chunk
+    _read_stats.cnt_chunk++;
+    _read_stats.cnt_byte += cnt_read;
+    if (b_end) {
+      _read_stats.cnt_end++;
+      _read_stats.cnt_read++;
       break;
+      }
+    else if (p_readResp->reason & 1)
+      _read_stats.cnt_reqcnt++;
+    else {
+      _read_stats.cnt_frag++;
+      if (cnt_read > _read_stats.chunk_device)
+        _read_stats.chunk_device = cnt_read;
+      }
+
+    // Grow the buffer so the next device_read asks for the rest of a
+    // definite length block, or else for at least the largest chunk the
+    // device returns, instead of being cut short by requestSize
+    if (pfn_grow) {
+      if (!cnt_block)
+        cnt_block = block_size (ac_data, *pcnt_read);
+      long long cnt_min = *pcnt_read + ((_read_stats.chunk_device > 0) ?
+                                        _read_stats.chunk_device : 1);
+      if (cnt_block > *pcnt_read) {     // Rest of the block in one chunk
+        long long cnt_ahead = (long long)_p_link->maxRecvSize *
+                              BLOCK_AHEAD_RECV;
+        if (cnt_ahead <= 0)             // Check for valid max value
+          cnt_ahead = 1024 * BLOCK_AHEAD_RECV;
+        if (cnt_ahead > CNT_BLOCK_AHEAD_MAX)
+          cnt_ahead = CNT_BLOCK_AHEAD_MAX;
+        if (cnt_ahead < *pcnt_read)     // Grow geometrically past that
+          cnt_ahead = *pcnt_read;
+        long long cnt_want = (cnt_block < *pcnt_read + cnt_ahead) ?
+                             cnt_block : *pcnt_read + cnt_ahead;
+        if (cnt_want > cnt_min)
+          cnt_min = cnt_want;
+        }
+      else if ((cnt_min > cnt_data_max) && (cnt_min < 2LL * cnt_data_max))
+        cnt_min = 2LL * cnt_data_max;   // Grow geometrically
+
+      char *ac_grow = (cnt_min > cnt_data_max) ?
+                      pfn_grow (p_buf, cnt_min, &cnt_data_max) : 0;
+      if (ac_grow)                      // Read on at the end of the data
+        ac_data = ac_grow;
+      }
 
     // If user buffer is full, return with error
-    else if (*pcnt_read == cnt_data_max) {
+    if (*pcnt_read == cnt_data_max) {
       log_err ("Vxi11::read error: read buffer full with %d bytes "
                "before reaching END indicator, %d last bytes read, "
                "termination reason 0x%x for %s.\n",
@@ -752,6 +2467,43 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
   return (0);
 }
 
+// ***************************************************************************
+// Vxi11::read_stats - Get the counters of the chunks read
+//
+// Parameters: None
+//
+// Returns: Counters since the link was opened or read_stats_reset()
+//
+// Notes: cnt_chunk / cnt_read is the number of device_read calls per
+//        response.  A gateway with small buffers shows cnt_frag chunks and
+//        its chunk size in chunk_device; cnt_reqcnt chunks were cut short by
+//        the buffer given to read().
+// ***************************************************************************
+  VXI11_TEMPLATE Vxi11ReadStats BASIC_VXI11::
+read_stats (void)
+{
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  return (_read_stats);
+}
+
+// ***************************************************************************
+// Vxi11::read_stats_reset - Clear the counters of the chunks read
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: The chunk size learned, chunk_device, is kept.
+// ***************************************************************************
+  VXI11_TEMPLATE void BASIC_VXI11::
+read_stats_reset (void)
+{
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  int chunk_device = _read_stats.chunk_device;
+  memset (&_read_stats, 0, sizeof (_read_stats));
+  _read_stats.chunk_device = chunk_device;
+}
+
 // ***************************************************************************
 // Vxi11::query - Send query for a double from the device
 //                Convenience function combines write() and read()
@@ -763,7 +2515,7 @@ read (char *ac_data, int cnt_data_max, int *pcnt_read)
 // Returns: 0 = no error
 //          1 = error
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 query (const char *s_query, double *pd_val)
 {
   int CNT_READ_MAX = 256;               // Assume 256 characters is enough
@@ -797,7 +2549,7 @@ query (const char *s_query, double *pd_val)
 // Returns: 0 = no error
 //          1 = error
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 query (const char *s_query, int *pi_val)
 {
   int CNT_READ_MAX = 256;               // Assume 256 characters is enough
@@ -832,7 +2584,7 @@ query (const char *s_query, int *pi_val)
 // Returns: 0 = no error
 //          1 = error
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 query (const char *s_query, char *s_val, int len_val_max)
 {
   // Send query
@@ -848,6 +2600,170 @@ query (const char *s_query, char *s_val, int len_val_max)
   return (err);
 }
 
+// ***************************************************************************
+// Vxi11::query - Send query for a string of any length from the device
+//                Convenience function combines write() and read()
+//
+// Parameters:
+// 1. s_query - Query string to send to device
+// 2. s_val   - Stores the string read from device here, without a null
+//              terminator in its size
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: s_val is reserved with the size of the longest response to s_query
+//        on this link, so a string used again for the same query is not
+//        reallocated.  It grows by doubling for a longer response.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+query (const char *s_query, std::string &s_val)
+{
+  if (!s_query) {                       // Check input parameters
+    log_err ("Vxi11::query error: invalid parameters for %s.\n",
+             _s_device_addr);
+    s_val.clear ();
+    return (1);
+    }
+
+  // Send query
+  if (write (s_query, strlen (s_query))) {
+    s_val.clear ();
+    return (1);
+    }
+
+  // Read response
+  return (_read_buf (s_val, s_query));
+}
+
+// ***************************************************************************
+// Vxi11::read - Read data of any length from the device
+//               VXI-11 RPC is "device_read"
+//
+// Parameters:
+// 1. s_data - Stores the data read here, without a null terminator in its
+//             size
+//
+// Returns: 0 = no error
+//          1 = error, with the data read before it
+//
+// Notes: s_data is reserved with the size of the longest response read
+//        this way on this link, at least 256 bytes, and doubles whenever
+//        it is full before the end of the data.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+read (std::string &s_data)
+{
+  return (_read_buf (s_data, 0));
+}
+
+// ***************************************************************************
+// Vxi11::read - Read data of any length from the device
+//               VXI-11 RPC is "device_read"
+//
+// Parameters:
+// 1. a_data - Stores the data read here
+//
+// Returns: 0 = no error
+//          1 = error, with the data read before it
+//
+// Notes: As read() to a std::string.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+read (std::vector<char> &a_data)
+{
+  return (_read_buf (a_data, 0));
+}
+
+// ***************************************************************************
+// read_grow - Grow a std::string or std::vector<char>, for _read()
+//
+// Parameters:
+// 1. p_buf         - Buffer, of type B
+// 2. cnt_min       - Size needed
+// 3. pcnt_data_max - Returns the new size
+//
+// Returns: Data of the buffer, null if it cannot grow
+// ***************************************************************************
+template <class B> static char *
+read_grow (void *p_buf, long long cnt_min, int *pcnt_data_max)
+{
+  B &buf = *(B *)p_buf;
+  if (cnt_min > 0x7fffffffLL)           // Size must fit in an int
+    return (0);
+
+  buf.resize (size_t (cnt_min));
+  if (buf.capacity () <= 0x7fffffffUL) // Room the allocation has anyway
+    buf.resize (buf.capacity ());
+  *pcnt_data_max = int (buf.size ());
+  return (&buf[0]);
+}
+
+// ***************************************************************************
+// Vxi11::_read_buf - Private function to read data of any length to a
+//                    std::string or std::vector<char>
+//
+// Parameters:
+// 1. buf     - Buffer to store the data to
+// 2. s_query - Query the data is the response to, or null if not known
+//
+// Returns: 0 = no error
+//          1 = error, with the data read before it
+//
+// Notes: The buffer is reserved with the longest response to s_query so
+//        far, or of read() if null, and the size read is learned after.
+// ***************************************************************************
+  VXI11_TEMPLATE template <class B> int BASIC_VXI11::
+_read_buf (B &buf, const char *s_query)
+{
+  // Size learned for this query
+  int cnt_hint = 0;
+  pthread_mutex_lock (&_p_read_hint->mutex);
+  if (!s_query)
+    cnt_hint = _p_read_hint->cnt_read;
+  else {
+    std::map<std::string, int>::iterator it =
+      _p_read_hint->map_query.find (s_query);
+    if (it != _p_read_hint->map_query.end ())
+      cnt_hint = it->second;
+    }
+  pthread_mutex_unlock (&_p_read_hint->mutex);
+
+  // Reserve it once, plus the null terminator that read() may store
+  if (cnt_hint < CNT_READ_BUF_MIN)
+    cnt_hint = CNT_READ_BUF_MIN;
+  if (buf.capacity () < size_t (cnt_hint) + 1)
+    buf.reserve (cnt_hint + 1);
+  buf.resize (buf.capacity ());
+
+  int cnt_read = 0;
+  int err = _read (&buf[0], int (buf.size ()), &cnt_read, &read_grow<B>,
+                   &buf);
+  buf.resize (cnt_read);
+  if (err)
+    return (1);
+
+  // Learn the size; a new query is only added while the table has room
+  pthread_mutex_lock (&_p_read_hint->mutex);
+  if (!s_query) {
+    if (cnt_read > _p_read_hint->cnt_read)
+      _p_read_hint->cnt_read = cnt_read;
+    }
+  else {
+    std::map<std::string, int> &map_query = _p_read_hint->map_query;
+    std::map<std::string, int>::iterator it = map_query.find (s_query);
+    if (it != map_query.end ()) {
+      if (cnt_read > it->second)
+        it->second = cnt_read;
+      }
+    else if (map_query.size () < CNT_READ_HINT_MAX)
+      map_query[s_query] = cnt_read;
+    }
+  pthread_mutex_unlock (&_p_read_hint->mutex);
+
+  return (0);
+}
+
 // ***************************************************************************
 // Vxi11::readstb - Read status byte from the device (serial poll)
 //                  VXI-11 RPC is "device_readstb"
@@ -865,8 +2781,14 @@ query (const char *s_query, char *s_val, int len_val_max)
 //        
 //        If Vxi11 object is associated with a GPIB interface (the GPIB/LAN
 //        gateway itself), this function will return an error.
+//
+//        Threads calling readstb() on the same object while a
+//        device_readstb is in progress wait for it and return its status
+//        byte, instead of each making a call.  A serial poll clears the RQS
+//        bit, so they all see it.  If readstb_max_age() is set, the status
+//        byte of a call started that recently is returned without a call.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 readstb (void)
 {
   // Early return if object did not make connection to instrument
@@ -875,16 +2797,130 @@ readstb (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (-1);
+
+  return (_readstb (true));
+}
+
+// ***************************************************************************
+// Vxi11::_readstb - Private function to read the status byte with one
+//                   device_readstb shared by the threads calling at the
+//                   same time
+//
+// Parameters:
+// 1. b_reuse - True to return the result of a call already in progress, or
+//              of a call within readstb_max_age()
+//              False to return the result of a call started after this
+//              function was called, as wait_for_srq() needs after an SRQ
+//
+// Returns: 8-bit status byte if no error
+//          -1 if error
+//
+// Notes: With Vxi11LockNone, the object is used by one thread, so nothing
+//        is shared or locked.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_readstb (bool b_reuse)
+{
+  Vxi11StbShare *p_stb = _p_stb;
+  double d_max_age = (b_reuse) ? _d_stb_max_age : 0;
+
+  if (!L::B_ENA) {
+    long long t_ns = Vxi11Tracer::time_ns ();
+    if ((d_max_age > 0) && p_stb->t_ns &&
+        (t_ns - p_stb->t_ns <= (long long)(d_max_age * 1e9)))
+      return (p_stb->stb);
+    p_stb->stb = _readstb_rpc ();
+    p_stb->t_ns = (p_stb->stb >= 0) ? t_ns : 0;
+    return (p_stb->stb);
+    }
+
+  pthread_mutex_lock (&p_stb->mutex);
+  if ((d_max_age > 0) && p_stb->t_ns &&
+      (Vxi11Tracer::time_ns () - p_stb->t_ns <=
+       (long long)(d_max_age * 1e9))) {
+    int stb = p_stb->stb;
+    pthread_mutex_unlock (&p_stb->mutex);
+    return (stb);
+    }
+
+  // Wait for the call in progress and return its result, or if it must be
+  // a newer one, wait for the call after it
+  bool b_join = b_reuse;
+  while (p_stb->b_call) {
+    unsigned long cnt_call = p_stb->cnt_call;
+    while (p_stb->cnt_call == cnt_call)
+      pthread_cond_wait (&p_stb->cond, &p_stb->mutex);
+    if (b_join) {
+      int stb = p_stb->stb;
+      pthread_mutex_unlock (&p_stb->mutex);
+      return (stb);
+      }
+    b_join = true;                      // Next call starts after this call
+    }
+
+  // Make the call for everyone
+  p_stb->b_call = true;
+  pthread_mutex_unlock (&p_stb->mutex);
+  long long t_ns = Vxi11Tracer::time_ns ();
+  int stb = _readstb_rpc ();
+
+  pthread_mutex_lock (&p_stb->mutex);
+  p_stb->stb = stb;
+  p_stb->t_ns = (stb >= 0) ? t_ns : 0;
+  p_stb->b_call = false;
+  p_stb->cnt_call++;
+  pthread_cond_broadcast (&p_stb->cond);
+  pthread_mutex_unlock (&p_stb->mutex);
+  return (stb);
+}
+
+// ***************************************************************************
+// Vxi11::_readstb_rpc - Private function to read the status byte from the
+//                       device
+//                       VXI-11 RPC is "device_readstb"
+//
+// Parameters: None
+//
+// Returns: 8-bit status byte if no error
+//          -1 if error
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_readstb_rpc (void)
+{
   Device_GenericParms genericParms;        // To send to device_readstb RPC
-  genericParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  genericParms.io_timeout = _timeout_ms;   // Timeout for I/O in ms
-  genericParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_READSTB); // Timeouts in ms
+  genericParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  genericParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   genericParms.flags = 0;                  // Not used
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::readstb error: circuit open for %s.\n", _s_device_addr);
+    return (-1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::readstb error: cancelled for %s.\n", _s_device_addr);
+    return (-1);
+    }
+  genericParms.lid = _p_link->lid;      // Link ID, as _relink() left it
   
   // Read status byte
-  Device_ReadStbResp *p_readStbResp=device_readstb_1 (&genericParms,_p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, genericParms.lid,
+                               device_readstb, "device_readstb", 0);
+  Vxi11RpcResult<Device_ReadStbResp, X, S> res (_p_transport);
+  Device_ReadStbResp *p_readStbResp = res.call (device_readstb,
+                                                xdr_Device_GenericParms,
+                                                &genericParms);
+  traceSpan.end ((p_readStbResp) ? 1 : 0,
+                 (p_readStbResp) ? int (p_readStbResp->error) : -1);
+  _call_end (OP_READSTB, (p_readStbResp) ? int (p_readStbResp->error) : -1);
 
   if (!p_readStbResp) {
     log_err ("Vxi11::readstb error: no RPC response for %s.\n",_s_device_addr);
@@ -932,7 +2968,7 @@ readstb (void)
 //        Use the doccmd_send_command() function to send the raw GPIB commands
 //        to address the set of devices prior to calling trigger().
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 trigger (void)
 {
   // Early return if object did not make connection to instrument
@@ -941,16 +2977,39 @@ trigger (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_GenericParms genericParms;        // To send to device_trigger RPC
-  genericParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  genericParms.io_timeout = _timeout_ms;   // Timeout for I/O in ms
-  genericParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_TRIGGER); // Timeouts in ms
+  genericParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  genericParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   genericParms.flags = 0;                  // Not used
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::trigger error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::trigger error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  genericParms.lid = _p_link->lid;      // Link ID, as _relink() left it
 
   // Send trigger command
-  Device_Error *p_error = device_trigger_1 (&genericParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, genericParms.lid,
+                               device_trigger, "device_trigger", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_trigger,
+                                    xdr_Device_GenericParms, &genericParms);
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_TRIGGER, (p_error) ? int (p_error->error) : -1);
 
   if (!p_error) {
     log_err ("Vxi11::trigger error: no RPC response for %s.\n",_s_device_addr);
@@ -994,7 +3053,7 @@ trigger (void)
 //        gateway itself), GPIB command is DCL (device clear, ATN code 20),
 //        and resets all devices
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 clear (void)
 {
   // Early return if object did not make connection to instrument
@@ -1003,16 +3062,39 @@ clear (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_GenericParms genericParms;        // To send to device_clear RPC
-  genericParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  genericParms.io_timeout = _timeout_ms;   // Timeout for I/O in ms
-  genericParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CLEAR); // Timeouts in ms
+  genericParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  genericParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   genericParms.flags = 0;                  // Not used
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::clear error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::clear error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  genericParms.lid = _p_link->lid;      // Link ID, as _relink() left it
 
   // Send clear command
-  Device_Error *p_error = device_clear_1 (&genericParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, genericParms.lid,
+                               device_clear, "device_clear", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_clear,
+                                    xdr_Device_GenericParms, &genericParms);
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_CLEAR, (p_error) ? int (p_error->error) : -1);
 
   if (!p_error) {
     log_err ("Vxi11::clear error: no RPC response for %s.\n", _s_device_addr);
@@ -1057,7 +3139,7 @@ clear (void)
 //        If Vxi11 object is associated with a GPIB interface (the GPIB/LAN
 //        gateway itself), this function will return an error.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 remote (void)
 {
   // Early return if object did not make connection to instrument
@@ -1066,16 +3148,39 @@ remote (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_GenericParms genericParms;        // To send to device_remote RPC
-  genericParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  genericParms.io_timeout = _timeout_ms;   // Timeout for I/O in ms
-  genericParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  genericParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  genericParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   genericParms.flags = 0;                  // Not used
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::remote error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::remote error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  genericParms.lid = _p_link->lid;      // Link ID, as _relink() left it
 
   // Send remote command
-  Device_Error *p_error = device_remote_1 (&genericParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, genericParms.lid,
+                               device_remote, "device_remote", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_remote,
+                                    xdr_Device_GenericParms, &genericParms);
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_CONTROL, (p_error) ? int (p_error->error) : -1);
 
   if (!p_error) {
     log_err ("Vxi11::remote error: no RPC response for %s.\n", _s_device_addr);
@@ -1121,7 +3226,7 @@ remote (void)
 //        is not supported, or it may deactivate the REN line, depending on
 //        the GPIB/LAN interface capability.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 local (void)
 {
   // Early return if object did not make connection to instrument
@@ -1130,16 +3235,39 @@ local (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_GenericParms genericParms;        // To send to device_local RPC
-  genericParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  genericParms.io_timeout = _timeout_ms;   // Timeout for I/O in ms
-  genericParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  genericParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  genericParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   genericParms.flags = 0;                  // Not used
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::local error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::local error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  genericParms.lid = _p_link->lid;      // Link ID, as _relink() left it
 
   // Send local command
-  Device_Error *p_error = device_local_1 (&genericParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, genericParms.lid,
+                               device_local, "device_local", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_local,
+                                    xdr_Device_GenericParms, &genericParms);
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_CONTROL, (p_error) ? int (p_error->error) : -1);
 
   if (!p_error) {
     log_err ("Vxi11::local error: no RPC response for %s.\n", _s_device_addr);
@@ -1175,7 +3303,7 @@ local (void)
 // Returns: 0 = no error
 //          1 = error
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 lock (void)
 {
   // Early return if object did not make connection to instrument
@@ -1184,15 +3312,38 @@ lock (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_LockParms lockParms;           // To send to device_lock RPC
-  lockParms.lid = _p_link->lid;         // Link ID from create_link RPC call
-  lockParms.lock_timeout = _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_LOCK); // Timeouts in ms
+  lockParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   lockParms.flags = 1;                  // Wait for lock
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::lock error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::lock error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+  lockParms.lid = _p_link->lid;         // Link ID, as _relink() left it
 
   // Send lock command
-  Device_Error *p_error = device_lock_1 (&lockParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, lockParms.lid, device_lock,
+                               "device_lock", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_lock,
+                                    xdr_Device_LockParms, &lockParms);
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_LOCK, (p_error) ? int (p_error->error) : -1);
 
   if (!p_error) {
     log_err ("Vxi11::lock error: no RPC response for %s.\n", _s_device_addr);
@@ -1213,119 +3364,628 @@ lock (void)
     return (1);
     }
 
-  return (0);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::unlock - Release lock acquired by previous call to Vxi11::lock
+//                 VXI-11 RPC is "device_unlock"
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+unlock (void)
+{
+  // Early return if object did not make connection to instrument
+  if (!_b_valid) {
+    log_err ("Vxi11::unlock error: no connection to device.\n");
+    return (1);
+    }
+
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
+  Vxi11Timeout timeoutCall = timeout_call (OP_LOCK); // Timeouts in ms
+
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::unlock error: circuit open for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::unlock error: cancelled for %s.\n", _s_device_addr);
+    return (1);
+    }
+
+  // Send unlock command
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, _p_link->lid,
+                               device_unlock, "device_unlock", 0);
+  Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+  Device_Error *p_error = res.call (device_unlock,
+                                    xdr_Device_Link, &(_p_link->lid));
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  _call_end (OP_LOCK, (p_error) ? int (p_error->error) : -1);
+
+  if (!p_error) {
+    log_err ("Vxi11::unlock error: no RPC response for %s.\n", _s_device_addr);
+    return (1);
+    }
+  
+  // Possible errors
+  //  0 = no error
+  //  4 = invalid link identifier
+  // 12 = no lock held by this link
+  int err_code = int (p_error->error);
+  if (err_code) {
+    int idx_err_desc = ((err_code >= 0) && (err_code < CNT_ERR_DESC_MAX)) ?
+                       err_code : 0;
+    log_err ("Vxi11::unlock error: %d %s for %s.\n",
+             err_code, _as_err_desc[idx_err_desc], _s_device_addr);
+    return (1);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::abort - Abort an in-progress VXI-11 RPC
+//                VXI-11 RPC is "device_abort"
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: This is normally called from a separate thread from which the RPC
+//        that is being aborted is called.  The purpose of the abort is to
+//        end an existing RPC before its timeout expires.
+//
+//        This function does not work on the Agilent E5810A LAN/GPIB gateway
+//        for unknown reasons.  The clnttcp_create() works, but the
+//        device_abort_1() RPC call times out.
+//
+//        HiSLIP and raw socket devices have no abort channel, so an error
+//        is returned.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+abort (void)
+{
+  return ((_abort (25000)) ? 1 : 0);    // As the rpcgen stub
+}
+
+// ***************************************************************************
+// Vxi11::_abort - Private function to abort an in-progress VXI-11 RPC
+//                 VXI-11 RPC is "device_abort"
+//
+// Parameters:
+// 1. timeout_ms - Time to wait for the reply, in ms
+//
+// Returns:  0 = no error
+//           1 = error
+//          -1 = no reply from the device
+//
+// Notes: See abort().
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_abort (int timeout_ms)
+{
+  // Early return if object did not make connection to instrument
+  if (!_b_valid) {
+    log_err ("Vxi11::abort error: no connection to device.\n");
+    return (1);
+    }
+
+  // HiSLIP and raw socket links have no abort channel, and it may not have
+  // been created by open()
+  pthread_mutex_lock (&_mutex_abort);   // close() waits for the abort
+  if (!_p_client_abort) {
+    pthread_mutex_unlock (&_mutex_abort);
+    log_err ("Vxi11::abort error: no abort channel for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  // Send abort command
+  // FIXME - times out on Agilent E5810A
+  Device_Link lid = _p_link->lid;       // Not freed before the abort client
+  Vxi11TraceSpan<S> traceSpan (this, _p_client_abort, lid,
+                               device_abort, "device_abort", 0);
+  Device_Error error;                   // Results of this call only
+  memset (&error, 0, sizeof (error));
+  timeval tv_timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  Device_Error *p_error = (clnt_call (_p_client_abort, device_abort,
+                                      (xdrproc_t)xdr_Device_Link,
+                                      (char *)&lid,
+                                      (xdrproc_t)xdr_Device_Error,
+                                      (char *)&error, tv_timeout) ==
+                           RPC_SUCCESS) ? &error : 0;
+  traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
+  pthread_mutex_unlock (&_mutex_abort);
+
+  if (!p_error) {
+    log_err ("Vxi11::abort error: no RPC response for %s.\n", _s_device_addr);
+    return (-1);
+    }
+  
+  // Possible errors
+  //  0 = no error
+  //  4 = invalid link identifier
+  int err_code = int (p_error->error);
+  if (err_code) {
+    int idx_err_desc = ((err_code >= 0) && (err_code < CNT_ERR_DESC_MAX)) ?
+                       err_code : 0;
+    log_err ("Vxi11::abort error: %d %s for %s.\n",
+             err_code, _as_err_desc[idx_err_desc], _s_device_addr);
+    return (1);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::_open_abort - Private function to create the RPC client of the
+//                      abort channel
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: The link must be open, with an abort channel.  Called by open(),
+//        so abort() never creates it while a call is in progress.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_open_abort (void)
+{
+  pthread_mutex_lock (&_mutex_abort);   // Not while aborting or closing
+  int err = _open_abort_locked ();
+  pthread_mutex_unlock (&_mutex_abort);
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11::_open_abort_locked - Private function to create the RPC client of
+//                             the abort channel, with _mutex_abort locked
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_open_abort_locked (void)
+{
+  // Replay the abort channel if replaying a session
+  if (!_p_client_abort && __p_replay)
+    __p_client_abort = ((Vxi11ReplayFile *)__p_replay)->client (
+                         DEVICE_ASYNC, _b_replay_realtime);
+
+  // Create abort channel if it was not already created
+  if (!_p_client_abort) {
+    sockaddr_in sockaddr = {0};
+    sockaddr.sin_family = AF_INET;
+    sockaddr.sin_port = htons (_p_link->abortPort);
+    sockaddr.sin_addr.s_addr = _ui_device_ip_addr;
+    int sock = RPC_ANYSOCK;
+  
+    __p_client_abort = clnttcp_create (&sockaddr, DEVICE_ASYNC,
+                                       DEVICE_ASYNC_VERSION, &sock, 0, 0);
+  
+    if (!_p_client_abort) {               // Exit early if error
+      const char *s_err = "Vxi11::abort error: abort channel client creation";
+      clnt_pcreateerror ((char *)s_err);  // Print error message
+      return (1);
+      }
+
+    // Record the abort channel with the core channel
+    if (__p_record)
+      __p_client_abort = ((Vxi11RecordFile *)__p_record)->client (
+                           _p_client_abort, DEVICE_ASYNC);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::_abort_call - Private static function to abort the call in progress
+//                      of an object, for Vxi11CancelCall
+//
+// Parameters:
+// 1. p_vxi11 - Object of this BasicVxi11 type
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Called on a thread of its own for each call, with a short RPC
+//        timeout.  If the device does not reply, the transport of the core
+//        channel is shut down, so the call returns an error at once instead
+//        of at its RPC timeout; the link must then be opened again.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_abort_call (Vxi11Common *p_vxi11)
+{
+  BASIC_VXI11 *p_this = (BASIC_VXI11 *)p_vxi11;
+  int err = p_this->_abort (ABORT_CALL_MS);
+  if ((err < 0) && p_this->transport ()) {
+    log_err ("Vxi11::abort error: shutting down the core channel of %s.\n",
+             p_this->device_addr ());
+    p_this->transport ()->cancel ();
+    }
+
+  return ((err) ? 1 : 0);
+}
+
+// ***************************************************************************
+// Vxi11::cancel_token - Set the token that aborts the calls of this object
+//
+// Parameters:
+// 1. p_cancel - Token, or null for none
+//
+// Returns: 0 = no error
+//          1 = error, the lock policy is Vxi11LockNone
+//
+// Notes: When Vxi11Cancel::cancel() is called, or the deadline of the token
+//        passes, the call in progress is aborted with device_abort and
+//        returns an error, and the following calls return an error without
+//        calling the device, until Vxi11Cancel::reset().  The link stays
+//        open.  The abort channel is created by open(), so no connection is
+//        made when the call is aborted.
+//
+//        Must not be changed while a call is in progress.  The token must
+//        not be deleted while set.  Needs a lock policy, since the call is
+//        aborted from another thread.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+cancel_token (Vxi11Cancel *p_cancel)
+{
+  if (!L::B_ENA && p_cancel) {
+    log_err ("Vxi11::cancel_token error: no lock policy for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  _p_cancel = p_cancel;
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::call_deadline - Set the longest time of each call
+//
+// Parameters:
+// 1. d_time - Time in seconds, < 0 for no limit
+//
+// Returns: 0 = no error
+//          1 = error, the lock policy is Vxi11LockNone
+//
+// Notes: A call of this object running longer is aborted with
+//        device_abort, and returns an error, as with cancel_token().  Unlike
+//        timeout(), this also ends a call the device does not time out
+//        itself.  Needs a lock policy, as cancel_token().
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+call_deadline (double d_time)
+{
+  if (!L::B_ENA && (d_time >= 0)) {
+    log_err ("Vxi11::call_deadline error: no lock policy for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  _d_call_deadline = d_time;
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::breaker - Set the circuit breaker of the link
+//
+// Parameters:
+// 1. cnt_fail        - Calls in a row without reply that open the breaker,
+//                      0 for no breaker
+// 2. d_probe         - Time between two pings of the device while open, in
+//                      seconds
+// 3. d_probe_timeout - RPC timeout of a ping, in seconds
+//
+// Returns: 0 = no error
+//          1 = error, the lock policy is Vxi11LockNone
+//
+// Notes: While the breaker is open, the calls of the link fail right away
+//        instead of each waiting for its RPC timeout, so the threads using
+//        the other links are not held up by the RPC mutex.  A probe thread
+//        pings the device with the null procedure of the abort channel,
+//        without the RPC mutex (of the core channel, with the RPC mutex,
+//        for HiSLIP and raw socket links), and the breaker closes when it
+//        is replied to.  If the ping is not replied to, or the core channel
+//        is broken, the probe creates the link again, so a device that
+//        restarted is used again once it answers; see _relink().  close()
+//        does not call destroy_link while open.
+//
+//        Must not be changed while a call is in progress.  Needs a lock
+//        policy, since the probe thread uses the link.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+breaker (int cnt_fail, double d_probe, double d_probe_timeout)
+{
+  delete _p_breaker;                    // Waits for a probe in progress
+  _p_breaker = 0;
+
+  if (cnt_fail <= 0)
+    return (0);
+
+  if (!L::B_ENA) {
+    log_err ("Vxi11::breaker error: no lock policy for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  _p_breaker = new Vxi11Breaker (this, &_probe_call, cnt_fail, d_probe,
+                                 int (d_probe_timeout * 1000 + 0.5));
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::_probe_call - Private static function to ping the device of an
+//                      object, for Vxi11Breaker
+//
+// Parameters:
+// 1. p_vxi11    - Object of this BasicVxi11 type
+// 2. timeout_ms - RPC timeout of the ping, in ms
+//
+// Returns: 0 = the device replied
+//          1 = no reply, or the link is not open
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_probe_call (Vxi11Common *p_vxi11, int timeout_ms)
+{
+  return (((BASIC_VXI11 *)p_vxi11)->_probe (timeout_ms));
+}
+
+// ***************************************************************************
+// Vxi11::_probe - Private function to ping the device, re-creating the link
+//                 if it does not reply
+//
+// Parameters:
+// 1. timeout_ms - RPC timeout of the ping, in ms
+//
+// Returns: 0 = the device replied, on the link or on a new one
+//          1 = no reply, or the link is not open
+//
+// Notes: Calls the null procedure, which does nothing on the device, on the
+//        abort channel, so the RPC mutex is not held while waiting for the
+//        reply.  Links without an abort channel (HiSLIP and raw socket) are
+//        pinged on the core channel, with the RPC mutex locked; the RPC
+//        timeout of the next call is set again by that call.
+//
+//        If the ping is not replied to, or the core channel was shut down
+//        by the device or by a cancelled call, the device may have
+//        restarted and forgotten the link, so the link is created again
+//        with _relink().
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+_probe (int timeout_ms)
+{
+  if (!_b_valid || !__p_transport)
+    return (1);
+
+  // A core channel that was shut down cannot be used again
+  int sock = _p_transport->fd ();
+  pollfd pollFd = {sock, POLLRDHUP, 0};
+  bool b_broken = (sock >= 0) && (poll (&pollFd, 1, 0) == 1) &&
+                  (pollFd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+
+  if (!b_broken) {
+    enum clnt_stat stat = RPC_FAILED;   // Result of the ping
+    bool b_abort = false;               // Pinged on the abort channel
+
+    pthread_mutex_lock (&_mutex_abort); // Not while closing
+    if (_p_client_abort) {
+      b_abort = true;
+      Vxi11TraceSpan<S> traceSpan (this, _p_client_abort, _p_link->lid,
+                                   NULLPROC, "nullproc", 0);
+      timeval tv_timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+      stat = clnt_call (_p_client_abort, NULLPROC, (xdrproc_t)xdr_void, 0,
+                        (xdrproc_t)xdr_void, 0, tv_timeout);
+      traceSpan.end (0, (stat == RPC_SUCCESS) ? 0 : -1);
+      }
+    pthread_mutex_unlock (&_mutex_abort);
+
+    if (!b_abort) {
+      Vxi11Mutex<L> vxi11Mutex;         // Lock access until the reply
+      _timeout_rpc (timeout_ms);
+      Vxi11TraceSpan<S> traceSpan (this, _p_transport, _p_link->lid,
+                                   NULLPROC, "nullproc", 0);
+      stat = _p_transport->call_uncounted (NULLPROC, (xdrproc_t)xdr_void, 0,
+                                           (xdrproc_t)xdr_void, 0);
+      traceSpan.end (0, (stat == RPC_SUCCESS) ? 0 : -1);
+      }
+
+    if (stat == RPC_SUCCESS)
+      return (0);
+    }
+
+  return (_relink (timeout_ms));
 }
 
 // ***************************************************************************
-// Vxi11::unlock - Release lock acquired by previous call to Vxi11::lock
-//                 VXI-11 RPC is "device_unlock"
+// Vxi11::_relink - Private function to re-create the transport and link of
+//                  a device that restarted or whose core channel is broken
+//                  VXI-11 RPC is "create_link"
 //
-// Parameters: None
+// Parameters:
+// 1. timeout_ms - Longest wait for each of the portmapper, the connection
+//                 and create_link, in ms
 //
-// Returns: 0 = no error
-//          1 = error
+// Returns: 0 = the link was created again
+//          1 = error, the link is not changed
+//
+// Notes: Only done for VXI-11 links over the built-in transport that are
+//        not recorded or replayed.  The new link is made without the RPC
+//        mutex, which is only locked to swap it in.  The device destroys
+//        the links of the old connection when it is closed.
+//
+//        Device locks and the SRQ channel of the old link are lost; lock()
+//        and enable_srq() must be called again.  The transport stats start
+//        again from 0.
 // ***************************************************************************
-  int Vxi11::
-unlock (void)
+  VXI11_TEMPLATE int BASIC_VXI11::
+_relink (int timeout_ms)
 {
-  // Early return if object did not make connection to instrument
-  if (!_b_valid) {
-    log_err ("Vxi11::unlock error: no connection to device.\n");
+  if (_port_relink < 0)                 // Transport cannot be created here
     return (1);
-    }
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
-
-  // Send unlock command
-  Device_Error *p_error = device_unlock_1 (&(_p_link->lid), _p_client);
+  // Connect to the core channel, with the portmapper if open() did
+  int port = (_port_relink) ? _port_relink :
+             pmap_port (_ui_device_ip_addr, timeout_ms);
+  int sock = (port) ? connect_timeout (_ui_device_ip_addr, port, timeout_ms) :
+             -1;
+  if (sock < 0)                         // Exit early if not reachable
+    return (1);
 
-  if (!p_error) {
-    log_err ("Vxi11::unlock error: no RPC response for %s.\n", _s_device_addr);
+  sockaddr_in sockaddr = {0};
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons (port);
+  sockaddr.sin_addr.s_addr = _ui_device_ip_addr;
+  CLIENT *p_client = clnttcp_create (&sockaddr, DEVICE_CORE,
+                                     DEVICE_CORE_VERSION, &sock, 0, 0);
+  if (!p_client) {                      // Exit early if error
+    ::close (sock);
     return (1);
     }
-  
-  // Possible errors
-  //  0 = no error
-  //  4 = invalid link identifier
-  // 12 = no lock held by this link
-  int err_code = int (p_error->error);
-  if (err_code) {
-    int idx_err_desc = ((err_code >= 0) && (err_code < CNT_ERR_DESC_MAX)) ?
-                       err_code : 0;
-    log_err ("Vxi11::unlock error: %d %s for %s.\n",
-             err_code, _as_err_desc[idx_err_desc], _s_device_addr);
+  clnt_control (p_client, CLSET_FD_CLOSE, 0); // Closed with the client
+
+  X *p_transport = new Vxi11TransportRpc (p_client);
+  p_transport->open (0, 0);             // Only reads the socket
+  p_transport->timeout (timeout_ms);
+
+  // Create a link to the device name of open()
+  Create_LinkParms linkParms;
+  linkParms.clientId = (long)p_transport; // RPC client ID
+  linkParms.lockDevice = 0;             // Do not lock device
+  linkParms.lock_timeout = 0;           // Timeout in ms
+  linkParms.device = strrchr (_s_device_addr, ':') + 1; // Device name
+
+  Create_LinkResp link;                 // New link, if created
+  bool b_link = false;
+  {
+    Vxi11TraceSpan<S> traceSpan (this, p_transport, -1, create_link,
+                                 "create_link", strlen (linkParms.device));
+    Vxi11RpcResult<Create_LinkResp, X, S> res (p_transport);
+    Create_LinkResp *p_link = res.call (create_link,
+                                        xdr_Create_LinkParms, &linkParms);
+    traceSpan.end (0, (p_link) ? int (p_link->error) : -1);
+    if (p_link && !p_link->error) {
+      link = *p_link;
+      b_link = true;
+      }
+  }
+
+  if (!b_link) {                        // Exit early if error
+    delete p_transport;
     return (1);
     }
 
+  // Swap in the new transport and link after the call in progress, and
+  // close the abort channel of the old link
+  {
+    Vxi11Mutex<L> vxi11Mutex;           // Lock access until swapped
+    pthread_mutex_lock (&_mutex_abort); // Not during an abort
+    if (_p_client_abort) {
+      clnt_destroy (_p_client_abort);
+      __p_client_abort = 0;
+      }
+    X *p_transport_old = _p_transport;
+    __p_transport = p_transport;
+    *_p_link = link;
+    _rpc_timeout_ms = timeout_ms;
+    pthread_mutex_unlock (&_mutex_abort);
+    delete p_transport_old;
+  }
+
+  if (_p_link->abortPort)
+    _open_abort ();
+
   return (0);
 }
 
 // ***************************************************************************
-// Vxi11::abort - Abort an in-progress VXI-11 RPC
-//                VXI-11 RPC is "device_abort"
+// Vxi11::wait_for_srq - Wait for the device to request service
+//                       VXI-11 RPC is "device_readstb"
 //
-// Parameters: None
+// Parameters:
+// 1. mask      - Status byte bits to wait for, for example 0x20 (ESB) after
+//                "*ESE 1;*SRE 32;*OPC" to wait for operation complete
+//                Set to 0 to return at the next SRQ with any status byte.
+// 2. d_timeout - Longest wait in seconds, < 0 for no limit (default)
 //
-// Returns: 0 = no error
-//          1 = error
+// Returns: 8-bit status byte if no error
+//          -1 if error or timed out
 //
-// Notes: This is normally called from a separate thread from which the RPC
-//        that is being aborted is called.  The purpose of the abort is to
-//        end an existing RPC before its timeout expires.
+// Notes: The status byte is read once, and then once after each SRQ
+//        interrupt for this object, until it has a bit of mask set.  In
+//        between, the thread sleeps on the Vxi11SrqWaiter of the object,
+//        which the SRQ service wakes up; there are no calls to the device
+//        while waiting, and the RPC mutex is not held.  Each status byte
+//        is from a call started after the previous step, never one shared
+//        from before or reused within readstb_max_age().
 //
-//        This function does not work on the Agilent E5810A LAN/GPIB gateway
-//        for unknown reasons.  The clnttcp_create() works, but the
-//        device_abort_1() RPC call times out.
+//        The SRQ service is started for the object, and SRQ is enabled with
+//        enable_srq(), if not done before.  The device must be configured
+//        to request service for the bits of mask, with "*SRE" and "*ESE".
+//        An srq_callback() or srq_handler() set for the object is still
+//        called for each SRQ.
 // ***************************************************************************
-  int Vxi11::
-abort (void)
+  VXI11_TEMPLATE int BASIC_VXI11::
+wait_for_srq (int mask, double d_timeout)
 {
   // Early return if object did not make connection to instrument
   if (!_b_valid) {
-    log_err ("Vxi11::abort error: no connection to device.\n");
-    return (1);
-    }
-
-  // Create abort channel if it was not already created
-  if (!_p_client_abort) {
-    sockaddr_in sockaddr = {0};
-    sockaddr.sin_family = AF_INET;
-    sockaddr.sin_port = htons (_p_link->abortPort);
-    sockaddr.sin_addr.s_addr = _ui_device_ip_addr;
-    int sock = RPC_ANYSOCK;
-  
-    __p_client_abort = clnttcp_create (&sockaddr, DEVICE_ASYNC,
-                                       DEVICE_ASYNC_VERSION, &sock, 0, 0);
-  
-    if (!_p_client_abort) {               // Exit early if error
-      const char *s_err = "Vxi11::abort error: abort channel client creation";
-      clnt_pcreateerror ((char *)s_err);  // Print error message
-      return (1);
-      }
+    log_err ("Vxi11::wait_for_srq error: no connection to device.\n");
+    return (-1);
     }
 
-  // Send abort command
-  // FIXME - times out on Agilent E5810A
-  Device_Error *p_error = device_abort_1 (&(_p_link->lid), _p_client_abort);
+  if (flush ())                         // Send the buffered commands first
+    return (-1);
 
-  if (!p_error) {
-    log_err ("Vxi11::abort error: no RPC response for %s.\n", _s_device_addr);
-    return (1);
-    }
-  
-  // Possible errors
-  //  0 = no error
-  //  4 = invalid link identifier
-  int err_code = int (p_error->error);
-  if (err_code) {
-    int idx_err_desc = ((err_code >= 0) && (err_code < CNT_ERR_DESC_MAX)) ?
-                       err_code : 0;
-    log_err ("Vxi11::abort error: %d %s for %s.\n",
-             err_code, _as_err_desc[idx_err_desc], _s_device_addr);
-    return (1);
+  // Run the SRQ service for this object, and enable SRQ on the device
+  if (!_b_srq_wait) {
+    if (_srq_service (true))
+      return (-1);
+    _b_srq_wait = true;
     }
+  if (!_b_srq_ena && enable_srq (true, _b_srq_udp))
+    return (-1);
 
-  return (0);
+  long long t_end_ns = Vxi11Tracer::time_ns () +
+                       (long long)(d_timeout * 1e9);
+  bool b_srq = false;                   // SRQ received since the first read
+  for (;;) {
+    // Count before reading, so an SRQ in between is not missed
+    unsigned long cnt_srq = _p_srq_waiter->count ();
+
+    int stb = _readstb (false);         // Not a status byte from before
+    if ((stb < 0) || (mask ? (stb & mask) : b_srq))
+      return (stb);
+
+    double d_wait = -1;
+    if (d_timeout >= 0) {
+      d_wait = (t_end_ns - Vxi11Tracer::time_ns ()) * 1e-9;
+      if (d_wait < 0)
+        d_wait = 0;
+      }
+    if (!_p_srq_waiter->wait (cnt_srq, d_wait)) {
+      log_err ("Vxi11::wait_for_srq error: timed out after %g s for %s, "
+               "status byte 0x%02x.\n", d_timeout, _s_device_addr, stb);
+      return (-1);
+      }
+    b_srq = true;
+    }
 }
 
 // ***************************************************************************
@@ -1337,240 +3997,202 @@ abort (void)
 //                       Set to NULL to disable callbacks.
 //                       Function is of the type
 //                         void srq_callback (Vxi11 *)
+//                       or of another BasicVxi11 type, such as Vxi11Bare
 // Returns: 0 = no error
 //          1 = error
 //
-// Notes: The function pfn_srq_callback will be called on a separate thread
-//        than the thread calling this function.  It will be called only if
-//        SRQ is enabled via enable_srq() and if the device issues a SRQ.
+// Notes: The function pfn_srq_callback will be called on a worker thread of
+//        the SRQ service, not the thread calling this function.  It will be
+//        called only if SRQ is enabled via enable_srq() and if the device
+//        issues a SRQ.
 //
 //        Call this function before calling enable_srq().
 //
 //        This is a static member function, so only one callback function
-//        can be used for all instances of the Vxi11 class.
+//        can be used for all instances of the Vxi11 class.  Each BasicVxi11
+//        type has its own callback, and they share one SRQ service, which
+//        runs while any callback or srq_handler() is set.  An object with
+//        its own srq_handler() does not call this function.
+//
+//        The callbacks of different objects run in parallel, on up to
+//        srq_workers() threads, so a slow callback for one device does not
+//        delay the SRQs of the others.  The callbacks of one object run one
+//        at a time; an SRQ received while its callback is running calls it
+//        once more afterward.
 //
 //        The Vxi11* parameter to the callback function can be used to talk
 //        to the device that created the SRQ and to identify the source via
 //        the device_addr() member.
 // ***************************************************************************
-  int Vxi11::
-srq_callback (void (*pfn_srq_callback)(Vxi11 *))
+  VXI11_TEMPLATE int BASIC_VXI11::
+srq_callback (void (*pfn_srq_callback)(BASIC_VXI11 *))
 {
   // Early return callback function is the same as before
   if (pfn_srq_callback == _pfn_srq_callback)
     return (0);
-  
-  // *************************************************************************
-  // Remove RPC service and callback for SRQ if callback previously set
-  // *************************************************************************
-  if (_pfn_srq_callback) {
-    int err = 0;
-    
-    // Stop thread running svc_run()
-    if (_p_pthread_svc_run) {
-      if (pthread_cancel (*(pthread_t *)_p_pthread_svc_run)) {
-        log_err ("Vxi11::srq_callback error: could not kill thread.\n");
-        err = 1;
-        }
-      _p_pthread_svc_run = 0;
-      }
-
-    // Unregister the callback function
-    svc_unregister (DEVICE_INTR, DEVICE_INTR_VERSION);
-    
-    // Destroy RPC service transport
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_tcp);
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_udp);
-
-    // Mark callback as null so it won't be destroyed again on repeat call
-    _pfn_srq_callback = NULL;
 
-    if (err)
-      return (1);
-    }
-
-  // Early return if no callback is specified
-  if (pfn_srq_callback == NULL)
+  // Replace the callback if the SRQ service is already running for it
+  if (_pfn_srq_callback && pfn_srq_callback) {
+    _pfn_srq_callback = pfn_srq_callback;
     return (0);
-
-  // *************************************************************************
-  // Create RPC service and callback for SRQ if callback is not null
-  // *************************************************************************
-
-  // Save the user's callback function
-  _pfn_srq_callback = pfn_srq_callback;
-
-  // Clear the port mapping for the SRQ interrupt channel
-  pmap_unset (DEVICE_INTR, DEVICE_INTR_VERSION);
-
-  // Create RPC service transport for the SRQ interrupt channel
-  _p_svcXprt_srq_tcp = (void *)svctcp_create (RPC_ANYSOCK, 0, 0);
-  if (!_p_svcXprt_srq_tcp) {
-    log_err ("Vxi11::srq_callback error: could not create RPC service "
-             "transport for TCP.\n");
-    _pfn_srq_callback = NULL;
-    return (1);
     }
 
-  _p_svcXprt_srq_udp = (void *)svcudp_create (RPC_ANYSOCK);
-  if (!_p_svcXprt_srq_udp) {
-    log_err ("Vxi11::srq_callback error: could not create RPC service "
-             "transport for UDP.\n");
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_tcp);
-    _pfn_srq_callback = NULL;
+  // Start the SRQ service for the first callback or handler, and stop it
+  // when the last one is removed
+  if (pfn_srq_callback && _srq_service (true))
     return (1);
-    }
-  
-  // Register the SRQ interrupt callback function with this service
-  if (!svc_register ((SVCXPRT*)_p_svcXprt_srq_tcp,
-                     DEVICE_INTR, DEVICE_INTR_VERSION,
-#ifdef __APPLE__
-                     (void(*)(void))&_fn_srq_callback,
-#endif
-#ifdef __linux__
-                     (void(*)(svc_req*, SVCXPRT*))&_fn_srq_callback,
-#endif
-                     IPPROTO_TCP)) {
-    log_err ("Vxi11::srq_callback error: could not register SRQ "
-             "callback function for TCP.\n");
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_tcp);
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_udp);
-    _pfn_srq_callback = NULL;    
-    return (1);    
+  if (!pfn_srq_callback) {
+    _pfn_srq_callback = 0;
+    return (_srq_service (false));
     }
 
-  if (!svc_register ((SVCXPRT*)_p_svcXprt_srq_udp,
-                     DEVICE_INTR, DEVICE_INTR_VERSION,
-#ifdef __APPLE__
-                     (void(*)(void))&_fn_srq_callback,
-#endif
-#ifdef __linux__
-                     (void(*)(svc_req*, SVCXPRT*))&_fn_srq_callback,
-#endif
-                     IPPROTO_UDP)) {
-    log_err ("Vxi11::srq_callback error: could not register SRQ "
-             "callback function for UDP.\n");
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_tcp);
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_udp);
-    _pfn_srq_callback = NULL;    
-    return (1);    
-    }
-
-  // Create a thread so that it can monitor SRQ interrupts via svc_run()
-  static pthread_t pthread_svc_run;
-  _p_pthread_svc_run =(void *)&pthread_svc_run;
-  if (pthread_create ((pthread_t *)_p_pthread_svc_run, NULL, &_fn_svc_run,
-                      NULL)) {
-    log_err ("Vxi11::srq_callback error: could not start SRQ service "
-             "thread.\n");
-    svc_unregister (DEVICE_INTR, DEVICE_INTR_VERSION);
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_tcp);
-    svc_destroy ((SVCXPRT *)_p_svcXprt_srq_udp);
-    _pfn_srq_callback = NULL;    
+  _pfn_srq_callback = pfn_srq_callback;
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11::srq_handler - Specify the handler function for the SRQ (service
+//                      request) interrupt of this object
+//
+// Parameters:
+// 1. pfn_srq_handler - Function to call when an SRQ interrupt occurs for
+//                      this object, instead of the srq_callback() of its
+//                      type.  Set to NULL to use srq_callback() again.
+//                      Function is of the type
+//                        void srq_handler (Vxi11 *, void *p_arg)
+// 2. p_arg           - Parameter passed to pfn_srq_handler
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Call this function before calling enable_srq().  The SRQ service
+//        runs while the handler is set, as for srq_callback().
+//
+//        The handler is called on a worker thread of the SRQ service, one
+//        call at a time for this object, in parallel with the handlers of
+//        other objects.  close() waits for a handler that is running, unless
+//        called by the handler itself.
+// ***************************************************************************
+  VXI11_TEMPLATE int BASIC_VXI11::
+srq_handler (void (*pfn_srq_handler)(BASIC_VXI11 *, void *), void *p_arg)
+{
+  // Start the SRQ service for the first handler, and stop it when the
+  // handler is removed
+  if (pfn_srq_handler && !_pfn_srq_handler && _srq_service (true))
     return (1);
+  if (!pfn_srq_handler && _pfn_srq_handler) {
+    _pfn_srq_handler = 0;
+    _p_srq_arg = 0;
+    return (_srq_service (false));
     }
-  
+
+  _p_srq_arg = p_arg;
+  _pfn_srq_handler = pfn_srq_handler;
   return (0);
 }
 
 // ***************************************************************************
-// Vxi11::_fn_svc_run - Private static function to run the RPC service for
-//                      the SRQ interrupt processing on its own thread
+// Vxi11::_srq_call - Private static function to call the SRQ handler of an
+//                    object, or the SRQ callback of this BasicVxi11 type
 //
 // Parameters:
-// 1. p_arg - Not used
+// 1. p_vxi11 - Object given to enable_srq(), of this BasicVxi11 type
 //
 // Returns: None
 //
-// Notes: This function is called by srq_callback() and executes in a
-//        separate thread.  This function never returns.
+// Notes: Called by _srq_handle() through _pfn_srq_call of the object.
 // ***************************************************************************
-  void *Vxi11::
-_fn_svc_run (void *p_arg)
+  VXI11_TEMPLATE void BASIC_VXI11::
+_srq_call (Vxi11Common *p_vxi11)
 {
-  // Start the RPC server to listen for SRQ interrupts
-  svc_run();                            // This function will never return
+  BASIC_VXI11 *p_basic = (BASIC_VXI11 *)p_vxi11;
+  void (*pfn_srq_handler)(BASIC_VXI11 *, void *) = p_basic->_pfn_srq_handler;
+  if (pfn_srq_handler)
+    pfn_srq_handler (p_basic, p_basic->_p_srq_arg);
+  else if (_pfn_srq_callback)
+    _pfn_srq_callback (p_basic);
+}
 
-  log_err ("Vxi11::_fn_svc_run error: svc_run() returned unexpectedly.\n");
+// ***************************************************************************
+// Vxi11::_srq_service - Private static function to add or remove a user of
+//                       the SRQ service
+//
+// Parameters:
+// 1. b_run - true  = add a user, and start the SRQ server of vxi11_srq.cpp
+//                    with srq_workers() threads if it is not running
+//            false = remove a user, and stop the server after the last one
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Called by srq_callback() and srq_handler() when a callback or
+//        handler is set or removed.
+//
+//        The server listens on its own TCP and UDP ports, which are given
+//        to the device by create_intr_chan, so it is not registered with
+//        the portmapper.
+// ***************************************************************************
+  int Vxi11Common::
+_srq_service (bool b_run)
+{
+  if (!b_run) {
+    vxi11_srq_stop ();
+    return (0);
+    }
 
-  return (0);                           // This should never be called
+  if (vxi11_srq_start (&_srq_handle, _cnt_srq_worker)) {
+    log_err ("Vxi11::srq_callback error: could not start SRQ service.\n");
+    return (1);
+    }
+  return (0);
 }
 
 // ***************************************************************************
-// Vxi11::_fn_srq_callback - Private static callback function for the SRQ
-//                           interrupt, which then calls the user speciified
-//                           SRQ callback function.
-//                           VXI-11 RPC is "device_intr_srq"
+// Vxi11::_srq_handle - Private static function to call the user specified
+//                      SRQ callback function for the handle of an SRQ
+//                      interrupt
 //
 // Parameters:
-// 1. rqstp  - Request type, used to get RPC function requested
-//             Actual type is svc_req*, but declared void* to reduce include
-//             dependencies in libvxi11.h.
-// 2. transp - RPC service transport, used to get arguments to the RPC
-//             Actual type is SVCXPRT*, but declared void* to reduce include
-//             dependencies in libvxi11.h.
+// 1. ac_handle  - Handle given to the device by enable_srq()
+// 2. cnt_handle - Number of bytes in ac_handle
 //
 // Returns: None
 //
-// Notes; This function assumes it is only called due to receiving the
-//        device_intr_srq RPC from the VXI-11 device.
-//
-//        This function is registered as an RPC service callback in
-//        srq_callback(), and is called by the svc_run() call in fn_svc_run()
-//        when the device_intr_srq RPC is received from the device.
+// Notes: Called on a worker thread of the SRQ server of vxi11_srq.cpp, for
+//        the device_intr_srq calls of VXI-11 devices and the
+//        AsyncServiceRequest of HiSLIP links.
 //
-//        See the notes for Vxi11::enable_srq() for an example of the
-//        sequence needed to use SRQ interrupts.
+//        close() deletes the handle and then waits for this function, so
+//        the object found here is not destroyed while its handler runs.
 // ***************************************************************************
-  void Vxi11::
-_fn_srq_callback (void /*svc_req*/ *rqstp, void /*SVCXPRT*/ *transp)
+  void Vxi11Common::
+_srq_handle (const char *ac_handle, int cnt_handle)
 {
-  // This is a simplified version of the code that is generated by rpcgen in
-  // vxi11_rpc_svc.c
-
-  // Check if getting the expected RPC call
-  if (((svc_req*)rqstp)->rq_proc != device_intr_srq) {
-    log_err ("Vxi11::_fn_srq_callback error: unexpected RPC call.\n");
-    svcerr_noproc ((SVCXPRT *)transp);
-    return;
-    }
-  
-  union {
-    Device_SrqParms device_intr_srq_1_arg;
-    } argument;
-
-  // Translate type sizes between client (VXI-11 deivce) and server (this Mac)
-  xdrproc_t xdr_argument = (xdrproc_t) xdr_Device_SrqParms;
-  (void) memset((char *)&argument, 0, sizeof (argument));
-  if (!svc_getargs ((SVCXPRT *)transp, xdr_argument, (caddr_t) &argument)) {
-    log_err ("Vxi11::_fn_srq_callback error: could not decode arguments.\n");
-    svcerr_decode ((SVCXPRT *)transp);
+  // Look up the Vxi11 object associated with the device that generated the
+  // SRQ interrupt.  The handle was added to the table by enable_srq().
+
+  // Check that the handle is the correct length
+  if (cnt_handle != VXI11_SRQ_HANDLE_LEN) {
+    log_err ("Vxi11::_srq_handle error:  handle in SRQ callback "
+             "has incorrect length %d, expected %d.\n",
+             cnt_handle, VXI11_SRQ_HANDLE_LEN);
     return;
     }
 
-  // Extract the pointer to the Vxi11 object associated with the device that
-  // generated the SRQ interrupt.
-  // Vxi11 object pointer was stored into the Device_SrqParms object by
-  // enable_srq().
-
-  // Check that the pointer is the correct length
-  int len_ptr = argument.device_intr_srq_1_arg.handle.handle_len;
-  if (len_ptr == sizeof (Vxi11 *)) {
-    Vxi11 *p_vxi11;
-    memcpy (&p_vxi11, argument.device_intr_srq_1_arg.handle.handle_val,
-            sizeof (Vxi11 *));
+  // Ignore the SRQ if the object was closed or destroyed since the handle
+  // was given to the device
+  Vxi11Common *p_vxi11 =
+    (Vxi11Common *)vxi11_srq_handle_find (ac_handle, cnt_handle);
+  if (!p_vxi11)
+    return;
 
-    // Call the user specified SRQ callback function with the Vxi11 object as
-    // the parameter
-    _pfn_srq_callback (p_vxi11);
-    }
-  else {
-    log_err ("Vxi11::_fn_srq_callback error:  pointer in SRQ callback "
-             "has incorrect length %d, expected %lu.\n",
-             len_ptr, sizeof (Vxi11 *));
-    }
+  // Wake up the threads in wait_for_srq() for the object
+  ((Vxi11SrqWaiter *)p_vxi11->__p_srq_waiter)->post ();
 
-  svc_freeargs ((SVCXPRT *)transp, xdr_argument, (caddr_t) &argument);
+  // Call the user specified SRQ handler of the object, or SRQ callback
+  // function of its BasicVxi11 type, with the object as the parameter
+  if (p_vxi11->_pfn_srq_call)
+    p_vxi11->_pfn_srq_call (p_vxi11);
 }
 
 // ***************************************************************************
@@ -1592,7 +4214,8 @@ _fn_srq_callback (void /*svc_req*/ *rqstp, void /*SVCXPRT*/ *transp)
 //          1 = error
 //
 // Notes: To use SRQ interrupts, follow this process:
-//        1. Specify the SRQ callback function with Vxi11::srq_callback()
+//        1. Specify the SRQ callback function with Vxi11::srq_callback(),
+//           or the handler of this object with Vxi11::srq_handler()
 //        2. Enable SRQ at the VXI-11 level with this function,
 //           Vxi11::enable_srq()
 //        3. Configure your device to create SRQ under the required conditions.
@@ -1608,7 +4231,7 @@ _fn_srq_callback (void /*svc_req*/ *rqstp, void /*SVCXPRT*/ *transp)
 //           caused the SRQ by sending "*CLS".  In the callback function, use
 //           the Vxi11 pointer passed to the function to access the device.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 enable_srq (bool b_ena, bool b_udp)
 {
   // Early return if enable state and protocol are the same as before
@@ -1622,15 +4245,23 @@ enable_srq (bool b_ena, bool b_udp)
     return (1);
     }
 
-  if ((_p_svcXprt_srq_tcp == NULL) || (_p_svcXprt_srq_udp == NULL)) {
-    log_err ("Vxi11::enable_srq error: must call srq_callback() first "
-             "for %s.\n", _s_device_addr);
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
+  // Port of the SRQ service, given to the device by create_intr_chan
+  int port_srq = vxi11_srq_port (b_udp);
+  if (b_ena && !port_srq) {
+    log_err ("Vxi11::enable_srq error: must call srq_callback() or "
+             "srq_handler() first for %s.\n", _s_device_addr);
     return (1);
     }
   
   int err = 0;                          // No error yet
   
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
 
   // *************************************************************************
   // Disable SRQ interrupt
@@ -1646,13 +4277,18 @@ enable_srq (bool b_ena, bool b_udp)
     enableSrqParms.enable = false;      // Disable interrupts
 
     // Set handle member to allow identification of the SRQ source
-    Vxi11 *p_vxi11 = this;
-    memcpy (_a_srq_handle, &p_vxi11, sizeof (Vxi11 *));
-    enableSrqParms.handle.handle_len = sizeof (Vxi11 *);
+    enableSrqParms.handle.handle_len = _cnt_srq_handle;
     enableSrqParms.handle.handle_val = _a_srq_handle;
     
     // Send SRQ disable command
-    Device_Error *p_error = device_enable_srq_1 (&enableSrqParms, _p_client);
+    Vxi11TraceSpan<S> traceSpan (this, _p_transport, enableSrqParms.lid,
+                                 device_enable_srq, "device_enable_srq",
+                                 enableSrqParms.handle.handle_len);
+    Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+    Device_Error *p_error = res.call (device_enable_srq,
+                                      xdr_Device_EnableSrqParms,
+                                      &enableSrqParms);
+    traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
     
     if (!p_error) {
       log_err ("Vxi11::enable_srq error: no RPC response for %s.\n",
@@ -1674,7 +4310,12 @@ enable_srq (bool b_ena, bool b_udp)
       }
 
     // Destroy the SRQ interrupt channel
-    p_error = destroy_intr_chan_1 (0, _p_client);
+    Vxi11TraceSpan<S> traceSpanDestroy (this, _p_transport, _p_link->lid,
+                                        destroy_intr_chan,
+                                        "destroy_intr_chan", 0);
+    Vxi11RpcResult<Device_Error, X, S> resDestroy (_p_transport);
+    p_error = resDestroy.call (destroy_intr_chan);
+    traceSpanDestroy.end (0, (p_error) ? int (p_error->error) : -1);
     
     if (!p_error) {
       log_err ("Vxi11::enable_srq error: could not destroy intr channel "
@@ -1709,7 +4350,6 @@ enable_srq (bool b_ena, bool b_udp)
     if (gethostname (s_hostname, sizeof (s_hostname))) {
       log_err ("Vxi11::enable_srq error: could not get host PC hostname "
                "for %s.\n", _s_device_addr);
-      _pfn_srq_callback = NULL;    
       return (1);
       }
     s_hostname[255] = 0;                // Make sure it is null terminated
@@ -1772,14 +4412,18 @@ enable_srq (bool b_ena, bool b_udp)
     Device_RemoteFunc remoteFunc;
     remoteFunc.hostAddr = ip_addr;             // IP address of this host
                                                // Port # for interrupt channel
-    remoteFunc.hostPort = (b_udp) ? ((SVCXPRT*)_p_svcXprt_srq_udp)->xp_port :
-                                    ((SVCXPRT*)_p_svcXprt_srq_tcp)->xp_port;
+    remoteFunc.hostPort = port_srq;
     remoteFunc.progNum = DEVICE_INTR;          // Must be this value
     remoteFunc.progVers = DEVICE_INTR_VERSION; // Must be this value
     remoteFunc.progFamily = (b_udp) ? DEVICE_UDP :DEVICE_TCP; // Protocol
   
     // Create SRQ interrupt channel
-    Device_Error *p_error = create_intr_chan_1 (&remoteFunc, _p_client);
+    Vxi11TraceSpan<S> traceSpan (this, _p_transport, _p_link->lid,
+                                 create_intr_chan, "create_intr_chan", 0);
+    Vxi11RpcResult<Device_Error, X, S> res (_p_transport);
+    Device_Error *p_error = res.call (create_intr_chan,
+                                      xdr_Device_RemoteFunc, &remoteFunc);
+    traceSpan.end (0, (p_error) ? int (p_error->error) : -1);
 
     if (!p_error) {
       log_err ("Vxi11::enable_srq error: create_intr_chan no RPC response "
@@ -1808,18 +4452,43 @@ enable_srq (bool b_ena, bool b_udp)
     enableSrqParms.enable = true;       // Enable interrupts
 
     // Set handle member to allow identification of the SRQ source
-    Vxi11 *p_vxi11 = this;
-    memcpy (_a_srq_handle, &p_vxi11, sizeof (Vxi11 *));
-    enableSrqParms.handle.handle_len = sizeof (Vxi11 *);
+    // The handle is kept until close(), so SRQs sent with it before a
+    // disable and enable are still delivered
+    if (!_cnt_srq_handle) {
+      if (vxi11_srq_handle_new ((Vxi11Common *)this, _a_srq_handle)) {
+        log_err ("Vxi11::enable_srq error: could not create SRQ handle "
+                 "for %s.\n", _s_device_addr);
+        Vxi11TraceSpan<S> traceSpanDestroy (this, _p_transport, _p_link->lid,
+                                            destroy_intr_chan,
+                                            "destroy_intr_chan", 0);
+        Vxi11RpcResult<Device_Error, X, S> resDestroy (_p_transport);
+        p_error = resDestroy.call (destroy_intr_chan);
+        traceSpanDestroy.end (0, (p_error) ? int (p_error->error) : -1);
+        return (1);
+        }
+      _cnt_srq_handle = VXI11_SRQ_HANDLE_LEN;
+      }
+    enableSrqParms.handle.handle_len = _cnt_srq_handle;
     enableSrqParms.handle.handle_val = _a_srq_handle;
     
     // Send SRQ enable command
-    p_error = device_enable_srq_1 (&enableSrqParms, _p_client);
+    Vxi11TraceSpan<S> traceSpanEnable (this, _p_transport, enableSrqParms.lid,
+                                       device_enable_srq, "device_enable_srq",
+                                       enableSrqParms.handle.handle_len);
+    Vxi11RpcResult<Device_Error, X, S> resEnable (_p_transport);
+    p_error = resEnable.call (device_enable_srq,
+                              xdr_Device_EnableSrqParms, &enableSrqParms);
+    traceSpanEnable.end (0, (p_error) ? int (p_error->error) : -1);
     
     if (!p_error) {
       log_err ("Vxi11::enable_srq error: no RPC response for %s.\n",
                _s_device_addr);
-      destroy_intr_chan_1 (0, _p_client);
+      Vxi11TraceSpan<S> traceSpanDestroy (this, _p_transport, _p_link->lid,
+                                          destroy_intr_chan,
+                                          "destroy_intr_chan", 0);
+      Vxi11RpcResult<Device_Error, X, S> resDestroy (_p_transport);
+      p_error = resDestroy.call (destroy_intr_chan);
+      traceSpanDestroy.end (0, (p_error) ? int (p_error->error) : -1);
       return (1);
       }
   
@@ -1832,7 +4501,12 @@ enable_srq (bool b_ena, bool b_udp)
         err_code : 0;
       log_err ("Vxi11::enable_srq error: %d %s for %s.\n",
                err_code, _as_err_desc[idx_err_desc], _s_device_addr);
-      destroy_intr_chan_1 (0, _p_client);
+      Vxi11TraceSpan<S> traceSpanDestroy (this, _p_transport, _p_link->lid,
+                                          destroy_intr_chan,
+                                          "destroy_intr_chan", 0);
+      Vxi11RpcResult<Device_Error, X, S> resDestroy (_p_transport);
+      p_error = resDestroy.call (destroy_intr_chan);
+      traceSpanDestroy.end (0, (p_error) ? int (p_error->error) : -1);
       return (1);
       }
 
@@ -1873,7 +4547,7 @@ enable_srq (bool b_ena, bool b_udp)
 //        to GPIB address 21 (the device address of the GPIB/LAN gateway
 //        interface), then enable listening on addresses 3 and 4.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_send_command (const char *s_data)
 {
   // Early return if object did not make connection to instrument
@@ -1882,21 +4556,49 @@ docmd_send_command (const char *s_data)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20000;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 1;              // 1 byte size
   docmdParms.data_in.data_in_len = strlen (s_data); // Command data size
   docmdParms.data_in.data_in_val = (char *)s_data;  // Command data
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_send_command error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_send_command error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Send raw low-level GPIB command
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_send_command error: no RPC response for %s.\n",
@@ -1963,7 +4665,7 @@ docmd_send_command (const char *s_data)
 //        GPIB interface itself (such as a GPIB/LAN gateway), not a GPIB
 //        instrument.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_bus_status (int type)
 {
   // Early return if object did not make connection to instrument
@@ -1973,20 +4675,45 @@ docmd_bus_status (int type)
     }
 
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20001;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 2;              // 2 byte size
   docmdParms.data_in.data_in_len = 2;   // Status type size
   docmdParms.data_in.data_in_val = (char *)(&type);  // Status type
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_bus_status error: circuit open for %s.\n",
+             _s_device_addr);
+    return (-1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_bus_status error: cancelled for %s.\n",
+             _s_device_addr);
+    return (-1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Send request for bus status
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_bus_status error: no RPC response for %s.\n",
@@ -2034,7 +4761,7 @@ docmd_bus_status (int type)
 //        GPIB interface itself (such as a GPIB/LAN gateway), not a GPIB
 //        instrument.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_atn_control (bool b_state)
 {
   // Early return if object did not make connection to instrument
@@ -2043,24 +4770,55 @@ docmd_atn_control (bool b_state)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   // Convert boolean state to 2-byte value needed by the RPC call
   unsigned short us_state = (b_state) ? 1 : 0;
   
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20002;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 2;              // 2 byte size
   docmdParms.data_in.data_in_len = 2;   // Command data size
   docmdParms.data_in.data_in_val = (char *)&us_state;  // Command data
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_atn_control error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_atn_control error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Set ATN line state
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_atn_control error: no RPC response for %s.\n",
@@ -2108,7 +4866,7 @@ docmd_atn_control (bool b_state)
 //        In a multi-controller setup, only the system controller can set
 //        this state.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_ren_control (bool b_state)
 {
   // Early return if object did not make connection to instrument
@@ -2117,24 +4875,52 @@ docmd_ren_control (bool b_state)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   // Convert boolean state to 2-byte value needed by the RPC call
   unsigned short us_state = (b_state) ? 1 : 0;
   
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20003;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 2;              // 2 byte size
   docmdParms.data_in.data_in_len = 2;   // Command data size
   docmdParms.data_in.data_in_val = (char *)&us_state;  // Command data
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_ren_control error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_ren_control error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Set REN line state
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_ren_control error: no RPC response for %s.\n",
@@ -2183,7 +4969,7 @@ docmd_ren_control (bool b_state)
 //        This function is only applicable in a multi-controller setup.
 //        This does not change which controller is the system controller.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_pass_control (int addr)
 {
   // Early return if object did not make connection to instrument
@@ -2192,21 +4978,49 @@ docmd_pass_control (int addr)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20004;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 4;              // 4 byte size
   docmdParms.data_in.data_in_len = 4;   // Command data size
   docmdParms.data_in.data_in_val = (char *)&addr;  // Command data
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_pass_control error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_pass_control error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Pass control to other GPIB controller
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_pass_control error: no RPC response for %s.\n",
@@ -2250,7 +5064,7 @@ docmd_pass_control (int addr)
 //        GPIB interface itself (such as a GPIB/LAN gateway), not a GPIB
 //        instrument.  Common addresses for the interface are 0 and 21.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_bus_address (int addr)
 {
   // Early return if object did not make connection to instrument
@@ -2259,21 +5073,49 @@ docmd_bus_address (int addr)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x2000a;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 4;              // 4 byte size
   docmdParms.data_in.data_in_len = 4;   // Command data size
   docmdParms.data_in.data_in_val = (char *)&addr;  // Command data
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_bus_address error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_bus_address error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Set GPIB address of GPIB/LAN gateway
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_bus_address error: no RPC response for %s.\n",
@@ -2319,7 +5161,7 @@ docmd_bus_address (int addr)
 //        In a multi-controller setup, only the system controller can do this
 //        operation.
 // ***************************************************************************
-  int Vxi11::
+  VXI11_TEMPLATE int BASIC_VXI11::
 docmd_ifc_control (void)
 {
   // Early return if object did not make connection to instrument
@@ -2328,21 +5170,49 @@ docmd_ifc_control (void)
     return (1);
     }
 
+  if (flush ())                         // Send the buffered commands first
+    return (1);
+
   Device_DocmdParms docmdParms;         // To send to device_docmd RPC
-  docmdParms.lid = _p_link->lid;        // Link ID from create_link RPC call
   docmdParms.flags = 0;                 // No flags
-  docmdParms.io_timeout = _timeout_ms;  // Timeout for I/O in ms
-  docmdParms.lock_timeout= _timeout_ms; // Timeout for lock in ms
+  Vxi11Timeout timeoutCall = timeout_call (OP_CONTROL); // Timeouts in ms
+  docmdParms.io_timeout = timeoutCall.io_ms; // Timeout for I/O in ms
+  docmdParms.lock_timeout = timeoutCall.lock_ms; // Timeout for lock in ms
   docmdParms.cmd = 0x20010;             // Command code
   docmdParms.network_order = 0;         // Little-endian
   docmdParms.datasize = 0;              // 0 byte size (not used)
   docmdParms.data_in.data_in_len = 0;   // Command data size (not used)
   docmdParms.data_in.data_in_val = 0;;  // Command data (not used)
 
-  Vxi11Mutex vxi11Mutex;                // Lock access until function returns
+  // Fail right away if the breaker is open, without waiting for the lock
+  if (L::B_ENA && _p_breaker && _p_breaker->reject ()) {
+    log_err ("Vxi11::docmd_ifc_control error: circuit open for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+
+  Vxi11Mutex<L> vxi11Mutex;             // Lock access until function returns
+  _timeout_rpc (timeoutCall.rpc_ms);
+  Vxi11CancelScope<L::B_ENA> cancelCall (this, _p_cancel, _d_call_deadline,
+                                         &_abort_call); // Abort if cancelled
+  if (cancelCall.cancelled ()) {
+    log_err ("Vxi11::docmd_ifc_control error: cancelled for %s.\n",
+             _s_device_addr);
+    return (1);
+    }
+  docmdParms.lid = _p_link->lid;        // Link ID, as _relink() left it
 
   // Toggle IFC line state
-  Device_DocmdResp *p_docmdResp = device_docmd_1 (&docmdParms, _p_client);
+  Vxi11TraceSpan<S> traceSpan (this, _p_transport, docmdParms.lid,
+                               device_docmd, "device_docmd",
+                               docmdParms.data_in.data_in_len);
+  Vxi11RpcResult<Device_DocmdResp, X, S> res (_p_transport);
+  Device_DocmdResp *p_docmdResp = res.call (device_docmd,
+                                            xdr_Device_DocmdParms,
+                                            &docmdParms);
+  traceSpan.end ((p_docmdResp) ? int (p_docmdResp->data_out.data_out_len) : 0,
+                 (p_docmdResp) ? int (p_docmdResp->error) : -1);
+  _call_end (OP_CONTROL, (p_docmdResp) ? int (p_docmdResp->error) : -1);
   
   if (p_docmdResp == 0) {
     log_err ("Vxi11::docmd_ifc_control error: no RPC response for %s.\n",
@@ -2370,3 +5240,23 @@ docmd_ifc_control (void)
 
   return (0);
 }
+
+// ***************************************************************************
+// Instantiate BasicVxi11 for every combination of the policies in
+// libvxi11.h, including Vxi11 and Vxi11Bare, as declared extern there
+//
+// With Vxi11LockNone, the checks of the cancellation token, call deadline
+// and breaker are compiled out, see Vxi11CancelScope.
+// ***************************************************************************
+#define VXI11_INSTANTIATE(L, E, S) \
+  template class BasicVxi11<L, E, S, Vxi11Transport>; \
+  template class BasicVxi11<L, E, S, Vxi11TransportRpc>;
+
+VXI11_INSTANTIATE (Vxi11LockGlobal, Vxi11ErrorLog,  Vxi11StatsTrace)
+VXI11_INSTANTIATE (Vxi11LockGlobal, Vxi11ErrorLog,  Vxi11StatsNone)
+VXI11_INSTANTIATE (Vxi11LockGlobal, Vxi11ErrorNone, Vxi11StatsTrace)
+VXI11_INSTANTIATE (Vxi11LockGlobal, Vxi11ErrorNone, Vxi11StatsNone)
+VXI11_INSTANTIATE (Vxi11LockNone,   Vxi11ErrorLog,  Vxi11StatsTrace)
+VXI11_INSTANTIATE (Vxi11LockNone,   Vxi11ErrorLog,  Vxi11StatsNone)
+VXI11_INSTANTIATE (Vxi11LockNone,   Vxi11ErrorNone, Vxi11StatsTrace)
+VXI11_INSTANTIATE (Vxi11LockNone,   Vxi11ErrorNone, Vxi11StatsNone)
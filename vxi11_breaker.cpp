@@ -0,0 +1,285 @@
+// ***************************************************************************
+// vxi11_breaker.cpp - Circuit breaker for links to unresponsive devices, for
+//                     libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "vxi11_breaker.h"
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <list>
+
+// Breakers that are open, for all links
+static pthread_mutex_t mutex_breaker = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_probe = PTHREAD_COND_INITIALIZER; // Wake thread
+static pthread_cond_t cond_done = PTHREAD_COND_INITIALIZER; // Probe ended
+static std::list<Vxi11Breaker *> list_open;
+static bool b_thread = false;           // Schedule thread started
+
+// ***************************************************************************
+// Vxi11Breaker constructor - Closed breaker of a link
+//
+// Parameters:
+// 1. p_vxi11   - Link
+// 2. pfn_probe - Function pinging p_vxi11 with an RPC timeout in ms,
+//                returning 0 if the device replied
+// 3. cnt_fail  - Calls in a row without reply that open the breaker
+// 4. d_probe   - Time between probes, in seconds
+// 5. probe_ms  - RPC timeout of a probe, in ms
+// ***************************************************************************
+  Vxi11Breaker::
+Vxi11Breaker (Vxi11Common *p_vxi11, int (*pfn_probe) (Vxi11Common *, int),
+              int cnt_fail, double d_probe, int probe_ms)
+{
+  _p_vxi11 = p_vxi11;
+  _pfn_probe = pfn_probe;
+  _cnt_fail_max = (cnt_fail < 1) ? 1 : cnt_fail;
+  _t_probe_ns = (d_probe < 0.001) ? 1000000LL : (long long)(d_probe * 1e9);
+  _probe_ms = (probe_ms < 1) ? 1 : probe_ms;
+  _cnt_fail = 0;
+  _b_open = false;
+  _b_probing = false;
+  _t_next_ns = 0;
+  memset (&_stats, 0, sizeof (_stats));
+}
+
+// ***************************************************************************
+// Vxi11Breaker destructor - Stop probing the link
+// ***************************************************************************
+  Vxi11Breaker::
+~Vxi11Breaker ()
+{
+  reset ();
+}
+
+// ***************************************************************************
+// Vxi11Breaker::reject - Check if a call must fail right away
+//
+// Parameters: None
+//
+// Returns: true if the breaker is open; the call is counted as rejected
+// ***************************************************************************
+  bool Vxi11Breaker::
+reject (void)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  bool b_open = _b_open;
+  if (b_open)
+    _stats.cnt_reject++;
+  pthread_mutex_unlock (&mutex_breaker);
+  return (b_open);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::call_end - Count the end of a call
+//
+// Parameters:
+// 1. b_reply - true if the device replied, with or without an error
+//
+// Returns: None
+//
+// Notes: The breaker opens after cnt_fail calls in a row without reply, and
+//        the schedule thread is started if not running.
+// ***************************************************************************
+  void Vxi11Breaker::
+call_end (bool b_reply)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  if (b_reply)
+    _cnt_fail = 0;
+  else if (!_b_open && (++_cnt_fail >= _cnt_fail_max)) {
+    _b_open = true;
+    _stats.cnt_open++;
+    _t_next_ns = Vxi11Tracer::time_ns () + _t_probe_ns;
+    list_open.push_back (this);
+
+    if (!b_thread) {                    // Runs until the process exits
+      pthread_t pthread;
+      b_thread = !pthread_create (&pthread, NULL, &_fn_schedule, 0);
+      if (b_thread)
+        pthread_detach (pthread);
+      else
+        Vxi11Common::log_err ("Vxi11Breaker error: could not start "
+                              "schedule thread.\n");
+      }
+    pthread_cond_signal (&cond_probe);
+    }
+  pthread_mutex_unlock (&mutex_breaker);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::reset - Close the breaker
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Waits for a probe in progress, so the link can be closed after
+//        this.  Must not be called with the RPC mutex locked.
+// ***************************************************************************
+  void Vxi11Breaker::
+reset (void)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  while (_b_probing)
+    pthread_cond_wait (&cond_done, &mutex_breaker);
+  if (_b_open)
+    list_open.remove (this);
+  _b_open = false;
+  _cnt_fail = 0;
+  pthread_mutex_unlock (&mutex_breaker);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::tripped - Check if the breaker is open
+//
+// Parameters: None
+//
+// Returns: true if the calls fail right away
+// ***************************************************************************
+  bool Vxi11Breaker::
+tripped (void)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  bool b_open = _b_open;
+  pthread_mutex_unlock (&mutex_breaker);
+  return (b_open);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::stats - Get the counters
+//
+// Parameters: None
+//
+// Returns: Counters since the breaker was created
+// ***************************************************************************
+  Vxi11BreakerStats Vxi11Breaker::
+stats (void)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  Vxi11BreakerStats stats = _stats;
+  pthread_mutex_unlock (&mutex_breaker);
+  return (stats);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::_probe - Private function to ping the link
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Called with mutex_breaker locked and _b_probing set, and unlocks
+//        it while the link is pinged.  The breaker is closed and removed
+//        from the list if the probe is replied to, else probed again
+//        d_probe later.  The breaker may be deleted once _b_probing is
+//        cleared.
+// ***************************************************************************
+  void Vxi11Breaker::
+_probe (void)
+{
+  _stats.cnt_probe++;
+  pthread_mutex_unlock (&mutex_breaker);
+  int err = _pfn_probe (_p_vxi11, _probe_ms);
+  pthread_mutex_lock (&mutex_breaker);
+
+  if (!err) {
+    list_open.remove (this);
+    _b_open = false;
+    _cnt_fail = 0;
+    }
+  else
+    _t_next_ns = Vxi11Tracer::time_ns () + _t_probe_ns;
+  _b_probing = false;
+  pthread_cond_broadcast (&cond_done);  // For reset()
+  pthread_cond_signal (&cond_probe);    // Schedule the next probe
+}
+
+// ***************************************************************************
+// Vxi11Breaker::_fn_probe - Private static thread function of one probe
+//
+// Parameters:
+// 1. p_arg - Breaker, with _b_probing set
+//
+// Returns: Null
+// ***************************************************************************
+  void *Vxi11Breaker::
+_fn_probe (void *p_arg)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  ((Vxi11Breaker *)p_arg)->_probe ();
+  pthread_mutex_unlock (&mutex_breaker);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Breaker::_fn_schedule - Private static schedule thread function
+//
+// Parameters:
+// 1. p_arg - Not used
+//
+// Returns: Never
+//
+// Notes: Sleeps until the next probe is due, then starts it on a thread of
+//        its own, so a device that does not reply to its probe does not
+//        delay the probes of the other links.  A link has at most one probe
+//        in progress.  If the thread cannot be created, the probe is made
+//        on this thread.
+// ***************************************************************************
+  void *Vxi11Breaker::
+_fn_schedule (void *p_arg)
+{
+  pthread_mutex_lock (&mutex_breaker);
+  for (;;) {
+    long long t_now_ns = Vxi11Tracer::time_ns ();
+    long long t_next_ns = 0;
+    Vxi11Breaker *p_due = 0;
+    std::list<Vxi11Breaker *>::iterator it;
+    for (it = list_open.begin (); it != list_open.end (); ++it) {
+      if ((*it)->_b_probing)            // Scheduled again when it ends
+        continue;
+      if (t_now_ns >= (*it)->_t_next_ns) {
+        p_due = *it;
+        break;
+        }
+      if (!t_next_ns || ((*it)->_t_next_ns < t_next_ns))
+        t_next_ns = (*it)->_t_next_ns;
+      }
+
+    // Ping the link due; reset() waits for this
+    if (p_due) {
+      p_due->_b_probing = true;
+      pthread_t pthread;
+      if (!pthread_create (&pthread, NULL, &_fn_probe, p_due))
+        pthread_detach (pthread);
+      else
+        p_due->_probe ();
+      continue;
+      }
+
+    // Sleep until the next probe, until a breaker opens, or until a probe
+    // ends
+    if (!t_next_ns)
+      pthread_cond_wait (&cond_probe, &mutex_breaker);
+    else {
+      timespec ts;                      // pthread_cond_timedwait() uses
+      clock_gettime (CLOCK_REALTIME, &ts); // CLOCK_REALTIME
+      long long t_wake_ns = (long long)ts.tv_sec * 1000000000LL +
+                            ts.tv_nsec + (t_next_ns - t_now_ns);
+      ts.tv_sec = t_wake_ns / 1000000000LL;
+      ts.tv_nsec = t_wake_ns % 1000000000LL;
+      pthread_cond_timedwait (&cond_probe, &mutex_breaker, &ts);
+      }
+    }
+
+  return (0);
+}
@@ -0,0 +1,100 @@
+#ifndef VXI11_BREAKER_H
+#define VXI11_BREAKER_H
+
+// ***************************************************************************
+// vxi11_breaker.h - Circuit breaker for links to unresponsive devices, for
+//                   libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// A device that is switched off or unplugged does not reply, so each call of
+// its link waits for the whole RPC timeout, with the RPC mutex locked; the
+// other threads of the station wait behind it, one call after another.  The
+// circuit breaker of a link stops that:
+//
+//   closed     Calls are made.  A reply to any call clears the count of
+//              failures; after cnt_fail calls in a row without a reply,
+//              the breaker opens.
+//   open       Calls fail right away, without calling the device.  A probe
+//              thread pings the device every d_probe seconds with the null
+//              procedure of the abort channel, with a short RPC timeout,
+//              and creates the link again if there is no reply or the core
+//              channel is broken, since the device may have restarted.
+//   closed     When a probe is replied to, the calls are made again.
+//
+//   vxi11.breaker (3, 1.0);              // Open after 3 calls without reply
+//
+// One schedule thread serves the breakers of all links, started by the
+// first one to open.  Each probe runs on a thread of its own, at most one
+// per link, so a device that does not reply delays only its own probes.
+// ***************************************************************************
+
+#include "libvxi11.h"
+
+// Counters of a Vxi11Breaker, see Vxi11Breaker::stats()
+struct Vxi11BreakerStats {
+  unsigned long cnt_open;               // Times opened
+  unsigned long cnt_reject;             // Calls failed while open
+  unsigned long cnt_probe;              // Probes made
+};
+
+// ***************************************************************************
+// Vxi11Breaker - Circuit breaker of one link, for the functions of
+//                BasicVxi11
+// ***************************************************************************
+class Vxi11Breaker {
+ private:
+  Vxi11Common *_p_vxi11;                // Link
+  int (*_pfn_probe) (Vxi11Common *, int); // Pings the link, with an RPC
+                                        // timeout in ms; 0 if replied to
+  int _cnt_fail_max;                    // Calls in a row without reply that
+                                        // open the breaker
+  long long _t_probe_ns;                // Time between probes
+  int _probe_ms;                        // RPC timeout of a probe
+  int _cnt_fail;                        // Calls in a row without reply
+  bool _b_open;                         // Calls fail right away
+  bool _b_probing;                      // Probe in progress
+  long long _t_next_ns;                 // Time of the next probe
+  Vxi11BreakerStats _stats;
+
+  void _probe (void);                   // Pings the link
+  static void *_fn_probe (void *p_arg); // Thread of one probe
+  static void *_fn_schedule (void *p_arg); // Starts the probes due
+
+ public:
+  // pfn_probe pings p_vxi11, or creates its link again, from a probe
+  // thread
+  // cnt_fail   = calls in a row without reply that open the breaker
+  // d_probe    = time between probes, in seconds
+  // probe_ms   = RPC timeout of a probe, in ms
+  Vxi11Breaker (Vxi11Common *p_vxi11,
+                int (*pfn_probe) (Vxi11Common *, int timeout_ms),
+                int cnt_fail, double d_probe, int probe_ms);
+
+  // Waits for a probe in progress
+  ~Vxi11Breaker ();
+
+  // true if open; counts a call failed right away
+  bool reject (void);
+
+  // Count the end of a call, replied to or not
+  void call_end (bool b_reply);
+
+  // Close, and wait for a probe in progress; for close() of the link
+  void reset (void);
+
+  // true if open
+  bool tripped (void);
+
+  // Get the counters
+  Vxi11BreakerStats stats (void);
+};
+
+#endif
@@ -0,0 +1,434 @@
+// ***************************************************************************
+// vxi11_cancel.cpp - Cancellation tokens and call deadlines, for libvxi11.so
+//                    library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "vxi11_cancel.h"
+
+#include <time.h>
+#include <pthread.h>
+
+#include <list>
+#include <vector>
+
+// Macro to conveniently access the __p_call member of Vxi11CancelCall
+#define _p_call         ((Vxi11CancelEntry *)__p_call)
+
+// Time between two device_abort of a call that did not end
+static const long long ABORT_RETRY_NS = 100000000LL;
+
+// ***************************************************************************
+// Vxi11CancelEntry - Call in progress of a link with a token or deadline
+// ***************************************************************************
+struct Vxi11CancelEntry {
+  Vxi11Common *p_vxi11;                 // Link making the call
+  Vxi11Cancel *p_cancel;                // Token watched, or null
+  int (*pfn_abort) (Vxi11Common *);     // Sends device_abort for p_vxi11
+  long long t_end_ns;                   // Deadline of the call, 0 if none
+  long long t_abort_ns;                 // Time of the last device_abort, 0
+                                        // if none
+  bool b_aborting;                      // device_abort being sent
+  int *pcnt_wait;                       // Aborts abort_all() waits for,
+                                        // decremented when sent, or null
+};
+
+// Calls in progress, and the tokens, for all links
+static pthread_mutex_t mutex_cancel = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_watch = PTHREAD_COND_INITIALIZER; // Wake watchdog
+static pthread_cond_t cond_abort = PTHREAD_COND_INITIALIZER; // Abort sent
+static std::list<Vxi11CancelEntry *> list_call;
+static bool b_watch = false;            // Watchdog thread started
+
+// ***************************************************************************
+// watch_start - Start the watchdog thread if not running, with mutex_cancel
+//               locked
+//
+// Parameters:
+// 1. pfn_watch - Thread function
+//
+// Returns: None
+//
+// Notes: The watchdog runs until the process exits.
+// ***************************************************************************
+static void
+watch_start (void *(*pfn_watch) (void *))
+{
+  if (b_watch)
+    return;
+
+  pthread_t pthread;
+  b_watch = !pthread_create (&pthread, NULL, pfn_watch, 0);
+  if (b_watch)
+    pthread_detach (pthread);
+  else
+    Vxi11Common::log_err ("Vxi11CancelCall error: could not start watchdog "
+                          "thread.\n");
+}
+
+// ***************************************************************************
+// abort_end - Mark the device_abort of a call sent, with mutex_cancel locked
+//
+// Parameters:
+// 1. p_entry - Call, marked b_aborting
+//
+// Returns: None
+// ***************************************************************************
+static void
+abort_end (Vxi11CancelEntry *p_entry)
+{
+  p_entry->b_aborting = false;
+  p_entry->t_abort_ns = Vxi11Tracer::time_ns ();
+  if (p_entry->pcnt_wait) {
+    (*p_entry->pcnt_wait)--;
+    p_entry->pcnt_wait = 0;
+    }
+  pthread_cond_broadcast (&cond_abort);
+  pthread_cond_signal (&cond_watch);    // Retry later if still running
+}
+
+// ***************************************************************************
+// abort_thread - Thread function sending the device_abort of one call
+//
+// Parameters:
+// 1. p_arg - Call, type Vxi11CancelEntry*, marked b_aborting
+//
+// Returns: Null
+// ***************************************************************************
+static void *
+abort_thread (void *p_arg)
+{
+  Vxi11CancelEntry *p_entry = (Vxi11CancelEntry *)p_arg;
+  p_entry->pfn_abort (p_entry->p_vxi11);
+
+  pthread_mutex_lock (&mutex_cancel);
+  abort_end (p_entry);
+  pthread_mutex_unlock (&mutex_cancel);
+  return (0);
+}
+
+// ***************************************************************************
+// cancel_abort - Send device_abort for calls, with mutex_cancel locked
+//
+// Parameters:
+// 1. a_p_entry - Calls, marked b_aborting
+// 2. pcnt_wait - Counter to wait for the aborts to be sent, or null to
+//                return right away
+//
+// Returns: None
+//
+// Notes: Each abort is sent on its own thread, so a device that does not
+//        reply does not delay the aborts of the other links.  The calls
+//        cannot end while b_aborting is set.
+// ***************************************************************************
+static void
+cancel_abort (std::vector<Vxi11CancelEntry *> &a_p_entry, int *pcnt_wait)
+{
+  for (size_t i=0; i < a_p_entry.size (); i++) {
+    Vxi11CancelEntry *p_entry = a_p_entry[i];
+    p_entry->pcnt_wait = pcnt_wait;
+    if (pcnt_wait)
+      (*pcnt_wait)++;
+
+    pthread_t pthread;
+    if (!pthread_create (&pthread, NULL, &abort_thread, p_entry))
+      pthread_detach (pthread);
+    else {                              // Send it from this thread instead
+      pthread_mutex_unlock (&mutex_cancel);
+      p_entry->pfn_abort (p_entry->p_vxi11);
+      pthread_mutex_lock (&mutex_cancel);
+      abort_end (p_entry);
+      }
+    }
+
+  while (pcnt_wait && *pcnt_wait)
+    pthread_cond_wait (&cond_abort, &mutex_cancel);
+}
+
+// ***************************************************************************
+// Vxi11Cancel constructor - Token not cancelled, without deadline
+// ***************************************************************************
+  Vxi11Cancel::
+Vxi11Cancel (void)
+{
+  _b_cancel = false;
+  _t_deadline_ns = 0;
+}
+
+// ***************************************************************************
+// Vxi11Cancel destructor
+// ***************************************************************************
+  Vxi11Cancel::
+~Vxi11Cancel ()
+{
+}
+
+// ***************************************************************************
+// Vxi11Cancel::_cancelled - Private function to check if the token is
+//                           cancelled, with mutex_cancel locked
+//
+// Parameters:
+// 1. t_now_ns - Current time
+//
+// Returns: true if cancel() was called or the deadline passed
+// ***************************************************************************
+  bool Vxi11Cancel::
+_cancelled (long long t_now_ns)
+{
+  if (_t_deadline_ns && (t_now_ns >= _t_deadline_ns))
+    _b_cancel = true;
+  return (_b_cancel);
+}
+
+// ***************************************************************************
+// Vxi11Cancel::cancel - Cancel the calls of the links watching the token
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: device_abort is sent for each call in progress before returning.
+//        May be called from any thread, but not by a call being cancelled.
+// ***************************************************************************
+  void Vxi11Cancel::
+cancel (void)
+{
+  pthread_mutex_lock (&mutex_cancel);
+  _b_cancel = true;
+  pthread_mutex_unlock (&mutex_cancel);
+
+  Vxi11CancelCall::abort_all (this);
+}
+
+// ***************************************************************************
+// Vxi11Cancel::deadline - Cancel the token at a later time
+//
+// Parameters:
+// 1. d_time - Time from now in seconds, < 0 for no deadline
+//
+// Returns: None
+//
+// Notes: Applies to the calls in progress and to the following ones.
+// ***************************************************************************
+  void Vxi11Cancel::
+deadline (double d_time)
+{
+  long long t_deadline_ns = (d_time < 0) ? 0 :
+    Vxi11Tracer::time_ns () + (long long)(d_time * 1e9);
+
+  pthread_mutex_lock (&mutex_cancel);
+  _t_deadline_ns = t_deadline_ns;
+  std::list<Vxi11CancelEntry *>::iterator it;
+  for (it = list_call.begin (); it != list_call.end (); ++it)
+    if ((*it)->p_cancel == this && t_deadline_ns &&
+        (!(*it)->t_end_ns || (*it)->t_end_ns > t_deadline_ns))
+      (*it)->t_end_ns = t_deadline_ns;
+  if (t_deadline_ns)
+    watch_start (&Vxi11CancelCall::_fn_watch);
+  pthread_cond_signal (&cond_watch);
+  pthread_mutex_unlock (&mutex_cancel);
+}
+
+// ***************************************************************************
+// Vxi11Cancel::reset - Clear the cancel and the deadline
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Cancel::
+reset (void)
+{
+  pthread_mutex_lock (&mutex_cancel);
+  _b_cancel = false;
+  _t_deadline_ns = 0;
+  pthread_mutex_unlock (&mutex_cancel);
+}
+
+// ***************************************************************************
+// Vxi11Cancel::cancelled - Check if the token is cancelled
+//
+// Parameters: None
+//
+// Returns: true if cancel() was called or the deadline passed, since the
+//          last reset()
+// ***************************************************************************
+  bool Vxi11Cancel::
+cancelled (void)
+{
+  pthread_mutex_lock (&mutex_cancel);
+  bool b_cancel = _cancelled (Vxi11Tracer::time_ns ());
+  pthread_mutex_unlock (&mutex_cancel);
+  return (b_cancel);
+}
+
+// ***************************************************************************
+// Vxi11CancelCall constructor - Add a call to the list watched by the
+//                               watchdog
+//
+// Parameters:
+// 1. p_vxi11   - Link making the call, with the RPC mutex locked
+// 2. p_cancel  - Token of the link, or null
+// 3. d_limit   - Longest time of the call in seconds, < 0 for no limit
+// 4. pfn_abort - Function sending device_abort for p_vxi11
+//
+// Notes: If the token is cancelled, cancelled() is true and the call must
+//        not be made.
+// ***************************************************************************
+  Vxi11CancelCall::
+Vxi11CancelCall (Vxi11Common *p_vxi11, Vxi11Cancel *p_cancel, double d_limit,
+                 int (*pfn_abort) (Vxi11Common *))
+{
+  __p_call = 0;
+  _b_cancelled = false;
+  if (!p_cancel && (d_limit < 0))       // Nothing to watch
+    return;
+
+  long long t_now_ns = Vxi11Tracer::time_ns ();
+  pthread_mutex_lock (&mutex_cancel);
+  if (p_cancel && p_cancel->_cancelled (t_now_ns)) {
+    pthread_mutex_unlock (&mutex_cancel);
+    _b_cancelled = true;
+    return;
+    }
+
+  Vxi11CancelEntry *p_entry = new Vxi11CancelEntry;
+  p_entry->p_vxi11 = p_vxi11;
+  p_entry->p_cancel = p_cancel;
+  p_entry->pfn_abort = pfn_abort;
+  p_entry->t_end_ns = (d_limit < 0) ? 0 :
+                      t_now_ns + (long long)(d_limit * 1e9);
+  if (p_cancel && p_cancel->_t_deadline_ns &&
+      (!p_entry->t_end_ns || p_entry->t_end_ns > p_cancel->_t_deadline_ns))
+    p_entry->t_end_ns = p_cancel->_t_deadline_ns;
+  p_entry->t_abort_ns = 0;
+  p_entry->b_aborting = false;
+  p_entry->pcnt_wait = 0;
+  list_call.push_back (p_entry);
+  __p_call = p_entry;
+
+  if (p_entry->t_end_ns) {
+    watch_start (&_fn_watch);
+    pthread_cond_signal (&cond_watch);
+    }
+  pthread_mutex_unlock (&mutex_cancel);
+}
+
+// ***************************************************************************
+// Vxi11CancelCall destructor - Remove the call from the list
+// ***************************************************************************
+  Vxi11CancelCall::
+~Vxi11CancelCall ()
+{
+  if (!_p_call)
+    return;
+
+  pthread_mutex_lock (&mutex_cancel);
+  while (_p_call->b_aborting)           // The link may be closed after this
+    pthread_cond_wait (&cond_abort, &mutex_cancel);
+  list_call.remove (_p_call);
+  pthread_mutex_unlock (&mutex_cancel);
+  delete _p_call;
+}
+
+// ***************************************************************************
+// Vxi11CancelCall::abort_all - Send device_abort for the calls of a token
+//
+// Parameters:
+// 1. p_cancel - Token, already cancelled
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11CancelCall::
+abort_all (Vxi11Cancel *p_cancel)
+{
+  std::vector<Vxi11CancelEntry *> a_p_entry;
+  int cnt_wait = 0;                     // Aborts not sent yet
+
+  pthread_mutex_lock (&mutex_cancel);
+  std::list<Vxi11CancelEntry *>::iterator it;
+  for (it = list_call.begin (); it != list_call.end (); ++it)
+    if ((*it)->p_cancel == p_cancel && !(*it)->b_aborting) {
+      (*it)->b_aborting = true;
+      a_p_entry.push_back (*it);
+      }
+  if (!a_p_entry.empty ()) {
+    watch_start (&_fn_watch);           // Retries if a call does not end
+    cancel_abort (a_p_entry, &cnt_wait);
+    }
+  pthread_mutex_unlock (&mutex_cancel);
+}
+
+// ***************************************************************************
+// Vxi11CancelCall::_fn_watch - Private static watchdog thread function
+//
+// Parameters:
+// 1. p_arg - Not used
+//
+// Returns: Never
+//
+// Notes: Sleeps until the earliest deadline, or the next retry of a call
+//        already aborted, then starts sending device_abort for the calls
+//        due, and goes back to sleep.
+// ***************************************************************************
+  void *Vxi11CancelCall::
+_fn_watch (void *p_arg)
+{
+  std::vector<Vxi11CancelEntry *> a_p_entry;
+
+  pthread_mutex_lock (&mutex_cancel);
+  for (;;) {
+    long long t_now_ns = Vxi11Tracer::time_ns ();
+    long long t_next_ns = 0;
+    a_p_entry.clear ();
+    std::list<Vxi11CancelEntry *>::iterator it;
+    for (it = list_call.begin (); it != list_call.end (); ++it) {
+      Vxi11CancelEntry *p_entry = *it;
+      if (p_entry->b_aborting)
+        continue;
+
+      // Abort if the deadline passed or the token was cancelled, again
+      // after ABORT_RETRY_NS if the call did not end
+      bool b_due = (p_entry->t_end_ns && (t_now_ns >= p_entry->t_end_ns)) ||
+                   (p_entry->p_cancel &&
+                    p_entry->p_cancel->_cancelled (t_now_ns));
+      bool b_retry = !p_entry->t_abort_ns ||
+                     (t_now_ns - p_entry->t_abort_ns >= ABORT_RETRY_NS);
+      if (b_due && b_retry) {
+        p_entry->b_aborting = true;
+        a_p_entry.push_back (p_entry);
+        continue;
+        }
+      long long t_ns = (b_due) ? p_entry->t_abort_ns + ABORT_RETRY_NS :
+                                 p_entry->t_end_ns;
+      if (t_ns && (!t_next_ns || t_ns < t_next_ns))
+        t_next_ns = t_ns;
+      }
+
+    if (!a_p_entry.empty ()) {
+      cancel_abort (a_p_entry, 0);      // Without waiting for the devices
+      continue;
+      }
+
+    // Sleep until the next deadline, or until a call is added
+    if (!t_next_ns)
+      pthread_cond_wait (&cond_watch, &mutex_cancel);
+    else {
+      timespec ts;                      // pthread_cond_timedwait() uses
+      clock_gettime (CLOCK_REALTIME, &ts); // CLOCK_REALTIME
+      long long t_wake_ns = (long long)ts.tv_sec * 1000000000LL +
+                            ts.tv_nsec + (t_next_ns - t_now_ns);
+      ts.tv_sec = t_wake_ns / 1000000000LL;
+      ts.tv_nsec = t_wake_ns % 1000000000LL;
+      pthread_cond_timedwait (&cond_watch, &mutex_cancel, &ts);
+      }
+    }
+
+  return (0);
+}
@@ -0,0 +1,114 @@
+#ifndef VXI11_CANCEL_H
+#define VXI11_CANCEL_H
+
+// ***************************************************************************
+// vxi11_cancel.h - Cancellation tokens and call deadlines, for libvxi11.so
+//                  library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// A Vxi11Cancel token stops the calls of the links that watch it, from any
+// thread, such as a watchdog:
+//
+//   Vxi11Cancel cancel;
+//   vxi11.cancel_token (&cancel);        // Opens the abort channel now
+//   vxi11.call_deadline (2.0);           // No call longer than 2 s
+//   ...
+//   cancel.cancel ();                    // On the watchdog thread
+//
+// cancel() sends device_abort on the abort channel of each link with a call
+// in progress, so the device ends the call and the caller gets an error
+// right away, instead of after its timeout.  The link stays open and can be
+// used again.  The calls made after cancel() fail without calling the
+// device, until reset().  deadline() cancels the token at a later time.
+//
+// call_deadline() of a link limits each of its calls, with or without a
+// token, the same way.  Deadlines are kept by one watchdog thread, started
+// by the first call with a deadline; a device that did not end the call is
+// sent device_abort again every 100 ms.  Each device_abort is sent on its
+// own thread with a short RPC timeout, so a device that does not reply
+// does not hold up the deadlines of the other links.  If it gets no reply,
+// the core channel of the link is shut down, so the call returns at once;
+// the link must then be opened again.
+//
+// Only VXI-11 links have an abort channel; the calls of HiSLIP and raw
+// socket links still fail after cancel(), but a call in progress runs to
+// its timeout.
+// ***************************************************************************
+
+#include "libvxi11.h"
+
+// ***************************************************************************
+// Vxi11Cancel - Cancellation token shared by any number of links
+// ***************************************************************************
+class Vxi11Cancel {
+  friend class Vxi11CancelCall;
+
+ private:
+  bool _b_cancel;                       // cancel() called
+  long long _t_deadline_ns;             // Time to cancel at, 0 if none
+
+  bool _cancelled (long long t_now_ns); // Cancelled, with the mutex locked
+
+ public:
+  Vxi11Cancel (void);
+
+  // Must not be watched by a link any more
+  ~Vxi11Cancel ();
+
+  // Abort the calls in progress of the links watching this token, and fail
+  // their next calls
+  void cancel (void);
+
+  // Cancel d_time seconds from now, < 0 for never
+  void deadline (double d_time);
+
+  // Clear cancel() and deadline(), so the links can be used again
+  void reset (void);
+
+  // true if cancel() was called or the deadline passed
+  bool cancelled (void);
+};
+
+// ***************************************************************************
+// Vxi11CancelCall - One call of a link watched by the watchdog, for the
+//                   functions of BasicVxi11
+//
+// Create a local instance after locking the RPC mutex, and return an error
+// if cancelled() is true.  Nothing is done if the link has no token and no
+// call deadline.
+// ***************************************************************************
+class Vxi11CancelCall {
+  friend class Vxi11Cancel;
+
+ private:
+  void *__p_call;                       // Entry in the list of calls, type
+                                        // Vxi11CancelEntry*, null if none
+  bool _b_cancelled;                    // Token already cancelled
+
+  static void *_fn_watch (void *p_arg); // Watchdog thread function
+
+ public:
+  // pfn_abort sends device_abort for p_vxi11, on another thread
+  // d_limit = longest time of the call in seconds, < 0 for no limit
+  Vxi11CancelCall (Vxi11Common *p_vxi11, Vxi11Cancel *p_cancel,
+                   double d_limit, int (*pfn_abort) (Vxi11Common *));
+
+  // Waits for an abort being sent for this call
+  ~Vxi11CancelCall ();
+
+  // true if the token was cancelled before the call
+  bool cancelled (void) { return (_b_cancelled); }
+
+  // Abort the calls of p_cancel, for Vxi11Cancel::cancel()
+  static void abort_all (Vxi11Cancel *p_cancel);
+};
+
+#endif
@@ -0,0 +1,630 @@
+// ***************************************************************************
+// vxi11_executor.cpp - Per-link job queues on a thread pool, for libvxi11.so
+//                      library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "vxi11_executor.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+// Macro to conveniently access the __p_pool member of Vxi11Executor
+#define _p_pool         ((Vxi11Pool *)__p_pool)
+
+// ***************************************************************************
+// Vxi11JobDone - Mutex and condition of a job, for Vxi11Job::wait()
+// ***************************************************************************
+struct Vxi11JobDone {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+// ***************************************************************************
+// Vxi11LinkQueue - Jobs of one link, in the order submitted
+//
+// b_scheduled is true while the queue is on the deque of a thread or being
+// run, so only one thread runs the jobs of a link at a time.
+// ***************************************************************************
+struct Vxi11LinkQueue {
+  Vxi11 *p_vxi11;                       // Link
+  pthread_mutex_t mutex;                // For the members below
+  std::deque<Vxi11Job *> a_p_job;       // Jobs not run yet
+  bool b_scheduled;                     // On a deque or being run
+};
+
+struct Vxi11Pool;
+
+// ***************************************************************************
+// Vxi11Worker - Thread of the pool, with its deque of links to run
+//
+// The thread takes links from the back of its own deque, and steals from
+// the front of the deques of the other threads.
+// ***************************************************************************
+struct Vxi11Worker {
+  Vxi11Pool *p_pool;                    // Pool of this thread
+  int idx;                              // Index in Vxi11Pool::a_p_worker
+  pthread_t pthread;
+  bool b_started;                       // pthread was created
+  pthread_mutex_t mutex;                // For a_p_queue
+  std::deque<Vxi11LinkQueue *> a_p_queue; // Links with jobs to run
+};
+
+// ***************************************************************************
+// Vxi11Pool - State of a Vxi11Executor
+// ***************************************************************************
+struct Vxi11Pool {
+  pthread_mutex_t mutex;                // For the members below
+  pthread_cond_t cond_ready;            // A link was put on a deque, or stop
+  pthread_cond_t cond_idle;             // All jobs have run
+  int cnt_ready;                        // Links on the deques
+  long cnt_pending;                     // Jobs submitted and not finished
+  bool b_stop;                          // Threads are stopping
+  unsigned int idx_next;                // Thread for the next link submitted
+                                        // from outside the pool
+  int cnt_batch_max;                    // Jobs run per link at a time
+  int cnt_started;                      // Threads created
+  Vxi11ExecutorStats stats;             // Counters
+  std::map<Vxi11 *, Vxi11LinkQueue *> map_queue; // Queue of each link
+  std::vector<Vxi11Worker *> a_p_worker;// Threads
+};
+
+// Thread of the pool running on this thread, null if none
+static __thread Vxi11Worker *_p_worker_self = 0;
+
+// ***************************************************************************
+// Vxi11Job constructor - Not submitted yet
+// ***************************************************************************
+  Vxi11Job::
+Vxi11Job (void)
+{
+  Vxi11JobDone *p_done = new Vxi11JobDone;
+  pthread_mutex_init (&p_done->mutex, NULL);
+  pthread_cond_init (&p_done->cond, NULL);
+  _p_done = p_done;
+  _b_done = true;
+  _err = 0;
+}
+
+// ***************************************************************************
+// Vxi11Job destructor - Release the mutex and condition
+// ***************************************************************************
+  Vxi11Job::
+~Vxi11Job ()
+{
+  Vxi11JobDone *p_done = (Vxi11JobDone *)_p_done;
+  pthread_cond_destroy (&p_done->cond);
+  pthread_mutex_destroy (&p_done->mutex);
+  delete p_done;
+}
+
+// ***************************************************************************
+// Vxi11Job::_finish - Set the result of the job and wake up wait()
+//
+// Parameters:
+// 1. err - Result of run()
+//
+// Returns: None
+//
+// Notes: The job may be deleted by its owner as soon as this returns.
+// ***************************************************************************
+  void Vxi11Job::
+_finish (int err)
+{
+  Vxi11JobDone *p_done = (Vxi11JobDone *)_p_done;
+  pthread_mutex_lock (&p_done->mutex);
+  _err = err;
+  _b_done = true;
+  pthread_cond_broadcast (&p_done->cond);
+  pthread_mutex_unlock (&p_done->mutex);
+}
+
+// ***************************************************************************
+// Vxi11Job::wait - Wait until the job has run
+//
+// Parameters: None
+//
+// Returns: Result of run(), 0 = no error
+//          Returns at once if the job was not submitted.
+// ***************************************************************************
+  int Vxi11Job::
+wait (void)
+{
+  Vxi11JobDone *p_done = (Vxi11JobDone *)_p_done;
+  pthread_mutex_lock (&p_done->mutex);
+  while (!_b_done)
+    pthread_cond_wait (&p_done->cond, &p_done->mutex);
+  int err = _err;
+  pthread_mutex_unlock (&p_done->mutex);
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11Job::done - Check whether the job has run, without waiting
+//
+// Parameters: None
+//
+// Returns: true if the job has run, or was not submitted
+// ***************************************************************************
+  bool Vxi11Job::
+done (void)
+{
+  Vxi11JobDone *p_done = (Vxi11JobDone *)_p_done;
+  pthread_mutex_lock (&p_done->mutex);
+  bool b_done = _b_done;
+  pthread_mutex_unlock (&p_done->mutex);
+  return (b_done);
+}
+
+// ***************************************************************************
+// Vxi11JobWrite constructor
+//
+// Parameters:
+// 1. s_data  - String to write
+// 2. b_merge - true = may be merged with the writes queued before and after
+// ***************************************************************************
+  Vxi11JobWrite::
+Vxi11JobWrite (const char *s_data, bool b_merge)
+  : _s_data (s_data)
+{
+  _b_merge = b_merge;
+}
+
+// ***************************************************************************
+// Vxi11JobWrite::run - Write the string, with the strings merged into it
+//
+// Parameters:
+// 1. p_vxi11 - Link
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11JobWrite::
+run (Vxi11 *p_vxi11)
+{
+  return (p_vxi11->write (_s_data.data (), int (_s_data.size ())));
+}
+
+// ***************************************************************************
+// Vxi11JobWrite::merge - Merge a write queued after this one
+//
+// Parameters:
+// 1. p_job - Next job of the link
+//
+// Returns: true if p_job is a write that was merged into this job
+//
+// Notes: The strings are joined with a line feed, the program message
+//        terminator of IEEE 488.2, so the device sees the same messages.
+// ***************************************************************************
+  bool Vxi11JobWrite::
+merge (Vxi11Job *p_job)
+{
+  Vxi11JobWrite *p_write = dynamic_cast<Vxi11JobWrite *> (p_job);
+  if (!_b_merge || !p_write || !p_write->_b_merge)
+    return (false);
+
+  if (!_s_data.empty () && _s_data[_s_data.size () - 1] != '\n')
+    _s_data += '\n';
+  _s_data += p_write->_s_data;
+  return (true);
+}
+
+// ***************************************************************************
+// Vxi11JobQuery constructor
+//
+// Parameters:
+// 1. s_query      - Query string to write
+// 2. len_resp_max - Largest response to read, in bytes
+// ***************************************************************************
+  Vxi11JobQuery::
+Vxi11JobQuery (const char *s_query, int len_resp_max)
+  : _s_query (s_query)
+{
+  _len_resp_max = (len_resp_max > 0) ? len_resp_max : 1;
+}
+
+// ***************************************************************************
+// Vxi11JobQuery::run - Write the query and read the response
+//
+// Parameters:
+// 1. p_vxi11 - Link
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11JobQuery::
+run (Vxi11 *p_vxi11)
+{
+  _s_resp.assign (_len_resp_max, 0);
+  int cnt_read = 0;
+  int err = p_vxi11->write (_s_query.data (), int (_s_query.size ()));
+  if (!err)
+    err = p_vxi11->read (&_s_resp[0], _len_resp_max, &cnt_read);
+  _s_resp.resize (cnt_read);
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11JobReadstb::run - Read the status byte
+//
+// Parameters:
+// 1. p_vxi11 - Link
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11JobReadstb::
+run (Vxi11 *p_vxi11)
+{
+  _stb = p_vxi11->readstb ();
+  return (_stb < 0);
+}
+
+// ***************************************************************************
+// schedule - Put a link with jobs on the deque of a thread
+//
+// Parameters:
+// 1. p_pool  - Pool
+// 2. p_queue - Link, with b_scheduled already set
+//
+// Returns: None
+//
+// Notes: A thread of the pool uses its own deque, so the links submitted
+//        by a job stay on that thread; others are spread over the threads.
+// ***************************************************************************
+static void
+schedule (Vxi11Pool *p_pool, Vxi11LinkQueue *p_queue)
+{
+  Vxi11Worker *p_worker = _p_worker_self;
+  if (!p_worker || p_worker->p_pool != p_pool) {
+    pthread_mutex_lock (&p_pool->mutex);
+    p_worker = p_pool->a_p_worker[p_pool->idx_next++ %
+                                  p_pool->a_p_worker.size ()];
+    pthread_mutex_unlock (&p_pool->mutex);
+    }
+
+  pthread_mutex_lock (&p_worker->mutex);
+  p_worker->a_p_queue.push_back (p_queue);
+  pthread_mutex_unlock (&p_worker->mutex);
+
+  pthread_mutex_lock (&p_pool->mutex);
+  p_pool->cnt_ready++;
+  pthread_cond_signal (&p_pool->cond_ready);
+  pthread_mutex_unlock (&p_pool->mutex);
+}
+
+// ***************************************************************************
+// take - Take a link to run, from the own deque or from another thread
+//
+// Parameters:
+// 1. p_worker - Thread taking the link
+//
+// Returns: Link, null if all deques are empty
+// ***************************************************************************
+static Vxi11LinkQueue *
+take (Vxi11Worker *p_worker)
+{
+  Vxi11Pool *p_pool = p_worker->p_pool;
+  Vxi11LinkQueue *p_queue = 0;
+  bool b_steal = false;
+
+  pthread_mutex_lock (&p_worker->mutex);
+  if (!p_worker->a_p_queue.empty ()) {
+    p_queue = p_worker->a_p_queue.back ();
+    p_worker->a_p_queue.pop_back ();
+    }
+  pthread_mutex_unlock (&p_worker->mutex);
+
+  int cnt_worker = int (p_pool->a_p_worker.size ());
+  for (int i=1; i < cnt_worker && !p_queue; i++) {
+    Vxi11Worker *p_victim = p_pool->a_p_worker[(p_worker->idx + i) %
+                                                cnt_worker];
+    pthread_mutex_lock (&p_victim->mutex);
+    if (!p_victim->a_p_queue.empty ()) {
+      p_queue = p_victim->a_p_queue.front ();
+      p_victim->a_p_queue.pop_front ();
+      b_steal = true;
+      }
+    pthread_mutex_unlock (&p_victim->mutex);
+    }
+
+  if (p_queue) {
+    pthread_mutex_lock (&p_pool->mutex);
+    p_pool->cnt_ready--;
+    p_pool->stats.cnt_steal += b_steal;
+    pthread_mutex_unlock (&p_pool->mutex);
+    }
+  return (p_queue);
+}
+
+// ***************************************************************************
+// Vxi11Executor::_run_queue - Run the jobs of a link
+//
+// Parameters:
+// 1. p_worker - Thread running the jobs
+// 2. p_queue  - Link
+//
+// Returns: None
+//
+// Notes: At most cnt_batch_max jobs are run; if more are left, the link
+//        goes to the front of the deque, behind the other links.
+// ***************************************************************************
+  void Vxi11Executor::
+_run_queue (Vxi11Worker *p_worker, Vxi11LinkQueue *p_queue)
+{
+  Vxi11Pool *p_pool = p_worker->p_pool;
+  std::vector<Vxi11Job *> a_p_merged;
+
+  for (int cnt=0; cnt < p_pool->cnt_batch_max; ) {
+    // Take the next job, and merge the jobs after it into it
+    pthread_mutex_lock (&p_queue->mutex);
+    if (p_queue->a_p_job.empty ()) {
+      p_queue->b_scheduled = false;
+      pthread_mutex_unlock (&p_queue->mutex);
+      return;
+      }
+    Vxi11Job *p_job = p_queue->a_p_job.front ();
+    p_queue->a_p_job.pop_front ();
+    a_p_merged.clear ();
+    while (!p_queue->a_p_job.empty () &&
+           p_job->merge (p_queue->a_p_job.front ())) {
+      a_p_merged.push_back (p_queue->a_p_job.front ());
+      p_queue->a_p_job.pop_front ();
+      }
+    pthread_mutex_unlock (&p_queue->mutex);
+
+    int err = p_job->run (p_queue->p_vxi11);
+    p_job->_finish (err);
+    for (size_t i=0; i < a_p_merged.size (); i++)
+      a_p_merged[i]->_finish (err);
+
+    int cnt_job = 1 + int (a_p_merged.size ());
+    cnt += cnt_job;
+    pthread_mutex_lock (&p_pool->mutex);
+    p_pool->stats.cnt_job += cnt_job;
+    p_pool->stats.cnt_merge += cnt_job - 1;
+    p_pool->cnt_pending -= cnt_job;
+    if (!p_pool->cnt_pending)
+      pthread_cond_broadcast (&p_pool->cond_idle);
+    pthread_mutex_unlock (&p_pool->mutex);
+    }
+
+  // Let the other links run first
+  pthread_mutex_lock (&p_worker->mutex);
+  p_worker->a_p_queue.push_front (p_queue);
+  pthread_mutex_unlock (&p_worker->mutex);
+  pthread_mutex_lock (&p_pool->mutex);
+  p_pool->cnt_ready++;
+  pthread_mutex_unlock (&p_pool->mutex);
+}
+
+// ***************************************************************************
+// Vxi11Executor::_fn_worker - Thread function of the pool
+//
+// Parameters:
+// 1. p_arg - Thread, type Vxi11Worker*
+//
+// Returns: Null
+// ***************************************************************************
+  void *Vxi11Executor::
+_fn_worker (void *p_arg)
+{
+  Vxi11Worker *p_worker = (Vxi11Worker *)p_arg;
+  Vxi11Pool *p_pool = p_worker->p_pool;
+  _p_worker_self = p_worker;
+
+  while (true) {
+    Vxi11LinkQueue *p_queue = take (p_worker);
+    if (p_queue) {
+      _run_queue (p_worker, p_queue);
+      continue;
+      }
+
+    // Sleep until a link is ready
+    pthread_mutex_lock (&p_pool->mutex);
+    while (!p_pool->cnt_ready && !p_pool->b_stop)
+      pthread_cond_wait (&p_pool->cond_ready, &p_pool->mutex);
+    bool b_stop = (p_pool->b_stop && !p_pool->cnt_ready);
+    pthread_mutex_unlock (&p_pool->mutex);
+    if (b_stop)
+      break;
+    }
+
+  _p_worker_self = 0;
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Executor constructor - Start the threads
+//
+// Parameters:
+// 1. cnt_thread    - Number of threads
+// 2. cnt_batch_max - Jobs of one link run before letting other links of the
+//                    same thread run
+//
+// Notes: If some threads cannot be created, the links put on their deques
+//        are stolen by the others.  If none can, submit() fails.
+// ***************************************************************************
+  Vxi11Executor::
+Vxi11Executor (int cnt_thread, int cnt_batch_max)
+{
+  Vxi11Pool *p_pool = new Vxi11Pool;
+  pthread_mutex_init (&p_pool->mutex, NULL);
+  pthread_cond_init (&p_pool->cond_ready, NULL);
+  pthread_cond_init (&p_pool->cond_idle, NULL);
+  p_pool->cnt_ready = 0;
+  p_pool->cnt_pending = 0;
+  p_pool->b_stop = false;
+  p_pool->idx_next = 0;
+  p_pool->cnt_batch_max = (cnt_batch_max > 0) ? cnt_batch_max : 1;
+  p_pool->cnt_started = 0;
+  memset (&p_pool->stats, 0, sizeof (p_pool->stats));
+  __p_pool = p_pool;
+
+  if (cnt_thread < 1)
+    cnt_thread = 1;
+  for (int i=0; i < cnt_thread; i++) {
+    Vxi11Worker *p_worker = new Vxi11Worker;
+    p_worker->p_pool = p_pool;
+    p_worker->idx = i;
+    p_worker->b_started = false;
+    pthread_mutex_init (&p_worker->mutex, NULL);
+    p_pool->a_p_worker.push_back (p_worker);
+    }
+
+  // Start the threads after all deques exist, since they steal from each
+  // other
+  for (int i=0; i < cnt_thread; i++) {
+    Vxi11Worker *p_worker = p_pool->a_p_worker[i];
+    if (pthread_create (&p_worker->pthread, NULL, _fn_worker, p_worker)) {
+      Vxi11::log_err ("Vxi11Executor error: could not create thread.\n");
+      continue;
+      }
+    p_worker->b_started = true;
+    p_pool->cnt_started++;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Executor destructor - Run the jobs already submitted, then stop the
+//                            threads
+// ***************************************************************************
+  Vxi11Executor::
+~Vxi11Executor ()
+{
+  drain ();
+
+  pthread_mutex_lock (&_p_pool->mutex);
+  _p_pool->b_stop = true;
+  pthread_cond_broadcast (&_p_pool->cond_ready);
+  pthread_mutex_unlock (&_p_pool->mutex);
+
+  for (size_t i=0; i < _p_pool->a_p_worker.size (); i++) {
+    Vxi11Worker *p_worker = _p_pool->a_p_worker[i];
+    if (p_worker->b_started)
+      pthread_join (p_worker->pthread, NULL);
+    pthread_mutex_destroy (&p_worker->mutex);
+    delete p_worker;
+    }
+
+  std::map<Vxi11 *, Vxi11LinkQueue *>::iterator it;
+  for (it = _p_pool->map_queue.begin (); it != _p_pool->map_queue.end ();
+       it++) {
+    pthread_mutex_destroy (&it->second->mutex);
+    delete it->second;
+    }
+
+  pthread_cond_destroy (&_p_pool->cond_idle);
+  pthread_cond_destroy (&_p_pool->cond_ready);
+  pthread_mutex_destroy (&_p_pool->mutex);
+  delete _p_pool;
+}
+
+// ***************************************************************************
+// Vxi11Executor::submit - Queue a job on a link
+//
+// Parameters:
+// 1. p_vxi11 - Link to run the job on
+// 2. p_job   - Job, which must not be changed or deleted until its wait()
+//              returns
+//
+// Returns: 0 = no error
+//          1 = error, the executor is stopping, has no threads, or p_job is
+//              still queued
+//
+// Notes: The jobs of a link run in the order they are submitted, from any
+//        thread.  Can be called from a job.
+// ***************************************************************************
+  int Vxi11Executor::
+submit (Vxi11 *p_vxi11, Vxi11Job *p_job)
+{
+  Vxi11JobDone *p_done = (Vxi11JobDone *)p_job->_p_done;
+  pthread_mutex_lock (&p_done->mutex);
+  bool b_queued = !p_job->_b_done;
+  p_job->_b_done = false;
+  pthread_mutex_unlock (&p_done->mutex);
+  if (b_queued) {
+    Vxi11::log_err ("Vxi11Executor::submit error: job already queued.\n");
+    return (1);
+    }
+
+  // Get the queue of the link
+  pthread_mutex_lock (&_p_pool->mutex);
+  if (_p_pool->b_stop) {
+    pthread_mutex_unlock (&_p_pool->mutex);
+    p_job->_finish (1);
+    Vxi11::log_err ("Vxi11Executor::submit error: executor is stopping.\n");
+    return (1);
+    }
+  if (!_p_pool->cnt_started) {
+    pthread_mutex_unlock (&_p_pool->mutex);
+    p_job->_finish (1);
+    Vxi11::log_err ("Vxi11Executor::submit error: no threads.\n");
+    return (1);
+    }
+  Vxi11LinkQueue *&p_queue = _p_pool->map_queue[p_vxi11];
+  if (!p_queue) {
+    p_queue = new Vxi11LinkQueue;
+    p_queue->p_vxi11 = p_vxi11;
+    pthread_mutex_init (&p_queue->mutex, NULL);
+    p_queue->b_scheduled = false;
+    }
+  Vxi11LinkQueue *p_queue_link = p_queue;
+  _p_pool->cnt_pending++;
+  pthread_mutex_unlock (&_p_pool->mutex);
+
+  // Queue the job, and schedule the link if it has no other jobs
+  pthread_mutex_lock (&p_queue_link->mutex);
+  p_queue_link->a_p_job.push_back (p_job);
+  bool b_schedule = !p_queue_link->b_scheduled;
+  p_queue_link->b_scheduled = true;
+  pthread_mutex_unlock (&p_queue_link->mutex);
+
+  if (b_schedule)
+    schedule (_p_pool, p_queue_link);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Executor::drain - Wait until all jobs submitted so far have run
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Must not be called from a job, which would wait for itself.
+// ***************************************************************************
+  void Vxi11Executor::
+drain (void)
+{
+  pthread_mutex_lock (&_p_pool->mutex);
+  while (_p_pool->cnt_pending)
+    pthread_cond_wait (&_p_pool->cond_idle, &_p_pool->mutex);
+  pthread_mutex_unlock (&_p_pool->mutex);
+}
+
+// ***************************************************************************
+// Vxi11Executor::stats - Get the counters
+//
+// Parameters: None
+//
+// Returns: Copy of the counters
+// ***************************************************************************
+  Vxi11ExecutorStats Vxi11Executor::
+stats (void)
+{
+  pthread_mutex_lock (&_p_pool->mutex);
+  Vxi11ExecutorStats stats = _p_pool->stats;
+  pthread_mutex_unlock (&_p_pool->mutex);
+  return (stats);
+}
@@ -0,0 +1,175 @@
+#ifndef VXI11_EXECUTOR_H
+#define VXI11_EXECUTOR_H
+
+// ***************************************************************************
+// vxi11_executor.h - Per-link job queues on a thread pool, for libvxi11.so
+//                    library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// A Vxi11Executor runs jobs on Vxi11 links from any number of producer
+// threads, without locks in the application:
+//
+//   - Each link has its own queue, and its jobs run one at a time in the
+//     order submitted, so the order of the commands to a device is kept.
+//   - The queues of different links run in parallel on a pool of threads.
+//     A link with jobs is put on the deque of one thread; a thread with
+//     nothing left steals links from the other threads.
+//   - Before a job runs, the jobs queued behind it may be merged into it,
+//     for example consecutive writes into one device_write.
+//
+// Jobs derive from Vxi11Job; Vxi11JobWrite, Vxi11JobQuery, Vxi11JobReadstb
+// and Vxi11JobFunc cover the usual operations.  The job belongs to the
+// caller, which must not change or delete it until wait() returns.
+//
+//   Vxi11Executor executor (4);
+//   Vxi11JobWrite job_volt ("VOLT 1.5");
+//   Vxi11JobQuery job_meas ("MEAS:CURR?");
+//   executor.submit (&vxi11, &job_volt);
+//   executor.submit (&vxi11, &job_meas);
+//   job_meas.wait ();
+//
+// A link must only be used through the executor while it has jobs queued.
+// ***************************************************************************
+
+#include "libvxi11.h"
+
+#include <string>
+
+struct Vxi11Worker;
+struct Vxi11LinkQueue;
+
+// ***************************************************************************
+// Vxi11Job - Operation on one link, run by a Vxi11Executor
+// ***************************************************************************
+class Vxi11Job {
+  friend class Vxi11Executor;
+
+ private:
+  void *_p_done;                        // Mutex and condition for wait(),
+                                        // type Vxi11JobDone*
+  bool _b_done;                         // Job finished
+  int _err;                             // Result of run()
+
+  void _finish (int err);               // Set the result, wake up wait()
+
+ public:
+  Vxi11Job (void);
+  virtual ~Vxi11Job ();
+
+  // Run the job on p_vxi11, on a thread of the executor
+  // Returns 0 if no error, as the functions of Vxi11.
+  virtual int run (Vxi11 *p_vxi11) = 0;
+
+  // Merge p_job, queued right after this job on the same link, into this
+  // job; p_job is then finished with the result of this job, without
+  // running
+  // Returns true if merged.  Default is no merging.
+  virtual bool merge (Vxi11Job *p_job) { return (false); }
+
+  // Wait until the job has run, and get its result
+  int wait (void);
+
+  // true if the job has run, without waiting
+  bool done (void);
+};
+
+// Write a string to the device
+// Consecutive writes with b_merge true are merged into one device_write,
+// joined with line feeds, which end each program message as in IEEE 488.2.
+class Vxi11JobWrite : public Vxi11Job {
+ private:
+  std::string _s_data;                  // Data to write
+  bool _b_merge;                        // Can be merged with other writes
+
+ public:
+  Vxi11JobWrite (const char *s_data, bool b_merge = true);
+  virtual int run (Vxi11 *p_vxi11);
+  virtual bool merge (Vxi11Job *p_job);
+};
+
+// Query for a string, see resp() after wait()
+class Vxi11JobQuery : public Vxi11Job {
+ private:
+  std::string _s_query;                 // Query to write
+  std::string _s_resp;                  // Response read
+  int _len_resp_max;                    // Largest response
+
+ public:
+  Vxi11JobQuery (const char *s_query, int len_resp_max = 4096);
+  virtual int run (Vxi11 *p_vxi11);
+  const std::string &resp (void) { return (_s_resp); }
+};
+
+// Read the status byte, see stb() after wait()
+class Vxi11JobReadstb : public Vxi11Job {
+ private:
+  int _stb;                             // Status byte, -1 if error
+
+ public:
+  Vxi11JobReadstb (void) { _stb = -1; }
+  virtual int run (Vxi11 *p_vxi11);
+  int stb (void) { return (_stb); }
+};
+
+// Call a function with the link, for any other operation
+class Vxi11JobFunc : public Vxi11Job {
+ private:
+  int (*_pfn) (Vxi11 *, void *);        // Function to call
+  void *_p_arg;                         // Its argument
+
+ public:
+  Vxi11JobFunc (int (*pfn) (Vxi11 *, void *), void *p_arg = 0) {
+    _pfn = pfn;
+    _p_arg = p_arg;
+    }
+  virtual int run (Vxi11 *p_vxi11) { return (_pfn (p_vxi11, _p_arg)); }
+};
+
+// Counters of a Vxi11Executor, see Vxi11Executor::stats()
+struct Vxi11ExecutorStats {
+  unsigned long cnt_job;                // Jobs finished, including merged
+  unsigned long cnt_merge;              // Jobs merged into another
+  unsigned long cnt_steal;              // Links taken from another thread
+};
+
+// ***************************************************************************
+// Vxi11Executor - Ordered queue per link, on a work-stealing thread pool
+// ***************************************************************************
+class Vxi11Executor {
+ private:
+  void *__p_pool;                       // Threads and queues, type
+                                        // Vxi11Pool*
+                                        // Use macro _p_pool for access
+
+  static void *_fn_worker (void *p_arg);// Thread function of the pool
+  static void _run_queue (Vxi11Worker *p_worker, Vxi11LinkQueue *p_queue);
+                                        // Run the jobs of a link
+
+ public:
+  // Start cnt_thread threads
+  // cnt_batch_max = jobs of one link run before letting other links run
+  Vxi11Executor (int cnt_thread = 4, int cnt_batch_max = 64);
+
+  // Run the jobs already submitted, then stop the threads
+  ~Vxi11Executor ();
+
+  // Queue p_job to run on p_vxi11 after the jobs already queued for it
+  // Returns 1 if the executor is stopping or none of its threads started.
+  int submit (Vxi11 *p_vxi11, Vxi11Job *p_job);
+
+  // Wait until all jobs submitted so far have run
+  void drain (void);
+
+  // Get the counters
+  Vxi11ExecutorStats stats (void);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef VXI11_FWD_H
+#define VXI11_FWD_H
+
+// ***************************************************************************
+// vxi11_fwd.h - Forward declarations of the Vxi11 types, for libvxi11.so
+//               library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Vxi11 is a typedef of the BasicVxi11 template, so it cannot be declared
+// with "class Vxi11;".  A header that only uses pointers or references to
+// it includes this file instead of libvxi11.h:
+//
+//   #include "vxi11_fwd.h"             // Was: class Vxi11;
+//
+//   void measure (Vxi11 *p_vxi11);
+//
+// The code calling the functions of the link includes libvxi11.h.
+// ***************************************************************************
+
+class Vxi11LockGlobal;
+class Vxi11LockNone;
+class Vxi11ErrorLog;
+class Vxi11ErrorNone;
+class Vxi11StatsTrace;
+class Vxi11StatsNone;
+class Vxi11Transport;
+class Vxi11TransportRpc;
+
+// VXI-11 link to one device, see libvxi11.h
+template <class LockPolicy = Vxi11LockGlobal,
+          class ErrorPolicy = Vxi11ErrorLog,
+          class StatsPolicy = Vxi11StatsTrace,
+          class Transport = Vxi11Transport>
+class BasicVxi11;
+
+// Link with every feature, used by most applications
+typedef BasicVxi11<> Vxi11;
+
+// Link with no lock, error logging, tracing or counters, through the
+// built-in transports only
+typedef BasicVxi11<Vxi11LockNone, Vxi11ErrorNone, Vxi11StatsNone,
+                   Vxi11TransportRpc> Vxi11Bare;
+
+#endif
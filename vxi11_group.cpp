@@ -0,0 +1,492 @@
+// ***************************************************************************
+// vxi11_group.cpp - Group of VXI-11 links operated together, for
+//                   libvxi11.so library (Linux only)
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "vxi11_group.h"
+#include "vxi11_rpc.h"
+#include "vxi11_cancel.h"
+#include "vxi11_breaker.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ***************************************************************************
+// InstrumentGroup constructor - No links yet
+//
+// Parameters:
+// 1. cnt_link_max - Number of links with a registered receive buffer
+// 2. b_uring      - true  = use io_uring if the kernel has it (default)
+//                   false = use epoll
+// ***************************************************************************
+  InstrumentGroup::
+InstrumentGroup (int cnt_link_max, bool b_uring)
+  : _uring (cnt_link_max, b_uring)
+{
+}
+
+// ***************************************************************************
+// InstrumentGroup destructor - Close all links
+// ***************************************************************************
+  InstrumentGroup::
+~InstrumentGroup ()
+{
+  close ();
+}
+
+// ***************************************************************************
+// InstrumentGroup::add - Open a link to a device and add it to the group
+//                        VXI-11 RPC is "create_link"
+//
+// Parameters:
+// 1. s_address - IP address or host name of the device, or "host:port"
+// 2. s_device  - Device name, such as "inst0" (default) or "gpib0,5"
+//
+// Returns: 0 = no error
+//          1 = error, the link is not added
+// ***************************************************************************
+  int InstrumentGroup::
+add (const char *s_address, const char *s_device)
+{
+  Vxi11 *p_vxi11 = new Vxi11;
+  Vxi11TransportUring *p_transport = new Vxi11TransportUring (&_uring);
+  if (p_vxi11->open (s_address, s_device, p_transport)) {
+    delete p_vxi11;                     // Transport deleted by open()
+    return (1);
+    }
+
+  _a_p_vxi11.push_back (p_vxi11);
+  _a_p_transport.push_back (p_transport);
+  return (0);
+}
+
+// ***************************************************************************
+// InstrumentGroup::close - Close all links and remove them from the group
+//                          VXI-11 RPC is "destroy_link"
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void InstrumentGroup::
+close (void)
+{
+  for (size_t i=0; i < _a_p_vxi11.size (); i++)
+    delete _a_p_vxi11[i];               // Also deletes the transport
+  _a_p_vxi11.clear ();
+  _a_p_transport.clear ();
+}
+
+// ***************************************************************************
+// InstrumentGroup::_ready - Private function to check that a link can take
+//                           a call of the group
+//
+// Parameters:
+// 1. idx    - Link, in the order added
+// 2. s_func - Name of the calling function, for the error message
+//
+// Returns: true if the call can be made
+//
+// Notes: As for the calls of Vxi11, a link whose cancellation token was
+//        cancelled or whose circuit breaker is open is not called, and the
+//        commands buffered with write_buffer() are sent first.
+// ***************************************************************************
+  bool InstrumentGroup::
+_ready (int idx, const char *s_func)
+{
+  Vxi11 *p_vxi11 = _a_p_vxi11[idx];
+  const char *s_err = 0;
+  if (p_vxi11->cancel_token () && p_vxi11->cancel_token ()->cancelled ())
+    s_err = "cancelled";
+  else if (p_vxi11->breaker () && p_vxi11->breaker ()->reject ())
+    s_err = "circuit open";
+  else if (p_vxi11->flush ())
+    s_err = "buffered commands not sent";
+
+  if (s_err)
+    Vxi11::log_err ("InstrumentGroup::%s error: %s for %s.\n", s_func,
+                    s_err, p_vxi11->device_addr ());
+  return (!s_err);
+}
+
+// ***************************************************************************
+// InstrumentGroup::_call_end - Private function to count the end of a call
+//                              of a link for its circuit breaker
+//
+// Parameters:
+// 1. idx     - Link, in the order added
+// 2. b_reply - true if the call was replied to
+//
+// Returns: None
+// ***************************************************************************
+  void InstrumentGroup::
+_call_end (int idx, bool b_reply)
+{
+  Vxi11Breaker *p_breaker = _a_p_vxi11[idx]->breaker ();
+  if (p_breaker)
+    p_breaker->call_end (b_reply);
+}
+
+// ***************************************************************************
+// InstrumentGroup::trigger_all - Send group execute trigger to all links at
+//                                once
+//                                VXI-11 RPC is "device_trigger"
+//
+// Parameters:
+// 1. pa_trigger - Returns the result of each link, in the order added, if
+//                 not null
+//
+// Returns: Number of links that failed, 0 if all were triggered
+//
+// Notes: The device_trigger calls of all links are encoded before any is
+//        sent, then released together with Vxi11Uring::submit(), so the
+//        skew between the devices is the time to hand the sends to the
+//        kernel rather than a round trip per device.  The skew reported for
+//        each link is its send time after the earliest send of the group.
+//
+//        With io_uring, the kernel makes the sends during one
+//        io_uring_enter(), and the send times are those of the processing
+//        of the completions right after it.  With epoll, each is taken
+//        after its send().
+//
+//        The commands buffered on each link are sent first.  Links that
+//        are cancelled, have their breaker open, or fail that flush are
+//        not triggered.
+// ***************************************************************************
+  int InstrumentGroup::
+trigger_all (std::vector<InstrumentGroupTrigger> *pa_trigger)
+{
+  int cnt_link = size ();
+  std::vector<Device_GenericParms> a_parms (cnt_link);
+  std::vector<Device_Error> a_error (cnt_link);
+  std::vector<bool> a_b_call (cnt_link, false);
+  std::vector<bool> a_b_ready (cnt_link, false);
+
+  // Flush the links before the batch, so the triggers stay together
+  for (int i=0; i < cnt_link; i++)
+    a_b_ready[i] = _ready (i, "trigger_all");
+
+  // Encode all calls first
+  for (int i=0; i < cnt_link; i++) {
+    if (!a_b_ready[i])
+      continue;
+    Vxi11Timeout timeout = _a_p_vxi11[i]->timeout_call (Vxi11::OP_TRIGGER);
+    a_parms[i].lid = _a_p_vxi11[i]->lid (); // Link ID from create_link
+    a_parms[i].io_timeout = timeout.io_ms;  // Timeout for I/O in ms
+    a_parms[i].lock_timeout = timeout.lock_ms; // Timeout for lock in ms
+    a_parms[i].flags = 0;                // Not used
+    memset (&a_error[i], 0, sizeof (Device_Error));
+    a_b_call[i] = !_a_p_transport[i]->call_submit (
+      device_trigger, (xdrproc_t)xdr_Device_GenericParms, &a_parms[i],
+      (xdrproc_t)xdr_Device_Error, &a_error[i]);
+    }
+
+  // Release them together, then wait for all replies
+  _uring.submit ();
+  _uring.wait ();
+
+  // Results
+  int cnt_fail = 0;
+  long long t_first_ns = 0;
+  if (pa_trigger)
+    pa_trigger->resize (cnt_link);
+  for (int i=0; i < cnt_link; i++) {
+    long long t_sent_ns = (a_b_call[i]) ? _a_p_transport[i]->t_sent_ns () : 0;
+    if (t_sent_ns && (!t_first_ns || t_sent_ns < t_first_ns))
+      t_first_ns = t_sent_ns;
+
+    int err = (a_b_ready[i]) ? -1 : -3;
+    if (a_b_call[i] && _a_p_transport[i]->call_result () == RPC_SUCCESS)
+      err = int (a_error[i].error);
+    if (a_b_ready[i])
+      _call_end (i, err != -1);
+    if (err == -1)
+      Vxi11::log_err ("InstrumentGroup::trigger_all error: no RPC response "
+                      "for %s: %s.\n", _a_p_vxi11[i]->device_addr (),
+                      _a_p_transport[i]->error ());
+    else if (err && (err != -3))        // -3 logged by _ready()
+      Vxi11::log_err ("InstrumentGroup::trigger_all error: %d for %s.\n",
+                      err, _a_p_vxi11[i]->device_addr ());
+    cnt_fail += (err != 0);
+
+    if (pa_trigger) {
+      (*pa_trigger)[i].err = err;
+      (*pa_trigger)[i].t_sent_ns = t_sent_ns;
+      }
+    }
+
+  if (pa_trigger)
+    for (int i=0; i < cnt_link; i++) {
+      InstrumentGroupTrigger &trigger = (*pa_trigger)[i];
+      trigger.t_skew_ns = (trigger.t_sent_ns) ?
+                          trigger.t_sent_ns - t_first_ns : 0;
+      }
+
+  return (cnt_fail);
+}
+
+// ***************************************************************************
+// InstrumentGroup::_query_all - Send a query to all links at once and read
+//                               the reply of each
+//                               VXI-11 RPCs are "device_write" and
+//                               "device_read"
+//
+// Parameters:
+// 1. s_query  - Query string to send to each device
+// 2. a_s_resp - Returns the reply of each link, empty if error
+// 3. a_err    - Returns the error of each link, see InstrumentGroupValue
+//
+// Returns: Number of links that failed, 0 if none
+//
+// Notes: The device_write calls of all links are made together, then the
+//        device_read calls of the links that were written, repeated for
+//        the links whose reply has not ended, so the time is that of the
+//        slowest device.  Each link uses its own timeout and read
+//        terminator.  The query is sent with one device_write, since every
+//        VXI-11 device takes at least 1024 bytes at once.
+//
+//        The commands buffered on each link are sent first.  Links that
+//        are cancelled, have their breaker open, or fail that flush are
+//        not written to.
+// ***************************************************************************
+  int InstrumentGroup::
+_query_all (const char *s_query, std::vector<std::string> &a_s_resp,
+            std::vector<int> &a_err)
+{
+  int cnt_link = size ();
+  a_s_resp.assign (cnt_link, std::string ());
+  a_err.assign (cnt_link, 0);
+
+  int len_query = strlen (s_query);
+  if (len_query > 1024) {
+    Vxi11::log_err ("InstrumentGroup::query_all error: query longer than "
+                    "1024 bytes.\n");
+    a_err.assign (cnt_link, -2);
+    return (cnt_link);
+    }
+
+  // Flush the links before the batch
+  for (int i=0; i < cnt_link; i++)
+    if (!_ready (i, "query_all"))
+      a_err[i] = -3;
+
+  // Send the query to all links
+  std::vector<Device_WriteParms> a_writeParms (cnt_link);
+  std::vector<Device_WriteResp> a_writeResp (cnt_link);
+  std::vector<bool> a_b_write (cnt_link, false); // Query sent
+  for (int i=0; i < cnt_link; i++) {
+    if (a_err[i])
+      continue;
+    Vxi11Timeout timeout = _a_p_vxi11[i]->timeout_call (Vxi11::OP_WRITE);
+    Device_WriteParms &writeParms = a_writeParms[i];
+    writeParms.lid = _a_p_vxi11[i]->lid (); // Link ID from create_link
+    writeParms.io_timeout = timeout.io_ms;  // Timeout for I/O in ms
+    writeParms.lock_timeout = timeout.lock_ms; // Timeout for lock in ms
+    writeParms.flags = 8;                 // Indicate this is the end of data
+    writeParms.data.data_len = len_query;
+    writeParms.data.data_val = (char *)s_query;
+    memset (&a_writeResp[i], 0, sizeof (Device_WriteResp));
+    if (_a_p_transport[i]->call_submit (
+          device_write, (xdrproc_t)xdr_Device_WriteParms, &writeParms,
+          (xdrproc_t)xdr_Device_WriteResp, &a_writeResp[i]))
+      a_err[i] = -1;
+    else
+      a_b_write[i] = true;
+    }
+  _uring.wait ();
+
+  std::vector<bool> a_b_read (cnt_link, false); // Reply not ended yet
+  for (int i=0; i < cnt_link; i++) {
+    if (!a_b_write[i])
+      continue;
+    if (_a_p_transport[i]->call_result () != RPC_SUCCESS)
+      a_err[i] = -1;
+    else
+      a_err[i] = int (a_writeResp[i].error);
+    _call_end (i, a_err[i] != -1);
+    a_b_read[i] = !a_err[i];
+    }
+
+  // Read the replies until each has ended
+  std::vector<Device_ReadParms> a_readParms (cnt_link);
+  std::vector<Device_ReadResp> a_readResp (cnt_link);
+  for (int i=0; i < cnt_link; i++) {
+    Vxi11Timeout timeout = _a_p_vxi11[i]->timeout_call (Vxi11::OP_READ);
+    signed char c_term = _a_p_vxi11[i]->read_terminator ();
+    Device_ReadParms &readParms = a_readParms[i];
+    readParms.lid = _a_p_vxi11[i]->lid (); // Link ID from create_link
+    readParms.requestSize = Vxi11Uring::LEN_BUF_FIXED - 256;
+    readParms.io_timeout = timeout.io_ms;   // Timeout for I/O in ms
+    readParms.lock_timeout = timeout.lock_ms; // Timeout for lock in ms
+    readParms.flags = (c_term == -1) ? 0 : 128; // Use termination character
+    readParms.termChar = (c_term == -1) ? 0 : char (c_term);
+    }
+
+  bool b_read = true;
+  while (b_read) {
+    for (int i=0; i < cnt_link; i++) {
+      if (!a_b_read[i])
+        continue;
+      memset (&a_readResp[i], 0, sizeof (Device_ReadResp));
+      if (_a_p_transport[i]->call_submit (
+            device_read, (xdrproc_t)xdr_Device_ReadParms, &a_readParms[i],
+            (xdrproc_t)xdr_Device_ReadResp, &a_readResp[i])) {
+        a_err[i] = -1;
+        a_b_read[i] = false;
+        }
+      }
+    _uring.wait ();
+
+    b_read = false;
+    for (int i=0; i < cnt_link; i++) {
+      if (!a_b_read[i])
+        continue;
+      Vxi11TransportUring *p_transport = _a_p_transport[i];
+      Device_ReadResp &readResp = a_readResp[i];
+      if (p_transport->call_result () != RPC_SUCCESS) {
+        a_err[i] = -1;
+        a_b_read[i] = false;
+        _call_end (i, false);
+        continue;
+        }
+      _call_end (i, true);
+      a_s_resp[i].append (readResp.data.data_val, readResp.data.data_len);
+      a_err[i] = int (readResp.error);
+
+      // Done at END, or at the termination character, as in Vxi11::read()
+      bool b_end = (_a_p_vxi11[i]->read_terminator () == -1) ?
+                   (readResp.reason & 4) : (readResp.reason & 2);
+      if (!a_err[i] && !b_end && a_s_resp[i].size () > LEN_RESP_MAX)
+        a_err[i] = -2;
+      a_b_read[i] = (!a_err[i] && !b_end);
+      b_read |= a_b_read[i];
+      p_transport->free_result ((xdrproc_t)xdr_Device_ReadResp, &readResp);
+      }
+    }
+
+  // Errors
+  int cnt_fail = 0;
+  for (int i=0; i < cnt_link; i++) {
+    if (!a_err[i])
+      continue;
+    cnt_fail++;
+    a_s_resp[i].clear ();
+    if (a_err[i] == -1)
+      Vxi11::log_err ("InstrumentGroup::query_all error: no RPC response "
+                      "for %s: %s.\n", _a_p_vxi11[i]->device_addr (),
+                      _a_p_transport[i]->error ());
+    else if (a_err[i] == -2)
+      Vxi11::log_err ("InstrumentGroup::query_all error: reply longer than "
+                      "%d bytes for %s.\n", int (LEN_RESP_MAX),
+                      _a_p_vxi11[i]->device_addr ());
+    else if (a_err[i] != -3)            // -3 logged by _ready()
+      Vxi11::log_err ("InstrumentGroup::query_all error: %d for %s.\n",
+                      a_err[i], _a_p_vxi11[i]->device_addr ());
+    }
+
+  return (cnt_fail);
+}
+
+// ***************************************************************************
+// InstrumentGroup::query_all - Send query for a double to all links at once
+//                              VXI-11 RPCs are "device_write" and
+//                              "device_read"
+//
+// Parameters:
+// 1. s_query - Query string to send to each device
+// 2. a_val   - Returns the value read from each link, in the order added
+//
+// Returns: Number of links that failed, 0 if none
+// ***************************************************************************
+  int InstrumentGroup::
+query_all (const char *s_query,
+           std::vector<InstrumentGroupValue<double> > &a_val)
+{
+  std::vector<std::string> a_s_resp;
+  std::vector<int> a_err;
+  int cnt_fail = _query_all (s_query, a_s_resp, a_err);
+
+  a_val.resize (size ());
+  for (int i=0; i < size (); i++) {
+    a_val[i].err = a_err[i];
+    a_val[i].val = 0.0;
+    if (!a_err[i] &&
+        sscanf (a_s_resp[i].c_str (), "%le", &a_val[i].val) != 1) {
+      a_val[i].val = 0.0;
+      a_val[i].err = -2;
+      cnt_fail++;
+      }
+    }
+
+  return (cnt_fail);
+}
+
+// ***************************************************************************
+// InstrumentGroup::query_all - Send query for an integer to all links at
+//                              once
+//                              VXI-11 RPCs are "device_write" and
+//                              "device_read"
+//
+// Parameters:
+// 1. s_query - Query string to send to each device
+// 2. a_val   - Returns the value read from each link, in the order added
+//
+// Returns: Number of links that failed, 0 if none
+// ***************************************************************************
+  int InstrumentGroup::
+query_all (const char *s_query, std::vector<InstrumentGroupValue<int> > &a_val)
+{
+  std::vector<std::string> a_s_resp;
+  std::vector<int> a_err;
+  int cnt_fail = _query_all (s_query, a_s_resp, a_err);
+
+  a_val.resize (size ());
+  for (int i=0; i < size (); i++) {
+    a_val[i].err = a_err[i];
+    a_val[i].val = 0;
+    if (!a_err[i] &&
+        sscanf (a_s_resp[i].c_str (), "%d", &a_val[i].val) != 1) {
+      a_val[i].val = 0;
+      a_val[i].err = -2;
+      cnt_fail++;
+      }
+    }
+
+  return (cnt_fail);
+}
+
+// ***************************************************************************
+// InstrumentGroup::query_all - Send query for a string to all links at once
+//                              VXI-11 RPCs are "device_write" and
+//                              "device_read"
+//
+// Parameters:
+// 1. s_query - Query string to send to each device
+// 2. a_val   - Returns the reply of each link, in the order added, with
+//              its terminator as in Vxi11::query()
+//
+// Returns: Number of links that failed, 0 if none
+// ***************************************************************************
+  int InstrumentGroup::
+query_all (const char *s_query,
+           std::vector<InstrumentGroupValue<std::string> > &a_val)
+{
+  std::vector<std::string> a_s_resp;
+  std::vector<int> a_err;
+  int cnt_fail = _query_all (s_query, a_s_resp, a_err);
+
+  a_val.resize (size ());
+  for (int i=0; i < size (); i++) {
+    a_val[i].err = a_err[i];
+    a_val[i].val.swap (a_s_resp[i]);
+    }
+
+  return (cnt_fail);
+}
@@ -0,0 +1,126 @@
+#ifndef VXI11_GROUP_H
+#define VXI11_GROUP_H
+
+// ***************************************************************************
+// vxi11_group.h - Group of VXI-11 links operated together, for libvxi11.so
+//                 library (Linux only)
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// An InstrumentGroup holds one Vxi11 link to each of its devices, each on
+// its own socket, with the I/O of all links done by one Vxi11Uring.  The
+// links are used one by one with link(), or all at once:
+//
+//   trigger_all()  device_trigger to every link, released as close together
+//                  as possible: the calls are encoded first, then the sends
+//                  of all links are submitted with one io_uring_enter() (or
+//                  send() in turn with epoll), and the replies are waited
+//                  for together.  The send time of each link is reported.
+//   query_all()    The same query to every link, with the reply of each
+//                  parsed as a double, an int or a string.  The writes of
+//                  all links are sent together, then the reads, so the time
+//                  is that of the slowest device instead of the sum.
+//
+// The group is used by one thread at a time, and its links must not be
+// used by another thread during a call of the group.  Example:
+//
+//   InstrumentGroup group;
+//   group.add ("192.168.1.10");
+//   group.add ("192.168.1.11");
+//   std::vector<InstrumentGroupTrigger> a_trigger;
+//   group.trigger_all (&a_trigger);
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_uring.h"
+
+#include <string>
+#include <vector>
+
+// Result of trigger_all() for one link
+struct InstrumentGroupTrigger {
+  int err;                              // 0 = triggered
+                                        // > 0 = error code of device_trigger
+                                        // -1 = no RPC response
+                                        // -3 = not sent: cancelled, circuit
+                                        //      open, or flush failed
+  long long t_sent_ns;                  // Time the trigger was sent, from
+                                        // Vxi11Tracer::time_ns(), 0 if not
+  long long t_skew_ns;                  // t_sent_ns after the first link sent
+};
+
+// Result of query_all() for one link
+template <class T> struct InstrumentGroupValue {
+  int err;                              // 0 = no error
+                                        // > 0 = error code of device_write
+                                        //       or device_read
+                                        // -1 = no RPC response
+                                        // -2 = reply could not be parsed,
+                                        //      or was too long
+                                        // -3 = not sent: cancelled, circuit
+                                        //      open, or flush failed
+  T val;                                // Value read, 0 or empty if error
+};
+
+// ***************************************************************************
+// InstrumentGroup - Links to several devices, operated together
+// ***************************************************************************
+class InstrumentGroup {
+ private:
+  Vxi11Uring _uring;                    // I/O of all links
+  std::vector<Vxi11 *> _a_p_vxi11;      // Links, in the order added
+  std::vector<Vxi11TransportUring *> _a_p_transport; // Transport of each link
+
+  bool _ready (int idx, const char *s_func); // Flush link idx, false if
+                                        // it must not be called
+  void _call_end (int idx, bool b_reply); // Count a call for the breaker
+  int _query_all (const char *s_query, std::vector<std::string> &a_s_resp,
+                  std::vector<int> &a_err);
+
+ public:
+  enum {LEN_RESP_MAX = 1048576};        // Longest reply of query_all()
+
+  // Set up for up to cnt_link_max links with registered receive buffers
+  // b_uring = false to use epoll instead of io_uring
+  InstrumentGroup (int cnt_link_max = 64, bool b_uring = true);
+  ~InstrumentGroup ();
+
+  // Open a link to a device and add it to the group
+  // s_address and s_device are as for Vxi11::open(); VXI-11 only
+  int add (const char *s_address, const char *s_device = 0);
+
+  // Close all links and remove them from the group
+  void close (void);
+
+  // Get the number of links, and link idx in the order added
+  int size (void) { return (int (_a_p_vxi11.size ())); }
+  Vxi11 *link (int idx) { return (_a_p_vxi11[idx]); }
+
+  // Get the Vxi11Uring doing the I/O, for its stats()
+  Vxi11Uring *uring (void) { return (&_uring); }
+
+  // Send group execute trigger to all links at once
+  // VXI-11 RPC is "device_trigger"
+  // pa_trigger returns the result of each link, if not null
+  int trigger_all (std::vector<InstrumentGroupTrigger> *pa_trigger = 0);
+
+  // Send a query to all links at once and read the value from each
+  // Convenience functions like Vxi11::query(), for all links
+  // VXI-11 RPCs are "device_write" and "device_read"
+  // a_val returns the value of each link, in the order added
+  int query_all (const char *s_query,
+                 std::vector<InstrumentGroupValue<double> > &a_val);
+  int query_all (const char *s_query,
+                 std::vector<InstrumentGroupValue<int> > &a_val);
+  int query_all (const char *s_query,
+                 std::vector<InstrumentGroupValue<std::string> > &a_val);
+};
+
+#endif
@@ -0,0 +1,768 @@
+// ***************************************************************************
+// vxi11_hislip.cpp - HiSLIP (IVI-6.1) transport for libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_hislip.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// VXI-11 error codes returned by the HiSLIP client
+#define ERR_NONE                0
+#define ERR_NOT_ACCESSIBLE      3
+#define ERR_NOT_SUPPORTED       8
+#define ERR_LOCKED              11
+#define ERR_NO_LOCK             12
+#define ERR_IO_TIMEOUT          15
+#define ERR_IO                  17
+
+// VXI-11 flags and reasons
+#define FLAG_WAITLOCK           1
+#define FLAG_END                8
+#define FLAG_TERMCHRSET         128
+#define REASON_REQCNT           1
+#define REASON_CHR              2
+#define REASON_END              4
+
+// Largest message accepted from the server
+static const unsigned long long SIZE_MESSAGE_MAX = 256 * 1024 * 1024;
+
+// maxRecvSize returned by create_link if the server accepts larger messages
+static const unsigned long SIZE_RECV_MAX = 1024 * 1024;
+
+// ***************************************************************************
+// HiSLIP RPC client
+//
+// All calls are made on the thread calling clnt_call(), except that the
+// asynchronous channel is read by its own thread, so that
+// AsyncServiceRequest is received while no call is in progress.  The
+// replies to the other asynchronous messages are passed to the calling
+// thread.
+// ***************************************************************************
+struct Vxi11HislipClient {
+  CLIENT client;                        // Must be first
+  char s_host[256];                     // Host name or IP address
+  int port;                             // TCP port of the server
+  void (*pfn_srq) (const char *, int);  // SRQ function, or null
+
+  int sock_sync;                        // Synchronous channel, or -1
+  int sock_async;                       // Asynchronous channel, or -1
+  unsigned int session_id;              // Session ID from the server
+  unsigned int message_id;              // MessageID of next message sent
+  unsigned int message_id_end;          // MessageID of last DataEnd sent
+  bool b_rmt;                           // Response message was delivered
+  std::string s_in;                     // Data received but not read
+  size_t idx_in;                        // Bytes of s_in already read
+  bool b_in_end;                        // s_in ends with DataEnd
+  std::string s_read;                   // Data returned by device_read
+  bool b_srq;                           // SRQ enabled by device_enable_srq
+  std::string s_handle;                 // Handle from device_enable_srq
+
+  pthread_t thread_async;               // Reads the asynchronous channel
+  bool b_thread_async;                  // True if thread_async is running
+  pthread_mutex_t mutex;                // Protects the members below
+  pthread_cond_t cond;                  // Signals an asynchronous reply
+  unsigned char type_async;             // Type of reply waited for
+  bool b_async_wait;                    // A call waits for a reply
+  bool b_async_reply;                   // Reply received
+  bool b_async_closed;                  // Asynchronous channel closed
+  Vxi11HislipHeader header_async;       // Reply
+
+  struct timeval timeout;               // RPC timeout
+  u_int32_t xid;                        // Transaction ID of last call
+  enum clnt_stat stat;                  // Status of last call
+};
+
+// Parameters of an SRQ thread
+struct Vxi11HislipSrq {
+  void (*pfn_srq) (const char *, int);
+  std::string s_handle;
+};
+
+// ***************************************************************************
+// Helper functions
+// ***************************************************************************
+
+// Connect a TCP socket to the server
+// Returns the socket, or -1 if error
+static int
+hislip_connect (Vxi11HislipClient *p_hislip)
+{
+  char s_port[16];
+  snprintf (s_port, sizeof (s_port), "%d", p_hislip->port);
+  addrinfo hints;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *p_addrinfo = 0;
+  if (getaddrinfo (p_hislip->s_host, s_port, &hints, &p_addrinfo) ||
+      !p_addrinfo)
+    return (-1);
+
+  int sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (sock >= 0 &&
+      connect (sock, p_addrinfo->ai_addr, p_addrinfo->ai_addrlen)) {
+    ::close (sock);
+    sock = -1;
+    }
+  freeaddrinfo (p_addrinfo);
+
+  if (sock >= 0) {
+    int on = 1;                         // Messages are small and interactive
+    setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+    }
+  return (sock);
+}
+
+// Close both channels, ending the asynchronous channel thread
+static void
+hislip_disconnect (Vxi11HislipClient *p_hislip)
+{
+  if (p_hislip->sock_async >= 0)
+    shutdown (p_hislip->sock_async, SHUT_RDWR);
+  if (p_hislip->b_thread_async) {
+    pthread_join (p_hislip->thread_async, NULL);
+    p_hislip->b_thread_async = false;
+    }
+  if (p_hislip->sock_async >= 0)
+    ::close (p_hislip->sock_async);
+  if (p_hislip->sock_sync >= 0)
+    ::close (p_hislip->sock_sync);
+  p_hislip->sock_async = -1;
+  p_hislip->sock_sync = -1;
+  p_hislip->s_in.clear ();
+  p_hislip->idx_in = 0;
+}
+
+// Get the RPC timeout in ms
+static int
+hislip_timeout_ms (Vxi11HislipClient *p_hislip)
+{
+  return (p_hislip->timeout.tv_sec * 1000 + p_hislip->timeout.tv_usec / 1000);
+}
+
+// Call SRQ function of the client, on its own thread
+static void *
+hislip_fn_srq (void *p_arg)
+{
+  Vxi11HislipSrq *p_srq = (Vxi11HislipSrq *)p_arg;
+  p_srq->pfn_srq (p_srq->s_handle.data (), p_srq->s_handle.size ());
+  delete p_srq;
+  return (0);
+}
+
+// Thread reading the asynchronous channel
+static void *
+hislip_fn_async (void *p_arg)
+{
+  Vxi11HislipClient *p_hislip = (Vxi11HislipClient *)p_arg;
+  Vxi11HislipHeader header;
+  std::string s_payload;
+
+  while (!vxi11_hislip_recv (p_hislip->sock_async, &header, s_payload, -1,
+                             SIZE_MESSAGE_MAX)) {
+    s_payload.clear ();
+    pthread_mutex_lock (&p_hislip->mutex);
+
+    // The SRQ function may call readstb(), which waits for this thread,
+    // so it is called on another thread
+    if (header.type == HISLIP_ASYNC_SERVICE_REQUEST) {
+      if (p_hislip->b_srq && p_hislip->pfn_srq) {
+        Vxi11HislipSrq *p_srq = new Vxi11HislipSrq;
+        p_srq->pfn_srq = p_hislip->pfn_srq;
+        p_srq->s_handle = p_hislip->s_handle;
+        pthread_t pthread;
+        if (pthread_create (&pthread, NULL, hislip_fn_srq, p_srq))
+          delete p_srq;
+        else
+          pthread_detach (pthread);
+        }
+      }
+    else if (p_hislip->b_async_wait && !p_hislip->b_async_reply &&
+             (header.type == p_hislip->type_async ||
+              header.type == HISLIP_ERROR ||
+              header.type == HISLIP_FATAL_ERROR)) {
+      p_hislip->header_async = header;
+      p_hislip->b_async_reply = true;
+      pthread_cond_broadcast (&p_hislip->cond);
+      }
+    pthread_mutex_unlock (&p_hislip->mutex);
+    }
+
+  pthread_mutex_lock (&p_hislip->mutex);
+  p_hislip->b_async_closed = true;
+  pthread_cond_broadcast (&p_hislip->cond);
+  pthread_mutex_unlock (&p_hislip->mutex);
+  return (0);
+}
+
+// Send a message on the asynchronous channel, and wait for its reply
+// Returns: 0 = reply received in *p_header
+//          1 = error, or no reply before timeout_ms
+static int
+hislip_async_call (Vxi11HislipClient *p_hislip, unsigned char type,
+                   unsigned char control, unsigned int param,
+                   unsigned char type_reply, Vxi11HislipHeader *p_header,
+                   int timeout_ms)
+{
+  pthread_mutex_lock (&p_hislip->mutex);
+  p_hislip->type_async = type_reply;
+  p_hislip->b_async_wait = true;
+  p_hislip->b_async_reply = false;
+  pthread_mutex_unlock (&p_hislip->mutex);
+
+  int err = vxi11_hislip_send (p_hislip->sock_async, type, control, param);
+
+  timespec ts;
+  clock_gettime (CLOCK_REALTIME, &ts);
+  long long t_ns = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec +
+                   (long long)timeout_ms * 1000000LL;
+  ts.tv_sec = t_ns / 1000000000LL;
+  ts.tv_nsec = t_ns % 1000000000LL;
+
+  pthread_mutex_lock (&p_hislip->mutex);
+  while (!err && !p_hislip->b_async_reply && !p_hislip->b_async_closed) {
+    if (pthread_cond_timedwait (&p_hislip->cond, &p_hislip->mutex, &ts))
+      break;
+    }
+  err = err || !p_hislip->b_async_reply;
+  if (!err)
+    *p_header = p_hislip->header_async;
+  p_hislip->b_async_wait = false;
+  pthread_mutex_unlock (&p_hislip->mutex);
+
+  if (!err && p_header->type != type_reply)
+    err = 1;                            // Error or FatalError from server
+  return (err);
+}
+
+// ***************************************************************************
+// Procedures of the DEVICE_CORE program
+//
+// Each returns the RPC status.  The results point to storage of the client,
+// which is valid until the next call.
+// ***************************************************************************
+
+// create_link - Open both channels and initialize the session
+static enum clnt_stat
+hislip_create_link (Vxi11HislipClient *p_hislip, Create_LinkParms *p_parms,
+                    Create_LinkResp *p_resp)
+{
+  memset (p_resp, 0, sizeof (Create_LinkResp));
+  hislip_disconnect (p_hislip);         // Only one link per client
+
+  p_hislip->sock_sync = hislip_connect (p_hislip);
+  if (p_hislip->sock_sync < 0)
+    return (RPC_CANTSEND);
+
+  int timeout_ms = hislip_timeout_ms (p_hislip);
+  Vxi11HislipHeader header;
+  std::string s_payload;
+
+  // Initialize with the sub-address, then AsyncInitialize with the session
+  const char *s_sub_address = (p_parms->device) ? p_parms->device : "";
+  if (vxi11_hislip_send (p_hislip->sock_sync, HISLIP_INITIALIZE, 0,
+                         (VXI11_HISLIP_VERSION << 16) | VXI11_HISLIP_VENDOR,
+                         s_sub_address, strlen (s_sub_address)) ||
+      vxi11_hislip_recv (p_hislip->sock_sync, &header, s_payload, timeout_ms,
+                         SIZE_MESSAGE_MAX)) {
+    hislip_disconnect (p_hislip);
+    return (RPC_CANTRECV);
+    }
+  if (header.type != HISLIP_INITIALIZE_RESPONSE) {
+    hislip_disconnect (p_hislip);       // FatalError, unknown sub-address
+    p_resp->error = ERR_NOT_ACCESSIBLE;
+    return (RPC_SUCCESS);
+    }
+  p_hislip->session_id = header.param & 0xffff;
+
+  p_hislip->sock_async = hislip_connect (p_hislip);
+  s_payload.clear ();
+  if (p_hislip->sock_async < 0 ||
+      vxi11_hislip_send (p_hislip->sock_async, HISLIP_ASYNC_INITIALIZE, 0,
+                         p_hislip->session_id) ||
+      vxi11_hislip_recv (p_hislip->sock_async, &header, s_payload,
+                         timeout_ms, SIZE_MESSAGE_MAX) ||
+      header.type != HISLIP_ASYNC_INITIALIZE_RESPONSE) {
+    hislip_disconnect (p_hislip);
+    return (RPC_CANTRECV);
+    }
+
+  // Exchange the maximum message sizes
+  char ac_size[8];
+  for (int i=0; i < 8; i++)
+    ac_size[i] = (char)(SIZE_MESSAGE_MAX >> (56 - 8 * i));
+  s_payload.clear ();
+  if (vxi11_hislip_send (p_hislip->sock_async,
+                         HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE, 0, 0, ac_size, 8) ||
+      vxi11_hislip_recv (p_hislip->sock_async, &header, s_payload,
+                         timeout_ms, SIZE_MESSAGE_MAX) ||
+      header.type != HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE ||
+      s_payload.size () != 8) {
+    hislip_disconnect (p_hislip);
+    return (RPC_CANTRECV);
+    }
+  unsigned long long size_max = 0;
+  for (int i=0; i < 8; i++)
+    size_max = (size_max << 8) | (unsigned char)s_payload[i];
+
+  p_hislip->message_id = HISLIP_MESSAGE_ID_INITIAL;
+  p_hislip->message_id_end = HISLIP_MESSAGE_ID_INITIAL - 2;
+  p_hislip->b_rmt = false;
+  p_hislip->b_in_end = false;
+  p_hislip->b_srq = false;
+  p_hislip->b_async_closed = false;
+  if (pthread_create (&p_hislip->thread_async, NULL, hislip_fn_async,
+                      p_hislip)) {
+    hislip_disconnect (p_hislip);
+    return (RPC_SYSTEMERROR);
+    }
+  p_hislip->b_thread_async = true;
+
+  // Lock the device if requested
+  if (p_parms->lockDevice &&
+      (hislip_async_call (p_hislip, HISLIP_ASYNC_LOCK, 1,
+                          p_parms->lock_timeout, HISLIP_ASYNC_LOCK_RESPONSE,
+                          &header, timeout_ms + p_parms->lock_timeout) ||
+       header.control != 1)) {
+    hislip_disconnect (p_hislip);
+    p_resp->error = ERR_LOCKED;
+    return (RPC_SUCCESS);
+    }
+
+  p_resp->lid = p_hislip->session_id;
+  p_resp->abortPort = 0;                // No abort channel
+  p_resp->maxRecvSize = (size_max && size_max < SIZE_RECV_MAX) ?
+                        (unsigned long)size_max : SIZE_RECV_MAX;
+  return (RPC_SUCCESS);
+}
+
+// device_write - Send Data, or DataEnd for the end of the message
+static enum clnt_stat
+hislip_write (Vxi11HislipClient *p_hislip, Device_WriteParms *p_parms,
+              Device_WriteResp *p_resp)
+{
+  bool b_end = (p_parms->flags & FLAG_END) != 0;
+  if (b_end) {                          // Earlier responses will not be read
+    p_hislip->s_in.clear ();
+    p_hislip->idx_in = 0;
+    p_hislip->b_in_end = false;
+    p_hislip->message_id_end = p_hislip->message_id;
+    }
+
+  if (vxi11_hislip_send (p_hislip->sock_sync,
+                         (b_end) ? HISLIP_DATA_END : HISLIP_DATA,
+                         (p_hislip->b_rmt) ? 1 : 0, p_hislip->message_id,
+                         p_parms->data.data_val, p_parms->data.data_len))
+    return (RPC_CANTSEND);
+  p_hislip->message_id += 2;
+  p_hislip->b_rmt = false;
+
+  p_resp->error = ERR_NONE;
+  p_resp->size = p_parms->data.data_len;
+  return (RPC_SUCCESS);
+}
+
+// device_read - Return the data of Data and DataEnd messages
+static enum clnt_stat
+hislip_read (Vxi11HislipClient *p_hislip, Device_ReadParms *p_parms,
+             Device_ReadResp *p_resp)
+{
+  memset (p_resp, 0, sizeof (Device_ReadResp));
+
+  timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  long long t_timeout_ms = (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 +
+                           p_parms->io_timeout;
+
+  for (;;) {
+    // Return when the request size, the termination character or the end
+    // of the message is reached
+    size_t cnt = p_hislip->s_in.size () - p_hislip->idx_in;
+    const char *p_data = p_hislip->s_in.data () + p_hislip->idx_in;
+    if (cnt >= p_parms->requestSize) {
+      cnt = p_parms->requestSize;
+      p_resp->reason = REASON_REQCNT;
+      }
+    if (p_parms->flags & FLAG_TERMCHRSET) {
+      const char *p_term = (const char *)memchr (p_data, p_parms->termChar,
+                                                 cnt);
+      if (p_term) {
+        cnt = p_term - p_data + 1;
+        p_resp->reason = REASON_CHR |
+                         ((cnt == p_parms->requestSize) ? REASON_REQCNT : 0);
+        }
+      }
+    bool b_end = p_hislip->b_in_end &&
+                 cnt == p_hislip->s_in.size () - p_hislip->idx_in;
+    if (b_end)
+      p_resp->reason |= REASON_END;
+
+    if (p_resp->reason) {
+      p_hislip->s_read.assign (p_data, cnt);
+      p_hislip->idx_in += cnt;
+      if (b_end) {                      // Whole response delivered
+        p_hislip->s_in.clear ();
+        p_hislip->idx_in = 0;
+        p_hislip->b_in_end = false;
+        p_hislip->b_rmt = true;
+        }
+      p_resp->error = ERR_NONE;
+      p_resp->data.data_len = p_hislip->s_read.size ();
+      p_resp->data.data_val = (char *)p_hislip->s_read.data ();
+      return (RPC_SUCCESS);
+      }
+
+    // Receive more data
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    long long t_left_ms = t_timeout_ms -
+                          ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    if (t_left_ms < 0)
+      t_left_ms = 0;
+
+    if (p_hislip->idx_in) {             // Drop data already read
+      p_hislip->s_in.erase (0, p_hislip->idx_in);
+      p_hislip->idx_in = 0;
+      }
+    size_t idx = p_hislip->s_in.size ();
+    Vxi11HislipHeader header;
+    int err = vxi11_hislip_recv (p_hislip->sock_sync, &header,
+                                 p_hislip->s_in, t_left_ms,
+                                 SIZE_MESSAGE_MAX);
+    if (err == 2) {
+      p_resp->error = ERR_IO_TIMEOUT;
+      return (RPC_SUCCESS);
+      }
+    if (err)
+      return (RPC_CANTRECV);
+
+    if ((header.type != HISLIP_DATA && header.type != HISLIP_DATA_END) ||
+        header.param != p_hislip->message_id_end) {
+      p_hislip->s_in.resize (idx);      // Not a response to the last message
+      if (header.type == HISLIP_INTERRUPTED) {
+        p_hislip->s_in.clear ();
+        p_hislip->b_in_end = false;
+        }
+      else if (header.type == HISLIP_ERROR ||
+               header.type == HISLIP_FATAL_ERROR) {
+        p_resp->error = ERR_IO;
+        return (RPC_SUCCESS);
+        }
+      continue;
+      }
+    p_hislip->b_in_end = (header.type == HISLIP_DATA_END);
+    }
+}
+
+// device_clear - Device clear on both channels
+static int
+hislip_clear (Vxi11HislipClient *p_hislip, int timeout_ms)
+{
+  Vxi11HislipHeader header;
+  if (hislip_async_call (p_hislip, HISLIP_ASYNC_DEVICE_CLEAR, 0, 0,
+                         HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE, &header,
+                         timeout_ms))
+    return (ERR_IO);
+
+  // Discard the synchronous channel until the server acknowledges
+  if (vxi11_hislip_send (p_hislip->sock_sync, HISLIP_DEVICE_CLEAR_COMPLETE,
+                         header.control, 0))
+    return (ERR_IO);
+  std::string s_payload;
+  do {
+    s_payload.clear ();
+    if (vxi11_hislip_recv (p_hislip->sock_sync, &header, s_payload,
+                           timeout_ms, SIZE_MESSAGE_MAX))
+      return (ERR_IO);
+    } while (header.type != HISLIP_DEVICE_CLEAR_ACKNOWLEDGE);
+
+  p_hislip->message_id = HISLIP_MESSAGE_ID_INITIAL;
+  p_hislip->message_id_end = HISLIP_MESSAGE_ID_INITIAL - 2;
+  p_hislip->b_rmt = false;
+  p_hislip->s_in.clear ();
+  p_hislip->idx_in = 0;
+  p_hislip->b_in_end = false;
+  return (ERR_NONE);
+}
+
+// ***************************************************************************
+// CLIENT operations
+// ***************************************************************************
+
+static enum clnt_stat
+hislip_call (CLIENT *p_client, rpcproc_t proc, xdrproc_t xdr_args,
+             void *p_args, xdrproc_t xdr_res, void *p_res,
+             struct timeval timeout)
+{
+  Vxi11HislipClient *p_hislip = (Vxi11HislipClient *)p_client;
+  p_hislip->xid++;
+
+  // All procedures but create_link need the session
+  if (proc != create_link && p_hislip->sock_sync < 0) {
+    p_hislip->stat = RPC_CANTSEND;
+    return (p_hislip->stat);
+    }
+
+  int timeout_ms = hislip_timeout_ms (p_hislip);
+  Vxi11HislipHeader header;
+  unsigned char control_rmt = (p_hislip->b_rmt) ? 1 : 0;
+  enum clnt_stat stat = RPC_SUCCESS;
+
+  switch (proc) {
+  case create_link:
+    stat = hislip_create_link (p_hislip, (Create_LinkParms *)p_args,
+                               (Create_LinkResp *)p_res);
+    break;
+
+  case device_write:
+    stat = hislip_write (p_hislip, (Device_WriteParms *)p_args,
+                         (Device_WriteResp *)p_res);
+    break;
+
+  case device_read:
+    stat = hislip_read (p_hislip, (Device_ReadParms *)p_args,
+                        (Device_ReadResp *)p_res);
+    break;
+
+  case device_readstb: {
+    Device_ReadStbResp *p_resp = (Device_ReadStbResp *)p_res;
+    p_resp->stb = 0;
+    p_resp->error = ERR_NONE;
+    if (hislip_async_call (p_hislip, HISLIP_ASYNC_STATUS_QUERY, control_rmt,
+                           p_hislip->message_id - 2,
+                           HISLIP_ASYNC_STATUS_RESPONSE, &header, timeout_ms))
+      p_resp->error = ERR_IO;
+    else {
+      p_resp->stb = header.control;
+      p_hislip->b_rmt = false;
+      }
+    break;
+    }
+
+  case NULLPROC:                        // Ping, with a status query
+    if (hislip_async_call (p_hislip, HISLIP_ASYNC_STATUS_QUERY, control_rmt,
+                           p_hislip->message_id - 2,
+                           HISLIP_ASYNC_STATUS_RESPONSE, &header, timeout_ms))
+      stat = RPC_TIMEDOUT;
+    else
+      p_hislip->b_rmt = false;
+    break;
+
+  case device_trigger:
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    if (vxi11_hislip_send (p_hislip->sock_sync, HISLIP_TRIGGER, control_rmt,
+                           p_hislip->message_id))
+      stat = RPC_CANTSEND;
+    p_hislip->message_id += 2;
+    p_hislip->b_rmt = false;
+    break;
+
+  case device_clear:
+    ((Device_Error *)p_res)->error = hislip_clear (p_hislip, timeout_ms);
+    break;
+
+  case device_remote:                   // Enable remote and go to remote
+  case device_local:                    // Go to local without changing REN
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    if (hislip_async_call (p_hislip, HISLIP_ASYNC_REMOTE_LOCAL_CONTROL,
+                           (proc == device_remote) ? 3 : 6,
+                           p_hislip->message_id - 2,
+                           HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE, &header,
+                           timeout_ms))
+      ((Device_Error *)p_res)->error = ERR_IO;
+    break;
+
+  case device_lock: {
+    // Request an exclusive lock, waiting lock_timeout if FLAG_WAITLOCK
+    Device_LockParms *p_parms = (Device_LockParms *)p_args;
+    unsigned int lock_timeout = (p_parms->flags & FLAG_WAITLOCK) ?
+                                p_parms->lock_timeout : 0;
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    if (hislip_async_call (p_hislip, HISLIP_ASYNC_LOCK, 1, lock_timeout,
+                           HISLIP_ASYNC_LOCK_RESPONSE, &header,
+                           timeout_ms + lock_timeout))
+      ((Device_Error *)p_res)->error = ERR_IO;
+    else if (header.control != 1)
+      ((Device_Error *)p_res)->error = ERR_LOCKED;
+    break;
+    }
+
+  case device_unlock:
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    if (hislip_async_call (p_hislip, HISLIP_ASYNC_LOCK, 0,
+                           p_hislip->message_id - 2,
+                           HISLIP_ASYNC_LOCK_RESPONSE, &header, timeout_ms))
+      ((Device_Error *)p_res)->error = ERR_IO;
+    else if (header.control != 1)
+      ((Device_Error *)p_res)->error = ERR_NO_LOCK;
+    break;
+
+  case device_enable_srq: {
+    Device_EnableSrqParms *p_parms = (Device_EnableSrqParms *)p_args;
+    pthread_mutex_lock (&p_hislip->mutex);
+    p_hislip->b_srq = p_parms->enable;
+    p_hislip->s_handle.assign (p_parms->handle.handle_val,
+                               p_parms->handle.handle_len);
+    pthread_mutex_unlock (&p_hislip->mutex);
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    break;
+    }
+
+  case device_docmd: {                  // HiSLIP has no GPIB commands
+    Device_DocmdResp *p_resp = (Device_DocmdResp *)p_res;
+    memset (p_resp, 0, sizeof (Device_DocmdResp));
+    p_resp->error = ERR_NOT_SUPPORTED;
+    break;
+    }
+
+  case create_intr_chan:                // SRQ is on the asynchronous channel
+  case destroy_intr_chan:
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    break;
+
+  case destroy_link:
+    hislip_disconnect (p_hislip);
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    break;
+
+  default:
+    stat = RPC_PROCUNAVAIL;
+    break;
+    }
+
+  p_hislip->stat = stat;
+  return (stat);
+}
+
+static void
+hislip_abort (CLIENT *p_client)
+{
+}
+
+static void
+hislip_geterr (CLIENT *p_client, struct rpc_err *p_err)
+{
+  Vxi11HislipClient *p_hislip = (Vxi11HislipClient *)p_client;
+  memset (p_err, 0, sizeof (struct rpc_err));
+  p_err->re_status = p_hislip->stat;
+}
+
+static bool_t
+hislip_freeres (CLIENT *p_client, xdrproc_t xdr_res, void *p_res)
+{
+  return (TRUE);                        // Results are owned by the client
+}
+
+static void
+hislip_destroy (CLIENT *p_client)
+{
+  Vxi11HislipClient *p_hislip = (Vxi11HislipClient *)p_client;
+  hislip_disconnect (p_hislip);
+  pthread_cond_destroy (&p_hislip->cond);
+  pthread_mutex_destroy (&p_hislip->mutex);
+  auth_destroy (p_hislip->client.cl_auth);
+  delete p_hislip;
+}
+
+static bool_t
+hislip_control (CLIENT *p_client, u_int request, void *p_info)
+{
+  Vxi11HislipClient *p_hislip = (Vxi11HislipClient *)p_client;
+
+  switch (request) {
+  case CLSET_TIMEOUT:
+    p_hislip->timeout = *(struct timeval *)p_info;
+    break;
+  case CLGET_TIMEOUT:
+    *(struct timeval *)p_info = p_hislip->timeout;
+    break;
+  case CLGET_XID:                       // Transaction ID of last call
+    *(u_int32_t *)p_info = p_hislip->xid;
+    break;
+  case CLSET_XID:                       // Transaction ID of next call
+    p_hislip->xid = *(u_int32_t *)p_info - 1;
+    break;
+  case CLGET_FD:                        // Socket, for readiness and cancel
+    if (p_hislip->sock_sync < 0)
+      return (FALSE);
+    *(int *)p_info = p_hislip->sock_sync;
+    break;
+  default:
+    return (FALSE);
+    }
+
+  return (TRUE);
+}
+
+static CLIENT::clnt_ops hislip_ops = {
+  hislip_call, hislip_abort, hislip_geterr, hislip_freeres, hislip_destroy,
+  hislip_control
+};
+
+// ***************************************************************************
+// vxi11_hislip_create - Create an RPC client for the DEVICE_CORE program
+//                       that uses HiSLIP
+//
+// Parameters:
+// 1. s_host  - Host name or IP address of the HiSLIP server
+// 2. port    - TCP port of the HiSLIP server, usually VXI11_HISLIP_PORT
+// 3. pfn_srq - Function called with the handle of device_enable_srq when
+//              the server sends AsyncServiceRequest, or null
+//
+// Returns: HiSLIP RPC client, destroy with clnt_destroy()
+//
+// Notes: The server is connected by create_link, so that the device name
+//        can be sent as the HiSLIP sub-address.  The link has no abort
+//        channel (abortPort is 0).
+// ***************************************************************************
+  CLIENT *
+vxi11_hislip_create (const char *s_host, int port,
+                     void (*pfn_srq) (const char *ac_handle, int cnt_handle))
+{
+  Vxi11HislipClient *p_hislip = new Vxi11HislipClient;
+  p_hislip->client.cl_auth = authnone_create ();
+  p_hislip->client.cl_ops = &hislip_ops;
+  p_hislip->client.cl_private = 0;
+  p_hislip->s_host[255] = 0;
+  strncpy (p_hislip->s_host, s_host, 255);
+  p_hislip->port = port;
+  p_hislip->pfn_srq = pfn_srq;
+  p_hislip->sock_sync = -1;
+  p_hislip->sock_async = -1;
+  p_hislip->session_id = 0;
+  p_hislip->message_id = HISLIP_MESSAGE_ID_INITIAL;
+  p_hislip->message_id_end = HISLIP_MESSAGE_ID_INITIAL - 2;
+  p_hislip->b_rmt = false;
+  p_hislip->idx_in = 0;
+  p_hislip->b_in_end = false;
+  p_hislip->b_srq = false;
+  p_hislip->b_thread_async = false;
+  pthread_mutex_init (&p_hislip->mutex, NULL);
+  pthread_cond_init (&p_hislip->cond, NULL);
+  p_hislip->type_async = 0;
+  p_hislip->b_async_wait = false;
+  p_hislip->b_async_reply = false;
+  p_hislip->b_async_closed = false;
+  p_hislip->timeout.tv_sec = 25;        // Same default as rpcgen clients
+  p_hislip->timeout.tv_usec = 0;
+  p_hislip->xid = 0;
+  p_hislip->stat = RPC_SUCCESS;
+
+  return (&p_hislip->client);
+}
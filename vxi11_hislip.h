@@ -0,0 +1,203 @@
+#ifndef VXI11_HISLIP_H
+#define VXI11_HISLIP_H
+
+// ***************************************************************************
+// vxi11_hislip.h - HiSLIP (IVI-6.1) transport for libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// The HiSLIP client is an RPC client (CLIENT) for the DEVICE_CORE program.
+// Each VXI-11 procedure called on it is carried out with HiSLIP messages,
+// so the Vxi11 class works unchanged on HiSLIP instruments:
+//
+//   create_link     Initialize on the synchronous channel, AsyncInitialize
+//                   and AsyncMaximumMessageSize on the asynchronous channel
+//   device_write    Data, or DataEnd if the END flag is set
+//   device_read     Returns the Data/DataEnd messages received
+//   device_readstb  AsyncStatusQuery
+//   device_trigger  Trigger
+//   device_clear    AsyncDeviceClear and DeviceClearComplete
+//   device_remote,  AsyncRemoteLocalControl
+//   device_local
+//   device_lock,    AsyncLock
+//   device_unlock
+//   SRQ             AsyncServiceRequest calls the SRQ function given to
+//                   vxi11_hislip_create() with the device_enable_srq handle
+//
+// The client uses the synchronized mode of HiSLIP.  The header and the
+// message helpers below are also used by the HiSLIP server of Vxi11Sim.
+// ***************************************************************************
+
+#include <rpc/rpc.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <string>
+
+#define VXI11_HISLIP_PORT     4880      // Default TCP port
+#define VXI11_HISLIP_VERSION  0x0100    // Protocol version 1.0
+#define VXI11_HISLIP_VENDOR   0x4c45    // Vendor ID "LE"
+
+// Message types
+enum {
+  HISLIP_INITIALIZE                   = 0,
+  HISLIP_INITIALIZE_RESPONSE          = 1,
+  HISLIP_FATAL_ERROR                  = 2,
+  HISLIP_ERROR                        = 3,
+  HISLIP_ASYNC_LOCK                   = 4,
+  HISLIP_ASYNC_LOCK_RESPONSE          = 5,
+  HISLIP_DATA                         = 6,
+  HISLIP_DATA_END                     = 7,
+  HISLIP_DEVICE_CLEAR_COMPLETE        = 8,
+  HISLIP_DEVICE_CLEAR_ACKNOWLEDGE     = 9,
+  HISLIP_ASYNC_REMOTE_LOCAL_CONTROL   = 10,
+  HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE  = 11,
+  HISLIP_TRIGGER                      = 12,
+  HISLIP_INTERRUPTED                  = 13,
+  HISLIP_ASYNC_INTERRUPTED            = 14,
+  HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE   = 15,
+  HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE = 16,
+  HISLIP_ASYNC_INITIALIZE             = 17,
+  HISLIP_ASYNC_INITIALIZE_RESPONSE    = 18,
+  HISLIP_ASYNC_DEVICE_CLEAR           = 19,
+  HISLIP_ASYNC_SERVICE_REQUEST        = 20,
+  HISLIP_ASYNC_STATUS_QUERY           = 21,
+  HISLIP_ASYNC_STATUS_RESPONSE        = 22,
+  HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE = 23,
+  HISLIP_ASYNC_LOCK_INFO              = 24,
+  HISLIP_ASYNC_LOCK_INFO_RESPONSE     = 25
+};
+
+#define HISLIP_MESSAGE_ID_INITIAL 0xffffff00u  // First MessageID of client
+
+// Message header, 16 bytes on the wire:
+//   'H' 'S' type control param[4] payload_len[8], big endian
+struct Vxi11HislipHeader {
+  unsigned char type;                   // HISLIP_xxx
+  unsigned char control;                // Control code
+  unsigned int param;                   // Message parameter
+  unsigned long long len;               // Length of payload
+};
+
+// Send a message
+// Returns: 0 = no error
+//          1 = error
+inline int
+vxi11_hislip_send (int sock, unsigned char type, unsigned char control,
+                   unsigned int param, const char *ac_payload = 0,
+                   unsigned long long len = 0)
+{
+  unsigned char ac_header[16] = {'H', 'S', type, control,
+    (unsigned char)(param >> 24), (unsigned char)(param >> 16),
+    (unsigned char)(param >> 8), (unsigned char)param};
+  for (int i=0; i < 8; i++)
+    ac_header[8 + i] = (unsigned char)(len >> (56 - 8 * i));
+
+  struct iovec a_iov[2] = {{ac_header, 16}, {(void *)ac_payload, len}};
+  struct msghdr msg;
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = a_iov;
+  msg.msg_iovlen = (len) ? 2 : 1;
+
+  unsigned long long cnt_left = 16 + len;
+  while (cnt_left) {
+    ssize_t cnt_send = sendmsg (sock, &msg, MSG_NOSIGNAL);
+    if (cnt_send < 0 && errno == EINTR)
+      continue;
+    if (cnt_send <= 0)
+      return (1);
+    cnt_left -= cnt_send;
+    while (msg.msg_iovlen && (size_t)cnt_send >= msg.msg_iov->iov_len) {
+      cnt_send -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+      }
+    if (msg.msg_iovlen) {
+      msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + cnt_send;
+      msg.msg_iov->iov_len -= cnt_send;
+      }
+    }
+  return (0);
+}
+
+// Receive exactly cnt bytes
+// Returns: 0 = no error
+//          1 = error or connection closed
+inline int
+vxi11_hislip_recv_all (int sock, char *ac_data, unsigned long long cnt)
+{
+  while (cnt) {
+    ssize_t cnt_recv = recv (sock, ac_data, cnt, 0);
+    if (cnt_recv < 0 && errno == EINTR)
+      continue;
+    if (cnt_recv <= 0)
+      return (1);
+    ac_data += cnt_recv;
+    cnt -= cnt_recv;
+    }
+  return (0);
+}
+
+// Receive a message, appending the payload to s_payload
+// timeout_ms = time to wait for the start of the message, -1 = forever
+// Returns: 0 = no error
+//          1 = error, connection closed, or payload larger than len_max
+//          2 = timeout
+inline int
+vxi11_hislip_recv (int sock, Vxi11HislipHeader *p_header,
+                   std::string &s_payload, int timeout_ms,
+                   unsigned long long len_max)
+{
+  if (timeout_ms >= 0) {
+    struct pollfd pfd = {sock, POLLIN, 0};
+    int cnt_ready;
+    while ((cnt_ready = poll (&pfd, 1, timeout_ms)) < 0 && errno == EINTR)
+      ;
+    if (cnt_ready == 0)
+      return (2);
+    }
+
+  unsigned char ac_header[16];
+  if (vxi11_hislip_recv_all (sock, (char *)ac_header, 16) ||
+      ac_header[0] != 'H' || ac_header[1] != 'S')
+    return (1);
+
+  p_header->type = ac_header[2];
+  p_header->control = ac_header[3];
+  p_header->param = ((unsigned int)ac_header[4] << 24) |
+                    ((unsigned int)ac_header[5] << 16) |
+                    ((unsigned int)ac_header[6] << 8) | ac_header[7];
+  p_header->len = 0;
+  for (int i=0; i < 8; i++)
+    p_header->len = (p_header->len << 8) | ac_header[8 + i];
+  if (p_header->len > len_max)
+    return (1);
+
+  size_t idx = s_payload.size ();
+  s_payload.resize (idx + p_header->len);
+  if (p_header->len &&
+      vxi11_hislip_recv_all (sock, &s_payload[idx], p_header->len))
+    return (1);
+  return (0);
+}
+
+// Create an RPC client for the DEVICE_CORE program that connects to the
+// HiSLIP server at s_host:port when create_link is called.  The device name
+// of create_link is the HiSLIP sub-address, for example "hislip0".
+// pfn_srq is called from another thread with the SRQ handle of
+// device_enable_srq when the server requests service.
+// Destroy with clnt_destroy().
+CLIENT *vxi11_hislip_create (const char *s_host, int port,
+                             void (*pfn_srq) (const char *ac_handle,
+                                              int cnt_handle));
+
+#endif
@@ -0,0 +1,404 @@
+// ***************************************************************************
+// vxi11_poller.cpp - Adaptive status byte polling of many links, for
+//                    libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "vxi11_poller.h"
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// Macro to conveniently access the __p_state member of Vxi11Poller
+#define _p_state        ((Vxi11PollerState *)__p_state)
+
+// Weight of a new completion time in the learned time of a link
+static const double D_LEARN_WEIGHT = 0.25;
+
+// ***************************************************************************
+// Vxi11PollerLink - Watch and learned time of one link
+// ***************************************************************************
+struct Vxi11PollerLink {
+  std::string s_host;                   // Host of device_addr(), to coalesce
+                                        // the polls of a gateway
+  double d_expected;                    // Learned time of an operation in
+                                        // seconds, 0 if not known yet
+
+  bool b_watch;                         // Being watched
+  bool b_polling;                       // readstb() in progress
+  bool b_calling;                       // Completion function running
+  int mask;                             // Status byte bits to wait for
+  void (*pfn_done) (Vxi11 *, int, void *); // Completion function
+  void *p_arg;                          // Its parameter
+  long long t_start_ns;                 // Time watch() was called
+  long long t_end_ns;                   // Timeout, 0 if none
+  long long t_next_ns;                  // Time of the next poll
+  long long t_miss_ns;                  // Time of the last poll not complete,
+                                        // 0 if none
+  long long interval_ns;                // Interval after the next poll
+};
+
+// ***************************************************************************
+// Vxi11PollerState - State of a Vxi11Poller
+// ***************************************************************************
+struct Vxi11PollerState {
+  pthread_mutex_t mutex;                // For the members below
+  pthread_cond_t cond;                  // Watch added or stop
+  pthread_cond_t cond_idle;             // readstb() or completion function
+                                        // of a link finished
+  pthread_t pthread;
+  bool b_stop;                          // Thread is stopping
+  long long interval_min_ns;
+  long long interval_max_ns;
+  long long coalesce_ns;
+  Vxi11PollerStats stats;               // Counters
+  std::map<Vxi11 *, Vxi11PollerLink> map_link; // Links watched or learned
+};
+
+// Completion found by the thread, called after the mutex is unlocked
+struct Vxi11PollerDone {
+  Vxi11 *p_vxi11;
+  int stb;
+  void (*pfn_done) (Vxi11 *, int, void *);
+  void *p_arg;
+};
+
+// Get the host of the device address "host:device" of a link
+static std::string
+poller_host (Vxi11 *p_vxi11)
+{
+  std::string s_addr = p_vxi11->device_addr ();
+  size_t idx = s_addr.rfind (':');
+  return ((idx == std::string::npos) ? s_addr : s_addr.substr (0, idx));
+}
+
+// ***************************************************************************
+// Vxi11Poller constructor - Start the thread
+//
+// Parameters:
+// 1. d_interval_min - Shortest interval between polls of a link, in seconds
+// 2. d_interval_max - Longest interval between polls of a link, in seconds
+// 3. d_coalesce     - How early a link may be polled with another link to
+//                     the same host, in seconds
+// ***************************************************************************
+  Vxi11Poller::
+Vxi11Poller (double d_interval_min, double d_interval_max, double d_coalesce)
+{
+  Vxi11PollerState *p_state = new Vxi11PollerState;
+  __p_state = p_state;
+  pthread_mutex_init (&p_state->mutex, NULL);
+  pthread_cond_init (&p_state->cond, NULL);
+  pthread_cond_init (&p_state->cond_idle, NULL);
+  p_state->b_stop = false;
+  p_state->interval_min_ns = (long long)(d_interval_min * 1e9);
+  p_state->interval_max_ns = (long long)(d_interval_max * 1e9);
+  if (p_state->interval_max_ns < p_state->interval_min_ns)
+    p_state->interval_max_ns = p_state->interval_min_ns;
+  p_state->coalesce_ns = (long long)(d_coalesce * 1e9);
+  memset (&p_state->stats, 0, sizeof (p_state->stats));
+
+  if (pthread_create (&p_state->pthread, NULL, &_fn_poll, p_state)) {
+    Vxi11::log_err ("Vxi11Poller error: could not start thread.\n");
+    p_state->b_stop = true;             // watch() returns an error
+    }
+}
+
+// ***************************************************************************
+// Vxi11Poller destructor - Stop the thread
+//
+// Notes: The completion functions of the watches not completed are not
+//        called.
+// ***************************************************************************
+  Vxi11Poller::
+~Vxi11Poller ()
+{
+  pthread_mutex_lock (&_p_state->mutex);
+  bool b_running = !_p_state->b_stop;
+  _p_state->b_stop = true;
+  pthread_cond_broadcast (&_p_state->cond);
+  pthread_mutex_unlock (&_p_state->mutex);
+  if (b_running)
+    pthread_join (_p_state->pthread, 0);
+
+  pthread_cond_destroy (&_p_state->cond_idle);
+  pthread_cond_destroy (&_p_state->cond);
+  pthread_mutex_destroy (&_p_state->mutex);
+  delete _p_state;
+}
+
+// ***************************************************************************
+// Vxi11Poller::watch - Poll a link until an operation completes
+//
+// Parameters:
+// 1. p_vxi11   - Link to poll, open
+// 2. mask      - Status byte bits to wait for, for example 0x20 (ESB)
+// 3. pfn_done  - Function called on the thread of the poller with the link,
+//                the status byte, or -1 if readstb() failed or timed out,
+//                and p_arg
+// 4. p_arg     - Parameter of pfn_done
+// 5. d_timeout - Longest time to poll in seconds, < 0 for no limit
+//
+// Returns: 0 = no error
+//          1 = link already watched, or poller stopped
+//
+// Notes: Call watch() right after starting the operation, since its time
+//        is measured from this call.  pfn_done may call watch() again for
+//        the same link.
+// ***************************************************************************
+  int Vxi11Poller::
+watch (Vxi11 *p_vxi11, int mask, void (*pfn_done) (Vxi11 *, int, void *),
+       void *p_arg, double d_timeout)
+{
+  std::string s_host = poller_host (p_vxi11);
+  long long t_now_ns = Vxi11Tracer::time_ns ();
+
+  pthread_mutex_lock (&_p_state->mutex);
+  Vxi11PollerLink &link = _p_state->map_link[p_vxi11];
+  if (link.b_watch || _p_state->b_stop) {
+    pthread_mutex_unlock (&_p_state->mutex);
+    Vxi11::log_err ("Vxi11Poller::watch error: %s already watched.\n",
+                    p_vxi11->device_addr ());
+    return (1);
+    }
+
+  link.s_host = s_host;
+  link.b_watch = true;
+  link.mask = mask;
+  link.pfn_done = pfn_done;
+  link.p_arg = p_arg;
+  link.t_start_ns = t_now_ns;
+  link.t_end_ns = (d_timeout < 0) ? 0 :
+                  t_now_ns + (long long)(d_timeout * 1e9);
+  link.t_miss_ns = 0;
+
+  // First poll at 3/4 of the learned time, then from 1/8 of it, doubling
+  long long expected_ns = (long long)(link.d_expected * 1e9);
+  link.t_next_ns = t_now_ns + ((expected_ns) ? expected_ns * 3 / 4 :
+                                               _p_state->interval_min_ns);
+  link.interval_ns = expected_ns / 8;
+  if (link.interval_ns < _p_state->interval_min_ns)
+    link.interval_ns = _p_state->interval_min_ns;
+  if (link.interval_ns > _p_state->interval_max_ns)
+    link.interval_ns = _p_state->interval_max_ns;
+
+  pthread_cond_broadcast (&_p_state->cond);
+  pthread_mutex_unlock (&_p_state->mutex);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Poller::remove - Stop watching a link and forget its learned time
+//
+// Parameters:
+// 1. p_vxi11 - Link
+//
+// Returns: None
+//
+// Notes: Waits for a readstb() or a completion function in progress on
+//        the link, unless called by a completion function.  A completion
+//        found but not called yet is dropped.  Call before deleting a link.
+// ***************************************************************************
+  void Vxi11Poller::
+remove (Vxi11 *p_vxi11)
+{
+  pthread_mutex_lock (&_p_state->mutex);
+  bool b_poller = pthread_equal (pthread_self (), _p_state->pthread);
+  std::map<Vxi11 *, Vxi11PollerLink>::iterator it;
+  while ((it = _p_state->map_link.find (p_vxi11)) !=
+         _p_state->map_link.end () && !b_poller &&
+         (it->second.b_polling || it->second.b_calling))
+    pthread_cond_wait (&_p_state->cond_idle, &_p_state->mutex);
+  if (it != _p_state->map_link.end ())
+    _p_state->map_link.erase (it);
+  pthread_mutex_unlock (&_p_state->mutex);
+}
+
+// ***************************************************************************
+// Vxi11Poller::expected - Get the learned time of an operation on a link
+//
+// Parameters:
+// 1. p_vxi11 - Link
+//
+// Returns: Time in seconds, 0 if not known yet
+// ***************************************************************************
+  double Vxi11Poller::
+expected (Vxi11 *p_vxi11)
+{
+  pthread_mutex_lock (&_p_state->mutex);
+  std::map<Vxi11 *, Vxi11PollerLink>::iterator it =
+    _p_state->map_link.find (p_vxi11);
+  double d_expected = (it != _p_state->map_link.end ()) ?
+                      it->second.d_expected : 0;
+  pthread_mutex_unlock (&_p_state->mutex);
+  return (d_expected);
+}
+
+// ***************************************************************************
+// Vxi11Poller::stats - Get the counters
+//
+// Parameters: None
+//
+// Returns: Counters since the poller was created
+// ***************************************************************************
+  Vxi11PollerStats Vxi11Poller::
+stats (void)
+{
+  pthread_mutex_lock (&_p_state->mutex);
+  Vxi11PollerStats stats = _p_state->stats;
+  pthread_mutex_unlock (&_p_state->mutex);
+  return (stats);
+}
+
+// ***************************************************************************
+// Vxi11Poller::_fn_poll - Private static thread function polling the links
+//
+// Parameters:
+// 1. p_arg - Vxi11PollerState* of the poller
+//
+// Returns: Null, when the poller is destroyed
+//
+// Notes: Each pass polls the links that are due, and the links to the same
+//        hosts that are due within the coalescing time, one after the other
+//        without the mutex locked.  The completion functions are called
+//        after the pass, each only if its link was not removed meanwhile.
+// ***************************************************************************
+  void *Vxi11Poller::
+_fn_poll (void *p_arg)
+{
+  Vxi11PollerState *p_state = (Vxi11PollerState *)p_arg;
+  std::vector<Vxi11 *> a_p_poll;
+  std::vector<Vxi11PollerDone> a_done;
+  typedef std::map<Vxi11 *, Vxi11PollerLink>::iterator Iter;
+
+  pthread_mutex_lock (&p_state->mutex);
+  while (!p_state->b_stop) {
+    // Find the next poll, and the hosts with a link due
+    long long t_now_ns = Vxi11Tracer::time_ns ();
+    long long t_next_ns = 0;
+    std::vector<std::string> a_s_host;
+    for (Iter it = p_state->map_link.begin ();
+         it != p_state->map_link.end (); ++it) {
+      Vxi11PollerLink &link = it->second;
+      if (!link.b_watch)
+        continue;
+      if (link.t_next_ns <= t_now_ns)
+        a_s_host.push_back (link.s_host);
+      else if (!t_next_ns || link.t_next_ns < t_next_ns)
+        t_next_ns = link.t_next_ns;
+      }
+
+    // Sleep until the next poll, or until watch() is called
+    if (a_s_host.empty ()) {
+      if (!t_next_ns)
+        pthread_cond_wait (&p_state->cond, &p_state->mutex);
+      else {
+        timespec ts;                    // pthread_cond_timedwait() uses
+        clock_gettime (CLOCK_REALTIME, &ts); // CLOCK_REALTIME
+        long long t_wake_ns = (long long)ts.tv_sec * 1000000000LL +
+                              ts.tv_nsec + (t_next_ns - t_now_ns);
+        ts.tv_sec = t_wake_ns / 1000000000LL;
+        ts.tv_nsec = t_wake_ns % 1000000000LL;
+        pthread_cond_timedwait (&p_state->cond, &p_state->mutex, &ts);
+        }
+      continue;
+      }
+
+    // Links due, and links of the same hosts due within the coalescing time
+    a_p_poll.clear ();
+    for (Iter it = p_state->map_link.begin ();
+         it != p_state->map_link.end (); ++it) {
+      Vxi11PollerLink &link = it->second;
+      if (!link.b_watch)
+        continue;
+      bool b_due = (link.t_next_ns <= t_now_ns);
+      bool b_coalesce = !b_due &&
+        link.t_next_ns <= t_now_ns + p_state->coalesce_ns &&
+        std::find (a_s_host.begin (), a_s_host.end (), link.s_host) !=
+        a_s_host.end ();
+      if (b_due || b_coalesce) {
+        link.b_polling = true;
+        a_p_poll.push_back (it->first);
+        p_state->stats.cnt_coalesce += b_coalesce;
+        }
+      }
+
+    // Poll them in turn, grouped by host
+    for (size_t i=0; i < a_p_poll.size (); i++) {
+      Vxi11 *p_vxi11 = a_p_poll[i];
+      pthread_mutex_unlock (&p_state->mutex);
+      int stb = p_vxi11->readstb ();
+      long long t_poll_ns = Vxi11Tracer::time_ns ();
+      pthread_mutex_lock (&p_state->mutex);
+      p_state->stats.cnt_poll++;
+
+      Iter it = p_state->map_link.find (p_vxi11);
+      if (it == p_state->map_link.end ())
+        continue;                       // Not possible while b_polling
+      Vxi11PollerLink &link = it->second;
+      link.b_polling = false;
+      pthread_cond_broadcast (&p_state->cond_idle);
+
+      bool b_done = (stb >= 0) && (stb & link.mask);
+      bool b_timeout = link.t_end_ns && (t_poll_ns >= link.t_end_ns);
+      if (b_done) {
+        // The operation completed between the last poll that was not
+        // complete and this one; learn the middle of that time
+        long long t_begin_ns = (link.t_miss_ns) ? link.t_miss_ns :
+                                                  link.t_start_ns;
+        double d_time = ((t_begin_ns + t_poll_ns) / 2 - link.t_start_ns) *
+                        1e-9;
+        link.d_expected = (link.d_expected) ?
+          link.d_expected + D_LEARN_WEIGHT * (d_time - link.d_expected) :
+          d_time;
+        }
+      if (b_done || stb < 0 || b_timeout) {
+        Vxi11PollerDone done = {p_vxi11, (b_done) ? stb : -1,
+                                link.pfn_done, link.p_arg};
+        a_done.push_back (done);
+        link.b_watch = false;
+        p_state->stats.cnt_done++;
+        continue;
+        }
+
+      // Not complete: back off
+      link.t_miss_ns = t_poll_ns;
+      link.t_next_ns = t_poll_ns + link.interval_ns;
+      link.interval_ns *= 2;
+      if (link.interval_ns > p_state->interval_max_ns)
+        link.interval_ns = p_state->interval_max_ns;
+      }
+
+    // Call the completion functions, which may call watch() again; remove()
+    // waits for the one running, and drops the others of its link
+    for (size_t i=0; i < a_done.size (); i++) {
+      Vxi11 *p_vxi11 = a_done[i].p_vxi11;
+      Iter it = p_state->map_link.find (p_vxi11);
+      if (it == p_state->map_link.end ())
+        continue;                       // Removed after its poll
+      it->second.b_calling = true;
+      pthread_mutex_unlock (&p_state->mutex);
+      a_done[i].pfn_done (p_vxi11, a_done[i].stb, a_done[i].p_arg);
+      pthread_mutex_lock (&p_state->mutex);
+      it = p_state->map_link.find (p_vxi11);
+      if (it != p_state->map_link.end ())
+        it->second.b_calling = false;
+      pthread_cond_broadcast (&p_state->cond_idle);
+      }
+    a_done.clear ();
+    }
+  pthread_mutex_unlock (&p_state->mutex);
+
+  return (0);
+}
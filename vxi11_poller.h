@@ -0,0 +1,95 @@
+#ifndef VXI11_POLLER_H
+#define VXI11_POLLER_H
+
+// ***************************************************************************
+// vxi11_poller.h - Adaptive status byte polling of many links, for
+//                  libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// A Vxi11Poller waits for operations to complete on devices that cannot
+// send SRQ, such as instruments behind a GPIB/LAN gateway without an
+// interrupt channel.  One thread reads the status byte of each link watched
+// until a bit of its mask is set, then calls the completion function:
+//
+//   - The time an operation of each link takes is learned, as a moving
+//     average.  The first poll is at 3/4 of that time, then the interval
+//     doubles after each poll that is not complete, from 1/8 of that time
+//     up to the longest interval.  Without history, polling starts at the
+//     shortest interval.
+//   - When a link is due, the other links to the same host (the gateway)
+//     that are due within the coalescing time are polled with it, so the
+//     gateway sees one burst instead of many separate polls.
+//
+//   Vxi11Poller poller;
+//   vxi11.printf ("*CLS;*ESE 1;INIT;*OPC");
+//   poller.watch (&vxi11, 0x20, &on_done, &station);
+//
+// The links are polled with readstb(), so the device must set the bits of
+// mask when the operation completes, for example ESB (0x20) with "*ESE 1"
+// and "*OPC".  A link must not be deleted while it is watched; call
+// remove() first.
+// ***************************************************************************
+
+#include "libvxi11.h"
+
+// Counters of a Vxi11Poller, see Vxi11Poller::stats()
+struct Vxi11PollerStats {
+  unsigned long cnt_poll;               // readstb() calls
+  unsigned long cnt_coalesce;           // Polls made early with a link to
+                                        // the same host
+  unsigned long cnt_done;               // Watches completed, with an error,
+                                        // or timed out
+};
+
+// ***************************************************************************
+// Vxi11Poller - Status byte polling with learned backoff per link
+// ***************************************************************************
+class Vxi11Poller {
+ private:
+  void *__p_state;                      // Links and thread, type
+                                        // Vxi11PollerState*
+                                        // Use macro _p_state for access
+
+  static void *_fn_poll (void *p_arg);  // Thread function
+
+ public:
+  // d_interval_min = shortest interval between polls of a link, in seconds
+  // d_interval_max = longest interval between polls of a link, in seconds
+  // d_coalesce     = how early a link may be polled with another link to
+  //                  the same host, in seconds
+  Vxi11Poller (double d_interval_min = 0.001, double d_interval_max = 0.1,
+               double d_coalesce = 0.002);
+
+  // Stop the thread; watches not completed are dropped
+  ~Vxi11Poller ();
+
+  // Poll p_vxi11 until its status byte has a bit of mask set, then call
+  // pfn_done with the status byte, or -1 if readstb() failed or d_timeout
+  // seconds passed (< 0 for no limit)
+  // Returns 1 if the link is already watched.
+  int watch (Vxi11 *p_vxi11, int mask,
+             void (*pfn_done) (Vxi11 *p_vxi11, int stb, void *p_arg),
+             void *p_arg = 0, double d_timeout = -1);
+
+  // Stop watching p_vxi11, without calling its completion function, and
+  // forget its learned time
+  // Waits for a readstb() or completion function in progress on the link.
+  void remove (Vxi11 *p_vxi11);
+
+  // Get the learned time of an operation on p_vxi11, in seconds, 0 if not
+  // known yet
+  double expected (Vxi11 *p_vxi11);
+
+  // Get the counters
+  Vxi11PollerStats stats (void);
+};
+
+#endif
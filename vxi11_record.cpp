@@ -0,0 +1,708 @@
+// ***************************************************************************
+// vxi11_record.cpp - Recording and replay of VXI-11 RPC sessions for
+//                    libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_record.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Macro to conveniently access the mutex member of the classes.
+// It is defined as void * in the class so that the .h file does not need to
+// include pthread.h.
+#define _p_mtx          ((pthread_mutex_t *)_p_mutex)
+
+// Initial size of the memory mapping of a record file
+static const unsigned long long SIZE_MAP_INITIAL = 1024 * 1024;
+
+// ***************************************************************************
+// Vxi11RecordFile constructor - Do not open file yet
+// ***************************************************************************
+  Vxi11RecordFile::
+Vxi11RecordFile (void)
+{
+  _fd = -1;                             // No file yet
+  _p_map = 0;
+  _size_map = 0;
+  _p_mutex = new pthread_mutex_t;
+  pthread_mutex_init (_p_mtx, NULL);
+}
+
+// ***************************************************************************
+// Vxi11RecordFile destructor - Close file if it is open
+// ***************************************************************************
+  Vxi11RecordFile::
+~Vxi11RecordFile ()
+{
+  close ();
+  pthread_mutex_destroy (_p_mtx);
+  delete _p_mtx;
+}
+
+// ***************************************************************************
+// Vxi11RecordFile::open - Create a new session trace file
+//
+// Parameters:
+// 1. s_file        - Name of file to create; an existing file is replaced
+// 2. s_device_addr - Device address & name being recorded
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11RecordFile::
+open (const char *s_file, const char *s_device_addr)
+{
+  close ();                             // Close previous file, if any
+
+  _fd = ::open (s_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (_fd < 0) {
+    Vxi11::log_err ("Vxi11RecordFile::open error: could not create %s.\n",
+                    s_file);
+    return (1);
+    }
+
+  // Map the initial part of the file, the mapping will grow as needed
+  if (_reserve (sizeof (Vxi11RecordHeader))) {
+    ::close (_fd);
+    _fd = -1;
+    return (1);
+    }
+
+  Vxi11RecordHeader *p_header = _p_header ();
+  memset (p_header, 0, sizeof (Vxi11RecordHeader));
+  memcpy (p_header->magic, VXI11_RECORD_MAGIC, sizeof (p_header->magic));
+  p_header->version = VXI11_RECORD_VERSION;
+  p_header->size_header = sizeof (Vxi11RecordHeader);
+  p_header->t_start_ns = Vxi11Tracer::time_ns ();
+  strncpy (p_header->s_device_addr, (s_device_addr) ? s_device_addr : "",
+           sizeof (p_header->s_device_addr) - 1);
+  p_header->cnt_used = sizeof (Vxi11RecordHeader);
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11RecordFile::close - Close the session trace file
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: The file is truncated to the size actually used.
+// ***************************************************************************
+  int Vxi11RecordFile::
+close (void)
+{
+  if (_fd < 0)
+    return (0);
+
+  int err = 0;
+  unsigned long long cnt_used = _p_header ()->cnt_used;
+
+  if (munmap (_p_map, _size_map))
+    err = 1;
+  if (ftruncate (_fd, cnt_used))
+    err = 1;
+  if (::close (_fd))
+    err = 1;
+
+  if (err)
+    Vxi11::log_err ("Vxi11RecordFile::close error: could not close file.\n");
+
+  _fd = -1;
+  _p_map = 0;
+  _size_map = 0;
+
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11RecordFile::_reserve - Grow the file and its mapping so that cnt more
+//                             bytes can be appended
+//
+// Parameters:
+// 1. cnt - Number of bytes that will be appended
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Must be called with the mutex locked, or before the file is used.
+// ***************************************************************************
+  int Vxi11RecordFile::
+_reserve (unsigned long long cnt)
+{
+  unsigned long long cnt_used = (_p_map) ? _p_header ()->cnt_used : 0;
+  if (cnt_used + cnt <= _size_map)      // Early return if it already fits
+    return (0);
+
+  // Double the size of the mapping to reduce the number of remappings
+  unsigned long long size_map = (_size_map) ? _size_map : SIZE_MAP_INITIAL;
+  while (size_map < cnt_used + cnt)
+    size_map *= 2;
+
+  if (ftruncate (_fd, size_map)) {
+    Vxi11::log_err ("Vxi11RecordFile error: could not grow file to %llu "
+                    "bytes.\n", size_map);
+    return (1);
+    }
+
+  if (_p_map)
+    munmap (_p_map, _size_map);
+
+  void *p_map = mmap (0, size_map, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (p_map == MAP_FAILED) {
+    Vxi11::log_err ("Vxi11RecordFile error: could not map %llu bytes.\n",
+                    size_map);
+    _p_map = 0;
+    _size_map = 0;
+    return (1);
+    }
+
+  _p_map = (char *)p_map;
+  _size_map = size_map;
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11RecordFile::append - Append one RPC to the session trace file
+//
+// Parameters:
+// 1. prog       - RPC program number
+// 2. proc       - RPC procedure number
+// 3. xid        - RPC transaction ID
+// 4. t_begin_ns - Monotonic time the RPC started
+// 5. t_end_ns   - Monotonic time the RPC ended
+// 6. stat       - RPC status
+// 7. xdr_args   - XDR function for the arguments
+// 8. p_args     - Arguments
+// 9. xdr_res    - XDR function for the results
+// 10. p_res     - Results, only used if stat is RPC_SUCCESS
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: The arguments and results are XDR encoded directly into the
+//        memory mapping of the file.
+// ***************************************************************************
+  int Vxi11RecordFile::
+append (unsigned int prog, unsigned int proc, unsigned int xid,
+        long long t_begin_ns, long long t_end_ns, enum clnt_stat stat,
+        xdrproc_t xdr_args, void *p_args, xdrproc_t xdr_res, void *p_res)
+{
+  unsigned int cnt_args = xdr_sizeof (xdr_args, p_args);
+  unsigned int cnt_res = (stat == RPC_SUCCESS) ? xdr_sizeof (xdr_res, p_res)
+                                               : 0;
+  unsigned int size = (sizeof (Vxi11RecordEntry) + cnt_args + cnt_res + 7) &
+                      ~7u;
+
+  pthread_mutex_lock (_p_mtx);
+
+  if ((_fd < 0) || _reserve (size)) {
+    pthread_mutex_unlock (_p_mtx);
+    return (1);
+    }
+
+  Vxi11RecordHeader *p_header = _p_header ();
+  char *p_data = _p_map + p_header->cnt_used;
+  memset (p_data, 0, size);
+
+  Vxi11RecordEntry *p_entry = (Vxi11RecordEntry *)p_data;
+  p_entry->size = size;
+  p_entry->prog = prog;
+  p_entry->proc = proc;
+  p_entry->xid = xid;
+  p_entry->t_begin_ns = t_begin_ns - p_header->t_start_ns;
+  p_entry->t_end_ns = t_end_ns - p_header->t_start_ns;
+  p_entry->stat = stat;
+  p_entry->cnt_args = cnt_args;
+  p_entry->cnt_res = cnt_res;
+
+  // Encode arguments and results after the entry header
+  XDR xdrs;
+  bool b_ok = true;
+  xdrmem_create (&xdrs, (char *)(p_entry + 1), cnt_args, XDR_ENCODE);
+  b_ok = xdr_args (&xdrs, p_args);
+  xdr_destroy (&xdrs);
+  if (b_ok && cnt_res) {
+    xdrmem_create (&xdrs, (char *)(p_entry + 1) + cnt_args, cnt_res,
+                   XDR_ENCODE);
+    b_ok = xdr_res (&xdrs, p_res);
+    xdr_destroy (&xdrs);
+    }
+
+  // Only make the entry visible once it is complete
+  if (b_ok)
+    p_header->cnt_used += size;
+
+  pthread_mutex_unlock (_p_mtx);
+
+  if (!b_ok) {
+    Vxi11::log_err ("Vxi11RecordFile::append error: could not encode RPC "
+                    "%u.\n", proc);
+    return (1);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Recording RPC client
+//
+// This is an RPC client (CLIENT) that passes every call to another RPC
+// client and appends the call and its reply to a Vxi11RecordFile.
+// ***************************************************************************
+struct Vxi11RecordClient {
+  CLIENT client;                        // Must be first
+  CLIENT *p_client;                     // Client making the actual calls
+  Vxi11RecordFile *p_file;              // File to record to
+  unsigned int prog;                    // RPC program of p_client
+};
+
+static enum clnt_stat
+record_call (CLIENT *p_client, rpcproc_t proc, xdrproc_t xdr_args,
+             void *p_args, xdrproc_t xdr_res, void *p_res,
+             struct timeval timeout)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+
+  long long t_begin_ns = Vxi11Tracer::time_ns ();
+  enum clnt_stat stat = clnt_call (p_record->p_client, proc, xdr_args,
+                                   (char *)p_args, xdr_res, (char *)p_res,
+                                   timeout);
+  long long t_end_ns = Vxi11Tracer::time_ns ();
+
+  u_int32_t xid = 0;
+  clnt_control (p_record->p_client, CLGET_XID, (char *)&xid);
+
+  p_record->p_file->append (p_record->prog, proc, xid, t_begin_ns, t_end_ns,
+                            stat, xdr_args, p_args, xdr_res, p_res);
+  return (stat);
+}
+
+static void
+record_abort (CLIENT *p_client)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+  clnt_abort (p_record->p_client);
+}
+
+static void
+record_geterr (CLIENT *p_client, struct rpc_err *p_err)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+  clnt_geterr (p_record->p_client, p_err);
+}
+
+static bool_t
+record_freeres (CLIENT *p_client, xdrproc_t xdr_res, void *p_res)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+  return (clnt_freeres (p_record->p_client, xdr_res, (char *)p_res));
+}
+
+static void
+record_destroy (CLIENT *p_client)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+  clnt_destroy (p_record->p_client);
+  delete p_record;
+}
+
+static bool_t
+record_control (CLIENT *p_client, u_int request, void *p_info)
+{
+  Vxi11RecordClient *p_record = (Vxi11RecordClient *)p_client;
+  return (clnt_control (p_record->p_client, request, (char *)p_info));
+}
+
+static CLIENT::clnt_ops record_ops = {
+  record_call, record_abort, record_geterr, record_freeres, record_destroy,
+  record_control
+};
+
+// ***************************************************************************
+// Vxi11RecordFile::client - Create an RPC client that records every call
+//
+// Parameters:
+// 1. p_client - RPC client that makes the actual calls
+// 2. prog     - RPC program of p_client, DEVICE_CORE or DEVICE_ASYNC
+//
+// Returns: Recording RPC client, destroy with clnt_destroy()
+//          Destroying it also destroys p_client.
+// ***************************************************************************
+  CLIENT *Vxi11RecordFile::
+client (CLIENT *p_client, unsigned int prog)
+{
+  Vxi11RecordClient *p_record = new Vxi11RecordClient;
+  memset (p_record, 0, sizeof (Vxi11RecordClient));
+  p_record->client.cl_auth = p_client->cl_auth;
+  p_record->client.cl_ops = &record_ops;
+  p_record->p_client = p_client;
+  p_record->p_file = this;
+  p_record->prog = prog;
+
+  return (&p_record->client);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile constructor - Do not open file yet
+// ***************************************************************************
+  Vxi11ReplayFile::
+Vxi11ReplayFile (void)
+{
+  _fd = -1;                             // No file yet
+  _p_map = 0;
+  _size_map = 0;
+  _a_offset[0] = _a_offset[1] = 0;
+  _p_mutex = new pthread_mutex_t;
+  pthread_mutex_init (_p_mtx, NULL);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile destructor - Close file if it is open
+// ***************************************************************************
+  Vxi11ReplayFile::
+~Vxi11ReplayFile ()
+{
+  close ();
+  pthread_mutex_destroy (_p_mtx);
+  delete _p_mtx;
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile::open - Open a session trace file for reading
+//
+// Parameters:
+// 1. s_file - Name of file created by Vxi11RecordFile
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11ReplayFile::
+open (const char *s_file)
+{
+  close ();                             // Close previous file, if any
+
+  _fd = ::open (s_file, O_RDONLY);
+  if (_fd < 0) {
+    Vxi11::log_err ("Vxi11ReplayFile::open error: could not open %s.\n",
+                    s_file);
+    return (1);
+    }
+
+  struct stat st;
+  if (fstat (_fd, &st) || (st.st_size < (off_t)sizeof (Vxi11RecordHeader))) {
+    Vxi11::log_err ("Vxi11ReplayFile::open error: %s is too short.\n",
+                    s_file);
+    ::close (_fd);
+    _fd = -1;
+    return (1);
+    }
+
+  void *p_map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+  if (p_map == MAP_FAILED) {
+    Vxi11::log_err ("Vxi11ReplayFile::open error: could not map %s.\n",
+                    s_file);
+    ::close (_fd);
+    _fd = -1;
+    return (1);
+    }
+  _p_map = (char *)p_map;
+  _size_map = st.st_size;
+
+  // Check that this is a file this version can read.  A file that was not
+  // closed is still valid up to cnt_used.
+  const Vxi11RecordHeader *p_header = header ();
+  if (memcmp (p_header->magic, VXI11_RECORD_MAGIC, sizeof (p_header->magic)) ||
+      (p_header->version != VXI11_RECORD_VERSION) ||
+      (p_header->size_header != sizeof (Vxi11RecordHeader)) ||
+      (p_header->cnt_used > _size_map)) {
+    Vxi11::log_err ("Vxi11ReplayFile::open error: %s is not a valid session "
+                    "trace file.\n", s_file);
+    close ();
+    return (1);
+    }
+
+  _a_offset[0] = _a_offset[1] = 0;
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile::close - Close the session trace file
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+// ***************************************************************************
+  int Vxi11ReplayFile::
+close (void)
+{
+  if (_fd < 0)
+    return (0);
+
+  munmap (_p_map, _size_map);
+  ::close (_fd);
+  _fd = -1;
+  _p_map = 0;
+  _size_map = 0;
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile::entry - Get an entry and advance to the next one
+//
+// Parameters:
+// 1. p_offset - Offset of entry to get, 0 for the first entry
+//               Updated to the offset of the next entry
+//
+// Returns: Entry, or null if there are no more entries
+// ***************************************************************************
+  const Vxi11RecordEntry *Vxi11ReplayFile::
+entry (unsigned long long *p_offset)
+{
+  if (_fd < 0)
+    return (0);
+
+  unsigned long long offset = *p_offset;
+  if (offset < sizeof (Vxi11RecordHeader))
+    offset = sizeof (Vxi11RecordHeader);
+
+  if (offset + sizeof (Vxi11RecordEntry) > header ()->cnt_used)
+    return (0);
+
+  const Vxi11RecordEntry *p_entry = (const Vxi11RecordEntry *)(_p_map+offset);
+  if ((p_entry->size < sizeof (Vxi11RecordEntry)) ||
+      (offset + p_entry->size > header ()->cnt_used) ||
+      (sizeof (Vxi11RecordEntry) + p_entry->cnt_args + p_entry->cnt_res >
+       p_entry->size)) {
+    Vxi11::log_err ("Vxi11ReplayFile error: corrupt entry at offset %llu.\n",
+                    offset);
+    return (0);
+    }
+
+  *p_offset = offset + p_entry->size;
+  return (p_entry);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile::decode_args - Decode the recorded arguments of an entry
+//
+// Parameters:
+// 1. p_entry  - Entry from entry() or next()
+// 2. xdr_args - XDR function for the arguments of the entry's procedure
+// 3. p_args   - Stores decoded arguments here; must be zeroed by the caller
+//
+// Returns: true if decoded
+//
+// Notes: Free the decoded arguments with xdr_free (xdr_args, p_args).
+// ***************************************************************************
+  bool Vxi11ReplayFile::
+decode_args (const Vxi11RecordEntry *p_entry, xdrproc_t xdr_args,
+             void *p_args)
+{
+  XDR xdrs;
+  xdrmem_create (&xdrs, (char *)args (p_entry), p_entry->cnt_args,
+                 XDR_DECODE);
+  bool b_ok = xdr_args (&xdrs, p_args);
+  xdr_destroy (&xdrs);
+  return (b_ok);
+}
+
+// ***************************************************************************
+// Vxi11ReplayFile::next - Get the next entry to replay for an RPC
+//
+// Parameters:
+// 1. prog      - RPC program number
+// 2. proc      - RPC procedure number
+// 3. pcnt_skip - Returns number of entries of prog skipped because they were
+//                for other procedures
+//
+// Returns: Entry, or null if there are no more entries for proc
+//
+// Notes: Each program has its own cursor, so the abort channel can be
+//        replayed independently of the core channel.
+// ***************************************************************************
+  const Vxi11RecordEntry *Vxi11ReplayFile::
+next (unsigned int prog, unsigned int proc, int *pcnt_skip)
+{
+  int idx = (prog == DEVICE_ASYNC) ? 1 : 0;
+  *pcnt_skip = 0;
+
+  pthread_mutex_lock (_p_mtx);
+
+  unsigned long long offset = _a_offset[idx];
+  const Vxi11RecordEntry *p_entry;
+  while ((p_entry = entry (&offset)) != 0) {
+    if (p_entry->prog != prog)          // Entry for the other channel
+      continue;
+    if (p_entry->proc == proc)
+      break;
+    (*pcnt_skip)++;
+    }
+
+  if (p_entry)                          // Leave cursor in place at the end
+    _a_offset[idx] = offset;            // so a later call fails the same way
+
+  pthread_mutex_unlock (_p_mtx);
+
+  return (p_entry);
+}
+
+// ***************************************************************************
+// Replay RPC client
+//
+// This is an RPC client (CLIENT) that does no I/O.  Each call returns the
+// reply recorded for the next call of the same procedure in a
+// Vxi11ReplayFile.
+// ***************************************************************************
+struct Vxi11ReplayClient {
+  CLIENT client;                        // Must be first
+  Vxi11ReplayFile *p_file;              // File to replay from
+  unsigned int prog;                    // RPC program replayed
+  bool b_realtime;                      // Wait for recorded RPC durations
+  u_int32_t xid;                        // Transaction ID of last call
+  enum clnt_stat stat;                  // Status of last call
+};
+
+static enum clnt_stat
+replay_call (CLIENT *p_client, rpcproc_t proc, xdrproc_t xdr_args,
+             void *p_args, xdrproc_t xdr_res, void *p_res,
+             struct timeval timeout)
+{
+  Vxi11ReplayClient *p_replay = (Vxi11ReplayClient *)p_client;
+
+  int cnt_skip;
+  const Vxi11RecordEntry *p_entry = p_replay->p_file->next (p_replay->prog,
+                                                           proc, &cnt_skip);
+  if (cnt_skip)
+    Vxi11::log_err ("Vxi11ReplayFile: skipped %d recorded RPCs before "
+                    "procedure %u.\n", cnt_skip, (unsigned int)proc);
+
+  if (!p_entry) {
+    Vxi11::log_err ("Vxi11ReplayFile: no recorded reply for procedure %u.\n",
+                    (unsigned int)proc);
+    p_replay->stat = RPC_CANTRECV;
+    return (p_replay->stat);
+    }
+
+  p_replay->xid = p_entry->xid;
+
+  // Reproduce the time the device took to reply
+  if (p_replay->b_realtime) {
+    long long t_ns = p_entry->t_end_ns - p_entry->t_begin_ns;
+    struct timespec ts = {time_t (t_ns / 1000000000LL),
+                          long (t_ns % 1000000000LL)};
+    nanosleep (&ts, 0);
+    }
+
+  p_replay->stat = (enum clnt_stat)p_entry->stat;
+  if (p_replay->stat != RPC_SUCCESS)
+    return (p_replay->stat);
+
+  XDR xdrs;
+  xdrmem_create (&xdrs, (char *)p_replay->p_file->res (p_entry),
+                 p_entry->cnt_res, XDR_DECODE);
+  if (!xdr_res (&xdrs, p_res))
+    p_replay->stat = RPC_CANTDECODERES;
+  xdr_destroy (&xdrs);
+
+  return (p_replay->stat);
+}
+
+static void
+replay_abort (CLIENT *p_client)
+{
+}
+
+static void
+replay_geterr (CLIENT *p_client, struct rpc_err *p_err)
+{
+  Vxi11ReplayClient *p_replay = (Vxi11ReplayClient *)p_client;
+  memset (p_err, 0, sizeof (struct rpc_err));
+  p_err->re_status = p_replay->stat;
+}
+
+static bool_t
+replay_freeres (CLIENT *p_client, xdrproc_t xdr_res, void *p_res)
+{
+  xdr_free (xdr_res, (char *)p_res);
+  return (TRUE);
+}
+
+static void
+replay_destroy (CLIENT *p_client)
+{
+  Vxi11ReplayClient *p_replay = (Vxi11ReplayClient *)p_client;
+  auth_destroy (p_replay->client.cl_auth);
+  delete p_replay;
+}
+
+static bool_t
+replay_control (CLIENT *p_client, u_int request, void *p_info)
+{
+  Vxi11ReplayClient *p_replay = (Vxi11ReplayClient *)p_client;
+
+  switch (request) {
+  case CLGET_XID:                       // Transaction ID of last call
+    *(u_int32_t *)p_info = p_replay->xid;
+    break;
+  case CLSET_XID:                       // Replies carry the recorded IDs
+    break;
+  default:                              // Timeouts etc. have no effect
+    break;
+    }
+
+  return (TRUE);
+}
+
+static CLIENT::clnt_ops replay_ops = {
+  replay_call, replay_abort, replay_geterr, replay_freeres, replay_destroy,
+  replay_control
+};
+
+// ***************************************************************************
+// Vxi11ReplayFile::client - Create an RPC client that replays recorded
+//                           replies
+//
+// Parameters:
+// 1. prog       - RPC program to replay, DEVICE_CORE or DEVICE_ASYNC
+// 2. b_realtime - true  = wait for the recorded duration of each RPC
+//                 false = reply immediately
+//
+// Returns: Replay RPC client, destroy with clnt_destroy()
+// ***************************************************************************
+  CLIENT *Vxi11ReplayFile::
+client (unsigned int prog, bool b_realtime)
+{
+  Vxi11ReplayClient *p_replay = new Vxi11ReplayClient;
+  memset (p_replay, 0, sizeof (Vxi11ReplayClient));
+  p_replay->client.cl_auth = authnone_create ();
+  p_replay->client.cl_ops = &replay_ops;
+  p_replay->p_file = this;
+  p_replay->prog = prog;
+  p_replay->b_realtime = b_realtime;
+  p_replay->stat = RPC_SUCCESS;
+
+  return (&p_replay->client);
+}
@@ -0,0 +1,140 @@
+#ifndef VXI11_RECORD_H
+#define VXI11_RECORD_H
+
+// ***************************************************************************
+// vxi11_record.h - Recording and replay of VXI-11 RPC sessions for
+//                  libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Session trace file format
+//
+// The file is written through a shared memory mapping and is append-only.
+// All values are in host byte order.  The RPC arguments and results are
+// stored in their XDR encoded form, exactly as they are sent on the wire
+// (without the RPC message header and record marking).
+//
+//   Vxi11RecordHeader                   File header
+//   Vxi11RecordEntry + args + results   One per RPC, padded to 8 bytes
+//   ...
+// ***************************************************************************
+
+#include <rpc/rpc.h>
+
+#define VXI11_RECORD_MAGIC   "VXI11REC"
+#define VXI11_RECORD_VERSION 1
+
+struct Vxi11RecordHeader {
+  char magic[8];                        // VXI11_RECORD_MAGIC, not terminated
+  unsigned int version;                 // VXI11_RECORD_VERSION
+  unsigned int size_header;             // sizeof (Vxi11RecordHeader)
+  unsigned long long cnt_used;          // Bytes used in file, incl. header
+  long long t_start_ns;                 // Monotonic time file was created
+  char s_device_addr[256];              // Device address & name recorded
+};
+
+struct Vxi11RecordEntry {
+  unsigned int size;                    // Size of entry incl. this header
+  unsigned int prog;                    // RPC program, DEVICE_CORE/ASYNC
+  unsigned int proc;                    // RPC procedure number
+  unsigned int xid;                     // RPC transaction ID
+  long long t_begin_ns;                 // Start of RPC, from t_start_ns
+  long long t_end_ns;                   // End of RPC, from t_start_ns
+  int stat;                             // RPC status, enum clnt_stat
+  unsigned int cnt_args;                // Bytes of XDR encoded arguments
+  unsigned int cnt_res;                 // Bytes of XDR encoded results
+                                        // 0 if stat is not RPC_SUCCESS
+  unsigned int reserved;
+};
+
+// ***************************************************************************
+// Vxi11RecordFile - Append-only, memory-mapped session trace file writer
+// ***************************************************************************
+class Vxi11RecordFile {
+ private:
+  int _fd;                              // File descriptor, -1 if not open
+  char *_p_map;                         // Memory mapping of the file
+  unsigned long long _size_map;         // Size of the mapping
+  void *_p_mutex;                       // Mutex for appends, pthread_mutex_t*
+
+  Vxi11RecordHeader *_p_header (void) {
+    return ((Vxi11RecordHeader *)_p_map);
+    }
+  int _reserve (unsigned long long cnt);// Grow mapping to fit cnt more bytes
+
+ public:
+  Vxi11RecordFile (void);
+  ~Vxi11RecordFile ();
+
+  int open (const char *s_file, const char *s_device_addr);
+  int close (void);
+
+  // Append one RPC to the file
+  int append (unsigned int prog, unsigned int proc, unsigned int xid,
+              long long t_begin_ns, long long t_end_ns, enum clnt_stat stat,
+              xdrproc_t xdr_args, void *p_args,
+              xdrproc_t xdr_res, void *p_res);
+
+  // Create an RPC client that records every call made through p_client
+  // Destroying the returned client also destroys p_client
+  CLIENT *client (CLIENT *p_client, unsigned int prog);
+};
+
+// ***************************************************************************
+// Vxi11ReplayFile - Reader for a session trace file
+// ***************************************************************************
+class Vxi11ReplayFile {
+ private:
+  int _fd;                              // File descriptor, -1 if not open
+  char *_p_map;                         // Memory mapping of the file
+  unsigned long long _size_map;         // Size of the mapping
+  void *_p_mutex;                       // Mutex for cursors, pthread_mutex_t*
+  unsigned long long _a_offset[2];      // Replay cursor for DEVICE_CORE and
+                                        // DEVICE_ASYNC
+
+ public:
+  Vxi11ReplayFile (void);
+  ~Vxi11ReplayFile ();
+
+  int open (const char *s_file);
+  int close (void);
+
+  // Get the file header
+  const Vxi11RecordHeader *header (void) {
+    return ((const Vxi11RecordHeader *)_p_map);
+    }
+
+  // Iterate over entries
+  // Start with offset 0; returns null at the end of the file
+  const Vxi11RecordEntry *entry (unsigned long long *p_offset);
+
+  // Get the XDR encoded arguments and results of an entry
+  const char *args (const Vxi11RecordEntry *p_entry) {
+    return ((const char *)(p_entry + 1));
+    }
+  const char *res (const Vxi11RecordEntry *p_entry) {
+    return ((const char *)(p_entry + 1) + p_entry->cnt_args);
+    }
+
+  // Decode the arguments of an entry, free with xdr_free()
+  bool decode_args (const Vxi11RecordEntry *p_entry, xdrproc_t xdr_args,
+                    void *p_args);
+
+  // Get the next entry for the given program and procedure, skipping
+  // entries of that program for other procedures
+  const Vxi11RecordEntry *next (unsigned int prog, unsigned int proc,
+                                int *pcnt_skip);
+
+  // Create an RPC client that returns the recorded replies of prog
+  // b_realtime = true to wait for the recorded duration of each RPC
+  CLIENT *client (unsigned int prog, bool b_realtime);
+};
+
+#endif
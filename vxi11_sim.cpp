@@ -0,0 +1,1942 @@
+// ***************************************************************************
+// vxi11_sim.cpp - VXI-11 instrument simulator
+//                 Local VXI-11 server for testing and benchmarking libvxi11
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// The ONC-RPC server is implemented here instead of with the rpcgen server
+// stubs and svc_run(), because svc_run() serves all connections on one
+// thread.  The simulator must serve each link concurrently, and must be
+// able to hold a reply (for latency, locks and I/O timeouts) without
+// stopping the other links.  Only the rpcgen XDR routines are used.
+
+#include "vxi11_sim.h"
+#include "vxi11_hislip.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <map>
+#include <set>
+
+// Macros to conveniently access the pthread and container members of the
+// class.  They are defined as void * in the class so that the .h file does
+// not need to include pthread.h and the containers.
+#define _p_mtx          ((pthread_mutex_t *)_p_mutex)
+#define _p_cnd          ((pthread_cond_t *)_p_cond)
+#define _a_thread       ((pthread_t *)_p_threads)
+#define _conns          (*(std::set<Conn *> *)_p_conns)
+#define _devices        (*(std::map<std::string, Device *> *)_p_devices)
+#define _links          (*(std::map<long, Link *> *)_p_links)
+
+// VXI-11 error codes used by the simulator
+#define ERR_NONE                0
+#define ERR_INVALID_LINK        4
+#define ERR_CHANNEL_NOT_EST     6
+#define ERR_NOT_SUPPORTED       8
+#define ERR_LOCKED              11
+#define ERR_NO_LOCK             12
+#define ERR_IO_TIMEOUT          15
+#define ERR_CHANNEL_EST         29
+#define ERR_ABORT               23
+
+// VXI-11 flags and reasons
+#define FLAG_WAITLOCK           1
+#define FLAG_END                8
+#define FLAG_TERMCHRSET         128
+#define REASON_REQCNT           1
+#define REASON_CHR              2
+#define REASON_END              4
+
+// Largest RPC message accepted
+#define CNT_MSG_MAX             (64 * 1024 * 1024)
+
+// ***************************************************************************
+// Simulator state
+// ***************************************************************************
+
+// Connection from a client, on the core or the abort channel, on a HiSLIP
+// channel, or on the raw SCPI socket
+struct Vxi11Sim::Conn {
+  int sock;                             // Socket of the connection
+  bool b_abort;                         // True for the abort channel
+  bool b_hislip;                        // True for a HiSLIP channel
+  bool b_socket;                        // True for the raw SCPI socket
+  long lid_hislip;                      // Link of the HiSLIP session, or -1
+  int sock_intr;                        // Interrupt channel socket, or -1
+  bool b_intr_udp;                      // Interrupt channel uses UDP
+  unsigned int prog_intr;               // Interrupt channel program
+  unsigned int vers_intr;               // Interrupt channel version
+  unsigned int xid_intr;                // Last interrupt channel xid
+};
+
+// Simulated device, shared by all links with the same device name
+struct Vxi11Sim::Device {
+  std::string s_name;                   // Device name from create_link
+  Link *p_lock;                         // Link holding the lock, or null
+  unsigned char stb;                    // Status byte, without bit 6
+  unsigned char esr;                    // Event status register
+  unsigned char ese;                    // Event status enable register
+  unsigned char sre;                    // Service request enable register
+  bool b_rqs;                           // Requesting service (stb bit 6)
+  bool b_summary;                       // Last state of (stb & sre)
+};
+
+// Link to a device
+struct Vxi11Sim::Link {
+  long lid;                             // Link ID
+  Conn *p_conn;                         // Connection that created the link
+  Device *p_device;                     // Device of the link
+  std::string s_in;                     // Data written without END yet
+  std::string s_out;                    // Output queue
+  size_t idx_out;                       // Bytes of s_out already read
+  long long t_out_ns;                   // Time s_out is ready (*OPC?)
+  bool b_busy;                          // Operation in progress
+  bool b_abort;                         // Abort of operation requested
+  bool b_srq;                           // SRQ enabled
+  std::string s_handle;                 // SRQ handle from enable_srq
+  Conn *p_conn_async;                   // HiSLIP asynchronous channel, or
+                                        // null
+};
+
+// Parameters of a listener thread
+struct Vxi11SimListen {
+  Vxi11Sim *p_sim;
+  int sock;                             // Listening socket
+  bool b_abort;                         // Abort channel
+  bool b_hislip;                        // HiSLIP channels
+  bool b_socket;                        // Raw SCPI socket
+};
+
+// Parameters of an operation complete thread
+struct Vxi11SimOpc {
+  Vxi11Sim *p_sim;
+  void *p_device;
+  long long t_ns;
+};
+
+// ***************************************************************************
+// Helper functions
+// ***************************************************************************
+
+// Get CLOCK_REALTIME in ns, which is the clock used by pthread_cond_timedwait
+static long long time_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_REALTIME, &ts);
+  return ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+// Receive exactly cnt bytes
+static bool recv_all (int sock, char *p_data, size_t cnt)
+{
+  while (cnt) {
+    ssize_t cnt_recv = recv (sock, p_data, cnt, 0);
+    if (cnt_recv < 0 && errno == EINTR)
+      continue;
+    if (cnt_recv <= 0)
+      return (false);
+    p_data += cnt_recv;
+    cnt -= cnt_recv;
+    }
+  return (true);
+}
+
+// Send exactly cnt bytes
+static bool send_all (int sock, const char *p_data, size_t cnt)
+{
+  while (cnt) {
+    ssize_t cnt_send = send (sock, p_data, cnt, MSG_NOSIGNAL);
+    if (cnt_send < 0 && errno == EINTR)
+      continue;
+    if (cnt_send <= 0)
+      return (false);
+    p_data += cnt_send;
+    cnt -= cnt_send;
+    }
+  return (true);
+}
+
+// Receive one RPC message, joining the record marking fragments
+static bool recv_record (int sock, std::string &s_msg)
+{
+  s_msg.clear ();
+  for (;;) {
+    unsigned int mark;
+    if (!recv_all (sock, (char *)&mark, 4))
+      return (false);
+    mark = ntohl (mark);
+    size_t cnt = mark & 0x7fffffff;
+    size_t idx = s_msg.size ();
+    if (idx + cnt > CNT_MSG_MAX)
+      return (false);
+    s_msg.resize (idx + cnt);
+    if (cnt && !recv_all (sock, &s_msg[idx], cnt))
+      return (false);
+    if (mark & 0x80000000)              // Last fragment
+      return (true);
+    }
+}
+
+// Encode an accepted RPC reply with record marking, ready to send
+static void reply_encode (std::string &s_reply, unsigned int xid,
+                          unsigned int stat, xdrproc_t xdr_res, void *p_res)
+{
+  unsigned int cnt = 24;                // Reply header
+  if (stat == SUCCESS && xdr_res)
+    cnt += xdr_sizeof (xdr_res, p_res);
+  if (stat == PROG_MISMATCH)
+    cnt += 8;
+  s_reply.resize (4 + cnt);
+
+  XDR xdrs;
+  xdrmem_create (&xdrs, &s_reply[4], cnt, XDR_ENCODE);
+  unsigned int a_header[6] = {xid, REPLY, MSG_ACCEPTED, AUTH_NONE, 0, stat};
+  for (int i=0; i < 6; i++)
+    xdr_u_int (&xdrs, &a_header[i]);
+  if (stat == SUCCESS && xdr_res)
+    xdr_res (&xdrs, p_res);
+  if (stat == PROG_MISMATCH) {
+    unsigned int vers = 1;              // Low and high versions supported
+    xdr_u_int (&xdrs, &vers);
+    xdr_u_int (&xdrs, &vers);
+    }
+  xdr_destroy (&xdrs);
+
+  unsigned int mark = htonl (0x80000000 | cnt);
+  memcpy (&s_reply[0], &mark, 4);
+}
+
+// Encode an RPC call with AUTH_NONE, with record marking if b_mark
+static void call_encode (std::string &s_call, bool b_mark, unsigned int xid,
+                         unsigned int prog, unsigned int vers,
+                         unsigned int proc, xdrproc_t xdr_args, void *p_args)
+{
+  unsigned int cnt = 40 + xdr_sizeof (xdr_args, p_args);
+  unsigned int idx = (b_mark) ? 4 : 0;
+  s_call.resize (idx + cnt);
+
+  XDR xdrs;
+  xdrmem_create (&xdrs, &s_call[idx], cnt, XDR_ENCODE);
+  unsigned int a_header[10] = {xid, CALL, 2, prog, vers, proc,
+                               AUTH_NONE, 0, AUTH_NONE, 0};
+  for (int i=0; i < 10; i++)
+    xdr_u_int (&xdrs, &a_header[i]);
+  xdr_args (&xdrs, p_args);
+  xdr_destroy (&xdrs);
+
+  if (b_mark) {
+    unsigned int mark = htonl (0x80000000 | cnt);
+    memcpy (&s_call[0], &mark, 4);
+    }
+}
+
+// Create a listening TCP socket, port 0 for any free port
+static int listen_socket (int *p_port)
+{
+  int sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return (-1);
+
+  int on = 1;
+  setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+
+  sockaddr_in addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_ANY);
+  addr.sin_port = htons (*p_port);
+  socklen_t len = sizeof (addr);
+  if (bind (sock, (sockaddr *)&addr, sizeof (addr)) ||
+      listen (sock, 64) ||
+      getsockname (sock, (sockaddr *)&addr, &len)) {
+    close (sock);
+    return (-1);
+    }
+
+  *p_port = ntohs (addr.sin_port);
+  return (sock);
+}
+
+// ***************************************************************************
+// Vxi11Sim constructor - Set default configuration, server not started
+// ***************************************************************************
+  Vxi11Sim::
+Vxi11Sim (void)
+{
+  _port_core = 0;
+  _port_abort = 0;
+  _port_hislip = 0;
+  _port_socket = 0;
+  _sock_core = -1;
+  _sock_abort = -1;
+  _sock_hislip = -1;
+  _sock_socket = -1;
+  _b_running = false;
+
+  _max_recv_size = 1024 * 1024;
+  _read_fragment = 0;                   // Read all that was requested
+  for (int op=0; op < CNT_OP; op++) {
+    _a_latency_us[op] = 0;
+    _a_count[op] = 0;
+    }
+  _opc_delay_us = 0;
+  _b_unresponsive = false;
+  _s_idn = "Lew Engineering,VXI-11 Simulator,0,1.0";
+  _pfn_response = 0;
+  _p_response_arg = 0;
+
+  _p_mutex = new pthread_mutex_t;
+  pthread_mutex_init (_p_mtx, NULL);
+  _p_cond = new pthread_cond_t;
+  pthread_cond_init (_p_cnd, NULL);
+  _p_threads = new pthread_t[4];
+  _p_conns = new std::set<Conn *>;
+  _p_devices = new std::map<std::string, Device *>;
+  _p_links = new std::map<long, Link *>;
+  _lid_next = 0;
+  _cnt_thread = 0;
+}
+
+// ***************************************************************************
+// Vxi11Sim destructor - Stop server
+// ***************************************************************************
+  Vxi11Sim::
+~Vxi11Sim ()
+{
+  stop ();
+
+  delete &_links;
+  delete &_devices;
+  delete &_conns;
+  delete[] _a_thread;
+  pthread_cond_destroy (_p_cnd);
+  delete _p_cnd;
+  pthread_mutex_destroy (_p_mtx);
+  delete _p_mtx;
+}
+
+// ***************************************************************************
+// Vxi11Sim::start - Start the server
+//
+// Parameters:
+// 1. port        - TCP port for the core channel, 0 for any free port
+// 2. port_hislip - TCP port for HiSLIP, 0 for any free port
+// 3. port_socket - TCP port for the raw SCPI socket, 0 for any free port
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: The core channel is not registered with the portmapper.  Use the
+//        address "host:port" with Vxi11::open(), where port is port().
+//        The abort channel is on port_abort(), which is returned to the
+//        client by create_link.
+//
+//        For HiSLIP, use the device name "hislip0,port" with Vxi11::open(),
+//        where port is port_hislip().  For the raw SCPI socket, use the
+//        device name "socket,port", where port is port_socket(); it is a
+//        link to device "inst0".
+// ***************************************************************************
+  int Vxi11Sim::
+start (int port, int port_hislip, int port_socket)
+{
+  if (_b_running) {
+    fprintf (stderr, "Vxi11Sim::start error: already started.\n");
+    return (1);
+    }
+
+  _port_core = port;
+  _sock_core = listen_socket (&_port_core);
+  _port_abort = 0;
+  _sock_abort = (_sock_core < 0) ? -1 : listen_socket (&_port_abort);
+  _port_hislip = port_hislip;
+  _sock_hislip = (_sock_abort < 0) ? -1 : listen_socket (&_port_hislip);
+  _port_socket = port_socket;
+  _sock_socket = (_sock_hislip < 0) ? -1 : listen_socket (&_port_socket);
+  if (_sock_socket < 0) {
+    fprintf (stderr, "Vxi11Sim::start error: could not listen on port %d, "
+             "%d or %d: %s.\n", port, port_hislip, port_socket,
+             strerror (errno));
+    if (_sock_core >= 0)
+      close (_sock_core);
+    if (_sock_abort >= 0)
+      close (_sock_abort);
+    if (_sock_hislip >= 0)
+      close (_sock_hislip);
+    _sock_core = -1;
+    _sock_abort = -1;
+    _sock_hislip = -1;
+    return (1);
+    }
+
+  _b_running = true;
+  int a_sock[4] = {_sock_core, _sock_abort, _sock_hislip, _sock_socket};
+  for (int i=0; i < 4; i++) {
+    Vxi11SimListen *p_listen = new Vxi11SimListen;
+    p_listen->p_sim = this;
+    p_listen->sock = a_sock[i];
+    p_listen->b_abort = (i == 1);
+    p_listen->b_hislip = (i == 2);
+    p_listen->b_socket = (i == 3);
+    pthread_create (&_a_thread[i], NULL, _fn_listen, p_listen);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Sim::stop - Stop the server
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Closes all connections, and waits for all threads to end.
+// ***************************************************************************
+  void Vxi11Sim::
+stop (void)
+{
+  pthread_mutex_lock (_p_mtx);
+  if (!_b_running) {
+    pthread_mutex_unlock (_p_mtx);
+    return;
+    }
+  _b_running = false;                   // Ends waits and listener threads
+  pthread_cond_broadcast (_p_cnd);
+  for (std::set<Conn *>::iterator it = _conns.begin (); it != _conns.end ();
+       ++it)
+    shutdown ((*it)->sock, SHUT_RDWR);  // Ends connection threads
+  pthread_mutex_unlock (_p_mtx);
+
+  for (int i=0; i < 4; i++)
+    pthread_join (_a_thread[i], NULL);
+  close (_sock_core);
+  close (_sock_abort);
+  close (_sock_hislip);
+  close (_sock_socket);
+  _sock_core = -1;
+  _sock_abort = -1;
+  _sock_hislip = -1;
+  _sock_socket = -1;
+
+  pthread_mutex_lock (_p_mtx);
+  while (_cnt_thread)
+    pthread_cond_wait (_p_cnd, _p_mtx);
+  for (std::map<std::string, Device *>::iterator it = _devices.begin ();
+       it != _devices.end (); ++it)
+    delete it->second;
+  _devices.clear ();
+  pthread_mutex_unlock (_p_mtx);
+}
+
+// ***************************************************************************
+// Vxi11Sim::latency - Set/get time to answer an operation
+//
+// Parameters:
+// 1. op - Operation, OP_xxx
+// 2. us - Time in us to wait before answering
+//
+// Returns: Time in us for get
+//
+// Notes: The wait is ended early by device_abort on the abort channel.
+//        OP_ABORT and OP_SRQ have no latency.
+// ***************************************************************************
+  void Vxi11Sim::
+latency (int op, int us)
+{
+  if (op >= 0 && op < CNT_OP)
+    _a_latency_us[op] = (us < 0) ? 0 : us;
+}
+
+  int Vxi11Sim::
+latency (int op)
+{
+  return ((op >= 0 && op < CNT_OP) ? _a_latency_us[op] : 0);
+}
+
+// ***************************************************************************
+// Vxi11Sim::unresponsive - Set/get whether the VXI-11 calls get no reply
+//
+// Parameters:
+// 1. b_unresponsive - true to drop the calls and the replies not sent yet
+//
+// Returns: true if the calls get no reply, for get
+//
+// Notes: The connections stay open, as with a device switched off or
+//        unplugged.  HiSLIP and raw socket connections are still served.
+// ***************************************************************************
+  void Vxi11Sim::
+unresponsive (bool b_unresponsive)
+{
+  pthread_mutex_lock (_p_mtx);
+  _b_unresponsive = b_unresponsive;
+  pthread_mutex_unlock (_p_mtx);
+}
+
+  bool Vxi11Sim::
+unresponsive (void)
+{
+  pthread_mutex_lock (_p_mtx);
+  bool b_unresponsive = _b_unresponsive;
+  pthread_mutex_unlock (_p_mtx);
+  return (b_unresponsive);
+}
+
+// ***************************************************************************
+// Vxi11Sim::count - Get number of an operation served since start, or
+//                   since count_reset()
+//
+// Parameters:
+// 1. op - Operation, OP_xxx; OP_SRQ counts the interrupts sent
+//
+// Returns: Number of operations
+// ***************************************************************************
+  unsigned long Vxi11Sim::
+count (int op)
+{
+  if (op < 0 || op >= CNT_OP)
+    return (0);
+  pthread_mutex_lock (_p_mtx);
+  unsigned long cnt = _a_count[op];
+  pthread_mutex_unlock (_p_mtx);
+  return (cnt);
+}
+
+  void Vxi11Sim::
+count_reset (void)
+{
+  pthread_mutex_lock (_p_mtx);
+  for (int op=0; op < CNT_OP; op++)
+    _a_count[op] = 0;
+  pthread_mutex_unlock (_p_mtx);
+}
+
+// ***************************************************************************
+// Vxi11Sim::srq - Request service from a device
+//
+// Parameters:
+// 1. s_device - Device name, or null for all devices
+//
+// Returns: None
+//
+// Notes: Sets the RQS bit of the status byte and calls the interrupt
+//        channel of each link to the device that has SRQ enabled.
+// ***************************************************************************
+  void Vxi11Sim::
+srq (const char *s_device)
+{
+  pthread_mutex_lock (_p_mtx);
+  for (std::map<std::string, Device *>::iterator it = _devices.begin ();
+       it != _devices.end (); ++it) {
+    if (s_device && it->first != s_device)
+      continue;
+    it->second->b_rqs = true;
+    _srq_send (it->second);
+    }
+  pthread_mutex_unlock (_p_mtx);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_fn_listen - Thread accepting connections on a channel
+//
+// Parameters:
+// 1. p_arg - Vxi11SimListen*, deleted by this function
+//
+// Returns: Null
+// ***************************************************************************
+  void *Vxi11Sim::
+_fn_listen (void *p_arg)
+{
+  Vxi11SimListen *p_listen = (Vxi11SimListen *)p_arg;
+  Vxi11Sim *p_sim = p_listen->p_sim;
+  int sock_listen = p_listen->sock;
+  bool b_abort = p_listen->b_abort;
+  bool b_hislip = p_listen->b_hislip;
+  bool b_socket = p_listen->b_socket;
+  delete p_listen;
+
+  for (;;) {
+    // Poll so that stop() does not depend on the OS waking up accept()
+    pollfd pfd = {sock_listen, POLLIN, 0};
+    int cnt_ready = poll (&pfd, 1, 100);
+
+    pthread_mutex_lock ((pthread_mutex_t *)p_sim->_p_mutex);
+    bool b_running = p_sim->_b_running;
+    pthread_mutex_unlock ((pthread_mutex_t *)p_sim->_p_mutex);
+    if (!b_running)
+      break;
+    if (cnt_ready <= 0)
+      continue;
+
+    int sock = accept (sock_listen, NULL, NULL);
+    if (sock < 0)
+      continue;
+    int on = 1;                         // Send replies without delay
+    setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+
+    Conn *p_conn = new Conn;
+    p_conn->sock = sock;
+    p_conn->b_abort = b_abort;
+    p_conn->b_hislip = b_hislip;
+    p_conn->b_socket = b_socket;
+    p_conn->lid_hislip = -1;
+    p_conn->sock_intr = -1;
+    p_conn->b_intr_udp = false;
+    p_conn->xid_intr = 0;
+
+    pthread_mutex_t *p_mutex = (pthread_mutex_t *)p_sim->_p_mutex;
+    pthread_mutex_lock (p_mutex);
+    if (!p_sim->_b_running) {
+      pthread_mutex_unlock (p_mutex);
+      close (sock);
+      delete p_conn;
+      break;
+      }
+    (*(std::set<Conn *> *)p_sim->_p_conns).insert (p_conn);
+    p_sim->_cnt_thread++;
+    pthread_mutex_unlock (p_mutex);
+
+    void **a_arg = new void *[2];
+    a_arg[0] = p_sim;
+    a_arg[1] = p_conn;
+    pthread_t pthread;
+    pthread_create (&pthread, NULL, _fn_conn, a_arg);
+    pthread_detach (pthread);
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_fn_conn - Thread serving one connection
+//
+// Parameters:
+// 1. p_arg - void*[2] with Vxi11Sim* and Conn*, deleted by this function
+//
+// Returns: Null
+//
+// Notes: Destroys the links of the connection when it closes.
+// ***************************************************************************
+  void *Vxi11Sim::
+_fn_conn (void *p_arg)
+{
+  Vxi11Sim *p_sim = (Vxi11Sim *)((void **)p_arg)[0];
+  Conn *p_conn = (Conn *)((void **)p_arg)[1];
+  delete[] (void **)p_arg;
+
+  if (p_conn->b_hislip)
+    p_sim->_serve_hislip (p_conn);
+  else if (p_conn->b_socket)
+    p_sim->_serve_socket (p_conn);
+  else
+    p_sim->_serve (p_conn);
+
+  pthread_mutex_t *p_mutex = (pthread_mutex_t *)p_sim->_p_mutex;
+  pthread_mutex_lock (p_mutex);
+  std::map<long, Link *> &links = *(std::map<long, Link *> *)p_sim->_p_links;
+  for (std::map<long, Link *>::iterator it = links.begin ();
+       it != links.end (); ) {
+    Link *p_link = (it++)->second;
+    if (p_link->p_conn_async == p_conn)
+      p_link->p_conn_async = 0;
+    if (p_link->p_conn == p_conn)
+      p_sim->_link_destroy (p_link);
+    }
+  if (p_conn->sock_intr >= 0)
+    close (p_conn->sock_intr);
+  (*(std::set<Conn *> *)p_sim->_p_conns).erase (p_conn);
+  close (p_conn->sock);
+  delete p_conn;
+  p_sim->_cnt_thread--;
+  pthread_cond_broadcast ((pthread_cond_t *)p_sim->_p_cond);
+  pthread_mutex_unlock (p_mutex);
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_serve - Receive RPC calls on a connection and send the replies
+//
+// Parameters:
+// 1. p_conn - Connection
+//
+// Returns: None, when the connection is closed
+// ***************************************************************************
+  void Vxi11Sim::
+_serve (Conn *p_conn)
+{
+  std::string s_msg;
+  std::string s_reply;
+
+  while (recv_record (p_conn->sock, s_msg)) {
+    if (unresponsive ())                // Call lost, see unresponsive()
+      continue;
+
+    XDR xdrs;
+    xdrmem_create (&xdrs, &s_msg[0], s_msg.size (), XDR_DECODE);
+
+    // Call header: xid, CALL, RPC version, program, version, procedure
+    unsigned int a_header[6];
+    bool b_ok = true;
+    for (int i=0; i < 6 && b_ok; i++)
+      b_ok = xdr_u_int (&xdrs, &a_header[i]);
+
+    // Skip credentials and verifier
+    for (int i=0; i < 2 && b_ok; i++) {
+      unsigned int flavor, len;
+      b_ok = xdr_u_int (&xdrs, &flavor) && xdr_u_int (&xdrs, &len) &&
+             len <= 400;
+      unsigned int pos = xdr_getpos (&xdrs) + ((len + 3) & ~3u);
+      b_ok = b_ok && pos <= s_msg.size () && xdr_setpos (&xdrs, pos);
+      }
+
+    if (!b_ok || a_header[1] != CALL || a_header[2] != 2) {
+      xdr_destroy (&xdrs);
+      break;                            // Not an ONC-RPC call, disconnect
+      }
+
+    unsigned int xid = a_header[0];
+    unsigned int prog = (p_conn->b_abort) ? DEVICE_ASYNC : DEVICE_CORE;
+    if (a_header[3] != prog)
+      reply_encode (s_reply, xid, PROG_UNAVAIL, 0, 0);
+    else if (a_header[4] != 1)
+      reply_encode (s_reply, xid, PROG_MISMATCH, 0, 0);
+    else if (a_header[5] == 0)          // NULLPROC, used to ping
+      reply_encode (s_reply, xid, SUCCESS, 0, 0);
+    else
+      _dispatch (p_conn, xid, a_header[5], &xdrs, s_reply);
+    xdr_destroy (&xdrs);
+
+    if (unresponsive ())                // Reply lost
+      continue;
+    if (!send_all (p_conn->sock, s_reply.data (), s_reply.size ()))
+      break;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_dispatch - Serve one RPC procedure
+//
+// Parameters:
+// 1. p_conn  - Connection the call was received on
+// 2. xid     - Transaction ID of the call
+// 3. proc    - Procedure number
+// 4. p_xdrs  - XDR*, positioned at the arguments
+// 5. s_reply - Returns the encoded reply
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Sim::
+_dispatch (Conn *p_conn, unsigned int xid, unsigned int proc, void *p_xdrs,
+           std::string &s_reply)
+{
+  XDR *xdrs = (XDR *)p_xdrs;
+
+  // Abort channel
+  if (p_conn->b_abort) {
+    Device_Link lid;
+    if (proc != device_abort) {
+      reply_encode (s_reply, xid, PROC_UNAVAIL, 0, 0);
+      return;
+      }
+    if (!xdr_Device_Link (xdrs, &lid)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      return;
+      }
+
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    _a_count[OP_ABORT]++;
+    std::map<long, Link *>::iterator it = _links.find (lid);
+    error.error = (it == _links.end ()) ? ERR_INVALID_LINK : ERR_NONE;
+    if (it != _links.end () && it->second->b_busy) {
+      it->second->b_abort = true;       // End the operation in progress
+      pthread_cond_broadcast (_p_cnd);
+      }
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    return;
+    }
+
+  switch (proc) {
+
+  case create_link: {
+    Create_LinkParms parms;
+    memset (&parms, 0, sizeof (parms));
+    if (!xdr_Create_LinkParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    pthread_mutex_lock (_p_mtx);
+    _a_count[OP_CREATE_LINK]++;
+    Link *p_link = _link_create (p_conn, parms.device);
+    p_link->b_busy = true;
+
+    Create_LinkResp resp;
+    resp.error = _wait_us (p_link, _a_latency_us[OP_CREATE_LINK]);
+    if (!resp.error && parms.lockDevice)
+      resp.error = _lock_wait (p_link, true, FLAG_WAITLOCK,
+                               parms.lock_timeout);
+    resp.lid = p_link->lid;
+    resp.abortPort = _port_abort;
+    resp.maxRecvSize = _max_recv_size;
+    p_link->b_busy = false;
+    if (resp.error)                     // The link is not created on error
+      _link_destroy (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Create_LinkResp,
+                  &resp);
+    xdr_free ((xdrproc_t)xdr_Create_LinkParms, (char *)&parms);
+    break;
+    }
+
+  case device_write: {
+    Device_WriteParms parms;
+    memset (&parms, 0, sizeof (parms));
+    if (!xdr_Device_WriteParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    Device_WriteResp resp;
+    resp.size = 0;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, OP_WRITE);
+    resp.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!resp.error)
+      resp.error = _lock_wait (p_link, false, parms.flags,
+                               parms.lock_timeout);
+    if (!resp.error)
+      resp.error = _wait_us (p_link, _a_latency_us[OP_WRITE]);
+    if (!resp.error) {
+      // Accept at most maxRecvSize bytes, like a device with a fixed size
+      // input buffer.  The END flag only applies if all data is accepted.
+      resp.size = parms.data.data_len;
+      if (resp.size > _max_recv_size)
+        resp.size = _max_recv_size;
+      p_link->s_in.append (parms.data.data_val, resp.size);
+      if ((parms.flags & FLAG_END) && resp.size == parms.data.data_len) {
+        _execute (p_link, p_link->s_in);
+        p_link->s_in.clear ();
+        }
+      }
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_WriteResp,
+                  &resp);
+    xdr_free ((xdrproc_t)xdr_Device_WriteParms, (char *)&parms);
+    break;
+    }
+
+  case device_read: {
+    Device_ReadParms parms;
+    memset (&parms, 0, sizeof (parms));
+    if (!xdr_Device_ReadParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    Device_ReadResp resp;
+    resp.reason = 0;
+    resp.data.data_len = 0;
+    resp.data.data_val = 0;
+    std::string s_data;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, OP_READ);
+    resp.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!resp.error)
+      resp.error = _lock_wait (p_link, false, parms.flags,
+                               parms.lock_timeout);
+    if (!resp.error)
+      resp.error = _wait_us (p_link, _a_latency_us[OP_READ]);
+
+    // Wait for output, up to io_timeout.  Output is not ready until
+    // t_out_ns after *OPC? with an operation complete delay.
+    if (!resp.error) {
+      long long t_timeout_ns = time_ns () +
+                               (long long)parms.io_timeout * 1000000LL;
+      if (p_link->idx_out >= p_link->s_out.size () ||
+          p_link->t_out_ns > t_timeout_ns) {
+        resp.error = _wait_until (p_link, t_timeout_ns);
+        if (!resp.error)
+          resp.error = ERR_IO_TIMEOUT;
+        }
+      else if (p_link->t_out_ns)
+        resp.error = _wait_until (p_link, p_link->t_out_ns);
+      }
+
+    if (!resp.error) {
+      p_link->t_out_ns = 0;
+      size_t cnt = p_link->s_out.size () - p_link->idx_out;
+      if (_read_fragment && (cnt > _read_fragment))
+        cnt = _read_fragment;           // Fragment ends without a reason
+      if (cnt >= parms.requestSize) {
+        cnt = parms.requestSize;
+        resp.reason |= REASON_REQCNT;
+        }
+      if (parms.flags & FLAG_TERMCHRSET) {
+        const char *p_term = (const char *)memchr (
+          p_link->s_out.data () + p_link->idx_out, parms.termChar, cnt);
+        if (p_term) {
+          cnt = p_term - (p_link->s_out.data () + p_link->idx_out) + 1;
+          resp.reason = REASON_CHR |
+                        ((cnt == parms.requestSize) ? REASON_REQCNT : 0);
+          }
+        }
+      s_data.assign (p_link->s_out, p_link->idx_out, cnt);
+      p_link->idx_out += cnt;
+      if (p_link->idx_out >= p_link->s_out.size ()) {
+        resp.reason |= REASON_END;
+        p_link->s_out.clear ();
+        p_link->idx_out = 0;
+        }
+      resp.data.data_len = s_data.size ();
+      resp.data.data_val = (char *)s_data.data ();
+      }
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_ReadResp,
+                  &resp);
+    break;
+    }
+
+  case device_readstb:
+  case device_trigger:
+  case device_clear:
+  case device_remote:
+  case device_local: {
+    Device_GenericParms parms;
+    if (!xdr_Device_GenericParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    int op = (proc == device_readstb) ? OP_READSTB :
+             (proc == device_trigger) ? OP_TRIGGER :
+             (proc == device_clear)   ? OP_CLEAR :
+             (proc == device_remote)  ? OP_REMOTE : OP_LOCAL;
+
+    Device_ReadStbResp resp;
+    resp.stb = 0;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, op);
+    resp.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!resp.error)
+      resp.error = _lock_wait (p_link, false, parms.flags,
+                               parms.lock_timeout);
+    if (!resp.error)
+      resp.error = _wait_us (p_link, _a_latency_us[op]);
+    if (!resp.error && op == OP_READSTB) {
+      Device *p_device = p_link->p_device;
+      resp.stb = p_device->stb | ((p_device->b_rqs) ? 0x40 : 0);
+      p_device->b_rqs = false;          // Serial poll clears RQS
+      }
+    if (!resp.error && op == OP_CLEAR) {
+      p_link->s_in.clear ();            // Device clear empties the buffers
+      p_link->s_out.clear ();
+      p_link->idx_out = 0;
+      p_link->t_out_ns = 0;
+      }
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    if (op == OP_READSTB)
+      reply_encode (s_reply, xid, SUCCESS,
+                    (xdrproc_t)xdr_Device_ReadStbResp, &resp);
+    else {
+      Device_Error error;
+      error.error = resp.error;
+      reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error,
+                    &error);
+      }
+    break;
+    }
+
+  case device_lock: {
+    Device_LockParms parms;
+    if (!xdr_Device_LockParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, OP_LOCK);
+    error.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!error.error)
+      error.error = _wait_us (p_link, _a_latency_us[OP_LOCK]);
+    if (!error.error)
+      error.error = _lock_wait (p_link, true, parms.flags,
+                                parms.lock_timeout);
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    break;
+    }
+
+  case device_unlock:
+  case destroy_link: {
+    Device_Link lid;
+    if (!xdr_Device_Link (xdrs, &lid)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    int op = (proc == device_unlock) ? OP_UNLOCK : OP_DESTROY_LINK;
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, lid, op);
+    error.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!error.error)
+      error.error = _wait_us (p_link, _a_latency_us[op]);
+    if (!error.error && op == OP_UNLOCK) {
+      if (p_link->p_device->p_lock != p_link)
+        error.error = ERR_NO_LOCK;
+      else {
+        p_link->p_device->p_lock = 0;
+        pthread_cond_broadcast (_p_cnd);
+        }
+      }
+    _end (p_link);
+    if (p_link && op == OP_DESTROY_LINK)
+      _link_destroy (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    break;
+    }
+
+  case device_enable_srq: {
+    Device_EnableSrqParms parms;
+    memset (&parms, 0, sizeof (parms));
+    if (!xdr_Device_EnableSrqParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, OP_ENABLE_SRQ);
+    error.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!error.error)
+      error.error = _wait_us (p_link, _a_latency_us[OP_ENABLE_SRQ]);
+    if (!error.error) {
+      p_link->b_srq = parms.enable;
+      p_link->s_handle.assign (parms.handle.handle_val,
+                               parms.handle.handle_len);
+      }
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    xdr_free ((xdrproc_t)xdr_Device_EnableSrqParms, (char *)&parms);
+    break;
+    }
+
+  case device_docmd: {
+    Device_DocmdParms parms;
+    memset (&parms, 0, sizeof (parms));
+    if (!xdr_Device_DocmdParms (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    // The simulated devices are not GPIB interfaces
+    Device_DocmdResp resp;
+    resp.data_out.data_out_len = 0;
+    resp.data_out.data_out_val = 0;
+    pthread_mutex_lock (_p_mtx);
+    Link *p_link = _begin (p_conn, parms.lid, OP_DOCMD);
+    resp.error = (p_link) ? ERR_NONE : ERR_INVALID_LINK;
+    if (!resp.error)
+      resp.error = _wait_us (p_link, _a_latency_us[OP_DOCMD]);
+    if (!resp.error)
+      resp.error = ERR_NOT_SUPPORTED;
+    _end (p_link);
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_DocmdResp,
+                  &resp);
+    xdr_free ((xdrproc_t)xdr_Device_DocmdParms, (char *)&parms);
+    break;
+    }
+
+  case create_intr_chan: {
+    Device_RemoteFunc parms;
+    if (!xdr_Device_RemoteFunc (xdrs, &parms)) {
+      reply_encode (s_reply, xid, GARBAGE_ARGS, 0, 0);
+      break;
+      }
+
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    _a_count[OP_CREATE_INTR_CHAN]++;
+    if (p_conn->sock_intr >= 0)
+      error.error = ERR_CHANNEL_EST;
+    else {
+      // hostAddr and hostPort are in host byte order
+      sockaddr_in addr;
+      memset (&addr, 0, sizeof (addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl (parms.hostAddr);
+      addr.sin_port = htons (parms.hostPort);
+      p_conn->b_intr_udp = (parms.progFamily == DEVICE_UDP);
+      p_conn->prog_intr = parms.progNum;
+      p_conn->vers_intr = parms.progVers;
+      p_conn->sock_intr = socket (AF_INET, (p_conn->b_intr_udp) ?
+                                  SOCK_DGRAM : SOCK_STREAM, 0);
+      if (p_conn->sock_intr >= 0 &&
+          connect (p_conn->sock_intr, (sockaddr *)&addr, sizeof (addr))) {
+        close (p_conn->sock_intr);
+        p_conn->sock_intr = -1;
+        }
+      error.error = (p_conn->sock_intr >= 0) ? ERR_NONE : ERR_CHANNEL_NOT_EST;
+      }
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    break;
+    }
+
+  case destroy_intr_chan: {
+    Device_Error error;
+    pthread_mutex_lock (_p_mtx);
+    _a_count[OP_DESTROY_INTR_CHAN]++;
+    if (p_conn->sock_intr < 0)
+      error.error = ERR_CHANNEL_NOT_EST;
+    else {
+      close (p_conn->sock_intr);
+      p_conn->sock_intr = -1;
+      error.error = ERR_NONE;
+      }
+    pthread_mutex_unlock (_p_mtx);
+
+    reply_encode (s_reply, xid, SUCCESS, (xdrproc_t)xdr_Device_Error, &error);
+    break;
+    }
+
+  default:
+    reply_encode (s_reply, xid, PROC_UNAVAIL, 0, 0);
+    break;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_serve_hislip - Receive HiSLIP messages on a connection and send
+//                           the replies
+//
+// Parameters:
+// 1. p_conn - Connection
+//
+// Returns: None, when the connection is closed
+//
+// Notes: The first message decides whether the connection is the
+//        synchronous channel (Initialize) or the asynchronous channel
+//        (AsyncInitialize) of a session.  The session ID is the low 16 bits
+//        of the link ID.  The server uses the synchronized mode.
+// ***************************************************************************
+  void Vxi11Sim::
+_serve_hislip (Conn *p_conn)
+{
+  Vxi11HislipHeader header;
+  std::string s_payload;
+
+  if (vxi11_hislip_recv (p_conn->sock, &header, s_payload, -1, CNT_MSG_MAX))
+    return;
+
+  pthread_mutex_lock (_p_mtx);
+  bool b_async = false;
+  unsigned int param = 0;
+  if (header.type == HISLIP_INITIALIZE) {
+    _a_count[OP_CREATE_LINK]++;
+    Link *p_link = _link_create (p_conn, s_payload.c_str ());
+    p_conn->lid_hislip = p_link->lid;
+    _wait_us (p_link, _a_latency_us[OP_CREATE_LINK]);
+    param = (VXI11_HISLIP_VERSION << 16) | (p_link->lid & 0xffff);
+    }
+  else if (header.type == HISLIP_ASYNC_INITIALIZE) {
+    for (std::map<long, Link *>::iterator it = _links.begin ();
+         it != _links.end (); ++it) {
+      Link *p_link = it->second;
+      if ((p_link->lid & 0xffff) == (header.param & 0xffff) &&
+          p_link->p_conn->b_hislip && !p_link->p_conn_async) {
+        p_link->p_conn_async = p_conn;
+        p_conn->lid_hislip = p_link->lid;
+        break;
+        }
+      }
+    b_async = true;
+    param = VXI11_HISLIP_VENDOR;
+    }
+  bool b_ok = p_conn->lid_hislip >= 0;
+  pthread_mutex_unlock (_p_mtx);
+
+  if (!b_ok) {                          // Unknown session, or not initialized
+    vxi11_hislip_send (p_conn->sock, HISLIP_FATAL_ERROR, 1, 0);
+    return;
+    }
+
+  pthread_mutex_lock (_p_mtx);          // Other threads may send on async
+  bool b_sent = !vxi11_hislip_send (p_conn->sock, (b_async) ?
+                                    HISLIP_ASYNC_INITIALIZE_RESPONSE :
+                                    HISLIP_INITIALIZE_RESPONSE, 0, param);
+  pthread_mutex_unlock (_p_mtx);
+  if (!b_sent)
+    return;
+
+  s_payload.clear ();
+  while (!vxi11_hislip_recv (p_conn->sock, &header, s_payload, -1,
+                             CNT_MSG_MAX)) {
+    if ((b_async) ? _hislip_async (p_conn, &header, s_payload) :
+                    _hislip_sync (p_conn, &header, s_payload))
+      break;
+    s_payload.clear ();
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_serve_socket - Receive commands on a raw SCPI socket connection
+//                           and send the responses
+//
+// Parameters:
+// 1. p_conn - Connection
+//
+// Returns: None, when the connection is closed
+//
+// Notes: The connection is one link to device "inst0".  Each line received
+//        is executed as one message, and its response, if any, is sent
+//        once it is ready.
+// ***************************************************************************
+  void Vxi11Sim::
+_serve_socket (Conn *p_conn)
+{
+  pthread_mutex_lock (_p_mtx);
+  _a_count[OP_CREATE_LINK]++;
+  Link *p_link = _link_create (p_conn, "inst0");
+  _wait_us (p_link, _a_latency_us[OP_CREATE_LINK]);
+  pthread_mutex_unlock (_p_mtx);
+
+  std::string s_in;
+  std::string s_out;
+  char ac_buf[64 * 1024];
+  for (;;) {
+    ssize_t cnt_recv = recv (p_conn->sock, ac_buf, sizeof (ac_buf), 0);
+    if (cnt_recv < 0 && errno == EINTR)
+      continue;
+    if (cnt_recv <= 0 || s_in.size () + cnt_recv > CNT_MSG_MAX)
+      break;
+    s_in.append (ac_buf, cnt_recv);
+
+    size_t idx = 0;
+    size_t idx_nl;
+    while ((idx_nl = s_in.find ('\n', idx)) != std::string::npos) {
+      pthread_mutex_lock (_p_mtx);
+      _a_count[OP_WRITE]++;
+      _wait_us (p_link, _a_latency_us[OP_WRITE]);
+      _execute (p_link, s_in.substr (idx, idx_nl - idx));
+      if (!p_link->s_out.empty ()) {
+        _a_count[OP_READ]++;
+        _wait_us (p_link, _a_latency_us[OP_READ]);
+        if (p_link->t_out_ns)
+          _wait_until (p_link, p_link->t_out_ns);
+        p_link->t_out_ns = 0;
+        s_out.swap (p_link->s_out);
+        p_link->idx_out = 0;
+        }
+      pthread_mutex_unlock (_p_mtx);
+
+      if (!s_out.empty () &&
+          send (p_conn->sock, s_out.data (), s_out.size (), MSG_NOSIGNAL) !=
+          (ssize_t)s_out.size ())
+        return;
+      s_out.clear ();
+      idx = idx_nl + 1;
+      }
+    s_in.erase (0, idx);
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_hislip_sync - Serve one message on the HiSLIP synchronous
+//                          channel
+//
+// Parameters:
+// 1. p_conn    - Connection of the synchronous channel
+// 2. p_header  - Vxi11HislipHeader* of the message
+// 3. s_payload - Payload of the message
+//
+// Returns: 0 = no error
+//          1 = close the connection
+//
+// Notes: The response to a message ending with DataEnd is sent as one
+//        DataEnd with the MessageID of that message.
+// ***************************************************************************
+  int Vxi11Sim::
+_hislip_sync (Conn *p_conn, const Vxi11HislipHeader *p_header,
+              const std::string &s_payload)
+{
+  std::string s_out;
+  int type_reply = -1;                  // No reply
+  unsigned char control_reply = 0;
+  unsigned int param_reply = 0;
+
+  pthread_mutex_lock (_p_mtx);
+  std::map<long, Link *>::iterator it = _links.find (p_conn->lid_hislip);
+  if (it == _links.end ()) {
+    pthread_mutex_unlock (_p_mtx);
+    return (1);
+    }
+  Link *p_link = it->second;
+
+  switch (p_header->type) {
+  case HISLIP_DATA:
+  case HISLIP_DATA_END:
+    _a_count[OP_WRITE]++;
+    _wait_us (p_link, _a_latency_us[OP_WRITE]);
+    p_link->s_in += s_payload;
+    if (p_header->type == HISLIP_DATA)
+      break;
+    _execute (p_link, p_link->s_in);
+    p_link->s_in.clear ();
+    if (p_link->s_out.empty ())
+      break;
+
+    // Send the response, once it is ready
+    _a_count[OP_READ]++;
+    _wait_us (p_link, _a_latency_us[OP_READ]);
+    if (p_link->t_out_ns)
+      _wait_until (p_link, p_link->t_out_ns);
+    p_link->t_out_ns = 0;
+    s_out.swap (p_link->s_out);
+    p_link->idx_out = 0;
+    type_reply = HISLIP_DATA_END;
+    param_reply = p_header->param;
+    break;
+
+  case HISLIP_TRIGGER:
+    _a_count[OP_TRIGGER]++;
+    _wait_us (p_link, _a_latency_us[OP_TRIGGER]);
+    break;
+
+  case HISLIP_DEVICE_CLEAR_COMPLETE:
+    p_link->s_in.clear ();              // Device clear empties the buffers
+    p_link->s_out.clear ();
+    p_link->idx_out = 0;
+    p_link->t_out_ns = 0;
+    type_reply = HISLIP_DEVICE_CLEAR_ACKNOWLEDGE;
+    control_reply = p_header->control;
+    break;
+
+  default:                              // Unrecognized message type
+    type_reply = HISLIP_ERROR;
+    control_reply = 3;
+    break;
+    }
+  pthread_mutex_unlock (_p_mtx);
+
+  if (type_reply >= 0 &&
+      vxi11_hislip_send (p_conn->sock, type_reply, control_reply, param_reply,
+                         s_out.data (), s_out.size ()))
+    return (1);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_hislip_async - Serve one message on the HiSLIP asynchronous
+//                           channel
+//
+// Parameters:
+// 1. p_conn    - Connection of the asynchronous channel
+// 2. p_header  - Vxi11HislipHeader* of the message
+// 3. s_payload - Payload of the message
+//
+// Returns: 0 = no error
+//          1 = close the connection
+//
+// Notes: The reply is sent with the mutex locked, because SRQ is also sent
+//        on the asynchronous channel by other threads.
+// ***************************************************************************
+  int Vxi11Sim::
+_hislip_async (Conn *p_conn, const Vxi11HislipHeader *p_header,
+               const std::string &s_payload)
+{
+  std::string s_out;
+  int type_reply;
+  unsigned char control_reply = 0;
+  unsigned int param_reply = 0;
+
+  pthread_mutex_lock (_p_mtx);
+  std::map<long, Link *>::iterator it = _links.find (p_conn->lid_hislip);
+  if (it == _links.end ()) {
+    pthread_mutex_unlock (_p_mtx);
+    return (1);
+    }
+  Link *p_link = it->second;
+  Device *p_device = p_link->p_device;
+
+  switch (p_header->type) {
+  case HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE: {
+    unsigned long long size = _max_recv_size;
+    s_out.resize (8);
+    for (int i=0; i < 8; i++)
+      s_out[i] = (char)(size >> (56 - 8 * i));
+    type_reply = HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE;
+    break;
+    }
+
+  case HISLIP_ASYNC_STATUS_QUERY:
+    _a_count[OP_READSTB]++;
+    _wait_us (p_link, _a_latency_us[OP_READSTB]);
+    control_reply = p_device->stb | ((p_device->b_rqs) ? 0x40 : 0);
+    p_device->b_rqs = false;            // Serial poll clears RQS
+    type_reply = HISLIP_ASYNC_STATUS_RESPONSE;
+    break;
+
+  case HISLIP_ASYNC_LOCK:
+    if (p_header->control) {            // Request, param is the timeout
+      _a_count[OP_LOCK]++;
+      _wait_us (p_link, _a_latency_us[OP_LOCK]);
+      control_reply = (_lock_wait (p_link, true, (p_header->param) ?
+                                   FLAG_WAITLOCK : 0, p_header->param)) ?
+                      0 : 1;
+      }
+    else {                              // Release
+      _a_count[OP_UNLOCK]++;
+      _wait_us (p_link, _a_latency_us[OP_UNLOCK]);
+      control_reply = 3;                // Error, no lock held
+      if (p_device->p_lock == p_link) {
+        p_device->p_lock = 0;
+        pthread_cond_broadcast (_p_cnd);
+        control_reply = 1;
+        }
+      }
+    type_reply = HISLIP_ASYNC_LOCK_RESPONSE;
+    break;
+
+  case HISLIP_ASYNC_LOCK_INFO:
+    control_reply = (p_device->p_lock) ? 1 : 0;
+    param_reply = (p_device->p_lock) ? 1 : 0;
+    type_reply = HISLIP_ASYNC_LOCK_INFO_RESPONSE;
+    break;
+
+  case HISLIP_ASYNC_REMOTE_LOCAL_CONTROL: {
+    int op = (p_header->control == 2 || p_header->control == 6) ?
+             OP_LOCAL : OP_REMOTE;
+    _a_count[op]++;
+    _wait_us (p_link, _a_latency_us[op]);
+    type_reply = HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE;
+    break;
+    }
+
+  case HISLIP_ASYNC_DEVICE_CLEAR:
+    _a_count[OP_CLEAR]++;
+    _wait_us (p_link, _a_latency_us[OP_CLEAR]);
+    type_reply = HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE;
+    break;
+
+  default:                              // Unrecognized message type
+    type_reply = HISLIP_ERROR;
+    control_reply = 3;
+    break;
+    }
+
+  int err = vxi11_hislip_send (p_conn->sock, type_reply, control_reply,
+                               param_reply, s_out.data (), s_out.size ());
+  pthread_mutex_unlock (_p_mtx);
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_begin - Start an operation on a link
+//
+// Parameters:
+// 1. p_conn - Connection the call was received on
+// 2. lid    - Link ID from the call
+// 3. op     - Operation, OP_xxx
+//
+// Returns: Link, or null if lid is not a link created on p_conn
+//
+// Notes: Must be called with the mutex locked.  Call _end() when done.
+// ***************************************************************************
+  Vxi11Sim::Link *Vxi11Sim::
+_begin (Conn *p_conn, long lid, int op)
+{
+  _a_count[op]++;
+  std::map<long, Link *>::iterator it = _links.find (lid);
+  if (it == _links.end () || it->second->p_conn != p_conn)
+    return (0);
+  it->second->b_busy = true;
+  it->second->b_abort = false;
+  return (it->second);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_end - End an operation on a link
+//
+// Parameters:
+// 1. p_link - Link from _begin(), may be null
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  void Vxi11Sim::
+_end (Link *p_link)
+{
+  if (p_link) {
+    p_link->b_busy = false;
+    p_link->b_abort = false;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_wait_until - Wait until a time, or until the operation on the
+//                         link is aborted
+//
+// Parameters:
+// 1. p_link - Link
+// 2. t_ns   - Time to wait until, from time_ns()
+//
+// Returns: 0 = time reached
+//          23 = aborted, or the server is stopping
+//
+// Notes: Must be called with the mutex locked.  The mutex is released
+//        while waiting.
+// ***************************************************************************
+  int Vxi11Sim::
+_wait_until (Link *p_link, long long t_ns)
+{
+  timespec ts;
+  ts.tv_sec = t_ns / 1000000000LL;
+  ts.tv_nsec = t_ns % 1000000000LL;
+  for (;;) {
+    if (p_link->b_abort || !_b_running)
+      return (ERR_ABORT);
+    if (time_ns () >= t_ns)
+      return (ERR_NONE);
+    pthread_cond_timedwait (_p_cnd, _p_mtx, &ts);
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_wait_us - Wait for the latency of an operation
+//
+// Parameters:
+// 1. p_link - Link
+// 2. us     - Time to wait in us
+//
+// Returns: 0 = no error
+//          23 = aborted
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  int Vxi11Sim::
+_wait_us (Link *p_link, int us)
+{
+  if (us <= 0)
+    return (ERR_NONE);
+  return (_wait_until (p_link, time_ns () + us * 1000LL));
+}
+
+// ***************************************************************************
+// Vxi11Sim::_lock_wait - Wait until the device is not locked by another
+//                        link, and optionally acquire the lock
+//
+// Parameters:
+// 1. p_link       - Link
+// 2. b_acquire    - True to acquire the lock
+// 3. flags        - Flags from the call, FLAG_WAITLOCK to wait
+// 4. lock_timeout - Time to wait in ms
+//
+// Returns: 0 = no error
+//          11 = device locked by another link
+//          23 = aborted
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  int Vxi11Sim::
+_lock_wait (Link *p_link, bool b_acquire, long flags,
+            unsigned long lock_timeout)
+{
+  Device *p_device = p_link->p_device;
+  if (p_device->p_lock && p_device->p_lock != p_link) {
+    if (!(flags & FLAG_WAITLOCK))
+      return (ERR_LOCKED);
+
+    long long t_timeout_ns = time_ns () + (long long)lock_timeout * 1000000LL;
+    timespec ts;
+    ts.tv_sec = t_timeout_ns / 1000000000LL;
+    ts.tv_nsec = t_timeout_ns % 1000000000LL;
+    while (p_device->p_lock && p_device->p_lock != p_link) {
+      if (p_link->b_abort || !_b_running)
+        return (ERR_ABORT);
+      if (time_ns () >= t_timeout_ns)
+        return (ERR_LOCKED);
+      pthread_cond_timedwait (_p_cnd, _p_mtx, &ts);
+      }
+    }
+
+  if (b_acquire)
+    p_device->p_lock = p_link;
+  return (ERR_NONE);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_link_create - Create a link to a device, creating the device
+//                          if it is the first link to it
+//
+// Parameters:
+// 1. p_conn   - Connection creating the link
+// 2. s_device - Device name
+//
+// Returns: Link
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  Vxi11Sim::Link *Vxi11Sim::
+_link_create (Conn *p_conn, const char *s_device)
+{
+  Device *&p_device = _devices[s_device];
+  if (!p_device) {
+    p_device = new Device;
+    p_device->s_name = s_device;
+    p_device->p_lock = 0;
+    p_device->stb = p_device->esr = p_device->ese = p_device->sre = 0;
+    p_device->b_rqs = p_device->b_summary = false;
+    }
+  Link *p_link = new Link;
+  p_link->lid = _lid_next++;
+  p_link->p_conn = p_conn;
+  p_link->p_device = p_device;
+  p_link->idx_out = 0;
+  p_link->t_out_ns = 0;
+  p_link->b_busy = false;
+  p_link->b_abort = false;
+  p_link->b_srq = false;
+  p_link->p_conn_async = 0;
+  _links[p_link->lid] = p_link;
+  return (p_link);
+}
+
+// ***************************************************************************
+// Vxi11Sim::_link_destroy - Destroy a link, releasing its lock
+//
+// Parameters:
+// 1. p_link - Link
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  void Vxi11Sim::
+_link_destroy (Link *p_link)
+{
+  if (p_link->p_device->p_lock == p_link) {
+    p_link->p_device->p_lock = 0;
+    pthread_cond_broadcast (_p_cnd);
+    }
+  _links.erase (p_link->lid);
+  delete p_link;
+}
+
+// ***************************************************************************
+// Vxi11Sim::_execute - Execute the commands of a complete message
+//
+// Parameters:
+// 1. p_link - Link the message was written to
+// 2. s_data - Message, commands separated by ';' or newline
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.  The responses to queries
+//        are joined by ';' and terminated by a newline.  Unread output from
+//        a previous message is discarded.
+// ***************************************************************************
+  void Vxi11Sim::
+_execute (Link *p_link, const std::string &s_data)
+{
+  std::string s_out;
+  std::string s_resp;
+  bool b_query = false;
+  size_t idx = 0;
+
+  p_link->t_out_ns = 0;
+  while (idx < s_data.size ()) {
+    size_t idx_end = s_data.find_first_of (";\n", idx);
+    if (idx_end == std::string::npos)
+      idx_end = s_data.size ();
+
+    // Trim white space
+    size_t idx_begin = idx;
+    while (idx_begin < idx_end && isspace ((unsigned char)s_data[idx_begin]))
+      idx_begin++;
+    size_t idx_last = idx_end;
+    while (idx_last > idx_begin && isspace ((unsigned char)s_data[idx_last-1]))
+      idx_last--;
+
+    if (idx_last > idx_begin) {
+      s_resp.clear ();
+      _command (p_link, s_data.substr (idx_begin, idx_last - idx_begin),
+                s_resp);
+      if (!s_resp.empty ()) {
+        if (b_query)
+          s_out += ';';
+        s_out += s_resp;
+        b_query = true;
+        }
+      }
+    idx = idx_end + 1;
+    }
+
+  if (b_query)
+    s_out += '\n';
+  p_link->s_out.swap (s_out);
+  p_link->idx_out = 0;
+}
+
+// ***************************************************************************
+// Vxi11Sim::_command - Execute one command
+//
+// Parameters:
+// 1. p_link - Link the command was written to
+// 2. s_cmd  - Command, without separators and surrounding white space
+// 3. s_resp - Returns the response, empty if there is none
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  void Vxi11Sim::
+_command (Link *p_link, const std::string &s_cmd, std::string &s_resp)
+{
+  if (_pfn_response && _pfn_response (_p_response_arg, s_cmd, s_resp))
+    return;
+
+  // Split header and argument; headers are not case sensitive
+  size_t idx_space = s_cmd.find_first_of (" \t");
+  std::string s_header = s_cmd.substr (0, idx_space);
+  std::string s_arg;
+  if (idx_space != std::string::npos)
+    s_arg = s_cmd.substr (s_cmd.find_first_not_of (" \t", idx_space));
+  for (size_t i=0; i < s_header.size (); i++)
+    s_header[i] = toupper ((unsigned char)s_header[i]);
+  if (s_header[0] == ':')
+    s_header.erase (0, 1);
+
+  Device *p_device = p_link->p_device;
+  char s_num[32];
+
+  if (s_header == "*IDN?")
+    s_resp = _s_idn;
+  else if (s_header == "*OPC?") {
+    s_resp = "1";
+    if (_opc_delay_us > 0)              // Output is ready after the delay
+      p_link->t_out_ns = time_ns () + _opc_delay_us * 1000LL;
+    }
+  else if (s_header == "*OPC") {
+    if (_opc_delay_us <= 0) {
+      p_device->esr |= 0x01;            // Operation complete
+      _status_update (p_device);
+      }
+    else {
+      Vxi11SimOpc *p_opc = new Vxi11SimOpc;
+      p_opc->p_sim = this;
+      p_opc->p_device = p_device;
+      p_opc->t_ns = time_ns () + _opc_delay_us * 1000LL;
+      _cnt_thread++;
+      pthread_t pthread;
+      pthread_create (&pthread, NULL, _fn_opc, p_opc);
+      pthread_detach (pthread);
+      }
+    }
+  else if (s_header == "*ESE") {
+    p_device->ese = (unsigned char)atoi (s_arg.c_str ());
+    _status_update (p_device);
+    }
+  else if (s_header == "*ESE?") {
+    snprintf (s_num, sizeof (s_num), "%d", p_device->ese);
+    s_resp = s_num;
+    }
+  else if (s_header == "*ESR?") {
+    snprintf (s_num, sizeof (s_num), "%d", p_device->esr);
+    s_resp = s_num;
+    p_device->esr = 0;                  // Cleared when read
+    _status_update (p_device);
+    }
+  else if (s_header == "*SRE") {
+    p_device->sre = (unsigned char)atoi (s_arg.c_str ()) & 0xbf;
+    _status_update (p_device);
+    }
+  else if (s_header == "*SRE?") {
+    snprintf (s_num, sizeof (s_num), "%d", p_device->sre);
+    s_resp = s_num;
+    }
+  else if (s_header == "*STB?") {
+    // Bit 6 is the master summary status
+    snprintf (s_num, sizeof (s_num), "%d", p_device->stb |
+              ((p_device->stb & p_device->sre) ? 0x40 : 0));
+    s_resp = s_num;
+    }
+  else if (s_header == "*CLS") {
+    p_device->esr = 0;
+    p_device->b_rqs = false;
+    _status_update (p_device);
+    }
+  else if (s_header == "*RST" || s_header == "*TRG")
+    ;
+  else if (s_header == "DATA?") {
+    // IEEE 488.2 definite length arbitrary block
+    long cnt = atol (s_arg.c_str ());
+    if (cnt < 0)
+      cnt = 0;
+    if (cnt > CNT_MSG_MAX)
+      cnt = CNT_MSG_MAX;
+    snprintf (s_num, sizeof (s_num), "%ld", cnt);
+    s_resp = "#";
+    s_resp += char ('0' + strlen (s_num));
+    s_resp += s_num;
+    size_t idx = s_resp.size ();
+    s_resp.resize (idx + cnt);
+    for (long i=0; i < cnt; i++)
+      s_resp[idx + i] = char ('A' + i % 26);
+    }
+  else if (s_header == "ECHO?")
+    s_resp = s_arg;
+  else if (s_header[s_header.size () - 1] == '?')
+    s_resp = "+1.00000000E+00";
+}
+
+// ***************************************************************************
+// Vxi11Sim::_status_update - Update the status byte after a change of the
+//                            status registers, and request service if a
+//                            new enabled condition is set
+//
+// Parameters:
+// 1. p_device - Device
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  void Vxi11Sim::
+_status_update (Device *p_device)
+{
+  // Bit 5 is the event status bit
+  if (p_device->esr & p_device->ese)
+    p_device->stb |= 0x20;
+  else
+    p_device->stb &= ~0x20;
+
+  bool b_summary = (p_device->stb & p_device->sre) != 0;
+  if (b_summary && !p_device->b_summary) {
+    p_device->b_rqs = true;
+    _srq_send (p_device);
+    }
+  p_device->b_summary = b_summary;
+}
+
+// ***************************************************************************
+// Vxi11Sim::_srq_send - Call the interrupt channel of each link to a device
+//                       that has SRQ enabled
+//
+// Parameters:
+// 1. p_device - Device
+//
+// Returns: None
+//
+// Notes: Must be called with the mutex locked.  device_intr_srq has no
+//        reply, so the call is sent directly on the socket of the
+//        interrupt channel, and any reply is ignored.
+//
+//        HiSLIP sessions are always sent AsyncServiceRequest, as HiSLIP has
+//        no equivalent of enable_srq.
+// ***************************************************************************
+  void Vxi11Sim::
+_srq_send (Device *p_device)
+{
+  for (std::map<long, Link *>::iterator it = _links.begin ();
+       it != _links.end (); ++it) {
+    Link *p_link = it->second;
+    Conn *p_conn = p_link->p_conn;
+    if (p_link->p_device == p_device && p_link->p_conn_async) {
+      vxi11_hislip_send (p_link->p_conn_async->sock,
+                         HISLIP_ASYNC_SERVICE_REQUEST,
+                         p_device->stb | ((p_device->b_rqs) ? 0x40 : 0), 0);
+      _a_count[OP_SRQ]++;
+      continue;
+      }
+    if (p_link->p_device != p_device || !p_link->b_srq ||
+        p_conn->sock_intr < 0)
+      continue;
+
+    Device_SrqParms parms;
+    parms.handle.handle_len = p_link->s_handle.size ();
+    parms.handle.handle_val = (char *)p_link->s_handle.data ();
+    std::string s_call;
+    call_encode (s_call, !p_conn->b_intr_udp, ++p_conn->xid_intr,
+                 p_conn->prog_intr, p_conn->vers_intr, device_intr_srq,
+                 (xdrproc_t)xdr_Device_SrqParms, &parms);
+    send_all (p_conn->sock_intr, s_call.data (), s_call.size ());
+    _a_count[OP_SRQ]++;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Sim::_fn_opc - Thread setting operation complete after the delay
+//
+// Parameters:
+// 1. p_arg - Vxi11SimOpc*, deleted by this function
+//
+// Returns: Null
+// ***************************************************************************
+  void *Vxi11Sim::
+_fn_opc (void *p_arg)
+{
+  Vxi11SimOpc *p_opc = (Vxi11SimOpc *)p_arg;
+  Vxi11Sim *p_sim = p_opc->p_sim;
+  pthread_mutex_t *p_mutex = (pthread_mutex_t *)p_sim->_p_mutex;
+  pthread_cond_t *p_cond = (pthread_cond_t *)p_sim->_p_cond;
+
+  timespec ts;
+  ts.tv_sec = p_opc->t_ns / 1000000000LL;
+  ts.tv_nsec = p_opc->t_ns % 1000000000LL;
+
+  pthread_mutex_lock (p_mutex);
+  while (p_sim->_b_running && time_ns () < p_opc->t_ns)
+    pthread_cond_timedwait (p_cond, p_mutex, &ts);
+  if (p_sim->_b_running) {
+    Device *p_device = (Device *)p_opc->p_device;
+    p_device->esr |= 0x01;              // Operation complete
+    p_sim->_status_update (p_device);
+    }
+  p_sim->_cnt_thread--;
+  pthread_cond_broadcast (p_cond);
+  pthread_mutex_unlock (p_mutex);
+
+  delete p_opc;
+  return (0);
+}
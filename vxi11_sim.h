@@ -0,0 +1,205 @@
+#ifndef VXI11_SIM_H
+#define VXI11_SIM_H
+
+// ***************************************************************************
+// vxi11_sim.h - Header file for the VXI-11 instrument simulator
+//               Local VXI-11 server for testing and benchmarking libvxi11
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Example of basic use of Vxi11Sim class
+//
+//   Vxi11Sim sim;                         // Simulated instrument
+//   sim.latency (Vxi11Sim::OP_READ, 200); // 200 us to answer each read
+//   sim.start ();                         // Listen on any free port
+//   char s_addr[64];
+//   snprintf (s_addr, 64, "127.0.0.1:%d", sim.port ());
+//   Vxi11 vxi11 (s_addr);                 // Connect without portmapper
+//   ...
+//   sim.stop ();
+//
+// The simulator implements the DEVICE_CORE and DEVICE_ASYNC (abort)
+// channels as an ONC-RPC server, and calls the DEVICE_INTR channel of the
+// client for SRQ.  It also serves HiSLIP sessions on port_hislip(), in the
+// synchronized mode, and a raw SCPI socket on port_socket(), with the same
+// devices.  Each connection is served on its own thread, so concurrent links
+// are served concurrently.
+//
+// Each link has its own output queue.  Device locks and status registers
+// are shared by all links to the same device name.
+//
+// Built-in commands (separate several with ';' or newline):
+//   *IDN?          Identification string, see idn()
+//   *OPC?          Returns 1 after the operation complete delay
+//   *OPC           Sets OPC in the event status register after the
+//                  operation complete delay, see opc_delay()
+//   *ESE n, *ESE?  Event status enable register
+//   *ESR?          Event status register, cleared when read
+//   *SRE n, *SRE?  Service request enable register
+//   *STB?          Status byte
+//   *CLS           Clear status
+//   *RST, *TRG     Accepted, no response
+//   DATA? n        IEEE 488.2 definite length block of n bytes
+//   ECHO? text     Returns text
+//   Other queries (ending in '?') return a number; other commands are
+//   accepted with no response.
+// ***************************************************************************
+
+#include <string>
+
+struct Vxi11HislipHeader;
+
+// Response generator
+// Return true if s_cmd was handled and s_resp was set, false to use the
+// built-in commands.
+typedef bool (*Vxi11SimResponse) (void *p_arg, const std::string &s_cmd,
+                                  std::string &s_resp);
+
+class Vxi11Sim {
+
+  // *************************************************************************
+  // Public members
+  // *************************************************************************
+ public:
+
+  // Operations with configurable latency and counters
+  enum Op {
+    OP_CREATE_LINK, OP_WRITE, OP_READ, OP_READSTB, OP_TRIGGER, OP_CLEAR,
+    OP_REMOTE, OP_LOCAL, OP_LOCK, OP_UNLOCK, OP_ENABLE_SRQ, OP_DOCMD,
+    OP_DESTROY_LINK, OP_CREATE_INTR_CHAN, OP_DESTROY_INTR_CHAN, OP_ABORT,
+    OP_SRQ, CNT_OP
+  };
+
+  Vxi11Sim (void);
+  ~Vxi11Sim ();
+
+  // Start/stop the server
+  // port = TCP port for the core channel, 0 = any free port
+  // port_hislip = TCP port for HiSLIP, 0 = any free port
+  // port_socket = TCP port for the raw SCPI socket, 0 = any free port
+  int start (int port = 0, int port_hislip = 0, int port_socket = 0);
+  void stop (void);
+
+  // Get TCP ports of the core and abort channels, of HiSLIP, and of the raw
+  // SCPI socket
+  int port (void) { return (_port_core); }
+  int port_abort (void) { return (_port_abort); }
+  int port_hislip (void) { return (_port_hislip); }
+  int port_socket (void) { return (_port_socket); }
+
+  // Set maxRecvSize returned by create_link, default 1 MB
+  void max_recv_size (unsigned long max) { _max_recv_size = max; }
+  unsigned long max_recv_size (void) { return (_max_recv_size); }
+
+  // Set/get most bytes returned by one device_read, like a gateway with
+  // small buffers, 0 for no limit (default)
+  void read_fragment (unsigned long cnt) { _read_fragment = cnt; }
+  unsigned long read_fragment (void) { return (_read_fragment); }
+
+  // Set/get time to answer an operation, in us, default 0
+  void latency (int op, int us);
+  int latency (int op);
+
+  // Set/get delay until *OPC and *OPC? complete, in us, default 0
+  void opc_delay (int us) { _opc_delay_us = us; }
+  int opc_delay (void) { return (_opc_delay_us); }
+
+  // Set the *IDN? response
+  void idn (const char *s_idn) { _s_idn = s_idn; }
+
+  // Set a response generator called for every command
+  // It is called with the simulator state locked, so it must not call
+  // other member functions.
+  void response (Vxi11SimResponse pfn_response, void *p_arg) {
+    _pfn_response = pfn_response;
+    _p_response_arg = p_arg;
+    }
+
+  // Set/get whether the VXI-11 calls get no reply, like a device switched
+  // off without closing its connections; device_abort does not end the
+  // operation in progress either.  Default is false.
+  void unresponsive (bool b_unresponsive);
+  bool unresponsive (void);
+
+  // Request service (SRQ) on a device, null for all devices
+  void srq (const char *s_device = 0);
+
+  // Get/reset number of each operation served
+  unsigned long count (int op);
+  void count_reset (void);
+
+  // *************************************************************************
+  // Private members
+  // *************************************************************************
+ private:
+  struct Conn;
+  struct Device;
+  struct Link;
+
+  int _port_core;                       // TCP port of core channel
+  int _port_abort;                      // TCP port of abort channel
+  int _port_hislip;                     // TCP port of HiSLIP
+  int _port_socket;                     // TCP port of raw SCPI socket
+  int _sock_core;                       // Listening socket, core channel
+  int _sock_abort;                      // Listening socket, abort channel
+  int _sock_hislip;                     // Listening socket, HiSLIP
+  int _sock_socket;                     // Listening socket, raw SCPI socket
+  bool _b_running;                      // True between start() and stop()
+
+  unsigned long _max_recv_size;         // maxRecvSize for create_link
+  unsigned long _read_fragment;         // Most bytes of a device_read, 0 if
+                                        // no limit
+  int _a_latency_us[CNT_OP];            // Latency of each operation
+  int _opc_delay_us;                    // Delay for *OPC
+  bool _b_unresponsive;                 // VXI-11 calls get no reply
+  std::string _s_idn;                   // *IDN? response
+  Vxi11SimResponse _pfn_response;       // Response generator, or null
+  void *_p_response_arg;                // Parameter for _pfn_response
+  unsigned long _a_count[CNT_OP];       // Number of each operation served
+
+  void *_p_mutex;                       // Protects all state, pthread_mutex_t*
+  void *_p_cond;                        // Signals state changes,
+                                        // pthread_cond_t*
+  void *_p_threads;                     // Listener threads, pthread_t[4]
+  void *_p_conns;                       // Connections, std::set<Conn *>*
+  void *_p_devices;                     // Devices, std::map<string,Device*>*
+  void *_p_links;                       // Links, std::map<long, Link *>*
+  long _lid_next;                       // Next link ID to assign
+  int _cnt_thread;                      // Number of connection threads
+
+  static void *_fn_listen (void *p_arg);
+  static void *_fn_conn (void *p_arg);
+  static void *_fn_opc (void *p_arg);
+
+  void _serve (Conn *p_conn);
+  void _dispatch (Conn *p_conn, unsigned int xid, unsigned int proc,
+                  void *p_xdrs, std::string &s_reply);
+  void _serve_hislip (Conn *p_conn);
+  int _hislip_sync (Conn *p_conn, const Vxi11HislipHeader *p_header,
+                    const std::string &s_payload);
+  int _hislip_async (Conn *p_conn, const Vxi11HislipHeader *p_header,
+                     const std::string &s_payload);
+  void _serve_socket (Conn *p_conn);
+  Link *_link_create (Conn *p_conn, const char *s_device);
+  Link *_begin (Conn *p_conn, long lid, int op);
+  void _end (Link *p_link);
+  int _wait_until (Link *p_link, long long t_ns);
+  int _wait_us (Link *p_link, int us);
+  int _lock_wait (Link *p_link, bool b_acquire, long flags,
+                  unsigned long lock_timeout);
+  void _execute (Link *p_link, const std::string &s_data);
+  void _command (Link *p_link, const std::string &s_cmd,
+                 std::string &s_resp);
+  void _status_update (Device *p_device);
+  void _srq_send (Device *p_device);
+  void _link_destroy (Link *p_link);
+};
+
+#endif
@@ -0,0 +1,548 @@
+// ***************************************************************************
+// vxi11_socket.cpp - Raw SCPI socket transport for libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_socket.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <string>
+
+// VXI-11 error codes returned by the socket client
+#define ERR_NONE                0
+#define ERR_NOT_SUPPORTED       8
+#define ERR_IO_TIMEOUT          15
+#define ERR_IO                  17
+
+// VXI-11 flags and reasons
+#define FLAG_END                8
+#define FLAG_TERMCHRSET         128
+#define REASON_REQCNT           1
+#define REASON_CHR              2
+#define REASON_END              4
+
+// maxRecvSize returned by create_link; the socket has no message size limit
+static const unsigned long SIZE_RECV_MAX = 16 * 1024 * 1024;
+
+// Smallest recv() into the input buffer
+static const size_t SIZE_RECV_CHUNK = 64 * 1024;
+
+// ***************************************************************************
+// Socket RPC client
+// ***************************************************************************
+struct Vxi11SocketClient {
+  CLIENT client;                        // Must be first
+  char s_host[256];                     // Host name or IP address
+  int port;                             // TCP port of the instrument
+
+  int sock;                             // Socket, or -1
+  std::string s_in;                     // Data received but not read
+  size_t idx_in;                        // Bytes of s_in already read
+  size_t idx_msg;                       // Start of the message in s_in
+  size_t idx_scan;                      // Bytes of s_in scanned for the end
+                                        // of the message
+  size_t idx_end;                       // End of message in s_in, after the
+                                        // newline, or 0 if not found yet
+  std::string s_read;                   // Data returned by device_read
+
+  struct timeval timeout;               // RPC timeout
+  u_int32_t xid;                        // Transaction ID of last call
+  enum clnt_stat stat;                  // Status of last call
+};
+
+// ***************************************************************************
+// Helper functions
+// ***************************************************************************
+
+// Get CLOCK_MONOTONIC in ms
+static long long
+time_ms (void)
+{
+  timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Close the socket and discard buffered data
+static void
+socket_disconnect (Vxi11SocketClient *p_socket)
+{
+  if (p_socket->sock >= 0)
+    ::close (p_socket->sock);
+  p_socket->sock = -1;
+  p_socket->s_in.clear ();
+  p_socket->idx_in = 0;
+  p_socket->idx_msg = 0;
+  p_socket->idx_scan = 0;
+  p_socket->idx_end = 0;
+}
+
+// Send exactly cnt bytes
+// Returns: 0 = no error
+//          1 = error
+static int
+socket_send (Vxi11SocketClient *p_socket, const char *ac_data, size_t cnt)
+{
+  while (cnt) {
+    ssize_t cnt_send = send (p_socket->sock, ac_data, cnt, MSG_NOSIGNAL);
+    if (cnt_send < 0 && errno == EINTR)
+      continue;
+    if (cnt_send <= 0)
+      return (1);
+    ac_data += cnt_send;
+    cnt -= cnt_send;
+    }
+  return (0);
+}
+
+// Find the end of the message at idx_msg, continuing from idx_scan
+// A newline ends the message unless it is inside a definite length block
+// that starts the message or follows a ',' or ';'.
+static void
+socket_scan (Vxi11SocketClient *p_socket)
+{
+  const std::string &s_in = p_socket->s_in;
+  size_t idx = p_socket->idx_scan;
+
+  while (idx < s_in.size ()) {
+    char c = s_in[idx];
+    if (c == '\n') {
+      p_socket->idx_end = idx + 1;
+      return;
+      }
+    if (c == '#' &&
+        (idx == p_socket->idx_msg || s_in[idx-1] == ',' ||
+         s_in[idx-1] == ';')) {
+      if (idx + 1 >= s_in.size ())
+        break;                          // Wait for the digit count
+      int cnt_digit = s_in[idx+1] - '0';
+      if (cnt_digit >= 1 && cnt_digit <= 9) {
+        if (idx + 2 + cnt_digit > s_in.size ())
+          break;                        // Wait for the length
+        size_t len = strtoul (s_in.substr (idx + 2, cnt_digit).c_str (), 0,
+                              10);
+        if (idx + 2 + cnt_digit + len > s_in.size ())
+          break;                        // Wait for the block
+        idx += 2 + cnt_digit + len;
+        continue;
+        }
+      }
+    idx++;
+    }
+
+  p_socket->idx_scan = idx;
+}
+
+// Receive more data into the input buffer
+// Returns: 0 = no error
+//          1 = error, or connection closed
+//          2 = timeout
+static int
+socket_recv (Vxi11SocketClient *p_socket, long long t_end_ms)
+{
+  // Drop the messages already read, once they are the larger part of the
+  // buffer
+  size_t cnt_drop = p_socket->idx_msg;
+  if (cnt_drop && cnt_drop >= p_socket->s_in.size () / 2) {
+    p_socket->s_in.erase (0, cnt_drop);
+    p_socket->idx_in -= cnt_drop;
+    p_socket->idx_msg = 0;
+    p_socket->idx_scan -= cnt_drop;
+    if (p_socket->idx_end)
+      p_socket->idx_end -= cnt_drop;
+    }
+
+  long long t_left_ms = t_end_ms - time_ms ();
+  pollfd pfd = {p_socket->sock, POLLIN, 0};
+  int cnt_ready;
+  while ((cnt_ready = poll (&pfd, 1, (t_left_ms > 0) ? t_left_ms : 0)) < 0 &&
+         errno == EINTR)
+    ;
+  if (cnt_ready == 0)
+    return (2);
+
+  // Receive all the data waiting, at least one chunk; growing the buffer by
+  // the request size instead would clear that much memory on every call
+  int cnt_pending = 0;
+  ioctl (p_socket->sock, FIONREAD, &cnt_pending);
+  size_t cnt = ((size_t)cnt_pending > SIZE_RECV_CHUNK) ? cnt_pending :
+                                                          SIZE_RECV_CHUNK;
+  size_t idx = p_socket->s_in.size ();
+  p_socket->s_in.resize (idx + cnt);
+  ssize_t cnt_recv;
+  do
+    cnt_recv = recv (p_socket->sock, &p_socket->s_in[idx], cnt, 0);
+  while (cnt_recv < 0 && errno == EINTR);
+  p_socket->s_in.resize (idx + ((cnt_recv > 0) ? cnt_recv : 0));
+  return ((cnt_recv > 0) ? 0 : 1);
+}
+
+// Get the RPC timeout in ms
+static int
+socket_timeout_ms (Vxi11SocketClient *p_socket)
+{
+  return (p_socket->timeout.tv_sec * 1000 + p_socket->timeout.tv_usec / 1000);
+}
+
+// ***************************************************************************
+// Procedures of the DEVICE_CORE program
+//
+// Each returns the RPC status.  The results point to storage of the client,
+// which is valid until the next call.
+// ***************************************************************************
+
+// create_link - Connect to the instrument
+static enum clnt_stat
+socket_create_link (Vxi11SocketClient *p_socket, Create_LinkResp *p_resp)
+{
+  memset (p_resp, 0, sizeof (Create_LinkResp));
+  socket_disconnect (p_socket);         // Only one link per client
+
+  char s_port[16];
+  snprintf (s_port, sizeof (s_port), "%d", p_socket->port);
+  addrinfo hints;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *p_addrinfo = 0;
+  if (getaddrinfo (p_socket->s_host, s_port, &hints, &p_addrinfo) ||
+      !p_addrinfo)
+    return (RPC_UNKNOWNHOST);
+
+  p_socket->sock = socket (AF_INET, SOCK_STREAM, 0);
+  if (p_socket->sock >= 0 &&
+      connect (p_socket->sock, p_addrinfo->ai_addr, p_addrinfo->ai_addrlen))
+    socket_disconnect (p_socket);
+  freeaddrinfo (p_addrinfo);
+  if (p_socket->sock < 0)
+    return (RPC_CANTSEND);
+
+  int on = 1;                           // Commands are small and interactive
+  setsockopt (p_socket->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+
+  p_resp->lid = 0;
+  p_resp->abortPort = 0;                // No abort channel
+  p_resp->maxRecvSize = SIZE_RECV_MAX;
+  return (RPC_SUCCESS);
+}
+
+// device_write - Send the data, adding a newline at END if needed
+static enum clnt_stat
+socket_write (Vxi11SocketClient *p_socket, Device_WriteParms *p_parms,
+              Device_WriteResp *p_resp)
+{
+  u_int cnt = p_parms->data.data_len;
+  if (socket_send (p_socket, p_parms->data.data_val, cnt))
+    return (RPC_CANTSEND);
+  if ((p_parms->flags & FLAG_END) &&
+      (cnt == 0 || p_parms->data.data_val[cnt-1] != '\n') &&
+      socket_send (p_socket, "\n", 1))
+    return (RPC_CANTSEND);
+
+  p_resp->error = ERR_NONE;
+  p_resp->size = cnt;
+  return (RPC_SUCCESS);
+}
+
+// device_read - Return buffered data up to the end of the message
+static enum clnt_stat
+socket_read (Vxi11SocketClient *p_socket, Device_ReadParms *p_parms,
+             Device_ReadResp *p_resp)
+{
+  memset (p_resp, 0, sizeof (Device_ReadResp));
+  long long t_end_ms = time_ms () + p_parms->io_timeout;
+
+  for (;;) {
+    // Return when the request size, the termination character or the end
+    // of the message is reached
+    if (!p_socket->idx_end)
+      socket_scan (p_socket);
+    size_t idx_last = (p_socket->idx_end) ? p_socket->idx_end :
+                                            p_socket->s_in.size ();
+    size_t cnt = idx_last - p_socket->idx_in;
+    const char *p_data = p_socket->s_in.data () + p_socket->idx_in;
+    if (cnt >= p_parms->requestSize) {
+      cnt = p_parms->requestSize;
+      p_resp->reason = REASON_REQCNT;
+      }
+    if (p_parms->flags & FLAG_TERMCHRSET) {
+      const char *p_term = (const char *)memchr (p_data, p_parms->termChar,
+                                                 cnt);
+      if (p_term) {
+        cnt = p_term - p_data + 1;
+        p_resp->reason = REASON_CHR |
+                         ((cnt == p_parms->requestSize) ? REASON_REQCNT : 0);
+        }
+      }
+    bool b_end = p_socket->idx_end &&
+                 p_socket->idx_in + cnt == p_socket->idx_end;
+    if (b_end)
+      p_resp->reason |= REASON_END;
+
+    if (p_resp->reason) {
+      p_socket->s_read.assign (p_data, cnt);
+      p_socket->idx_in += cnt;
+      if (b_end) {                      // Next message starts here
+        p_socket->idx_msg = p_socket->idx_in;
+        p_socket->idx_scan = p_socket->idx_in;
+        p_socket->idx_end = 0;
+        }
+      p_resp->error = ERR_NONE;
+      p_resp->data.data_len = p_socket->s_read.size ();
+      p_resp->data.data_val = (char *)p_socket->s_read.data ();
+      return (RPC_SUCCESS);
+      }
+
+    // Receive more data
+    int err = socket_recv (p_socket, t_end_ms);
+    if (err == 2) {
+      p_resp->error = ERR_IO_TIMEOUT;
+      return (RPC_SUCCESS);
+      }
+    if (err)
+      return (RPC_CANTRECV);
+    }
+}
+
+// device_readstb - Emulate the serial poll with "*STB?"
+static enum clnt_stat
+socket_readstb (Vxi11SocketClient *p_socket, Device_ReadStbResp *p_resp)
+{
+  p_resp->stb = 0;
+  p_resp->error = ERR_NONE;
+  if (socket_send (p_socket, "*STB?\n", 6))
+    return (RPC_CANTSEND);
+
+  Device_ReadParms parms;
+  memset (&parms, 0, sizeof (parms));
+  parms.requestSize = 256;
+  parms.io_timeout = socket_timeout_ms (p_socket);
+  Device_ReadResp resp;
+  enum clnt_stat stat = socket_read (p_socket, &parms, &resp);
+  if (stat != RPC_SUCCESS || resp.error) {
+    p_resp->error = (stat == RPC_SUCCESS) ? resp.error : ERR_IO;
+    return (stat);
+    }
+
+  std::string s_stb (resp.data.data_val, resp.data.data_len);
+  p_resp->stb = (u_char)strtol (s_stb.c_str (), 0, 10);
+  return (RPC_SUCCESS);
+}
+
+// ***************************************************************************
+// CLIENT operations
+// ***************************************************************************
+
+static enum clnt_stat
+socket_call (CLIENT *p_client, rpcproc_t proc, xdrproc_t xdr_args,
+             void *p_args, xdrproc_t xdr_res, void *p_res,
+             struct timeval timeout)
+{
+  Vxi11SocketClient *p_socket = (Vxi11SocketClient *)p_client;
+  p_socket->xid++;
+
+  // All procedures but create_link need the connection
+  if (proc != create_link && p_socket->sock < 0) {
+    p_socket->stat = RPC_CANTSEND;
+    return (p_socket->stat);
+    }
+
+  enum clnt_stat stat = RPC_SUCCESS;
+
+  switch (proc) {
+  case create_link:
+    stat = socket_create_link (p_socket, (Create_LinkResp *)p_res);
+    break;
+
+  case device_write:
+    stat = socket_write (p_socket, (Device_WriteParms *)p_args,
+                         (Device_WriteResp *)p_res);
+    break;
+
+  case device_read:
+    stat = socket_read (p_socket, (Device_ReadParms *)p_args,
+                        (Device_ReadResp *)p_res);
+    break;
+
+  case device_readstb:
+    stat = socket_readstb (p_socket, (Device_ReadStbResp *)p_res);
+    break;
+
+  case NULLPROC: {                      // Ping, with a status query
+    Device_ReadStbResp resp;
+    stat = socket_readstb (p_socket, &resp);
+    if ((stat == RPC_SUCCESS) && resp.error)
+      stat = RPC_TIMEDOUT;
+    break;
+    }
+
+  case device_trigger:
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    if (socket_send (p_socket, "*TRG\n", 5))
+      stat = RPC_CANTSEND;
+    break;
+
+  case device_clear: {
+    // There is no device clear on the socket, so discard the responses
+    // received so far
+    char ac_data[4096];
+    while (recv (p_socket->sock, ac_data, sizeof (ac_data), MSG_DONTWAIT) > 0)
+      ;
+    p_socket->s_in.clear ();
+    p_socket->idx_in = 0;
+    p_socket->idx_msg = 0;
+    p_socket->idx_scan = 0;
+    p_socket->idx_end = 0;
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    break;
+    }
+
+  case device_remote:
+  case device_local:
+  case device_lock:
+  case device_unlock:
+  case device_enable_srq:
+  case create_intr_chan:
+  case destroy_intr_chan:
+    ((Device_Error *)p_res)->error = ERR_NOT_SUPPORTED;
+    break;
+
+  case device_docmd: {
+    Device_DocmdResp *p_resp = (Device_DocmdResp *)p_res;
+    memset (p_resp, 0, sizeof (Device_DocmdResp));
+    p_resp->error = ERR_NOT_SUPPORTED;
+    break;
+    }
+
+  case destroy_link:
+    socket_disconnect (p_socket);
+    ((Device_Error *)p_res)->error = ERR_NONE;
+    break;
+
+  default:
+    stat = RPC_PROCUNAVAIL;
+    break;
+    }
+
+  p_socket->stat = stat;
+  return (stat);
+}
+
+static void
+socket_abort (CLIENT *p_client)
+{
+}
+
+static void
+socket_geterr (CLIENT *p_client, struct rpc_err *p_err)
+{
+  Vxi11SocketClient *p_socket = (Vxi11SocketClient *)p_client;
+  memset (p_err, 0, sizeof (struct rpc_err));
+  p_err->re_status = p_socket->stat;
+}
+
+static bool_t
+socket_freeres (CLIENT *p_client, xdrproc_t xdr_res, void *p_res)
+{
+  return (TRUE);                        // Results are owned by the client
+}
+
+static void
+socket_destroy (CLIENT *p_client)
+{
+  Vxi11SocketClient *p_socket = (Vxi11SocketClient *)p_client;
+  socket_disconnect (p_socket);
+  auth_destroy (p_socket->client.cl_auth);
+  delete p_socket;
+}
+
+static bool_t
+socket_control (CLIENT *p_client, u_int request, void *p_info)
+{
+  Vxi11SocketClient *p_socket = (Vxi11SocketClient *)p_client;
+
+  switch (request) {
+  case CLSET_TIMEOUT:
+    p_socket->timeout = *(struct timeval *)p_info;
+    break;
+  case CLGET_TIMEOUT:
+    *(struct timeval *)p_info = p_socket->timeout;
+    break;
+  case CLGET_XID:                       // Transaction ID of last call
+    *(u_int32_t *)p_info = p_socket->xid;
+    break;
+  case CLSET_XID:                       // Transaction ID of next call
+    p_socket->xid = *(u_int32_t *)p_info - 1;
+    break;
+  case CLGET_FD:                        // Socket, for readiness and cancel
+    if (p_socket->sock < 0)
+      return (FALSE);
+    *(int *)p_info = p_socket->sock;
+    break;
+  default:
+    return (FALSE);
+    }
+
+  return (TRUE);
+}
+
+static CLIENT::clnt_ops socket_ops = {
+  socket_call, socket_abort, socket_geterr, socket_freeres, socket_destroy,
+  socket_control
+};
+
+// ***************************************************************************
+// vxi11_socket_create - Create an RPC client for the DEVICE_CORE program
+//                       that uses a raw SCPI socket
+//
+// Parameters:
+// 1. s_host - Host name or IP address of the instrument
+// 2. port   - TCP port of the socket, usually VXI11_SOCKET_PORT
+//
+// Returns: Socket RPC client, destroy with clnt_destroy()
+//
+// Notes: The instrument is connected by create_link.  The link has no
+//        abort channel (abortPort is 0).
+// ***************************************************************************
+  CLIENT *
+vxi11_socket_create (const char *s_host, int port)
+{
+  Vxi11SocketClient *p_socket = new Vxi11SocketClient;
+  p_socket->client.cl_auth = authnone_create ();
+  p_socket->client.cl_ops = &socket_ops;
+  p_socket->client.cl_private = 0;
+  p_socket->s_host[255] = 0;
+  strncpy (p_socket->s_host, s_host, 255);
+  p_socket->port = port;
+  p_socket->sock = -1;
+  p_socket->idx_in = 0;
+  p_socket->idx_msg = 0;
+  p_socket->idx_scan = 0;
+  p_socket->idx_end = 0;
+  p_socket->timeout.tv_sec = 25;        // Same default as rpcgen clients
+  p_socket->timeout.tv_usec = 0;
+  p_socket->xid = 0;
+  p_socket->stat = RPC_SUCCESS;
+
+  return (&p_socket->client);
+}
@@ -0,0 +1,45 @@
+#ifndef VXI11_SOCKET_H
+#define VXI11_SOCKET_H
+
+// ***************************************************************************
+// vxi11_socket.h - Raw SCPI socket transport for libvxi11.so library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// The socket client is an RPC client (CLIENT) for the DEVICE_CORE program
+// that talks to the raw SCPI socket of an instrument, usually on port 5025,
+// so the Vxi11 class works unchanged on it:
+//
+//   create_link     Connects to the instrument
+//   device_write    Sends the data; a newline is added at END if the data
+//                   does not end with one
+//   device_read     Returns buffered data; a message ends at a newline that
+//                   is not inside an IEEE 488.2 definite length block
+//                   ("#<n><length><data>"), and is returned with END
+//   device_readstb  Sends "*STB?" and reads the reply
+//   device_trigger  Sends "*TRG"
+//   device_clear    Discards the data received so far; a response still on
+//                   its way from the instrument is not discarded
+//
+// The raw socket has no out-of-band channel, so readstb() should only be
+// called when no response is waiting to be read.  Locks, remote/local and
+// SRQ are not supported.
+// ***************************************************************************
+
+#include <rpc/rpc.h>
+
+#define VXI11_SOCKET_PORT     5025      // Default TCP port
+
+// Create an RPC client for the DEVICE_CORE program that connects to the
+// raw SCPI socket at s_host:port when create_link is called.
+// Destroy with clnt_destroy().
+CLIENT *vxi11_socket_create (const char *s_host, int port);
+
+#endif
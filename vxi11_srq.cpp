@@ -0,0 +1,844 @@
+// ***************************************************************************
+// vxi11_srq.cpp - DEVICE_INTR server for SRQ interrupts, for libvxi11.so
+//                 library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// The server is implemented here instead of with svc_register() and
+// svc_run(), because svc_run() calls the SRQ function on its only thread,
+// so one slow SRQ function stops the SRQs of every device.  Only the rpcgen
+// XDR routines are used.
+
+#include "libvxi11.h"
+#include "vxi11_srq.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// Fragment header of an RPC record on TCP (RFC 5531 record marking)
+#define RM_LAST         0x80000000u     // Last fragment of the record
+#define RM_LEN          0x7fffffffu     // Length of the fragment
+
+// Largest device_intr_srq call accepted; the handle is at most 40 bytes
+static const size_t LEN_MSG_MAX = 65536;
+
+// Most events processed per wait of the I/O thread
+static const int CNT_EVENT_MAX = 64;
+
+// ***************************************************************************
+// Vxi11SrqConn - TCP connection of an interrupt channel
+// ***************************************************************************
+struct Vxi11SrqConn {
+  std::string s_buf;                    // Received, not yet a full fragment
+  std::string s_msg;                    // Fragments of the call so far
+};
+
+// ***************************************************************************
+// Vxi11SrqLink - SRQ state of one handle
+// ***************************************************************************
+struct Vxi11SrqLink {
+  bool b_queued;                        // In a_s_ready, waiting for a worker
+  bool b_running;                       // SRQ function running
+  bool b_again;                         // SRQ received while running
+  pthread_t pthread;                    // Worker running the SRQ function
+};
+
+// ***************************************************************************
+// Vxi11SrqServer - Sockets, threads and queue of the server
+// ***************************************************************************
+struct Vxi11SrqServer {
+  int cnt_user;                         // vxi11_srq_start() not yet stopped
+  void (*pfn_srq) (const char *, int);  // SRQ function
+
+  int sock_tcp;                         // Listening TCP socket
+  int sock_udp;                         // UDP socket
+  int port_tcp;
+  int port_udp;
+  int a_fd_wake[2];                     // Pipe to stop the I/O thread
+  int fd_epoll;                         // epoll instance, Linux only
+  std::map<int, Vxi11SrqConn> conns;    // TCP connections, by socket
+                                        // Used by the I/O thread only
+
+  bool b_io;                            // I/O thread started
+  pthread_t pthread_io;
+  std::vector<pthread_t> a_pthread;     // Worker threads
+
+  // Guarded by mutex_srq
+  bool b_stop;                          // Threads must exit
+  std::deque<std::string> a_s_ready;    // Handles waiting for a worker
+  std::map<std::string, Vxi11SrqLink> links; // Handles queued or running
+};
+
+// Serializes vxi11_srq_start() and vxi11_srq_stop()
+static pthread_mutex_t mutex_start = PTHREAD_MUTEX_INITIALIZER;
+
+// Guards p_server and the queue of the server
+static pthread_mutex_t mutex_srq = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_work = PTHREAD_COND_INITIALIZER; // Handle queued
+static pthread_cond_t cond_idle = PTHREAD_COND_INITIALIZER; // SRQ func done
+
+static Vxi11SrqServer *p_server = 0;    // Running server, or null
+
+// Queue an SRQ for a handle
+// Must be called with mutex_srq locked.
+static void
+srq_queue (Vxi11SrqServer *p_srv, const std::string &s_handle)
+{
+  Vxi11SrqLink &link = p_srv->links[s_handle]; // Cleared if new
+  if (link.b_running)
+    link.b_again = true;                // Run again after the running one
+  else if (!link.b_queued) {
+    link.b_queued = true;
+    p_srv->a_s_ready.push_back (s_handle);
+    pthread_cond_signal (&cond_work);
+    }
+}
+
+// Decode a device_intr_srq call and queue its handle
+static void
+srq_call (Vxi11SrqServer *p_srv, char *ac_msg, size_t cnt_msg)
+{
+  XDR xdrs;
+  xdrmem_create (&xdrs, ac_msg, cnt_msg, XDR_DECODE);
+
+  // Call header: xid, CALL, RPC version, program, version, procedure
+  unsigned int a_header[6];
+  bool b_ok = true;
+  for (int i=0; i < 6 && b_ok; i++)
+    b_ok = xdr_u_int (&xdrs, &a_header[i]);
+
+  // Skip credentials and verifier
+  for (int i=0; i < 2 && b_ok; i++) {
+    unsigned int flavor, len;
+    b_ok = xdr_u_int (&xdrs, &flavor) && xdr_u_int (&xdrs, &len) &&
+           len <= 400;
+    unsigned int pos = xdr_getpos (&xdrs) + ((len + 3) & ~3u);
+    b_ok = b_ok && pos <= cnt_msg && xdr_setpos (&xdrs, pos);
+    }
+
+  if (!b_ok || a_header[1] != CALL || a_header[2] != 2 ||
+      a_header[3] != DEVICE_INTR || a_header[4] != DEVICE_INTR_VERSION ||
+      a_header[5] != device_intr_srq) {
+    Vxi11Common::log_err ("Vxi11 SRQ server error: unexpected RPC call.\n");
+    xdr_destroy (&xdrs);
+    return;
+    }
+
+  Device_SrqParms parms;
+  memset (&parms, 0, sizeof (parms));
+  if (!xdr_Device_SrqParms (&xdrs, &parms))
+    Vxi11Common::log_err ("Vxi11 SRQ server error: could not decode "
+                          "arguments.\n");
+  else {
+    std::string s_handle (parms.handle.handle_val, parms.handle.handle_len);
+    pthread_mutex_lock (&mutex_srq);
+    srq_queue (p_srv, s_handle);
+    pthread_mutex_unlock (&mutex_srq);
+    }
+  xdr_free ((xdrproc_t)xdr_Device_SrqParms, (char *)&parms);
+  xdr_destroy (&xdrs);
+}
+
+// Add a socket to the sockets waited on by the I/O thread
+static int
+srq_watch (Vxi11SrqServer *p_srv, int sock)
+{
+#ifdef __linux__
+  epoll_event event;
+  memset (&event, 0, sizeof (event));
+  event.events = EPOLLIN;
+  event.data.fd = sock;
+  return (epoll_ctl (p_srv->fd_epoll, EPOLL_CTL_ADD, sock, &event));
+#else
+  return (0);                           // poll() uses the sockets of conns
+#endif
+}
+
+// Close a TCP connection
+static void
+srq_conn_close (Vxi11SrqServer *p_srv, int sock)
+{
+  close (sock);                         // Also removes it from epoll
+  p_srv->conns.erase (sock);
+}
+
+// Receive data on a TCP connection, and decode each call completed
+static void
+srq_recv_tcp (Vxi11SrqServer *p_srv, int sock)
+{
+  char ac_data[4096];
+  ssize_t cnt_recv = recv (sock, ac_data, sizeof (ac_data), 0);
+  if (cnt_recv < 0 && (errno == EINTR || errno == EAGAIN))
+    return;
+  if (cnt_recv <= 0) {                  // Closed by the device
+    srq_conn_close (p_srv, sock);
+    return;
+    }
+
+  Vxi11SrqConn &conn = p_srv->conns[sock];
+  conn.s_buf.append (ac_data, cnt_recv);
+
+  size_t idx = 0;
+  while (conn.s_buf.size () - idx >= 4) {
+    unsigned int mark;
+    memcpy (&mark, &conn.s_buf[idx], 4);
+    mark = ntohl (mark);
+    size_t cnt = mark & RM_LEN;
+    if (conn.s_msg.size () + cnt > LEN_MSG_MAX) {
+      Vxi11Common::log_err ("Vxi11 SRQ server error: call too long.\n");
+      srq_conn_close (p_srv, sock);
+      return;
+      }
+    if (conn.s_buf.size () - idx - 4 < cnt)
+      break;                            // Rest of fragment not received
+    conn.s_msg.append (conn.s_buf, idx + 4, cnt);
+    idx += 4 + cnt;
+    if (mark & RM_LAST) {
+      srq_call (p_srv, &conn.s_msg[0], conn.s_msg.size ());
+      conn.s_msg.clear ();
+      }
+    }
+  conn.s_buf.erase (0, idx);
+}
+
+// Wait for sockets ready to read
+// Returns the number of sockets stored to a_fd.
+static int
+srq_wait (Vxi11SrqServer *p_srv, int *a_fd)
+{
+  int cnt_fd = 0;
+
+#ifdef __linux__
+  epoll_event a_event[CNT_EVENT_MAX];
+  int cnt_event = epoll_wait (p_srv->fd_epoll, a_event, CNT_EVENT_MAX, -1);
+  for (int i=0; i < cnt_event; i++)
+    a_fd[cnt_fd++] = a_event[i].data.fd;
+#else
+  std::vector<pollfd> a_pollfd;
+  pollfd pfd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  pfd.fd = p_srv->a_fd_wake[0];
+  a_pollfd.push_back (pfd);
+  pfd.fd = p_srv->sock_tcp;
+  a_pollfd.push_back (pfd);
+  pfd.fd = p_srv->sock_udp;
+  a_pollfd.push_back (pfd);
+  for (std::map<int, Vxi11SrqConn>::iterator it = p_srv->conns.begin ();
+       it != p_srv->conns.end (); ++it) {
+    pfd.fd = it->first;
+    a_pollfd.push_back (pfd);
+    }
+  if (poll (&a_pollfd[0], a_pollfd.size (), -1) > 0) {
+    for (size_t i=0; i < a_pollfd.size () && cnt_fd < CNT_EVENT_MAX; i++)
+      if (a_pollfd[i].revents)
+        a_fd[cnt_fd++] = a_pollfd[i].fd;
+    }
+#endif
+
+  return (cnt_fd);
+}
+
+// Thread receiving the calls of all interrupt channels
+static void *
+srq_fn_io (void *p_arg)
+{
+  Vxi11SrqServer *p_srv = (Vxi11SrqServer *)p_arg;
+  std::vector<char> ac_datagram (LEN_MSG_MAX);
+  int a_fd[CNT_EVENT_MAX];
+
+  for (;;) {
+    int cnt_fd = srq_wait (p_srv, a_fd);
+    for (int i=0; i < cnt_fd; i++) {
+      int fd = a_fd[i];
+
+      if (fd == p_srv->a_fd_wake[0])   // vxi11_srq_stop()
+        return (0);
+
+      if (fd == p_srv->sock_tcp) {      // New interrupt channel
+        int sock = accept (p_srv->sock_tcp, 0, 0);
+        if (sock < 0)
+          continue;
+        if (srq_watch (p_srv, sock)) {
+          close (sock);
+          continue;
+          }
+        p_srv->conns[sock];
+        }
+
+      else if (fd == p_srv->sock_udp) { // One call per datagram
+        ssize_t cnt_recv = recv (fd, &ac_datagram[0], ac_datagram.size (), 0);
+        if (cnt_recv > 0)
+          srq_call (p_srv, &ac_datagram[0], cnt_recv);
+        }
+
+      else if (p_srv->conns.count (fd))
+        srq_recv_tcp (p_srv, fd);
+      }
+    }
+}
+
+// Worker thread calling the SRQ function
+static void *
+srq_fn_worker (void *p_arg)
+{
+  Vxi11SrqServer *p_srv = (Vxi11SrqServer *)p_arg;
+
+  pthread_mutex_lock (&mutex_srq);
+  for (;;) {
+    while (!p_srv->b_stop && p_srv->a_s_ready.empty ())
+      pthread_cond_wait (&cond_work, &mutex_srq);
+    if (p_srv->b_stop)
+      break;
+
+    std::string s_handle = p_srv->a_s_ready.front ();
+    p_srv->a_s_ready.pop_front ();
+    Vxi11SrqLink &link = p_srv->links[s_handle]; // Not erased while running
+    link.b_queued = false;
+    link.b_running = true;
+    link.pthread = pthread_self ();
+    pthread_mutex_unlock (&mutex_srq);
+
+    p_srv->pfn_srq (s_handle.data (), int (s_handle.size ()));
+
+    pthread_mutex_lock (&mutex_srq);
+    link.b_running = false;
+    if (link.b_again) {                 // SRQ received while running
+      link.b_again = false;
+      link.b_queued = true;
+      p_srv->a_s_ready.push_back (s_handle);
+      pthread_cond_signal (&cond_work);
+      }
+    else
+      p_srv->links.erase (s_handle);
+    pthread_cond_broadcast (&cond_idle);
+    }
+  pthread_mutex_unlock (&mutex_srq);
+
+  return (0);
+}
+
+// Create a socket bound to any free port on all interfaces
+static int
+srq_socket (int type, int *p_port)
+{
+  int sock = socket (AF_INET, type, 0);
+  if (sock < 0)
+    return (-1);
+
+  sockaddr_in addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_ANY);
+  addr.sin_port = 0;
+  socklen_t len = sizeof (addr);
+  if (bind (sock, (sockaddr *)&addr, sizeof (addr)) ||
+      (type == SOCK_STREAM && listen (sock, 64)) ||
+      getsockname (sock, (sockaddr *)&addr, &len)) {
+    close (sock);
+    return (-1);
+    }
+
+  *p_port = ntohs (addr.sin_port);
+  return (sock);
+}
+
+// Stop the threads of a server and release it
+// Must be called with mutex_start locked.
+static void
+srq_shutdown (Vxi11SrqServer *p_srv)
+{
+  pthread_mutex_lock (&mutex_srq);
+  p_srv->b_stop = true;
+  pthread_cond_broadcast (&cond_work);
+  pthread_mutex_unlock (&mutex_srq);
+
+  if (p_srv->b_io) {
+    char c_wake = 0;
+    while (write (p_srv->a_fd_wake[1], &c_wake, 1) < 0 && errno == EINTR)
+      ;
+    pthread_join (p_srv->pthread_io, 0);
+    }
+  for (size_t i=0; i < p_srv->a_pthread.size (); i++)
+    pthread_join (p_srv->a_pthread[i], 0);
+
+  pthread_mutex_lock (&mutex_srq);
+  if (p_server == p_srv)
+    p_server = 0;
+  pthread_cond_broadcast (&cond_idle);  // For vxi11_srq_forget()
+  pthread_mutex_unlock (&mutex_srq);
+
+  for (std::map<int, Vxi11SrqConn>::iterator it = p_srv->conns.begin ();
+       it != p_srv->conns.end (); ++it)
+    close (it->first);
+  int a_fd[5] = {p_srv->sock_tcp, p_srv->sock_udp, p_srv->a_fd_wake[0],
+                 p_srv->a_fd_wake[1], p_srv->fd_epoll};
+  for (int i=0; i < 5; i++)
+    if (a_fd[i] >= 0)
+      close (a_fd[i]);
+
+  delete p_srv;
+}
+
+// ***************************************************************************
+// vxi11_srq_start - Start the SRQ server, or add a user to it
+//
+// Parameters:
+// 1. pfn_srq    - Function called with the handle of each SRQ
+// 2. cnt_worker - Number of threads calling pfn_srq, at least 1
+//                 Only used when the server is started.
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int
+vxi11_srq_start (void (*pfn_srq) (const char *ac_handle, int cnt_handle),
+                 int cnt_worker)
+{
+  pthread_mutex_lock (&mutex_start);
+  if (p_server) {
+    p_server->cnt_user++;
+    pthread_mutex_unlock (&mutex_start);
+    return (0);
+    }
+
+  Vxi11SrqServer *p_srv = new Vxi11SrqServer;
+  p_srv->cnt_user = 1;
+  p_srv->pfn_srq = pfn_srq;
+  p_srv->port_tcp = 0;
+  p_srv->port_udp = 0;
+  p_srv->a_fd_wake[0] = -1;
+  p_srv->a_fd_wake[1] = -1;
+  p_srv->fd_epoll = -1;
+  p_srv->b_io = false;
+  p_srv->b_stop = false;
+
+  // Sockets of the interrupt channels
+  p_srv->sock_tcp = srq_socket (SOCK_STREAM, &p_srv->port_tcp);
+  p_srv->sock_udp = srq_socket (SOCK_DGRAM, &p_srv->port_udp);
+  bool b_err = (p_srv->sock_tcp < 0 || p_srv->sock_udp < 0 ||
+                pipe (p_srv->a_fd_wake));
+#ifdef __linux__
+  if (!b_err) {
+    p_srv->fd_epoll = epoll_create1 (EPOLL_CLOEXEC);
+    b_err = (p_srv->fd_epoll < 0 ||
+             srq_watch (p_srv, p_srv->a_fd_wake[0]) ||
+             srq_watch (p_srv, p_srv->sock_tcp) ||
+             srq_watch (p_srv, p_srv->sock_udp));
+    }
+#endif
+  if (b_err) {
+    Vxi11Common::log_err ("Vxi11 SRQ server error: could not create "
+                          "sockets: %s.\n", strerror (errno));
+    srq_shutdown (p_srv);
+    pthread_mutex_unlock (&mutex_start);
+    return (1);
+    }
+
+  pthread_mutex_lock (&mutex_srq);
+  p_server = p_srv;
+  pthread_mutex_unlock (&mutex_srq);
+
+  // Threads
+  p_srv->b_io = !pthread_create (&p_srv->pthread_io, NULL, srq_fn_io, p_srv);
+  b_err = !p_srv->b_io;
+  if (cnt_worker < 1)
+    cnt_worker = 1;
+  for (int i=0; i < cnt_worker && !b_err; i++) {
+    pthread_t pthread;
+    b_err = (pthread_create (&pthread, NULL, srq_fn_worker, p_srv) != 0);
+    if (!b_err)
+      p_srv->a_pthread.push_back (pthread);
+    }
+  if (b_err) {
+    Vxi11Common::log_err ("Vxi11 SRQ server error: could not start "
+                          "threads.\n");
+    srq_shutdown (p_srv);
+    pthread_mutex_unlock (&mutex_start);
+    return (1);
+    }
+
+  pthread_mutex_unlock (&mutex_start);
+  return (0);
+}
+
+// ***************************************************************************
+// vxi11_srq_stop - Remove a user of the SRQ server, stop it after the last
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void
+vxi11_srq_stop (void)
+{
+  pthread_mutex_lock (&mutex_start);
+  if (p_server && !--p_server->cnt_user)
+    srq_shutdown (p_server);
+  pthread_mutex_unlock (&mutex_start);
+}
+
+// ***************************************************************************
+// vxi11_srq_port - Get the port of the SRQ server
+//
+// Parameters:
+// 1. b_udp - false = TCP port
+//            true  = UDP port
+//
+// Returns: Port, 0 if the server is not running
+// ***************************************************************************
+  int
+vxi11_srq_port (bool b_udp)
+{
+  pthread_mutex_lock (&mutex_srq);
+  int port = (!p_server) ? 0 : (b_udp) ? p_server->port_udp :
+                                         p_server->port_tcp;
+  pthread_mutex_unlock (&mutex_srq);
+  return (port);
+}
+
+// ***************************************************************************
+// vxi11_srq_post - Queue an SRQ for a handle
+//
+// Parameters:
+// 1. ac_handle  - Handle given to the device by enable_srq()
+// 2. cnt_handle - Number of bytes in ac_handle
+//
+// Returns: None
+//
+// Notes: Used by HiSLIP links for AsyncServiceRequest.
+// ***************************************************************************
+  void
+vxi11_srq_post (const char *ac_handle, int cnt_handle)
+{
+  pthread_mutex_lock (&mutex_srq);
+  if (p_server && !p_server->b_stop)
+    srq_queue (p_server, std::string (ac_handle, cnt_handle));
+  pthread_mutex_unlock (&mutex_srq);
+}
+
+// ***************************************************************************
+// vxi11_srq_forget - Drop the queued SRQ of a handle, and wait for the SRQ
+//                    function running for it
+//
+// Parameters:
+// 1. ac_handle  - Handle given to the device by enable_srq()
+// 2. cnt_handle - Number of bytes in ac_handle
+//
+// Returns: None
+//
+// Notes: Called when a link is closed, so that the SRQ function is not
+//        called for it afterward.  Does not wait if called by the SRQ
+//        function of the handle itself.
+// ***************************************************************************
+  void
+vxi11_srq_forget (const char *ac_handle, int cnt_handle)
+{
+  std::string s_handle (ac_handle, cnt_handle);
+
+  pthread_mutex_lock (&mutex_srq);
+  for (;;) {
+    if (!p_server)
+      break;
+    std::map<std::string, Vxi11SrqLink>::iterator it =
+      p_server->links.find (s_handle);
+    if (it == p_server->links.end ())
+      break;
+
+    Vxi11SrqLink &link = it->second;
+    link.b_again = false;
+    if (link.b_queued) {
+      std::deque<std::string> &a_s_ready = p_server->a_s_ready;
+      a_s_ready.erase (std::find (a_s_ready.begin (), a_s_ready.end (),
+                                  s_handle));
+      link.b_queued = false;
+      }
+    if (!link.b_running) {
+      p_server->links.erase (it);
+      break;
+      }
+    if (pthread_equal (link.pthread, pthread_self ()))
+      break;                            // Called by the SRQ function
+    pthread_cond_wait (&cond_idle, &mutex_srq);
+    }
+  pthread_mutex_unlock (&mutex_srq);
+}
+
+// ***************************************************************************
+// Handle table
+//
+// The entries are in chunks that are allocated when first needed and never
+// freed, so vxi11_srq_handle_find() can read them without a lock while
+// other threads add entries.  The generation of an entry is odd while it
+// is used; it is incremented when the entry is added and again when it is
+// deleted, so a handle of a deleted entry never matches again.
+// ***************************************************************************
+
+// Entries per chunk, and most chunks
+static const unsigned CNT_SLOT_CHUNK = 1024;
+static const unsigned CNT_CHUNK_MAX = 1024;
+
+// Entry of the handle table
+struct Vxi11SrqSlot {
+  void *p_obj;                          // Object, valid while gen is odd
+  unsigned gen;                         // Generation
+  unsigned idx_next;                    // Next free entry + 1, 0 if none
+};
+
+static Vxi11SrqSlot *a_p_chunk[CNT_CHUNK_MAX]; // Chunks, null if not yet used
+static unsigned cnt_slot = 0;           // Entries in the chunks so far
+static unsigned idx_free = 0;           // First free entry + 1, 0 if none
+
+// Guards the free list and the addition of chunks
+static pthread_mutex_t mutex_handle = PTHREAD_MUTEX_INITIALIZER;
+
+// Get the entry of an index, null if its chunk is not allocated
+static Vxi11SrqSlot *
+srq_slot (unsigned idx)
+{
+  if (idx / CNT_SLOT_CHUNK >= CNT_CHUNK_MAX)
+    return (0);
+  Vxi11SrqSlot *p_chunk =
+    __atomic_load_n (&a_p_chunk[idx / CNT_SLOT_CHUNK], __ATOMIC_ACQUIRE);
+  return ((p_chunk) ? &p_chunk[idx % CNT_SLOT_CHUNK] : 0);
+}
+
+// Decode a handle into the index and generation of its entry
+static bool
+srq_handle_decode (const char *ac_handle, int cnt_handle, unsigned *p_idx,
+                   unsigned *p_gen)
+{
+  if (cnt_handle != VXI11_SRQ_HANDLE_LEN)
+    return (false);
+  unsigned a_val[2];
+  memcpy (a_val, ac_handle, VXI11_SRQ_HANDLE_LEN);
+  *p_idx = ntohl (a_val[0]);
+  *p_gen = ntohl (a_val[1]);
+  return (true);
+}
+
+// ***************************************************************************
+// vxi11_srq_handle_new - Add an object to the handle table
+//
+// Parameters:
+// 1. p_obj     - Object, returned by vxi11_srq_handle_find()
+// 2. ac_handle - Returns the handle, VXI11_SRQ_HANDLE_LEN bytes
+//
+// Returns: 0 = no error
+//          1 = table full
+// ***************************************************************************
+  int
+vxi11_srq_handle_new (void *p_obj, char *ac_handle)
+{
+  pthread_mutex_lock (&mutex_handle);
+
+  // Use a free entry, or add one at the end
+  unsigned idx;
+  Vxi11SrqSlot *p_slot;
+  if (idx_free) {
+    idx = idx_free - 1;
+    p_slot = srq_slot (idx);
+    idx_free = p_slot->idx_next;
+    }
+  else {
+    if (cnt_slot == CNT_SLOT_CHUNK * CNT_CHUNK_MAX) {
+      pthread_mutex_unlock (&mutex_handle);
+      Vxi11Common::log_err ("Vxi11 SRQ server error: too many handles.\n");
+      return (1);
+      }
+    idx = cnt_slot++;
+    if (!(idx % CNT_SLOT_CHUNK)) {
+      Vxi11SrqSlot *p_chunk = new Vxi11SrqSlot[CNT_SLOT_CHUNK];
+      memset (p_chunk, 0, CNT_SLOT_CHUNK * sizeof (Vxi11SrqSlot));
+      __atomic_store_n (&a_p_chunk[idx / CNT_SLOT_CHUNK], p_chunk,
+                        __ATOMIC_RELEASE);
+      }
+    p_slot = srq_slot (idx);
+    }
+
+  // Store the object before the generation shows the entry is used
+  __atomic_store_n (&p_slot->p_obj, p_obj, __ATOMIC_RELAXED);
+  unsigned gen = p_slot->gen + 1;
+  __atomic_store_n (&p_slot->gen, gen, __ATOMIC_RELEASE);
+  pthread_mutex_unlock (&mutex_handle);
+
+  unsigned a_val[2] = {htonl (idx), htonl (gen)};
+  memcpy (ac_handle, a_val, VXI11_SRQ_HANDLE_LEN);
+  return (0);
+}
+
+// ***************************************************************************
+// vxi11_srq_handle_delete - Remove a handle from the handle table
+//
+// Parameters:
+// 1. ac_handle  - Handle from vxi11_srq_handle_new()
+// 2. cnt_handle - Number of bytes in ac_handle
+//
+// Returns: None
+//
+// Notes: vxi11_srq_handle_find() may still return the object to a thread
+//        that was already in it.  Call vxi11_srq_forget() after this
+//        function to wait for the SRQ function using it.
+// ***************************************************************************
+  void
+vxi11_srq_handle_delete (const char *ac_handle, int cnt_handle)
+{
+  unsigned idx, gen;
+  if (!srq_handle_decode (ac_handle, cnt_handle, &idx, &gen))
+    return;
+
+  pthread_mutex_lock (&mutex_handle);
+  Vxi11SrqSlot *p_slot = (idx < cnt_slot) ? srq_slot (idx) : 0;
+  if (p_slot && p_slot->gen == gen) {
+    __atomic_store_n (&p_slot->gen, gen + 1, __ATOMIC_RELEASE);
+    __atomic_store_n (&p_slot->p_obj, (void *)0, __ATOMIC_RELAXED);
+    p_slot->idx_next = idx_free;
+    idx_free = idx + 1;
+    }
+  pthread_mutex_unlock (&mutex_handle);
+}
+
+// ***************************************************************************
+// vxi11_srq_handle_find - Get the object of a handle
+//
+// Parameters:
+// 1. ac_handle  - Handle received with an SRQ
+// 2. cnt_handle - Number of bytes in ac_handle
+//
+// Returns: Object given to vxi11_srq_handle_new(), null if the handle was
+//          deleted or is not a handle of the table
+//
+// Notes: Takes no lock.  The generation is read again after the object, so
+//        an entry deleted or used again meanwhile is not returned.
+// ***************************************************************************
+  void *
+vxi11_srq_handle_find (const char *ac_handle, int cnt_handle)
+{
+  unsigned idx, gen;
+  if (!srq_handle_decode (ac_handle, cnt_handle, &idx, &gen) || !(gen & 1))
+    return (0);
+
+  Vxi11SrqSlot *p_slot = srq_slot (idx);
+  if (!p_slot || __atomic_load_n (&p_slot->gen, __ATOMIC_ACQUIRE) != gen)
+    return (0);
+  void *p_obj = __atomic_load_n (&p_slot->p_obj, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  if (__atomic_load_n (&p_slot->gen, __ATOMIC_RELAXED) != gen)
+    return (0);
+  return (p_obj);
+}
+
+// ***************************************************************************
+// Vxi11SrqWaiter constructor - No SRQ received yet
+// ***************************************************************************
+  Vxi11SrqWaiter::
+Vxi11SrqWaiter (void)
+{
+  pthread_mutex_init (&_mutex, NULL);
+  pthread_cond_init (&_cond, NULL);
+  _cnt_srq = 0;
+}
+
+// ***************************************************************************
+// Vxi11SrqWaiter destructor
+// ***************************************************************************
+  Vxi11SrqWaiter::
+~Vxi11SrqWaiter ()
+{
+  pthread_cond_destroy (&_cond);
+  pthread_mutex_destroy (&_mutex);
+}
+
+// ***************************************************************************
+// Vxi11SrqWaiter::post - Count an SRQ and wake up the threads waiting
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Called by the SRQ function before the SRQ handler of the link.
+// ***************************************************************************
+  void Vxi11SrqWaiter::
+post (void)
+{
+  pthread_mutex_lock (&_mutex);
+  _cnt_srq++;
+  pthread_cond_broadcast (&_cond);
+  pthread_mutex_unlock (&_mutex);
+}
+
+// ***************************************************************************
+// Vxi11SrqWaiter::count - Get the number of SRQs received so far
+//
+// Parameters: None
+//
+// Returns: Count, to pass to wait()
+// ***************************************************************************
+  unsigned long Vxi11SrqWaiter::
+count (void)
+{
+  pthread_mutex_lock (&_mutex);
+  unsigned long cnt_srq = _cnt_srq;
+  pthread_mutex_unlock (&_mutex);
+  return (cnt_srq);
+}
+
+// ***************************************************************************
+// Vxi11SrqWaiter::wait - Wait for an SRQ after count() returned cnt_srq
+//
+// Parameters:
+// 1. cnt_srq   - Value of count() before checking the state of the device
+// 2. d_timeout - Longest wait in seconds, < 0 for no limit
+//
+// Returns: true  = an SRQ was received since count() returned cnt_srq
+//          false = timed out
+//
+// Notes: Taking the count before reading the status byte, and waiting for
+//        it to change, does not miss an SRQ received in between.
+// ***************************************************************************
+  bool Vxi11SrqWaiter::
+wait (unsigned long cnt_srq, double d_timeout)
+{
+  // pthread_cond_timedwait() uses CLOCK_REALTIME
+  timespec ts;
+  clock_gettime (CLOCK_REALTIME, &ts);
+  long long t_end_ns = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec +
+                       (long long)(d_timeout * 1e9);
+  ts.tv_sec = t_end_ns / 1000000000LL;
+  ts.tv_nsec = t_end_ns % 1000000000LL;
+
+  pthread_mutex_lock (&_mutex);
+  int err = 0;
+  while (_cnt_srq == cnt_srq && !err)
+    err = (d_timeout < 0) ? pthread_cond_wait (&_cond, &_mutex) :
+                            pthread_cond_timedwait (&_cond, &_mutex, &ts);
+  bool b_srq = (_cnt_srq != cnt_srq);
+  pthread_mutex_unlock (&_mutex);
+  return (b_srq);
+}
@@ -0,0 +1,105 @@
+#ifndef VXI11_SRQ_H
+#define VXI11_SRQ_H
+
+// ***************************************************************************
+// vxi11_srq.h - DEVICE_INTR server for SRQ interrupts, for libvxi11.so
+//               library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// The SRQ server receives the device_intr_srq calls of the interrupt
+// channels, which the devices open with create_intr_chan, and runs the SRQ
+// function for each handle on a pool of worker threads:
+//
+//   I/O thread      One thread waits on the TCP and UDP sockets and on every
+//                   TCP connection with epoll (poll on other systems),
+//                   decodes the ONC-RPC calls and queues their handles.
+//                   device_intr_srq has no reply.
+//   Worker threads  Call the SRQ function with the handle.  The calls for
+//                   one handle run one at a time, and an SRQ received while
+//                   one is running runs the function once more after it;
+//                   the other handles run on the other workers, so a slow
+//                   function only delays the SRQs of its own handle.
+//
+// HiSLIP links queue their AsyncServiceRequest with vxi11_srq_post(), so
+// they use the same workers.  Each link also has a Vxi11SrqWaiter, posted
+// before its SRQ handler is called, for threads in wait_for_srq().
+//
+// The handle given to the device by device_enable_srq is an index in a
+// table of objects and the generation of that entry, 8 bytes, instead of a
+// pointer.  An SRQ for an entry that was deleted, or deleted and used
+// again, does not match its generation and is ignored.  The lookup takes
+// no lock, and entries are created and deleted in constant time.
+// ***************************************************************************
+
+#define VXI11_SRQ_HANDLE_LEN    8       // Bytes in a handle of the table
+
+#include <pthread.h>
+
+// ***************************************************************************
+// Vxi11SrqWaiter - Count of the SRQs of one link, for threads waiting for
+//                  the next one
+// ***************************************************************************
+class Vxi11SrqWaiter {
+ private:
+  pthread_mutex_t _mutex;
+  pthread_cond_t _cond;
+  unsigned long _cnt_srq;               // SRQs received so far
+
+ public:
+  Vxi11SrqWaiter (void);
+  ~Vxi11SrqWaiter ();
+
+  // Count an SRQ and wake up the threads waiting
+  void post (void);
+
+  // Get the number of SRQs received so far
+  unsigned long count (void);
+
+  // Wait until the count is no longer cnt_srq, for up to d_timeout seconds,
+  // or without limit if d_timeout < 0
+  // Returns true if an SRQ was received, false if timed out.
+  bool wait (unsigned long cnt_srq, double d_timeout);
+};
+
+// Start the server with cnt_worker threads calling pfn_srq with the handle
+// of each SRQ, or add a user to the server already running
+// Returns 0 if no error.
+int vxi11_srq_start (void (*pfn_srq) (const char *ac_handle, int cnt_handle),
+                     int cnt_worker);
+
+// Remove a user, and stop the server when it was the last one
+// Handles still queued are dropped.  Must not be called by the SRQ function.
+void vxi11_srq_stop (void);
+
+// Get the TCP or UDP port of the server, 0 if not running
+int vxi11_srq_port (bool b_udp);
+
+// Queue an SRQ for a handle, as if received by the server
+// Dropped if the server is not running.
+void vxi11_srq_post (const char *ac_handle, int cnt_handle);
+
+// Drop the queued SRQ of a handle, and wait until the SRQ function is not
+// running for it, unless called by that SRQ function
+void vxi11_srq_forget (const char *ac_handle, int cnt_handle);
+
+// Add p_obj to the handle table, and store its handle to ac_handle, which
+// has room for VXI11_SRQ_HANDLE_LEN bytes
+// Returns 0 if no error, 1 if the table is full.
+int vxi11_srq_handle_new (void *p_obj, char *ac_handle);
+
+// Remove a handle from the table; SRQs for it are then ignored
+void vxi11_srq_handle_delete (const char *ac_handle, int cnt_handle);
+
+// Get the object of a handle, without locking
+// Returns null if the handle is not in the table.
+void *vxi11_srq_handle_find (const char *ac_handle, int cnt_handle);
+
+#endif
@@ -0,0 +1,240 @@
+// ***************************************************************************
+// vxi11_trace.cpp - Tracing of VXI-11 RPCs for libvxi11.so library
+//                   Vxi11TraceChrome writes Chrome trace-event JSON
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Macros to conveniently access the FILE and mutex members of the class.
+// They are defined as void * in the class so that the .h file does not need
+// to include stdio.h and pthread.h.
+#define _p_fp           ((FILE *)_p_file)
+#define _p_mtx          ((pthread_mutex_t *)_p_mutex)
+
+// ***************************************************************************
+// Vxi11Tracer::time_ns - Get monotonic time used for trace timestamps
+//
+// Parameters: None
+//
+// Returns: Time in ns from an arbitrary starting point
+// ***************************************************************************
+  long long Vxi11Tracer::
+time_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome constructor - Do not open output file yet
+// ***************************************************************************
+  Vxi11TraceChrome::
+Vxi11TraceChrome (void)
+{
+  _p_file = 0;                          // No output file yet
+  _p_mutex = new pthread_mutex_t;
+  pthread_mutex_init (_p_mtx, NULL);
+  _t_start_ns = 0;
+  _cnt_event = 0;
+  _cnt_thread = 0;
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome destructor - Close output file if it is open
+//
+// Notes: Remove this object with Vxi11::tracer(0) before destroying it.
+// ***************************************************************************
+  Vxi11TraceChrome::
+~Vxi11TraceChrome ()
+{
+  close ();
+  pthread_mutex_destroy (_p_mtx);
+  delete _p_mtx;
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::open - Open the trace output file
+//
+// Parameters:
+// 1. s_file - Name of the JSON file to write
+//
+// Returns: 0 = no error
+//          1 = error
+//
+// Notes: Typical use is
+//          Vxi11TraceChrome trace;
+//          trace.open ("vxi11_trace.json");
+//          Vxi11::tracer (&trace);
+//          ...
+//          Vxi11::tracer (0);
+//          trace.close ();
+// ***************************************************************************
+  int Vxi11TraceChrome::
+open (const char *s_file)
+{
+  close ();                             // Close previous file, if any
+
+  if (!s_file) {
+    Vxi11::log_err ("Vxi11TraceChrome::open error: null file name.\n");
+    return (1);
+    }
+
+  FILE *p_file = fopen (s_file, "w");
+  if (!p_file) {
+    Vxi11::log_err ("Vxi11TraceChrome::open error: could not open %s.\n",
+                    s_file);
+    return (1);
+    }
+
+  pthread_mutex_lock (_p_mtx);
+  _p_file = p_file;
+  _t_start_ns = time_ns ();
+  _cnt_event = 0;
+  fputs ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", _p_fp);
+  pthread_mutex_unlock (_p_mtx);
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::close - Finish and close the trace output file
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = error
+// ***************************************************************************
+  int Vxi11TraceChrome::
+close (void)
+{
+  pthread_mutex_lock (_p_mtx);
+
+  int err = 0;
+  if (_p_file) {
+    fputs ("\n]}\n", _p_fp);
+    err = (fclose (_p_fp)) ? 1 : 0;
+    _p_file = 0;
+    }
+
+  pthread_mutex_unlock (_p_mtx);
+
+  return (err);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::_thread_id - Get a small integer ID for calling thread
+//
+// Parameters: None
+//
+// Returns: Thread ID, starting at 1 for the first thread that is traced
+//
+// Notes: Must be called with the mutex locked.
+// ***************************************************************************
+  int Vxi11TraceChrome::
+_thread_id (void)
+{
+  static __thread int thread_id = 0;    // ID of this thread, 0 = not assigned
+  if (!thread_id)
+    thread_id = ++_cnt_thread;
+  return (thread_id);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::_write_slice - Write one complete ("X") event
+//
+// Parameters:
+// 1. s_name     - Name of the slice
+// 2. s_cat      - Category of the slice
+// 3. t_begin_ns - Start time, from Vxi11Tracer::time_ns()
+// 4. t_end_ns   - End time, from Vxi11Tracer::time_ns()
+// 5. s_args     - JSON object with the slice arguments, or null
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TraceChrome::
+_write_slice (const char *s_name, const char *s_cat, long long t_begin_ns,
+              long long t_end_ns, const char *s_args)
+{
+  pthread_mutex_lock (_p_mtx);
+
+  if (_p_file) {
+    // Chrome trace timestamps are in microseconds
+    fprintf (_p_fp, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+             "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+             (_cnt_event) ? "," : "", s_name, s_cat,
+             (t_begin_ns - _t_start_ns) / 1000.0,
+             (t_end_ns - t_begin_ns) / 1000.0, _thread_id ());
+    if (s_args)
+      fprintf (_p_fp, ",\"args\":%s", s_args);
+    fputs ("}", _p_fp);
+    _cnt_event++;
+    }
+
+  pthread_mutex_unlock (_p_mtx);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::rpc_begin - Called at the start of each RPC
+//
+// Parameters:
+// 1. event - Description of the RPC
+//
+// Returns: None
+//
+// Notes: Nothing is written here; the whole RPC is written as one slice
+//        by rpc_end().
+// ***************************************************************************
+  void Vxi11TraceChrome::
+rpc_begin (const Vxi11TraceEvent &event)
+{
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::rpc_end - Called at the end of each RPC
+//
+// Parameters:
+// 1. event - Description of the RPC
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TraceChrome::
+rpc_end (const Vxi11TraceEvent &event)
+{
+  char s_args[512];
+  snprintf (s_args, sizeof (s_args),
+            "{\"device\":\"%s\",\"lid\":%ld,\"xid\":%u,\"send\":%d,"
+            "\"recv\":%d,\"err\":%d}",
+            (event.s_device_addr) ? event.s_device_addr : "", event.lid,
+            event.xid, event.cnt_send, event.cnt_recv, event.err);
+
+  _write_slice (event.s_proc, "rpc", event.t_begin_ns, event.t_end_ns,
+                s_args);
+}
+
+// ***************************************************************************
+// Vxi11TraceChrome::mutex_wait - Called after waiting for the RPC mutex
+//
+// Parameters:
+// 1. t_begin_ns - Time the wait started
+// 2. t_end_ns   - Time the mutex was locked
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TraceChrome::
+mutex_wait (long long t_begin_ns, long long t_end_ns)
+{
+  _write_slice ("mutex wait", "lock", t_begin_ns, t_end_ns, 0);
+}
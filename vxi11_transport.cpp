@@ -0,0 +1,348 @@
+// ***************************************************************************
+// vxi11_transport.cpp - Transport of the VXI-11 core channel for libvxi11.so
+//                       library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_transport.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+// ***************************************************************************
+// Vxi11Transport constructor - Clear the counters
+// ***************************************************************************
+  Vxi11Transport::
+Vxi11Transport (void)
+{
+  stats_reset ();
+}
+
+// ***************************************************************************
+// Vxi11Transport::call - Call a procedure of the DEVICE_CORE program
+//
+// Parameters:
+// 1. proc     - Procedure number, for example device_write
+// 2. xdr_args - XDR routine of the arguments
+// 3. p_args   - Arguments
+// 4. xdr_res  - XDR routine of the results
+// 5. p_res    - Returns the results; must be cleared before the call, and
+//               released with free_result() after use
+//
+// Returns: RPC_SUCCESS = reply received
+//          Other       = no reply, see error()
+//
+// Notes: Counts and times the call for stats().
+// ***************************************************************************
+  enum clnt_stat Vxi11Transport::
+call (u_long proc, xdrproc_t xdr_args, void *p_args, xdrproc_t xdr_res,
+      void *p_res)
+{
+  long long t_begin_ns = Vxi11Tracer::time_ns ();
+  enum clnt_stat stat = _call (proc, xdr_args, p_args, xdr_res, p_res);
+  long long t_ns = Vxi11Tracer::time_ns () - t_begin_ns;
+
+  _stats.cnt_call++;
+  if (stat != RPC_SUCCESS)
+    _stats.cnt_fail++;
+  _stats.t_call_ns += t_ns;
+  _stats.t_last_ns = t_ns;
+  if (t_ns > _stats.t_call_max_ns)
+    _stats.t_call_max_ns = t_ns;
+
+  return (stat);
+}
+
+// ***************************************************************************
+// Vxi11Transport::cancel - End the call in progress
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Called from another thread than the one in call().  The transport
+//        can only be closed after that.
+// ***************************************************************************
+  void Vxi11Transport::
+cancel (void)
+{
+  __atomic_add_fetch (&_stats.cnt_cancel, 1, __ATOMIC_RELAXED);
+  _cancel ();
+}
+
+// ***************************************************************************
+// Vxi11Transport::stats_reset - Clear the counters
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Transport::
+stats_reset (void)
+{
+  memset (&_stats, 0, sizeof (_stats));
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc constructor - Use an RPC client
+//
+// Parameters:
+// 1. p_client - RPC client for the DEVICE_CORE program, destroyed by
+//               close(); null to create one with open()
+// ***************************************************************************
+  Vxi11TransportRpc::
+Vxi11TransportRpc (CLIENT *p_client)
+{
+  _p_client = p_client;
+  _s_error[0] = 0;
+  _sock = -1;
+  _b_cancel = false;
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc destructor - Destroy the RPC client
+// ***************************************************************************
+  Vxi11TransportRpc::
+~Vxi11TransportRpc ()
+{
+  close ();
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::open - Create a tirpc client for the core channel
+//
+// Parameters:
+// 1. s_host - Host name or IP address of the device
+// 2. port   - TCP port of the core channel, 0 to ask the portmapper of the
+//             device
+//
+// Returns: 0 = no error
+//          1 = error, see error()
+//
+// Notes: Nothing is done if an RPC client was given to the constructor.
+// ***************************************************************************
+  int Vxi11TransportRpc::
+open (const char *s_host, int port)
+{
+  if (_p_client) {
+    _sock = _fd_client ();
+    return (0);
+    }
+
+  if (port) {
+    hostent *p_hostent = gethostbyname (s_host);
+    if (!p_hostent) {
+      snprintf (_s_error, sizeof (_s_error), "unknown host %s", s_host);
+      return (1);
+      }
+    sockaddr_in sockaddr = {0};
+    sockaddr.sin_family = AF_INET;
+    sockaddr.sin_port = htons (port);
+    sockaddr.sin_addr.s_addr = *(unsigned int *)(p_hostent->h_addr_list[0]);
+    int sock = RPC_ANYSOCK;
+    _p_client = clnttcp_create (&sockaddr, DEVICE_CORE, DEVICE_CORE_VERSION,
+                                &sock, 0, 0);
+    }
+  else {
+    const char *s_tcp = "tcp";
+    _p_client = clnt_create ((char *)s_host, DEVICE_CORE,
+                             DEVICE_CORE_VERSION, (char *)s_tcp);
+    }
+
+  if (!_p_client) {
+    // The message starts with the prefix given, which is not wanted here
+    const char *s_err = clnt_spcreateerror ((char *)"");
+    snprintf (_s_error, sizeof (_s_error), "%s",
+              (!strncmp (s_err, ": ", 2)) ? s_err + 2 : s_err);
+    _s_error[strcspn (_s_error, "\n")] = 0;
+    return (1);
+    }
+
+  _sock = _fd_client ();
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::close - Destroy the RPC client
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportRpc::
+close (void)
+{
+  if (_p_client)
+    clnt_destroy (_p_client);
+  _p_client = 0;
+  _sock = -1;
+  _b_cancel = false;
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::_call - Call a procedure with the RPC client
+//
+// Parameters: See Vxi11Transport::call()
+//
+// Returns: RPC status
+//
+// Notes: The RPC client uses the timeout set with CLSET_TIMEOUT, not the
+//        one given to clnt_call().
+// ***************************************************************************
+  enum clnt_stat Vxi11TransportRpc::
+_call (u_long proc, xdrproc_t xdr_args, void *p_args, xdrproc_t xdr_res,
+       void *p_res)
+{
+  if (!_p_client) {
+    snprintf (_s_error, sizeof (_s_error), "not open");
+    return (RPC_FAILED);
+    }
+  if (__atomic_load_n (&_b_cancel, __ATOMIC_ACQUIRE)) {
+    snprintf (_s_error, sizeof (_s_error), "cancelled");
+    return (RPC_CANTSEND);
+    }
+
+  struct timeval timeval_timeout = {25, 0};
+  enum clnt_stat stat = clnt_call (_p_client, proc, xdr_args, (char *)p_args,
+                                   xdr_res, (char *)p_res, timeval_timeout);
+  if (stat != RPC_SUCCESS)
+    _s_error[0] = 0;                    // Made by error() when needed
+  return (stat);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::free_result - Release the memory of results
+//
+// Parameters:
+// 1. xdr_res - XDR routine of the results
+// 2. p_res   - Results of call()
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportRpc::
+free_result (xdrproc_t xdr_res, void *p_res)
+{
+  if (_p_client)
+    clnt_freeres (_p_client, xdr_res, (char *)p_res);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::timeout - Set the time to wait for a reply
+//
+// Parameters:
+// 1. timeout_ms - Timeout, in ms
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportRpc::
+timeout (int timeout_ms)
+{
+  if (!_p_client)
+    return;
+  struct timeval timeval_timeout = {timeout_ms / 1000,
+                                    (timeout_ms % 1000) * 1000};
+  clnt_control (_p_client, CLSET_TIMEOUT, (char *)(&timeval_timeout));
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::_cancel - End the call in progress
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Shuts down the socket of the RPC client, so the call in progress
+//        returns with an error, and the next calls fail without writing to
+//        it, which would raise SIGPIPE.  The socket read by open() is used:
+//        tirpc waits for the call in progress to end before answering
+//        clnt_control().  Nothing is done if the client has no socket, for
+//        example when replaying a session.
+// ***************************************************************************
+  void Vxi11TransportRpc::
+_cancel (void)
+{
+  __atomic_store_n (&_b_cancel, true, __ATOMIC_RELEASE);
+  if (_sock >= 0)
+    shutdown (_sock, SHUT_RDWR);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::fd - Get the socket of the RPC client
+//
+// Parameters: None
+//
+// Returns: Socket, -1 if none
+// ***************************************************************************
+  int Vxi11TransportRpc::
+fd (void)
+{
+  return ((_sock >= 0) ? _sock : _fd_client ());
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::_fd_client - Private function to ask the RPC client for
+//                                 its socket
+//
+// Parameters: None
+//
+// Returns: Socket, -1 if none
+//
+// Notes: Waits for a call in progress on another thread to end.
+// ***************************************************************************
+  int Vxi11TransportRpc::
+_fd_client (void)
+{
+  int sock = -1;
+  if (!_p_client || !clnt_control (_p_client, CLGET_FD, (char *)&sock))
+    return (-1);
+  return (sock);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::xid_last - Get the transaction ID of the last call
+//
+// Parameters: None
+//
+// Returns: Transaction ID, 0 if not open
+//
+// Notes: The ID is the one the RPC client chose for the call, read back
+//        after it; it is not set, so the client never reuses an ID.
+// ***************************************************************************
+  unsigned int Vxi11TransportRpc::
+xid_last (void)
+{
+  if (!_p_client)
+    return (0);
+  u_int32_t xid = 0;
+  clnt_control (_p_client, CLGET_XID, (char *)&xid);
+  return (xid);
+}
+
+// ***************************************************************************
+// Vxi11TransportRpc::error - Get a description of the last error
+//
+// Parameters: None
+//
+// Returns: Description, for example "RPC: Unable to receive; errno = ..."
+// ***************************************************************************
+  const char *Vxi11TransportRpc::
+error (void)
+{
+  if (!_s_error[0] && _p_client) {
+    const char *s_err = clnt_sperror (_p_client, (char *)"");
+    snprintf (_s_error, sizeof (_s_error), "%s",
+              (!strncmp (s_err, ": ", 2)) ? s_err + 2 : s_err);
+    _s_error[strcspn (_s_error, "\n")] = 0;
+    }
+  return (_s_error);
+}
@@ -0,0 +1,158 @@
+#ifndef VXI11_TRANSPORT_H
+#define VXI11_TRANSPORT_H
+
+// ***************************************************************************
+// vxi11_transport.h - Transport of the VXI-11 core channel for libvxi11.so
+//                     library
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// The Vxi11 class makes every call of the DEVICE_CORE program through a
+// Vxi11Transport.  The procedure numbers, arguments and results are those of
+// vxi11_rpc.h, so a transport only has to carry them:
+//
+//   Vxi11TransportRpc   ONC-RPC client (CLIENT) from tirpc, or any other
+//                       RPC client such as the HiSLIP and raw socket
+//                       clients, or the session recorder and replayer
+//
+// Other transports (an in-memory fake, a different codec, another protocol)
+// derive from Vxi11Transport and are passed to Vxi11::open().
+//
+// Results are decoded into storage of the caller, which must be cleared
+// before call() and released with free_result() after use.  Unlike the
+// rpcgen stubs, which return a static buffer per procedure, the results of
+// different links do not share any storage.
+// ***************************************************************************
+
+#include <rpc/rpc.h>
+
+// Counters of a transport, see Vxi11Transport::stats()
+struct Vxi11TransportStats {
+  unsigned long cnt_call;               // Calls made
+  unsigned long cnt_fail;               // Calls with no reply
+  unsigned long cnt_cancel;             // Calls of cancel()
+  long long t_call_ns;                  // Total time in calls, in ns
+  long long t_call_max_ns;              // Longest call, in ns
+  long long t_last_ns;                  // Time of the last call, in ns
+};
+
+// ***************************************************************************
+// Vxi11Transport - Interface to the channel carrying the DEVICE_CORE calls
+// ***************************************************************************
+class Vxi11Transport {
+ private:
+  Vxi11TransportStats _stats;           // Counters updated by call()
+
+ protected:
+  // Make one call, see call()
+  virtual enum clnt_stat _call (u_long proc, xdrproc_t xdr_args,
+                                void *p_args, xdrproc_t xdr_res,
+                                void *p_res) = 0;
+
+  // End the call in progress, see cancel()
+  virtual void _cancel (void) = 0;
+
+ public:
+  Vxi11Transport (void);
+  virtual ~Vxi11Transport () {}
+
+  // Connect to the core channel of the device at s_host
+  // port = TCP port, 0 = default port of the transport
+  virtual int open (const char *s_host, int port) = 0;
+
+  // Disconnect, nothing is done if not connected
+  virtual void close (void) = 0;
+
+  // Call procedure proc, decoding the reply into p_res
+  // Not thread safe; calls on one transport must be serialized
+  enum clnt_stat call (u_long proc, xdrproc_t xdr_args, void *p_args,
+                       xdrproc_t xdr_res, void *p_res);
+
+  // Call procedure proc without counting it in stats()
+  enum clnt_stat call_uncounted (u_long proc, xdrproc_t xdr_args,
+                                 void *p_args, xdrproc_t xdr_res,
+                                 void *p_res) {
+    return (_call (proc, xdr_args, p_args, xdr_res, p_res));
+    }
+
+  // Release memory allocated in p_res by call()
+  virtual void free_result (xdrproc_t xdr_res, void *p_res) = 0;
+
+  // Set the time to wait for a reply, in ms
+  virtual void timeout (int timeout_ms) = 0;
+
+  // End the call in progress from another thread, without waiting for the
+  // device; the transport can only be closed after that
+  void cancel (void);
+
+  // Get a file descriptor that is readable when a reply is waiting, -1 if
+  // the transport has none
+  virtual int fd (void) { return (-1); }
+
+  // Get the transaction ID of the last call, 0 if not known
+  // The RPC tracer reports it at the end of the call.
+  virtual unsigned int xid_last (void) { return (0); }
+
+  // Get a description of the error of the last call or of open()
+  virtual const char *error (void) = 0;
+
+  // Get/reset the counters
+  const Vxi11TransportStats &stats (void) { return (_stats); }
+  void stats_reset (void);
+};
+
+// ***************************************************************************
+// Vxi11TransportRpc - Transport through an ONC-RPC client
+//
+// Declared final, so BasicVxi11 with this transport type calls it directly
+// instead of through virtual functions.
+// ***************************************************************************
+class Vxi11TransportRpc final : public Vxi11Transport {
+ private:
+  CLIENT *_p_client;                    // RPC client, null if not open
+  char _s_error[256];                   // Description of last error
+  int _sock;                            // Socket of the RPC client, -1 if
+                                        // none, read by open() since the
+                                        // client cannot be asked during a
+                                        // call
+  bool _b_cancel;                       // cancel() called, so the calls
+                                        // fail without writing to the
+                                        // socket shut down
+
+  int _fd_client (void);                // Socket from the RPC client
+
+ protected:
+  virtual enum clnt_stat _call (u_long proc, xdrproc_t xdr_args,
+                                void *p_args, xdrproc_t xdr_res,
+                                void *p_res);
+  virtual void _cancel (void);
+
+ public:
+  // Use p_client, which is destroyed by close(); null to create a tirpc
+  // client with open()
+  Vxi11TransportRpc (CLIENT *p_client = 0);
+  ~Vxi11TransportRpc ();
+
+  // Create a TCP client for DEVICE_CORE, with the portmapper of s_host if
+  // port is 0; nothing is done if the client was given to the constructor
+  virtual int open (const char *s_host, int port);
+  virtual void close (void);
+  virtual void free_result (xdrproc_t xdr_res, void *p_res);
+  virtual void timeout (int timeout_ms);
+  virtual int fd (void);
+  virtual unsigned int xid_last (void);
+  virtual const char *error (void);
+
+  // Get/replace the RPC client, for example to wrap it with a recorder
+  CLIENT *client (void) { return (_p_client); }
+  void client (CLIENT *p_client) { _p_client = p_client; }
+};
+
+#endif
@@ -0,0 +1,1276 @@
+// ***************************************************************************
+// vxi11_uring.cpp - io_uring transport of the VXI-11 core channel for
+//                   libvxi11.so library (Linux only)
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+#include "libvxi11.h"
+#include "vxi11_uring.h"
+#include "vxi11_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <rpc/pmap_clnt.h>
+#include <linux/io_uring.h>
+
+// Macro to conveniently access the __p_ring member of Vxi11Uring
+#define _p_ring         ((Vxi11UringRing *)__p_ring)
+
+// Operation in the user_data of a submission, with the transport pointer
+#define OP_SEND         1
+#define OP_RECV         2
+#define OP_MASK         3
+
+// Fragment header of an RPC record on TCP (RFC 5531 record marking)
+#define RM_LAST         0x80000000u     // Last fragment of the record
+#define RM_LEN          0x7fffffffu     // Length of the fragment
+
+// Largest call record, so that a bad argument cannot use all memory
+static const int LEN_SEND_MAX = 256 * 1024 * 1024;
+
+// Largest reply record, so that a bad fragment header cannot use all memory
+static const int LEN_RECV_MAX = 256 * 1024 * 1024;
+
+// Most epoll events processed per epoll_wait()
+static const int CNT_EVENT_MAX = 64;
+
+// ***************************************************************************
+// Vxi11UringRing - Submission and completion rings mapped from the kernel
+// ***************************************************************************
+struct Vxi11UringRing {
+  void *p_sq;                           // Submission ring
+  size_t len_sq;
+  void *p_cq;                           // Completion ring, may be p_sq
+  size_t len_cq;
+  io_uring_sqe *a_sqe;                  // Submission entries
+  size_t len_sqe;
+
+  unsigned *p_sq_head;                  // Consumed by the kernel
+  unsigned *p_sq_tail;                  // Produced here
+  unsigned *p_sq_mask;
+  unsigned *p_sq_array;
+  unsigned cnt_sq;                      // Number of submission entries
+  unsigned sq_tail;                     // Tail not yet given to the kernel
+  int cnt_to_submit;                    // Entries not yet submitted
+
+  unsigned *p_cq_head;                  // Consumed here
+  unsigned *p_cq_tail;                  // Produced by the kernel
+  unsigned *p_cq_mask;
+  io_uring_cqe *a_cqe;
+};
+
+// ***************************************************************************
+// Vxi11Uring constructor - Set up io_uring, or epoll
+//
+// Parameters:
+// 1. cnt_link_max - Number of links with a registered receive buffer
+// 2. b_uring      - true  = use io_uring if the kernel has it (default)
+//                   false = use epoll
+//
+// Notes: io_uring needs IORING_FEAT_EXT_ARG (Linux 5.11) for the timeout of
+//        io_uring_enter().  If the buffers cannot be registered, for example
+//        because of RLIMIT_MEMLOCK, io_uring is used without them.
+// ***************************************************************************
+  Vxi11Uring::
+Vxi11Uring (int cnt_link_max, bool b_uring)
+{
+  _fd = -1;
+  __p_ring = 0;
+  _ac_buf_fixed = 0;
+  _cnt_buf_fixed = 0;
+  stats_reset ();
+
+  if (cnt_link_max < 1)
+    cnt_link_max = 1;
+  _b_uring = b_uring && !_setup_uring (cnt_link_max);
+
+  if (!_b_uring) {
+    _fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (_fd < 0)
+      Vxi11::log_err ("Vxi11Uring error: epoll_create1: %s.\n",
+                      strerror (errno));
+    }
+}
+
+// ***************************************************************************
+// Vxi11Uring destructor - Release the rings and buffers
+//
+// Notes: The transports using this object must be deleted before.
+// ***************************************************************************
+  Vxi11Uring::
+~Vxi11Uring ()
+{
+  if (_fd >= 0)
+    ::close (_fd);                      // Also unregisters the buffers
+
+  if (_p_ring) {
+    munmap (_p_ring->a_sqe, _p_ring->len_sqe);
+    if (_p_ring->p_cq != _p_ring->p_sq)
+      munmap (_p_ring->p_cq, _p_ring->len_cq);
+    munmap (_p_ring->p_sq, _p_ring->len_sq);
+    delete _p_ring;
+    }
+
+  if (_ac_buf_fixed)
+    munmap (_ac_buf_fixed, size_t (_cnt_buf_fixed) * LEN_BUF_FIXED);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_setup_uring - Set up io_uring and its registered buffers
+//
+// Parameters:
+// 1. cnt_link_max - Number of registered buffers
+//
+// Returns: 0 = no error
+//          1 = io_uring is not available
+// ***************************************************************************
+  int Vxi11Uring::
+_setup_uring (int cnt_link_max)
+{
+  // Each link has at most a send, a receive and their cancellations
+  io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  unsigned cnt_entry = (cnt_link_max < 1024) ? 4 * cnt_link_max : 4096;
+  if (cnt_entry < 8)
+    cnt_entry = 8;
+
+  int fd = syscall (__NR_io_uring_setup, cnt_entry, &params);
+  if (fd < 0)
+    return (1);
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    ::close (fd);
+    return (1);
+    }
+
+  // Map the rings
+  Vxi11UringRing *p_ring = new Vxi11UringRing;
+  memset (p_ring, 0, sizeof (Vxi11UringRing));
+  p_ring->len_sq = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  p_ring->len_cq = params.cq_off.cqes +
+                   params.cq_entries * sizeof (io_uring_cqe);
+  bool b_single = (params.features & IORING_FEAT_SINGLE_MMAP);
+  if (b_single) {
+    if (p_ring->len_cq > p_ring->len_sq)
+      p_ring->len_sq = p_ring->len_cq;
+    p_ring->len_cq = p_ring->len_sq;
+    }
+  p_ring->len_sqe = params.sq_entries * sizeof (io_uring_sqe);
+
+  p_ring->p_sq = mmap (0, p_ring->len_sq, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  p_ring->p_cq = (b_single || p_ring->p_sq == MAP_FAILED) ? p_ring->p_sq :
+                 mmap (0, p_ring->len_cq, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  p_ring->a_sqe = (io_uring_sqe *)mmap (0, p_ring->len_sqe,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, fd,
+                                        IORING_OFF_SQES);
+  if (p_ring->p_sq == MAP_FAILED || p_ring->p_cq == MAP_FAILED ||
+      p_ring->a_sqe == MAP_FAILED) {
+    if (p_ring->a_sqe != MAP_FAILED)
+      munmap (p_ring->a_sqe, p_ring->len_sqe);
+    if (p_ring->p_cq != MAP_FAILED && p_ring->p_cq != p_ring->p_sq)
+      munmap (p_ring->p_cq, p_ring->len_cq);
+    if (p_ring->p_sq != MAP_FAILED)
+      munmap (p_ring->p_sq, p_ring->len_sq);
+    delete p_ring;
+    ::close (fd);
+    return (1);
+    }
+
+  char *p_sq = (char *)p_ring->p_sq;
+  char *p_cq = (char *)p_ring->p_cq;
+  p_ring->p_sq_head = (unsigned *)(p_sq + params.sq_off.head);
+  p_ring->p_sq_tail = (unsigned *)(p_sq + params.sq_off.tail);
+  p_ring->p_sq_mask = (unsigned *)(p_sq + params.sq_off.ring_mask);
+  p_ring->p_sq_array = (unsigned *)(p_sq + params.sq_off.array);
+  p_ring->cnt_sq = params.sq_entries;
+  p_ring->sq_tail = *p_ring->p_sq_tail;
+  p_ring->p_cq_head = (unsigned *)(p_cq + params.cq_off.head);
+  p_ring->p_cq_tail = (unsigned *)(p_cq + params.cq_off.tail);
+  p_ring->p_cq_mask = (unsigned *)(p_cq + params.cq_off.ring_mask);
+  p_ring->a_cqe = (io_uring_cqe *)(p_cq + params.cq_off.cqes);
+
+  _fd = fd;
+  __p_ring = p_ring;
+
+  // Register one receive buffer per link
+  size_t len_buf = size_t (cnt_link_max) * LEN_BUF_FIXED;
+  void *p_buf = mmap (0, len_buf, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p_buf != MAP_FAILED) {
+    iovec *a_iov = new iovec[cnt_link_max];
+    for (int i=0; i < cnt_link_max; i++) {
+      a_iov[i].iov_base = (char *)p_buf + size_t (i) * LEN_BUF_FIXED;
+      a_iov[i].iov_len = LEN_BUF_FIXED;
+      }
+    if (syscall (__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, a_iov,
+                 cnt_link_max) == 0) {
+      _ac_buf_fixed = (char *)p_buf;
+      _cnt_buf_fixed = cnt_link_max;
+      for (int i=cnt_link_max - 1; i >= 0; i--)
+        _a_idx_buf_free.push_back (i);
+      }
+    else
+      munmap (p_buf, len_buf);
+    delete[] a_iov;
+    }
+
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11Uring::stats_reset - Clear the counters
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Uring::
+stats_reset (void)
+{
+  memset (&_stats, 0, sizeof (_stats));
+}
+
+// ***************************************************************************
+// Vxi11Uring::_buf_alloc - Get a registered buffer
+//
+// Parameters: None
+//
+// Returns: Index of the buffer, -1 if none is left
+// ***************************************************************************
+  int Vxi11Uring::
+_buf_alloc (void)
+{
+  if (_a_idx_buf_free.empty ())
+    return (-1);
+  int idx_buf = _a_idx_buf_free.back ();
+  _a_idx_buf_free.pop_back ();
+  return (idx_buf);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_buf_free - Release a registered buffer
+//
+// Parameters:
+// 1. idx_buf - Index from _buf_alloc(), nothing is done if -1
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Uring::
+_buf_free (int idx_buf)
+{
+  if (idx_buf >= 0)
+    _a_idx_buf_free.push_back (idx_buf);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_sqe_get - Get the next submission entry of io_uring
+//
+// Parameters: None
+//
+// Returns: Cleared entry, type io_uring_sqe*, or null if the ring is full
+//
+// Notes: The entries are given to the kernel by the next _enter().  If the
+//        ring is full, the entries so far are submitted first.
+// ***************************************************************************
+  void *Vxi11Uring::
+_sqe_get (void)
+{
+  Vxi11UringRing *p_ring = _p_ring;
+  if (p_ring->sq_tail - __atomic_load_n (p_ring->p_sq_head, __ATOMIC_ACQUIRE)
+      >= p_ring->cnt_sq) {
+    _enter (p_ring->cnt_to_submit, 0, 0);
+    if (p_ring->sq_tail -
+        __atomic_load_n (p_ring->p_sq_head, __ATOMIC_ACQUIRE) >=
+        p_ring->cnt_sq)
+      return (0);
+    }
+
+  unsigned idx = p_ring->sq_tail & *p_ring->p_sq_mask;
+  io_uring_sqe *p_sqe = &p_ring->a_sqe[idx];
+  memset (p_sqe, 0, sizeof (io_uring_sqe));
+  p_ring->p_sq_array[idx] = idx;
+  p_ring->sq_tail++;
+  p_ring->cnt_to_submit++;
+  return (p_sqe);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_enter - Submit entries and wait for completions
+//
+// Parameters:
+// 1. cnt_submit - Number of entries to submit
+// 2. cnt_wait   - Number of completions to wait for, 0 to not wait
+// 3. t_end_ns   - Time to stop waiting, from Vxi11Tracer::time_ns()
+//
+// Returns: >= 0 = number of entries submitted
+//          < 0  = -errno, -ETIME if the wait timed out
+// ***************************************************************************
+  int Vxi11Uring::
+_enter (int cnt_submit, int cnt_wait, long long t_end_ns)
+{
+  Vxi11UringRing *p_ring = _p_ring;
+  __atomic_store_n (p_ring->p_sq_tail, p_ring->sq_tail, __ATOMIC_RELEASE);
+
+  unsigned flags = 0;
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  memset (&arg, 0, sizeof (arg));
+  if (cnt_wait) {
+    long long t_ns = t_end_ns - Vxi11Tracer::time_ns ();
+    if (t_ns < 0)
+      t_ns = 0;
+    ts.tv_sec = t_ns / 1000000000;
+    ts.tv_nsec = t_ns % 1000000000;
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    }
+
+  _stats.cnt_syscall++;
+  int ret = syscall (__NR_io_uring_enter, _fd, cnt_submit, cnt_wait, flags,
+                     (cnt_wait) ? &arg : 0, (cnt_wait) ? sizeof (arg) : 0);
+  if (ret < 0)
+    ret = -errno;
+
+  p_ring->cnt_to_submit = p_ring->sq_tail -
+    __atomic_load_n (p_ring->p_sq_head, __ATOMIC_ACQUIRE);
+  return (ret);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_reap - Process all completions of io_uring
+//
+// Parameters: None
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11Uring::
+_reap (void)
+{
+  Vxi11UringRing *p_ring = _p_ring;
+  unsigned head = *p_ring->p_cq_head;
+  unsigned tail = __atomic_load_n (p_ring->p_cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    io_uring_cqe *p_cqe = &p_ring->a_cqe[head & *p_ring->p_cq_mask];
+    uint64_t user_data = p_cqe->user_data;
+    int res = p_cqe->res;
+    head++;
+    __atomic_store_n (p_ring->p_cq_head, head, __ATOMIC_RELEASE);
+
+    if (!user_data)                     // Completion of a cancellation
+      continue;
+
+    Vxi11TransportUring *p_transport =
+      (Vxi11TransportUring *)(uintptr_t)(user_data & ~uint64_t (OP_MASK));
+    _stats.cnt_complete++;
+    p_transport->_cnt_op--;
+
+    if ((user_data & OP_MASK) == OP_SEND) {
+      p_transport->_b_send_op = false;
+      if (res < 0)
+        p_transport->_fail (RPC_CANTSEND, strerror (-res));
+      else
+        p_transport->_sent (res);
+      }
+    else {
+      p_transport->_b_recv_op = false;
+      if (res < 0)
+        p_transport->_fail (RPC_CANTRECV, strerror (-res));
+      else if (res == 0)
+        p_transport->_fail (RPC_CANTRECV, "connection closed by device");
+      else
+        p_transport->_received (res);
+      }
+
+    tail = __atomic_load_n (p_ring->p_cq_tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+// ***************************************************************************
+// Vxi11Uring::_start - Start a call that was encoded by call_submit()
+//
+// Parameters:
+// 1. p_transport - Transport of the call
+//
+// Returns: None
+//
+// Notes: With io_uring, the send and the receive of the reply are queued
+//        for the next _enter().  With epoll, the data is sent by wait().
+//        Also called with io_uring to send the rest of a call partly sent.
+// ***************************************************************************
+  void Vxi11Uring::
+_start (Vxi11TransportUring *p_transport)
+{
+  if (!p_transport->_off_send)          // New call
+    _a_p_call.push_back (p_transport);
+
+  if (!_b_uring)
+    return;
+
+  io_uring_sqe *p_sqe = (io_uring_sqe *)_sqe_get ();
+  if (!p_sqe) {
+    p_transport->_fail (RPC_CANTSEND, "io_uring submission ring full");
+    return;
+    }
+  p_sqe->opcode = IORING_OP_SEND;
+  p_sqe->fd = p_transport->_sock;
+  p_sqe->addr = (uint64_t)(uintptr_t)(p_transport->_ac_send +
+                                      p_transport->_off_send);
+  p_sqe->len = p_transport->_len_send - p_transport->_off_send;
+  p_sqe->msg_flags = MSG_NOSIGNAL;
+  p_sqe->user_data = (uint64_t)(uintptr_t)p_transport | OP_SEND;
+  p_transport->_b_send_op = true;
+  p_transport->_cnt_op++;
+  _stats.cnt_submit++;
+
+  if (!p_transport->_b_recv_op)
+    _recv (p_transport);
+}
+
+// ***************************************************************************
+// Vxi11Uring::_recv - Start receiving more of the reply
+//
+// Parameters:
+// 1. p_transport - Transport of the call
+//
+// Returns: None
+//
+// Notes: The receive buffer is grown first if the reply does not fit.  With
+//        io_uring, a registered buffer is read with IORING_OP_READ_FIXED.
+//        With epoll, the data is received by wait() when it arrives.
+// ***************************************************************************
+  void Vxi11Uring::
+_recv (Vxi11TransportUring *p_transport)
+{
+  if (p_transport->_grow ())
+    return;
+
+  if (!_b_uring)
+    return;
+
+  io_uring_sqe *p_sqe = (io_uring_sqe *)_sqe_get ();
+  if (!p_sqe) {
+    p_transport->_fail (RPC_CANTRECV, "io_uring submission ring full");
+    return;
+    }
+  bool b_fixed = (p_transport->_idx_buf >= 0 &&
+                  p_transport->_ac_recv != p_transport->_ac_recv_heap);
+  p_sqe->opcode = (b_fixed) ? IORING_OP_READ_FIXED : IORING_OP_RECV;
+  p_sqe->fd = p_transport->_sock;
+  p_sqe->addr = (uint64_t)(uintptr_t)(p_transport->_ac_recv +
+                                      p_transport->_len_recv);
+  p_sqe->len = p_transport->_len_recv_max - p_transport->_len_recv;
+  if (b_fixed)
+    p_sqe->buf_index = p_transport->_idx_buf;
+  p_sqe->user_data = (uint64_t)(uintptr_t)p_transport | OP_RECV;
+  p_transport->_b_recv_op = true;
+  p_transport->_cnt_op++;
+  _stats.cnt_submit++;
+}
+
+// ***************************************************************************
+// Vxi11Uring::_cancel - Cancel the I/O in progress of a call that failed
+//
+// Parameters:
+// 1. p_transport - Transport of the call
+//
+// Returns: None
+//
+// Notes: With io_uring, the cancelled operations still complete, and the
+//        call is finished by wait() when they have.
+// ***************************************************************************
+  void Vxi11Uring::
+_cancel (Vxi11TransportUring *p_transport)
+{
+  if (!_b_uring) {
+    if (p_transport->_b_send_op) {      // Stop waiting to send
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.ptr = p_transport;
+      _stats.cnt_syscall++;
+      epoll_ctl (_fd, EPOLL_CTL_MOD, p_transport->_sock, &event);
+      p_transport->_b_send_op = false;
+      }
+    return;
+    }
+
+  for (int op=OP_SEND; op <= OP_RECV; op++) {
+    if ((op == OP_SEND) ? !p_transport->_b_send_op :
+                          !p_transport->_b_recv_op)
+      continue;
+    io_uring_sqe *p_sqe = (io_uring_sqe *)_sqe_get ();
+    if (!p_sqe)
+      continue;
+    p_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    p_sqe->fd = -1;
+    p_sqe->addr = (uint64_t)(uintptr_t)p_transport | op;
+    p_sqe->user_data = 0;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Uring::_send_epoll - Send the rest of a call with send()
+//
+// Parameters:
+// 1. p_transport - Transport of the call
+//
+// Returns: None
+//
+// Notes: If the socket is full, EPOLLOUT is waited for.
+// ***************************************************************************
+  void Vxi11Uring::
+_send_epoll (Vxi11TransportUring *p_transport)
+{
+  while (!p_transport->_b_done &&
+         p_transport->_off_send < p_transport->_len_send) {
+    _stats.cnt_syscall++;
+    _stats.cnt_submit++;
+    int cnt = send (p_transport->_sock,
+                    p_transport->_ac_send + p_transport->_off_send,
+                    p_transport->_len_send - p_transport->_off_send,
+                    MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (cnt >= 0) {
+      _stats.cnt_complete++;
+      p_transport->_off_send += cnt;
+      if (p_transport->_off_send >= p_transport->_len_send)
+        p_transport->_t_sent_ns = Vxi11Tracer::time_ns ();
+      continue;
+      }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      p_transport->_fail (RPC_CANTSEND, strerror (errno));
+      return;
+      }
+
+    // Wait until the socket can take more
+    if (!p_transport->_b_send_op) {
+      epoll_event event;
+      event.events = EPOLLIN | EPOLLOUT;
+      event.data.ptr = p_transport;
+      _stats.cnt_syscall++;
+      epoll_ctl (_fd, EPOLL_CTL_MOD, p_transport->_sock, &event);
+      p_transport->_b_send_op = true;
+      }
+    return;
+    }
+
+  // All sent, stop waiting for EPOLLOUT
+  if (p_transport->_b_send_op) {
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = p_transport;
+    _stats.cnt_syscall++;
+    epoll_ctl (_fd, EPOLL_CTL_MOD, p_transport->_sock, &event);
+    p_transport->_b_send_op = false;
+    }
+}
+
+// ***************************************************************************
+// Vxi11Uring::_wait_epoll - Wait for epoll events and process them
+//
+// Parameters:
+// 1. t_end_ns - Time to stop waiting, from Vxi11Tracer::time_ns()
+//
+// Returns: Number of events, 0 if the wait timed out
+// ***************************************************************************
+  int Vxi11Uring::
+_wait_epoll (long long t_end_ns)
+{
+  long long t_ns = t_end_ns - Vxi11Tracer::time_ns ();
+  int timeout_ms = (t_ns > 0) ? int ((t_ns + 999999) / 1000000) : 0;
+
+  epoll_event a_event[CNT_EVENT_MAX];
+  _stats.cnt_syscall++;
+  int cnt_event = epoll_wait (_fd, a_event, CNT_EVENT_MAX, timeout_ms);
+  if (cnt_event < 0)
+    return (0);
+
+  for (int i=0; i < cnt_event; i++) {
+    Vxi11TransportUring *p_transport =
+      (Vxi11TransportUring *)a_event[i].data.ptr;
+
+    if (a_event[i].events & EPOLLOUT)
+      _send_epoll (p_transport);
+
+    if (!(a_event[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+      continue;
+    if (p_transport->_grow ())
+      continue;
+    _stats.cnt_syscall++;
+    _stats.cnt_submit++;
+    int cnt = recv (p_transport->_sock,
+                    p_transport->_ac_recv + p_transport->_len_recv,
+                    p_transport->_len_recv_max - p_transport->_len_recv,
+                    MSG_DONTWAIT);
+    if (cnt > 0) {
+      _stats.cnt_complete++;
+      p_transport->_received (cnt);
+      }
+    else if (cnt == 0 ||
+             (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      // Stop watching the socket, which stays readable
+      _stats.cnt_syscall++;
+      epoll_ctl (_fd, EPOLL_CTL_DEL, p_transport->_sock, 0);
+      p_transport->_fail (RPC_CANTRECV, (cnt == 0) ?
+                          "connection closed by device" : strerror (errno));
+      }
+    }
+
+  return (cnt_event);
+}
+
+// ***************************************************************************
+// Vxi11Uring::submit - Send the calls started with call_submit() now
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = io_uring_enter() failed, wait() ends the calls
+//
+// Notes: With io_uring, the sends of all calls are submitted with one
+//        io_uring_enter() and the completions already there are processed.
+//        With epoll, send() is called for each call in turn.  Used to
+//        release calls encoded ahead of time as close together as possible.
+// ***************************************************************************
+  int Vxi11Uring::
+submit (void)
+{
+  if (!_b_uring) {
+    for (size_t i=0; i < _a_p_call.size (); i++)
+      _send_epoll (_a_p_call[i]);
+    return (0);
+    }
+
+  int ret = _enter (_p_ring->cnt_to_submit, 0, 0);
+  _reap ();
+  return (ret < 0);
+}
+
+// ***************************************************************************
+// Vxi11Uring::wait - Finish the calls started with call_submit()
+//
+// Parameters: None
+//
+// Returns: Number of calls that failed, see call_result() of each transport
+//
+// Notes: With io_uring, the entries of all calls are submitted, and the
+//        completions of all calls are waited for, with one io_uring_enter().
+//        A call that has a partial reply is waited for again.  Each call
+//        times out at the timeout of its transport.
+// ***************************************************************************
+  int Vxi11Uring::
+wait (void)
+{
+  _stats.cnt_wait++;
+  int cnt_fail = 0;
+
+  if (!_b_uring)                        // Send all calls first
+    for (size_t i=0; i < _a_p_call.size (); i++)
+      _send_epoll (_a_p_call[i]);
+
+  while (!_a_p_call.empty ()) {
+    // Remove the finished calls, and time out the late ones
+    long long t_ns = Vxi11Tracer::time_ns ();
+    long long t_end_ns = t_ns + 3600000000000LL;
+    int cnt_op = 0;
+    for (size_t i=0; i < _a_p_call.size (); ) {
+      Vxi11TransportUring *p_transport = _a_p_call[i];
+      if (!p_transport->_b_done && t_ns >= p_transport->_t_end_ns)
+        p_transport->_fail (RPC_TIMEDOUT, "timed out");
+      if (p_transport->_b_done && !p_transport->_cnt_op) {
+        _stats.cnt_call++;
+        if (p_transport->_stat != RPC_SUCCESS)
+          cnt_fail++;
+        _a_p_call[i] = _a_p_call.back ();
+        _a_p_call.pop_back ();
+        continue;
+        }
+      if (!p_transport->_b_done && p_transport->_t_end_ns < t_end_ns)
+        t_end_ns = p_transport->_t_end_ns;
+      cnt_op += p_transport->_cnt_op;
+      i++;
+      }
+    if (_a_p_call.empty ())
+      break;
+
+    if (!_b_uring) {
+      _wait_epoll (t_end_ns);
+      continue;
+      }
+
+    // Wait for every operation in progress, which reaps the replies of all
+    // links together
+    int ret = _enter (_p_ring->cnt_to_submit, cnt_op, t_end_ns);
+    if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+      for (size_t i=0; i < _a_p_call.size (); i++)
+        _a_p_call[i]->_fail (RPC_SYSTEMERROR, strerror (-ret));
+      }
+    _reap ();
+    }
+
+  return (cnt_fail);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring constructor - Not connected yet
+//
+// Parameters:
+// 1. p_uring - I/O of this transport, which must exist until the transport
+//              is deleted; null to create one for this transport only
+// ***************************************************************************
+  Vxi11TransportUring::
+Vxi11TransportUring (Vxi11Uring *p_uring)
+{
+  _b_uring_own = !p_uring;
+  _p_uring = (p_uring) ? p_uring : new Vxi11Uring (1);
+  _sock = -1;
+  _xid = (unsigned int)(Vxi11Tracer::time_ns () ^ getpid ());
+  _timeout_ms = 25000;
+  _s_error[0] = 0;
+
+  _ac_send = 0;
+  _len_send_max = 0;
+  _len_send = 0;
+  _off_send = 0;
+  _xdr_res = 0;
+  _p_res = 0;
+  _t_end_ns = 0;
+  _t_sent_ns = 0;
+  _stat = RPC_SUCCESS;
+  _b_done = true;
+  _cnt_op = 0;
+  _b_send_op = false;
+  _b_recv_op = false;
+
+  _idx_buf = -1;
+  _ac_recv = 0;
+  _ac_recv_heap = 0;
+  _len_recv_max = 0;
+  _len_recv = 0;
+  _len_need = 0;
+}
+
+// ***************************************************************************
+// Vxi11TransportUring destructor - Disconnect and release the buffers
+// ***************************************************************************
+  Vxi11TransportUring::
+~Vxi11TransportUring ()
+{
+  close ();
+  free (_ac_send);
+  if (_b_uring_own)
+    delete _p_uring;
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::open - Connect to the core channel of a device
+//
+// Parameters:
+// 1. s_host - Host name or IP address of the device
+// 2. port   - TCP port of the core channel, 0 to ask the portmapper of the
+//             device
+//
+// Returns: 0 = no error
+//          1 = error, see error()
+// ***************************************************************************
+  int Vxi11TransportUring::
+open (const char *s_host, int port)
+{
+  close ();
+
+  if (_p_uring->_fd < 0) {
+    snprintf (_s_error, sizeof (_s_error), "no io_uring or epoll");
+    return (1);
+    }
+
+  hostent *p_hostent = gethostbyname (s_host);
+  if (!p_hostent) {
+    snprintf (_s_error, sizeof (_s_error), "unknown host %s", s_host);
+    return (1);
+    }
+  sockaddr_in sockaddr;
+  memset (&sockaddr, 0, sizeof (sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_addr.s_addr = *(unsigned int *)(p_hostent->h_addr_list[0]);
+
+  if (!port) {
+    port = pmap_getport (&sockaddr, DEVICE_CORE, DEVICE_CORE_VERSION,
+                         IPPROTO_TCP);
+    if (!port) {
+      snprintf (_s_error, sizeof (_s_error),
+                "no core channel port from the portmapper of %s", s_host);
+      return (1);
+      }
+    }
+  sockaddr.sin_port = htons (port);
+
+  int sock = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0 || connect (sock, (struct sockaddr *)&sockaddr,
+                           sizeof (sockaddr))) {
+    snprintf (_s_error, sizeof (_s_error), "connect to %s:%d: %s", s_host,
+              port, strerror (errno));
+    if (sock >= 0)
+      ::close (sock);
+    return (1);
+    }
+  int b_nodelay = 1;
+  setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, &b_nodelay, sizeof (b_nodelay));
+
+  // With epoll, the socket is nonblocking and always watched for replies
+  if (!_p_uring->_b_uring) {
+    fcntl (sock, F_SETFL, fcntl (sock, F_GETFL) | O_NONBLOCK);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = this;
+    if (epoll_ctl (_p_uring->_fd, EPOLL_CTL_ADD, sock, &event)) {
+      snprintf (_s_error, sizeof (_s_error), "epoll_ctl: %s",
+                strerror (errno));
+      ::close (sock);
+      return (1);
+      }
+    }
+
+  // Receive into a registered buffer if one is left
+  _idx_buf = _p_uring->_buf_alloc ();
+  if (_idx_buf >= 0) {
+    _ac_recv = _p_uring->_ac_buf_fixed +
+               size_t (_idx_buf) * Vxi11Uring::LEN_BUF_FIXED;
+    _len_recv_max = Vxi11Uring::LEN_BUF_FIXED;
+    }
+  else {
+    _ac_recv_heap = (char *)malloc (Vxi11Uring::LEN_BUF_FIXED);
+    _ac_recv = _ac_recv_heap;
+    _len_recv_max = (_ac_recv) ? int (Vxi11Uring::LEN_BUF_FIXED) : 0;
+    }
+  _len_recv = 0;
+  _len_need = 0;
+
+  _sock = sock;
+  _b_done = true;
+  _cnt_op = 0;
+  _b_send_op = false;
+  _b_recv_op = false;
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::close - Disconnect from the device
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: A call in progress is cancelled first.
+// ***************************************************************************
+  void Vxi11TransportUring::
+close (void)
+{
+  if (_sock < 0)
+    return;
+
+  if (!_b_done || _cnt_op) {
+    _fail (RPC_FAILED, "closed");
+    _p_uring->wait ();
+    }
+
+  if (!_p_uring->_b_uring)
+    epoll_ctl (_p_uring->_fd, EPOLL_CTL_DEL, _sock, 0);
+  ::close (_sock);
+  _sock = -1;
+
+  _p_uring->_buf_free (_idx_buf);
+  _idx_buf = -1;
+  free (_ac_recv_heap);
+  _ac_recv_heap = 0;
+  _ac_recv = 0;
+  _len_recv_max = 0;
+  _len_recv = 0;
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::call_submit - Start a call
+//
+// Parameters:
+// 1. proc     - Procedure number, for example device_write
+// 2. xdr_args - XDR routine of the arguments
+// 3. p_args   - Arguments
+// 4. xdr_res  - XDR routine of the results
+// 5. p_res    - Returns the results; must be cleared before the call, and
+//               released with free_result() after use
+//
+// Returns: 0 = call started, finish it with Vxi11Uring::wait()
+//          1 = error, see call_result() and error()
+//
+// Notes: The call record is encoded here, so the calls of many links can
+//        be sent together by wait().
+// ***************************************************************************
+  int Vxi11TransportUring::
+call_submit (u_long proc, xdrproc_t xdr_args, void *p_args,
+             xdrproc_t xdr_res, void *p_res)
+{
+  if (_sock < 0 || !_b_done || _cnt_op) {
+    snprintf (_s_error, sizeof (_s_error),
+              (_sock < 0) ? "not open" : "call already in progress");
+    _stat = RPC_FAILED;
+    return (1);
+    }
+
+  // Encode the call after the fragment header, growing the buffer until it
+  // fits
+  rpc_msg msg;
+  memset (&msg, 0, sizeof (msg));
+  msg.rm_xid = _xid + 1;
+  msg.rm_direction = CALL;
+  msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
+  msg.rm_call.cb_prog = DEVICE_CORE;
+  msg.rm_call.cb_vers = DEVICE_CORE_VERSION;
+  msg.rm_call.cb_proc = proc;
+  msg.rm_call.cb_cred = _null_auth;
+  msg.rm_call.cb_verf = _null_auth;
+
+  int len_msg = -1;
+  while (len_msg < 0) {
+    if (_len_send_max > 4) {
+      XDR xdr;
+      xdrmem_create (&xdr, _ac_send + 4, _len_send_max - 4, XDR_ENCODE);
+      if (xdr_callmsg (&xdr, &msg) && xdr_args (&xdr, p_args))
+        len_msg = xdr_getpos (&xdr);
+      XDR_DESTROY (&xdr);
+      if (len_msg >= 0)
+        break;
+      }
+    int len_max = (_len_send_max) ? 2 * _len_send_max : 8192;
+    char *ac_send = (len_max <= LEN_SEND_MAX) ?
+                    (char *)realloc (_ac_send, len_max) : 0;
+    if (!ac_send) {
+      snprintf (_s_error, sizeof (_s_error), "cannot encode arguments");
+      _stat = RPC_CANTENCODEARGS;
+      return (1);
+      }
+    _ac_send = ac_send;
+    _len_send_max = len_max;
+    }
+  uint32_t header = htonl (RM_LAST | uint32_t (len_msg));
+  memcpy (_ac_send, &header, 4);
+
+  _xid++;
+  _len_send = len_msg + 4;
+  _off_send = 0;
+  _xdr_res = xdr_res;
+  _p_res = p_res;
+  _t_end_ns = Vxi11Tracer::time_ns () + _timeout_ms * 1000000LL;
+  _t_sent_ns = 0;
+  _stat = RPC_SUCCESS;
+  _b_done = false;
+  _s_error[0] = 0;
+
+  // Go back to the registered buffer after a large reply
+  if (!_len_recv && _idx_buf >= 0) {
+    _ac_recv = _p_uring->_ac_buf_fixed +
+               size_t (_idx_buf) * Vxi11Uring::LEN_BUF_FIXED;
+    _len_recv_max = Vxi11Uring::LEN_BUF_FIXED;
+    }
+
+  _p_uring->_start (this);
+  return (0);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_call - Make one call and wait for its reply
+//
+// Parameters: See Vxi11Transport::call()
+//
+// Returns: RPC status
+//
+// Notes: Calls started with call_submit() on other transports of the same
+//        Vxi11Uring are finished too.
+// ***************************************************************************
+  enum clnt_stat Vxi11TransportUring::
+_call (u_long proc, xdrproc_t xdr_args, void *p_args, xdrproc_t xdr_res,
+       void *p_res)
+{
+  if (!call_submit (proc, xdr_args, p_args, xdr_res, p_res))
+    _p_uring->wait ();
+  return (_stat);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_cancel - End the call in progress
+//
+// Parameters: None
+//
+// Returns: None
+//
+// Notes: Shuts down the socket, so the call in progress fails.
+// ***************************************************************************
+  void Vxi11TransportUring::
+_cancel (void)
+{
+  if (_sock >= 0)
+    shutdown (_sock, SHUT_RDWR);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::free_result - Release the memory of results
+//
+// Parameters:
+// 1. xdr_res - XDR routine of the results
+// 2. p_res   - Results of call()
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportUring::
+free_result (xdrproc_t xdr_res, void *p_res)
+{
+  xdr_free (xdr_res, (char *)p_res);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::timeout - Set the time to wait for a reply
+//
+// Parameters:
+// 1. timeout_ms - Timeout, in ms
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportUring::
+timeout (int timeout_ms)
+{
+  _timeout_ms = timeout_ms;
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_fail - End the call in progress with an error
+//
+// Parameters:
+// 1. stat    - RPC status of the call
+// 2. s_error - Description of the error
+//
+// Returns: None
+//
+// Notes: Nothing is done if the call already ended.  If only part of the
+//        call was sent, the connection cannot be used anymore and is shut
+//        down.
+// ***************************************************************************
+  void Vxi11TransportUring::
+_fail (enum clnt_stat stat, const char *s_error)
+{
+  if (_b_done)
+    return;
+
+  _b_done = true;
+  _stat = stat;
+  snprintf (_s_error, sizeof (_s_error), "%s", s_error);
+
+  if (_off_send > 0 && _off_send < _len_send)
+    shutdown (_sock, SHUT_RDWR);
+  _p_uring->_cancel (this);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_sent - Process bytes of the call that were sent
+//
+// Parameters:
+// 1. cnt - Number of bytes sent
+//
+// Returns: None
+// ***************************************************************************
+  void Vxi11TransportUring::
+_sent (int cnt)
+{
+  _off_send += cnt;
+  if (_off_send >= _len_send)
+    _t_sent_ns = Vxi11Tracer::time_ns ();
+  else if (!_b_done)
+    _p_uring->_start (this);            // Send the rest
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_received - Process bytes of the reply received
+//
+// Parameters:
+// 1. cnt - Number of bytes received into _ac_recv
+//
+// Returns: None
+//
+// Notes: Replies of earlier calls that timed out are dropped.  If the reply
+//        is not complete, another receive is started.
+// ***************************************************************************
+  void Vxi11TransportUring::
+_received (int cnt)
+{
+  _len_recv += cnt;
+
+  int ret;
+  while ((ret = _parse ()) == 2)        // Drop the replies of old calls
+    ;
+
+  if (!ret && !_b_done)
+    _p_uring->_recv (this);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_parse - Decode the reply at the start of _ac_recv
+//
+// Parameters: None
+//
+// Returns: 0 = reply not complete, _len_need is set
+//          1 = reply of the call decoded, or it could not be decoded
+//          2 = reply of an old call dropped
+//
+// Notes: A record longer than LEN_RECV_MAX fails the call and shuts down
+//        the socket, as the stream cannot be followed after it.
+// ***************************************************************************
+  int Vxi11TransportUring::
+_parse (void)
+{
+  // Find the end of the record, at the fragment with RM_LAST
+  int pos = 0;
+  bool b_last = false;
+  while (!b_last) {
+    if (pos + 4 > _len_recv) {
+      _len_need = pos + 4;
+      return (0);
+      }
+    uint32_t header;
+    memcpy (&header, _ac_recv + pos, 4);
+    header = ntohl (header);
+    int len_frag = int (header & RM_LEN);
+    if (len_frag > LEN_RECV_MAX - pos - 4) {
+      _len_recv = 0;
+      _len_need = 0;
+      shutdown (_sock, SHUT_RDWR);
+      _fail (RPC_CANTDECODERES, "reply record too large");
+      return (1);
+      }
+    if (len_frag > _len_recv - pos - 4) {
+      _len_need = pos + 4 + len_frag;
+      return (0);
+      }
+    pos += 4 + len_frag;
+    b_last = (header & RM_LAST);
+    }
+  int len_record = pos;
+
+  // Join the fragments in place
+  int len_msg = 0;
+  for (pos=0; pos < len_record; ) {
+    uint32_t header;
+    memcpy (&header, _ac_recv + pos, 4);
+    int len_frag = int (ntohl (header) & RM_LEN);
+    memmove (_ac_recv + len_msg, _ac_recv + pos + 4, len_frag);
+    len_msg += len_frag;
+    pos += 4 + len_frag;
+    }
+
+  // Decode the reply if it is for the call in progress
+  uint32_t xid = 0;
+  if (len_msg >= 4) {
+    memcpy (&xid, _ac_recv, 4);
+    xid = ntohl (xid);
+    }
+  int ret = 2;
+  if (!_b_done && xid == _xid) {
+    rpc_msg reply;
+    memset (&reply, 0, sizeof (reply));
+    reply.acpted_rply.ar_verf = _null_auth;
+    reply.acpted_rply.ar_results.where = (caddr_t)_p_res;
+    reply.acpted_rply.ar_results.proc = _xdr_res;
+    XDR xdr;
+    xdrmem_create (&xdr, _ac_recv, len_msg, XDR_DECODE);
+    enum clnt_stat stat = RPC_SUCCESS;
+    if (!xdr_replymsg (&xdr, &reply))
+      stat = RPC_CANTDECODERES;
+    else if (reply.rm_reply.rp_stat != MSG_ACCEPTED)
+      stat = RPC_AUTHERROR;
+    else switch (reply.acpted_rply.ar_stat) {
+      case SUCCESS:       stat = RPC_SUCCESS;          break;
+      case PROG_UNAVAIL:  stat = RPC_PROGUNAVAIL;      break;
+      case PROG_MISMATCH: stat = RPC_PROGVERSMISMATCH; break;
+      case PROC_UNAVAIL:  stat = RPC_PROCUNAVAIL;      break;
+      case GARBAGE_ARGS:  stat = RPC_CANTDECODEARGS;   break;
+      default:            stat = RPC_SYSTEMERROR;      break;
+      }
+    XDR_DESTROY (&xdr);
+
+    _b_done = true;
+    _stat = stat;
+    if (stat != RPC_SUCCESS)
+      snprintf (_s_error, sizeof (_s_error), "%s", clnt_sperrno (stat));
+    ret = 1;
+    }
+
+  // Remove the record, keeping any data after it
+  memmove (_ac_recv, _ac_recv + len_record, _len_recv - len_record);
+  _len_recv -= len_record;
+  _len_need = 0;
+  return (ret);
+}
+
+// ***************************************************************************
+// Vxi11TransportUring::_grow - Make room in the receive buffer
+//
+// Parameters: None
+//
+// Returns: 0 = no error
+//          1 = out of memory or at LEN_RECV_MAX, the call failed
+//
+// Notes: Grows geometrically to at least _len_need bytes when the buffer is
+//        full or the reply is larger, up to LEN_RECV_MAX.  A registered buffer is replaced by a
+//        buffer on the heap, until the next call finds it empty.
+// ***************************************************************************
+  int Vxi11TransportUring::
+_grow (void)
+{
+  if (_len_recv < _len_recv_max && _len_need <= _len_recv_max)
+    return (0);
+
+  int len_max = 2 * _len_recv_max;
+  if (len_max < _len_need)
+    len_max = _len_need;
+  if (len_max < Vxi11Uring::LEN_BUF_FIXED)
+    len_max = Vxi11Uring::LEN_BUF_FIXED;
+  if (len_max > LEN_RECV_MAX)
+    len_max = LEN_RECV_MAX;
+  if (len_max <= _len_recv_max) {
+    _fail (RPC_CANTRECV, "reply too large");
+    return (1);
+    }
+
+  bool b_fixed = (_ac_recv != _ac_recv_heap);
+  char *ac_recv = (char *)realloc (_ac_recv_heap, len_max);
+  if (!ac_recv) {
+    _fail (RPC_CANTRECV, "out of memory for the reply");
+    return (1);
+    }
+  if (b_fixed)
+    memcpy (ac_recv, _ac_recv, _len_recv);
+  _ac_recv_heap = ac_recv;
+  _ac_recv = ac_recv;
+  _len_recv_max = len_max;
+  return (0);
+}
@@ -0,0 +1,204 @@
+#ifndef VXI11_URING_H
+#define VXI11_URING_H
+
+// ***************************************************************************
+// vxi11_uring.h - io_uring transport of the VXI-11 core channel for
+//                 libvxi11.so library (Linux only)
+//
+// Written by Eddie Lew, Lew Engineering
+// Copyright (C) 2020 Eddie Lew
+//
+// Edit history:
+//
+// 10-17-26 - Started file.
+// ***************************************************************************
+
+// ***************************************************************************
+// Vxi11TransportUring carries the DEVICE_CORE calls of one link as ONC-RPC
+// records on its own TCP socket, without the tirpc client.  The I/O of many
+// links is done by one Vxi11Uring:
+//
+//   io_uring  The send and the receive of a call are submitted, and their
+//             completions reaped, with one io_uring_enter() in the usual
+//             case.  Replies are received into buffers registered with the
+//             ring, so device_read payloads are not copied by the kernel
+//             into a new buffer for every call.
+//   epoll     Used if io_uring is not available (Linux before 5.11, or
+//             disabled by kernel.io_uring_disabled): nonblocking send() and
+//             recv() with epoll_wait() for the replies.
+//
+// Calls on several links are batched with call_submit() on each transport
+// followed by one Vxi11Uring::wait(); the sends of all links are submitted
+// together and the replies are reaped as they arrive.  A Vxi11Uring is used
+// by one thread at a time.  Example with the Vxi11 class:
+//
+//   Vxi11Uring uring;
+//   Vxi11 vxi11;
+//   vxi11.open ("192.168.1.10", 0, new Vxi11TransportUring (&uring));
+//
+// stats() of the Vxi11Uring counts the system calls made, for comparing
+// syscalls per query with the tirpc transport.
+// ***************************************************************************
+
+#include "vxi11_transport.h"
+
+#include <vector>
+
+class Vxi11TransportUring;
+
+// Counters of a Vxi11Uring, see Vxi11Uring::stats()
+struct Vxi11UringStats {
+  unsigned long cnt_syscall;            // System calls made for the calls:
+                                        // io_uring_enter(), or send(),
+                                        // recv(), epoll_wait() and
+                                        // epoll_ctl()
+  unsigned long cnt_submit;             // Sends and receives started
+  unsigned long cnt_complete;           // Sends and receives completed
+  unsigned long cnt_call;               // RPC calls finished
+  unsigned long cnt_wait;               // Calls of wait()
+};
+
+// ***************************************************************************
+// Vxi11Uring - io_uring, or epoll, shared by the transports of many links
+// ***************************************************************************
+class Vxi11Uring {
+  friend class Vxi11TransportUring;
+
+ private:
+  bool _b_uring;                        // true = io_uring, false = epoll
+  int _fd;                              // io_uring or epoll file descriptor
+  void *__p_ring;                       // Mapped rings, type Vxi11UringRing*
+                                        // Use macro _p_ring for access
+  char *_ac_buf_fixed;                  // Registered receive buffers, null
+                                        // if none
+  int _cnt_buf_fixed;                   // Number of registered buffers
+  std::vector<int> _a_idx_buf_free;     // Registered buffers not in use
+  std::vector<Vxi11TransportUring *> _a_p_call; // Transports with a call
+                                        // in progress
+  Vxi11UringStats _stats;               // Counters
+
+  int _setup_uring (int cnt_link_max);  // Set up io_uring
+  void *_sqe_get (void);                // Get the next submission entry
+  int _enter (int cnt_submit, int cnt_wait, long long t_end_ns);
+  void _reap (void);                    // Process the completions
+  int _wait_epoll (long long t_end_ns); // Wait for the epoll events
+  void _send_epoll (Vxi11TransportUring *p_transport); // Send with send()
+  void _start (Vxi11TransportUring *p_transport); // Start sending a call
+  void _recv (Vxi11TransportUring *p_transport);  // Start a receive
+  void _cancel (Vxi11TransportUring *p_transport); // Cancel the I/O of a
+                                        // call that failed
+  int _buf_alloc (void);                // Get a registered buffer, -1 if none
+  void _buf_free (int idx_buf);         // Release a registered buffer
+
+ public:
+  enum {LEN_BUF_FIXED = 65536};         // Size of each registered buffer
+
+  // Set up io_uring for up to cnt_link_max links with registered buffers,
+  // or epoll if io_uring is not available or b_uring is false
+  // More links can be used, with unregistered buffers.
+  Vxi11Uring (int cnt_link_max = 64, bool b_uring = true);
+  ~Vxi11Uring ();
+
+  // true = io_uring is used, false = epoll
+  bool uring (void) { return (_b_uring); }
+
+  // Send the calls started with Vxi11TransportUring::call_submit() now,
+  // without waiting for the replies; wait() still has to be called
+  // Returns 1 if the sends could not be submitted.
+  int submit (void);
+
+  // Finish the calls started with Vxi11TransportUring::call_submit()
+  // Each call ends at its reply, or at the timeout of its transport.
+  // Returns the number of calls that failed.
+  int wait (void);
+
+  // Get/reset the counters
+  const Vxi11UringStats &stats (void) { return (_stats); }
+  void stats_reset (void);
+};
+
+// ***************************************************************************
+// Vxi11TransportUring - Transport through a Vxi11Uring
+// ***************************************************************************
+class Vxi11TransportUring : public Vxi11Transport {
+  friend class Vxi11Uring;
+
+ private:
+  Vxi11Uring *_p_uring;                 // I/O of this transport
+  bool _b_uring_own;                    // _p_uring was created here
+  int _sock;                            // TCP socket, -1 if not open
+  unsigned int _xid;                    // Transaction ID of the last call
+  int _timeout_ms;                      // Time to wait for a reply, in ms
+  char _s_error[256];                   // Description of last error
+
+  // Call in progress
+  char *_ac_send;                       // Call record to send
+  int _len_send_max;                    // Size of _ac_send
+  int _len_send;                        // Bytes in the call record
+  int _off_send;                        // Bytes sent so far
+  xdrproc_t _xdr_res;                   // XDR routine of the results
+  void *_p_res;                         // Results of the call
+  long long _t_end_ns;                  // Time the call times out
+  long long _t_sent_ns;                 // Time the call was sent, 0 if not
+  enum clnt_stat _stat;                 // Status of the call
+  bool _b_done;                         // Reply received or call failed
+  int _cnt_op;                          // Sends and receives in the kernel
+  bool _b_send_op;                      // A send is in the kernel
+  bool _b_recv_op;                      // A receive is in the kernel
+
+  // Receive buffer
+  int _idx_buf;                         // Registered buffer, -1 if none
+  char *_ac_recv;                       // Received data, a registered buffer
+                                        // or _ac_recv_heap
+  char *_ac_recv_heap;                  // Buffer that is not registered
+  int _len_recv_max;                    // Size of _ac_recv
+  int _len_recv;                        // Bytes received
+  int _len_need;                        // Bytes needed for the reply, as
+                                        // far as known
+
+  void _fail (enum clnt_stat stat, const char *s_error);
+  void _sent (int cnt);                 // Process bytes sent
+  void _received (int cnt);             // Process bytes received
+  int _parse (void);                    // Decode a complete reply
+  int _grow (void);                     // Make room for _len_need bytes
+
+ protected:
+  virtual enum clnt_stat _call (u_long proc, xdrproc_t xdr_args,
+                                void *p_args, xdrproc_t xdr_res,
+                                void *p_res);
+  virtual void _cancel (void);
+
+ public:
+  // Use p_uring for the I/O, which must exist until the transport is
+  // deleted; null to use a Vxi11Uring of this transport only
+  Vxi11TransportUring (Vxi11Uring *p_uring = 0);
+  ~Vxi11TransportUring ();
+
+  // Connect to the core channel of s_host, with the portmapper of s_host if
+  // port is 0
+  virtual int open (const char *s_host, int port);
+  virtual void close (void);
+  virtual void free_result (xdrproc_t xdr_res, void *p_res);
+  virtual void timeout (int timeout_ms);
+  virtual int fd (void) { return (_sock); }
+  virtual unsigned int xid_last (void) { return (_xid); }
+  virtual const char *error (void) { return (_s_error); }
+
+  // Start a call without waiting for the reply; finish it, with the calls
+  // started on other transports of the same Vxi11Uring, with
+  // Vxi11Uring::wait(), then get its status with call_result()
+  // p_res must be cleared before, and released with free_result() after.
+  int call_submit (u_long proc, xdrproc_t xdr_args, void *p_args,
+                   xdrproc_t xdr_res, void *p_res);
+  enum clnt_stat call_result (void) { return (_stat); }
+
+  // Get the time the last call was all sent, from Vxi11Tracer::time_ns(),
+  // 0 if it was not
+  // With io_uring, this is when the completion of the send was processed.
+  long long t_sent_ns (void) { return (_t_sent_ns); }
+
+  // Get the Vxi11Uring of this transport
+  Vxi11Uring *uring (void) { return (_p_uring); }
+};
+
+#endif